@@ -18,3 +18,9 @@ group ""
 
 include "Dependencies.lua"
 include "Game/Build-Game.lua"
+
+group "Tools"
+    include "Tools/AssetCooker/Build-AssetCooker.lua"
+    include "Tools/AssetPacker/Build-AssetPacker.lua"
+    include "Tools/MeshBenchmark/Build-MeshBenchmark.lua"
+group ""
@@ -5,11 +5,18 @@ project "Game"
    targetdir "Binaries/%{cfg.buildcfg}"
    staticruntime "off"
 
-   files { "Source/Components/**.h", "Source/Components/**.cpp",
+   files { "Source/Animation/**.h", "Source/Animation/**.cpp",
+    "Source/Assets/**.h", "Source/Assets/**.cpp",
+    "Source/Components/**.h", "Source/Components/**.cpp",
+    "Source/Compression/**.h", "Source/Compression/**.cpp",
     "Source/Containers/**.h", "Source/Containers/**.cpp",
+    "Source/Hashing/**.h", "Source/Hashing/**.cpp",
     "Source/Logging/**.h", "Source/Logging/**.cpp",
     "Source/Memory/**.h", "Source/Memory/**.cpp",
+    "Source/Models/**.h", "Source/Models/**.cpp",
     "Source/Systems/**.h", "Source/Systems/**.cpp",
+    "Source/Textures/**.h", "Source/Textures/**.cpp",
+    "Source/Threading/**.h", "Source/Threading/**.cpp",
     "Source/Rendering/**.h", "Source/Rendering/**.cpp",
     "Source/App.cpp", "Source/common.h", "Source/Engine*",
     "Source/FileIO/**.h", "Source/FileIO/**.cpp",
@@ -73,6 +80,7 @@ project "Game"
    links
    {
       vulkanSDKPath .. "/Lib/vulkan-1.lib",
+      vulkanSDKPath .. "/Lib/shaderc_shared.lib",
       "GLFW", "assimp"
    }
 
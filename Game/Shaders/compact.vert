@@ -0,0 +1,35 @@
+#version 450
+
+// Vertex shader of meshes packed with COMPACT_VERTEX_LAYOUT. Positions arrive
+// in [0, 1] of the mesh bounds, model has the dequantization folded in.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 normal_octahedral;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(binding = 0) uniform constants {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+    mat4 normal_mat;
+};
+
+const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+const float AMBIENT = 0.02;
+
+vec3 decode_octahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+    return normalize(normal);
+}
+
+void main() {
+    mat4 mvp = projection * view * model;
+    gl_Position = mvp * vec4(position, 1.0);
+    vec3 normal_world_space = normalize(mat3(normal_mat) * decode_octahedral(normal_octahedral));
+    float light_intensity = AMBIENT + max(dot(normal_world_space, DIRECTION_TO_LIGHT), 0);
+    fragColor = light_intensity * color;
+}
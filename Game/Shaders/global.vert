@@ -18,7 +18,7 @@ const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
 const float AMBIENT = 0.02;
 
 void main() {
-    mat4 mvp = model * view * projection;
+    mat4 mvp = projection * view * model;
     gl_Position = mvp * vec4(position, 1.0);
     vec3 normal_world_space = normalize(mat3(normal_mat) * normal);
     float light_intensity = AMBIENT + max(dot(normal_world_space, DIRECTION_TO_LIGHT), 0);
@@ -0,0 +1,64 @@
+#version 450
+
+// Vertex shader of meshes packed with COMPACT_SKINNED_VERTEX_LAYOUT. Positions
+// are dequantized to object space, blended over up to four joints of the
+// entity's palette and then transformed by model, which has no dequantization.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 normal_octahedral;
+layout(location = 3) in vec2 uv;
+layout(location = 4) in uvec4 joints;
+layout(location = 5) in vec4 weights;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(binding = 0) uniform constants {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+    mat4 normal_mat;
+    mat4 dequantization;
+    uint palette_offset;
+};
+
+// Top three rows of joint * inverse bind, see JointMatrix
+struct JointMatrix {
+    vec4 rows[3];
+};
+
+// Every character's palette back to back
+layout(std430, binding = 1) readonly buffer palettes {
+    JointMatrix joint_matrices[];
+};
+
+const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+const float AMBIENT = 0.02;
+
+vec3 decode_octahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+    return normalize(normal);
+}
+
+void main() {
+    // Weights are quantized to 8 bits and may not add up to exactly 1
+    vec4 joint_weights = weights / max(dot(weights, vec4(1.0)), 1e-5);
+    vec4 rows[3] = vec4[3](vec4(0.0), vec4(0.0), vec4(0.0));
+    for (int i = 0; i < 4; i++) {
+        JointMatrix joint = joint_matrices[palette_offset + joints[i]];
+        rows[0] += joint_weights[i] * joint.rows[0];
+        rows[1] += joint_weights[i] * joint.rows[1];
+        rows[2] += joint_weights[i] * joint.rows[2];
+    }
+    vec4 object_position = dequantization * vec4(position, 1.0);
+    vec3 skinned_position = vec3(dot(rows[0], object_position), dot(rows[1], object_position), dot(rows[2], object_position));
+    vec3 normal = decode_octahedral(normal_octahedral);
+    vec3 skinned_normal = vec3(dot(rows[0].xyz, normal), dot(rows[1].xyz, normal), dot(rows[2].xyz, normal));
+
+    mat4 mvp = projection * view * model;
+    gl_Position = mvp * vec4(skinned_position, 1.0);
+    vec3 normal_world_space = normalize(mat3(normal_mat) * skinned_normal);
+    float light_intensity = AMBIENT + max(dot(normal_world_space, DIRECTION_TO_LIGHT), 0);
+    fragColor = light_intensity * color;
+}
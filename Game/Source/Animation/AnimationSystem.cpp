@@ -0,0 +1,95 @@
+﻿#include "AnimationSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
+namespace engine {
+
+AnimationSystem::AnimationSystem(flecs::world& world, AssetCache<MeshAsset>& meshes, ThreadPool& thread_pool)
+    : m_world_(world), m_meshes_(meshes), m_thread_pool_(thread_pool) {
+    // Systems of a phase run in declaration order, so the gather finishes
+    // before the characters are animated
+    m_gather_system_ = world.system<const components::MeshRef, components::Animator>("Gather Animated Characters")
+        .kind(flecs::PreStore)
+        .each([this](const components::MeshRef& mesh_ref, components::Animator& animator) {
+            const MeshAsset* mesh = m_meshes_.get(mesh_ref.mesh);
+            if (mesh == nullptr || mesh->skeleton.empty()) {
+                animator.palette_offset = ~0u;
+                return;
+            }
+            m_characters_.push_back(AnimatedCharacter{mesh, &animator});
+        });
+    m_animate_system_ = world.system("Animate Characters")
+        .kind(flecs::PreStore)
+        .run([this](flecs::iter& iter) {
+            update(iter.delta_time());
+            iter.world().set(SkinningPalettes{m_palettes_});
+        });
+}
+
+AnimationSystem::~AnimationSystem() {
+    m_gather_system_.destruct();
+    m_animate_system_.destruct();
+    m_world_.remove<SkinningPalettes>();
+}
+
+void AnimationSystem::animate(const AnimatedCharacter& character, f32 delta_time, std::span<JointPose> local_poses, std::span<JointMatrix> palette) {
+    const MeshAsset& mesh = *character.mesh;
+    components::Animator& animator = *character.animator;
+    const std::span<const SkeletonJoint> joints{mesh.skeleton};
+    if (animator.clip >= mesh.animations.size()) {
+        // No clip to play holds the bind pose
+        for (size_t joint = 0; joint < joints.size(); joint++) {
+            local_poses[joint] = joints[joint].bind_pose;
+        }
+        compute_skinning_palette(joints, local_poses, palette);
+        return;
+    }
+    const AnimationClip& clip = mesh.animations[animator.clip];
+    animator.time += delta_time * animator.speed;
+    if (animator.looping && clip.duration > 0.0f) {
+        animator.time = std::fmod(animator.time, clip.duration);
+        if (animator.time < 0.0f) {
+            animator.time += clip.duration;
+        }
+    } else {
+        animator.time = std::clamp(animator.time, 0.0f, clip.duration);
+    }
+    sample_animation(clip, mesh.animation_poses, animator.time, local_poses);
+    compute_skinning_palette(joints, local_poses, palette);
+}
+
+void AnimationSystem::update(f32 delta_time) {
+    const auto start = std::chrono::steady_clock::now();
+    u32 joint_count = 0;
+    for (const AnimatedCharacter& character : m_characters_) {
+        character.animator->palette_offset = joint_count;
+        joint_count += static_cast<u32>(character.mesh->skeleton.size());
+    }
+    m_palettes_.resize(joint_count);
+    m_thread_pool_.parallel_for(m_characters_.size(), ANIMATED_CHARACTERS_PER_JOB, [this, delta_time](size_t begin, size_t end) {
+        std::array<JointPose, MAX_SKELETON_JOINTS> local_poses;
+        for (size_t i = begin; i < end; i++) {
+            const AnimatedCharacter& character = m_characters_[i];
+            const size_t character_joints = character.mesh->skeleton.size();
+            animate(character, delta_time, std::span{local_poses}.first(character_joints),
+                    std::span{m_palettes_}.subspan(character.animator->palette_offset, character_joints));
+        }
+    });
+    m_stats_.character_count = static_cast<u32>(m_characters_.size());
+    m_stats_.joint_count = joint_count;
+    m_stats_.update_milliseconds = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_characters_.clear();
+}
+
+std::span<const JointMatrix> AnimationSystem::get_palettes() const {
+    return m_palettes_;
+}
+
+const AnimationStats& AnimationSystem::get_stats() const {
+    return m_stats_;
+}
+
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "flecs.h"
+#include "Skinning.h"
+#include "Assets/AssetCache.h"
+#include "Assets/MeshAsset.h"
+#include "Components/Components.h"
+#include "Threading/ThreadPool.h"
+
+namespace engine {
+
+// Characters animated by one job, a 60 joint skeleton is a few microseconds each
+static constexpr size_t ANIMATED_CHARACTERS_PER_JOB = 4;
+
+// What the last frame's animation update cost
+struct AnimationStats {
+    u32 character_count = 0;
+    u32 joint_count = 0;
+    f32 update_milliseconds = 0.0f;
+};
+
+// World singleton the animation system sets every frame, every character's
+// palette back to back. The renderer uploads it for the skinned meshes, each
+// indexed by its Animator's palette_offset. Valid until the next update.
+struct SkinningPalettes {
+    std::span<const JointMatrix> matrices;
+};
+
+// Advances every entity with an Animator whose mesh is ready and skinned,
+// samples its clip and computes its skinning palette. Characters are gathered
+// first and then animated in parallel on the thread pool, each writing its
+// own range of the palette buffer at its Animator's palette_offset. The
+// palettes are published as the SkinningPalettes singleton.
+class AnimationSystem {
+    struct AnimatedCharacter {
+        const MeshAsset* mesh;
+        components::Animator* animator;
+    };
+
+    flecs::world& m_world_;
+    AssetCache<MeshAsset>& m_meshes_;
+    ThreadPool& m_thread_pool_;
+    std::vector<AnimatedCharacter> m_characters_;
+    // Every character's palette back to back, rebuilt every frame
+    std::vector<JointMatrix> m_palettes_;
+    AnimationStats m_stats_;
+    flecs::system m_gather_system_;
+    flecs::system m_animate_system_;
+
+    static void animate(const AnimatedCharacter& character, f32 delta_time, std::span<JointPose> local_poses, std::span<JointMatrix> palette);
+public:
+    AnimationSystem(flecs::world& world, AssetCache<MeshAsset>& meshes, ThreadPool& thread_pool);
+    AnimationSystem(const AnimationSystem&) = delete;
+    AnimationSystem& operator=(const AnimationSystem&) = delete;
+    AnimationSystem(AnimationSystem&&) = delete;
+    AnimationSystem& operator=(AnimationSystem&&) = delete;
+    ~AnimationSystem();
+
+    // Animates the characters gathered this frame, once per frame after the gather
+    void update(f32 delta_time);
+
+    [[nodiscard]] std::span<const JointMatrix> get_palettes() const;
+    [[nodiscard]] const AnimationStats& get_stats() const;
+};
+
+}
@@ -0,0 +1,109 @@
+﻿#include "Skinning.h"
+
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Simd.h"
+
+namespace engine {
+
+namespace {
+
+glm::mat4 compose(const JointPose& pose) {
+    glm::mat4 matrix = glm::mat4_cast(glm::quat{pose.rotation.w, pose.rotation.x, pose.rotation.y, pose.rotation.z});
+    matrix[0] *= pose.scale.x;
+    matrix[1] *= pose.scale.y;
+    matrix[2] *= pose.scale.z;
+    matrix[3] = glm::vec4{glm::vec3{pose.translation}, 1.0f};
+    return matrix;
+}
+
+#ifdef ENGINE_HAS_SSE
+struct Matrix {
+    __m128 columns[4];
+};
+
+Matrix load_matrix(const glm::mat4& matrix) {
+    return Matrix{_mm_loadu_ps(&matrix[0].x), _mm_loadu_ps(&matrix[1].x), _mm_loadu_ps(&matrix[2].x), _mm_loadu_ps(&matrix[3].x)};
+}
+
+__m128 transform(const Matrix& matrix, __m128 vector) {
+    __m128 result = _mm_mul_ps(matrix.columns[0], _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(0, 0, 0, 0)));
+    result = _mm_add_ps(result, _mm_mul_ps(matrix.columns[1], _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(1, 1, 1, 1))));
+    result = _mm_add_ps(result, _mm_mul_ps(matrix.columns[2], _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(2, 2, 2, 2))));
+    return _mm_add_ps(result, _mm_mul_ps(matrix.columns[3], _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+
+Matrix multiply(const Matrix& a, const Matrix& b) {
+    return Matrix{transform(a, b.columns[0]), transform(a, b.columns[1]), transform(a, b.columns[2]), transform(a, b.columns[3])};
+}
+
+__m128 lerp(__m128 a, __m128 b, __m128 blend) {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), blend));
+}
+
+// Dot product in every lane
+__m128 dot4(__m128 a, __m128 b) {
+    const __m128 products = _mm_mul_ps(a, b);
+    const __m128 pairs = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+#endif
+
+}
+
+void sample_animation(const AnimationClip& clip, std::span<const JointPose> poses, f32 time, std::span<JointPose> local_poses) {
+    const size_t joint_count = local_poses.size();
+    const f32 frame = std::clamp(time, 0.0f, clip.duration) * clip.sample_rate;
+    const u32 first_frame = std::min(static_cast<u32>(frame), clip.frame_count - 1);
+    const u32 second_frame = std::min(first_frame + 1, clip.frame_count - 1);
+    const f32 blend = frame - static_cast<f32>(first_frame);
+    const JointPose* from = poses.data() + clip.pose_offset + first_frame * joint_count;
+    const JointPose* to = poses.data() + clip.pose_offset + second_frame * joint_count;
+#ifdef ENGINE_HAS_SSE
+    // One joint part per vector, every lane blends the same way
+    const __m128 blend_lanes = _mm_set1_ps(blend);
+    for (size_t joint = 0; joint < joint_count; joint++) {
+        const __m128 translation = lerp(_mm_loadu_ps(&from[joint].translation.x), _mm_loadu_ps(&to[joint].translation.x), blend_lanes);
+        const __m128 rotation = lerp(_mm_loadu_ps(&from[joint].rotation.x), _mm_loadu_ps(&to[joint].rotation.x), blend_lanes);
+        const __m128 scale = lerp(_mm_loadu_ps(&from[joint].scale.x), _mm_loadu_ps(&to[joint].scale.x), blend_lanes);
+        _mm_storeu_ps(&local_poses[joint].translation.x, translation);
+        _mm_storeu_ps(&local_poses[joint].rotation.x, _mm_div_ps(rotation, _mm_sqrt_ps(dot4(rotation, rotation))));
+        _mm_storeu_ps(&local_poses[joint].scale.x, scale);
+    }
+#else
+    for (size_t joint = 0; joint < joint_count; joint++) {
+        local_poses[joint].translation = glm::mix(from[joint].translation, to[joint].translation, blend);
+        local_poses[joint].rotation = glm::normalize(glm::mix(from[joint].rotation, to[joint].rotation, blend));
+        local_poses[joint].scale = glm::mix(from[joint].scale, to[joint].scale, blend);
+    }
+#endif
+}
+
+void compute_skinning_palette(std::span<const SkeletonJoint> joints, std::span<const JointPose> local_poses, std::span<JointMatrix> palette) {
+#ifdef ENGINE_HAS_SSE
+    // Model space transform of every joint, parents always come first
+    Matrix models[MAX_SKELETON_JOINTS];
+    for (size_t joint = 0; joint < joints.size(); joint++) {
+        const Matrix local = load_matrix(compose(local_poses[joint]));
+        const i32 parent = joints[joint].parent;
+        models[joint] = parent >= 0 ? multiply(models[parent], local) : local;
+        Matrix skin = multiply(models[joint], load_matrix(joints[joint].inverse_bind));
+        _MM_TRANSPOSE4_PS(skin.columns[0], skin.columns[1], skin.columns[2], skin.columns[3]);
+        _mm_storeu_ps(&palette[joint].rows[0].x, skin.columns[0]);
+        _mm_storeu_ps(&palette[joint].rows[1].x, skin.columns[1]);
+        _mm_storeu_ps(&palette[joint].rows[2].x, skin.columns[2]);
+    }
+#else
+    glm::mat4 models[MAX_SKELETON_JOINTS];
+    for (size_t joint = 0; joint < joints.size(); joint++) {
+        const glm::mat4 local = compose(local_poses[joint]);
+        const i32 parent = joints[joint].parent;
+        models[joint] = parent >= 0 ? models[parent] * local : local;
+        const glm::mat4 skin = glm::transpose(models[joint] * joints[joint].inverse_bind);
+        palette[joint] = JointMatrix{skin[0], skin[1], skin[2]};
+    }
+#endif
+}
+
+}
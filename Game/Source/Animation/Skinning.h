@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include <span>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "Models/Skeleton.h"
+
+namespace engine {
+
+// Top three rows of joint * inverse bind, the last one is always 0 0 0 1.
+// Row major, a skinning shader transforms a position with three dot products.
+struct JointMatrix {
+    glm::vec4 rows[3];
+};
+
+// Samples the clip at time seconds, clamped to its duration, into one local
+// pose per joint. Blends the two neighbouring frames with a normalized lerp,
+// which import keeps on the short arc.
+void sample_animation(const AnimationClip& clip, std::span<const JointPose> poses, f32 time, std::span<JointPose> local_poses);
+// Composes the local poses down the hierarchy and writes the palette entry of
+// every joint
+void compute_skinning_palette(std::span<const SkeletonJoint> joints, std::span<const JointPose> local_poses, std::span<JointMatrix> palette);
+
+}
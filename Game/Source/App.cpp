@@ -1,10 +1,21 @@
 #include <utils.hpp>
 #include <vuk/Buffer.hpp>
 #include <vuk/Pipeline.hpp>
+#include <doctest/doctest.h>
+
+#include <string_view>
 
 #include "Engine.h"
 
-int main() {
+int main(int argc, char** argv) {
+    // "--test" runs the doctest cases instead of the game, any further
+    // arguments go to doctest (e.g. --test-case=BTree*)
+    if (argc > 1 && std::string_view{argv[1]} == "--test") {
+        engine::Logger::Init();
+        doctest::Context context;
+        context.applyCommandLine(argc - 1, argv + 1);
+        return context.run();
+    }
 	engine::StealthEngine engine;
     flecs::world& world = engine.get_world();
     engine.run();
@@ -0,0 +1,311 @@
+﻿#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AssetHandle.h"
+#include "common.h"
+#include "concurrentqueue.h"
+#include "robin_hood.h"
+#include "Threading/ThreadPool.h"
+
+namespace engine {
+
+enum class AssetState : u8 {
+    UNLOADED,
+    LOADING,
+    READY,
+    FAILED
+};
+
+enum class AssetPriority : u8 {
+    // Needed now, loads ahead of background work
+    NORMAL,
+    // Speculative, e.g. prefetching, only runs on otherwise idle workers
+    BACKGROUND
+};
+
+// Deduplicates loads of one kind of asset by path and reference counts them.
+// The first acquire starts a load on the thread pool, later ones share it.
+// Finished loads only become visible in update(), called once per frame on
+// the main thread, so the frame never waits on a load and the ready callback
+// can touch main thread state such as the renderer. The last release unloads.
+template <typename T>
+class AssetCache {
+public:
+    // Runs on a worker thread, false marks the asset FAILED
+    using Loader = std::function<bool(const std::string& path, T& asset)>;
+    // Runs inside update() as the asset becomes READY, may move data out of it
+    using ReadyCallback = std::function<void(AssetHandle handle, const std::string& path, T& asset)>;
+    // Runs when the last reference to a READY asset is released
+    using UnloadCallback = std::function<void(const std::string& path)>;
+    // Runs inside acquire when it starts the load of an asset, i.e. on first use
+    using LoadCallback = std::function<void(const std::string& path)>;
+private:
+    struct Slot {
+        std::string path;
+        AssetId id = 0;
+        T asset{};
+        u32 generation = 0;
+        u32 references = 0;
+        AssetState state = AssetState::UNLOADED;
+        AssetPriority priority = AssetPriority::NORMAL;
+        // Set by whichever job runs the load, a background load needed now
+        // gets a second, regular job and the slower of the two does nothing
+        std::shared_ptr<std::atomic<bool>> load_claim;
+    };
+
+    struct LoadResult {
+        u32 index;
+        u32 generation;
+        bool succeeded;
+        T asset;
+    };
+
+    ThreadPool& m_thread_pool_;
+    Loader m_loader_;
+    ReadyCallback m_on_ready_;
+    UnloadCallback m_on_unload_;
+    LoadCallback m_on_load_;
+    std::vector<Slot> m_slots_;
+    std::vector<u32> m_free_slots_;
+    robin_hood::unordered_flat_map<AssetId, u32> m_lookup_;
+    moodycamel::ConcurrentQueue<LoadResult> m_completed_;
+    JobCounter m_in_flight_;
+
+    Slot* get_slot(AssetHandle handle);
+    const Slot* get_slot(AssetHandle handle) const;
+    void unload(u32 index);
+    void submit_load(u32 index);
+public:
+    AssetCache(ThreadPool& thread_pool, Loader loader, ReadyCallback on_ready = {});
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+    AssetCache(AssetCache&&) = delete;
+    AssetCache& operator=(AssetCache&&) = delete;
+    ~AssetCache();
+
+    // Handle of the asset at path with one more reference, starting its load
+    // when it is not loaded yet. Every acquire or retain needs a release.
+    // A NORMAL acquire of an asset still queued in the background promotes it.
+    AssetHandle acquire(std::string_view path, AssetPriority priority = AssetPriority::NORMAL);
+    void retain(AssetHandle handle);
+    void release(AssetHandle handle);
+    // Publishes finished loads, returns how many finished
+    u32 update();
+    // Swaps in new contents for a READY asset, e.g. a hot reloaded one.
+    // Returns false when the asset is not loaded.
+    bool replace(AssetId id, T asset);
+
+    void set_ready_callback(ReadyCallback on_ready);
+    void set_unload_callback(UnloadCallback on_unload);
+    void set_load_callback(LoadCallback on_load);
+    [[nodiscard]] AssetState get_state(AssetHandle handle) const;
+    // nullptr until the asset is READY
+    [[nodiscard]] const T* get(AssetHandle handle) const;
+    [[nodiscard]] AssetHandle find(AssetId id) const;
+    [[nodiscard]] u32 get_reference_count(AssetHandle handle) const;
+    // Assets with at least one reference
+    [[nodiscard]] size_t size() const;
+};
+
+template <typename T>
+AssetCache<T>::AssetCache(ThreadPool& thread_pool, Loader loader, ReadyCallback on_ready)
+    : m_thread_pool_(thread_pool), m_loader_(std::move(loader)), m_on_ready_(std::move(on_ready)) {
+
+}
+
+template <typename T>
+AssetCache<T>::~AssetCache() {
+    m_thread_pool_.wait(m_in_flight_);
+}
+
+template <typename T>
+typename AssetCache<T>::Slot* AssetCache<T>::get_slot(AssetHandle handle) {
+    if (handle.index >= m_slots_.size() || m_slots_[handle.index].generation != handle.generation || m_slots_[handle.index].references == 0) {
+        return nullptr;
+    }
+    return &m_slots_[handle.index];
+}
+
+template <typename T>
+const typename AssetCache<T>::Slot* AssetCache<T>::get_slot(AssetHandle handle) const {
+    return const_cast<AssetCache*>(this)->get_slot(handle);
+}
+
+template <typename T>
+AssetHandle AssetCache<T>::acquire(std::string_view path, AssetPriority priority) {
+    const AssetId id = get_asset_id(path);
+    if (const auto it = m_lookup_.find(id); it != m_lookup_.end()) {
+        Slot& slot = m_slots_[it->second];
+        ENGINE_ASSERT(slot.path == path, "Asset id collision")
+        slot.references++;
+        if (slot.state == AssetState::LOADING && slot.priority == AssetPriority::BACKGROUND && priority == AssetPriority::NORMAL) {
+            slot.priority = AssetPriority::NORMAL;
+            submit_load(it->second);
+        }
+        return AssetHandle{it->second, slot.generation};
+    }
+
+    u32 index;
+    if (!m_free_slots_.empty()) {
+        index = m_free_slots_.back();
+        m_free_slots_.pop_back();
+    } else {
+        index = static_cast<u32>(m_slots_.size());
+        m_slots_.emplace_back();
+    }
+    Slot& slot = m_slots_[index];
+    slot.path = path;
+    slot.id = id;
+    slot.references = 1;
+    slot.state = AssetState::LOADING;
+    slot.priority = priority;
+    slot.load_claim = std::make_shared<std::atomic<bool>>(false);
+    m_lookup_[id] = index;
+    if (m_on_load_) {
+        m_on_load_(slot.path);
+    }
+    submit_load(index);
+    return AssetHandle{index, slot.generation};
+}
+
+template <typename T>
+void AssetCache<T>::submit_load(u32 index) {
+    const Slot& slot = m_slots_[index];
+    ThreadPool::Job job = [this, index, generation = slot.generation, path = slot.path, claim = slot.load_claim] {
+        if (claim->exchange(true)) {
+            return;
+        }
+        LoadResult result{index, generation, false, T{}};
+        result.succeeded = m_loader_(path, result.asset);
+        m_completed_.enqueue(std::move(result));
+    };
+    if (slot.priority == AssetPriority::BACKGROUND) {
+        m_thread_pool_.submit_background(std::move(job), &m_in_flight_);
+    } else {
+        m_thread_pool_.submit(std::move(job), &m_in_flight_);
+    }
+}
+
+template <typename T>
+void AssetCache<T>::retain(AssetHandle handle) {
+    if (Slot* slot = get_slot(handle)) {
+        slot->references++;
+    }
+}
+
+template <typename T>
+void AssetCache<T>::release(AssetHandle handle) {
+    Slot* slot = get_slot(handle);
+    if (slot != nullptr && --slot->references == 0) {
+        unload(handle.index);
+    }
+}
+
+template <typename T>
+void AssetCache<T>::unload(u32 index) {
+    // A load still in flight finds the generation moved on and is dropped,
+    // one that has not started yet is skipped
+    Slot& slot = m_slots_[index];
+    if (slot.load_claim) {
+        slot.load_claim->store(true);
+    }
+    if (slot.state == AssetState::READY && m_on_unload_) {
+        m_on_unload_(slot.path);
+    }
+    m_lookup_.erase(slot.id);
+    slot.asset = T{};
+    slot.load_claim.reset();
+    slot.path.clear();
+    slot.generation++;
+    slot.state = AssetState::UNLOADED;
+    m_free_slots_.push_back(index);
+}
+
+template <typename T>
+u32 AssetCache<T>::update() {
+    u32 finished = 0;
+    LoadResult result;
+    while (m_completed_.try_dequeue(result)) {
+        Slot* slot = get_slot(AssetHandle{result.index, result.generation});
+        if (slot == nullptr) {
+            continue;
+        }
+        finished++;
+        if (!result.succeeded) {
+            ENGINE_LOG_ERROR("Failed to load asset {}", slot->path)
+            slot->state = AssetState::FAILED;
+            continue;
+        }
+        slot->asset = std::move(result.asset);
+        slot->state = AssetState::READY;
+        if (m_on_ready_) {
+            m_on_ready_(AssetHandle{result.index, result.generation}, slot->path, slot->asset);
+        }
+    }
+    return finished;
+}
+
+template <typename T>
+bool AssetCache<T>::replace(AssetId id, T asset) {
+    const auto it = m_lookup_.find(id);
+    if (it == m_lookup_.end() || m_slots_[it->second].state != AssetState::READY) {
+        return false;
+    }
+    m_slots_[it->second].asset = std::move(asset);
+    return true;
+}
+
+template <typename T>
+void AssetCache<T>::set_ready_callback(ReadyCallback on_ready) {
+    m_on_ready_ = std::move(on_ready);
+}
+
+template <typename T>
+void AssetCache<T>::set_unload_callback(UnloadCallback on_unload) {
+    m_on_unload_ = std::move(on_unload);
+}
+
+template <typename T>
+void AssetCache<T>::set_load_callback(LoadCallback on_load) {
+    m_on_load_ = std::move(on_load);
+}
+
+template <typename T>
+AssetState AssetCache<T>::get_state(AssetHandle handle) const {
+    const Slot* slot = get_slot(handle);
+    return slot == nullptr ? AssetState::UNLOADED : slot->state;
+}
+
+template <typename T>
+const T* AssetCache<T>::get(AssetHandle handle) const {
+    const Slot* slot = get_slot(handle);
+    return slot == nullptr || slot->state != AssetState::READY ? nullptr : &slot->asset;
+}
+
+template <typename T>
+AssetHandle AssetCache<T>::find(AssetId id) const {
+    const auto it = m_lookup_.find(id);
+    if (it == m_lookup_.end()) {
+        return AssetHandle{};
+    }
+    return AssetHandle{it->second, m_slots_[it->second].generation};
+}
+
+template <typename T>
+u32 AssetCache<T>::get_reference_count(AssetHandle handle) const {
+    const Slot* slot = get_slot(handle);
+    return slot == nullptr ? 0 : slot->references;
+}
+
+template <typename T>
+size_t AssetCache<T>::size() const {
+    return m_lookup_.size();
+}
+
+}
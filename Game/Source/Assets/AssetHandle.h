@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <string_view>
+
+#include "common.h"
+#include "Hashing/Hash.h"
+
+namespace engine {
+
+// Slot and generation in a cache, plain data so components can store it.
+// A handle whose asset was unloaded reads as UNLOADED instead of aliasing
+// whatever reused the slot.
+struct AssetHandle {
+    u32 index = ~0u;
+    u32 generation = 0;
+
+    [[nodiscard]] bool is_valid() const {
+        return index != ~0u;
+    }
+    bool operator==(const AssetHandle&) const = default;
+};
+
+// Interned path, the same path always gives the same id
+using AssetId = u64;
+
+inline AssetId get_asset_id(std::string_view path) {
+    return hash::xxh64(path);
+}
+
+}
@@ -0,0 +1,121 @@
+﻿#include "AssetPrefetcher.h"
+
+#include <algorithm>
+
+#include "Rendering/Camera.h"
+
+namespace engine {
+
+AssetPrefetcher::AssetPrefetcher(flecs::world& world, AssetCache<MeshAsset>& meshes, LevelManifest& manifest)
+    : m_meshes_(meshes), m_manifest_(manifest), m_position_(0.0f), m_velocity_(0.0f), m_has_position_(false), m_is_recording_(false),
+      m_prefetch_distance_(DEFAULT_PREFETCH_DISTANCE) {
+    // After movement, so the camera is where it will be drawn this frame
+    m_system_ = world.system("Prefetch Assets")
+        .kind(flecs::PostUpdate)
+        .run([this](flecs::iter& iter) {
+            const Camera* camera = iter.world().get<Camera>();
+            if (camera != nullptr) {
+                update(glm::vec3{glm::inverse(camera->get_view())[3]}, iter.delta_time());
+            }
+        });
+}
+
+AssetPrefetcher::~AssetPrefetcher() {
+    m_system_.destruct();
+    set_recording(false);
+    for (RegionState& region : m_regions_) {
+        release_region(region);
+    }
+}
+
+void AssetPrefetcher::release_region(RegionState& region) {
+    for (const AssetHandle handle : region.meshes) {
+        m_meshes_.release(handle);
+    }
+    region.meshes.clear();
+    region.next_mesh = 0;
+}
+
+void AssetPrefetcher::update(const glm::vec3& position, f32 delta_time) {
+    if (m_has_position_ && delta_time > 0.0f) {
+        // Smoothed so one frame of jitter does not swing the lookahead around
+        m_velocity_ = glm::mix(m_velocity_, (position - m_position_) / delta_time, 0.25f);
+    }
+    m_position_ = position;
+    m_has_position_ = true;
+    if (m_is_recording_) {
+        return;
+    }
+
+    const std::span<const LevelRegion> regions = m_manifest_.regions();
+    if (m_regions_.size() != regions.size()) {
+        reset();
+    }
+    const glm::vec3 lookahead = position + m_velocity_ * PREFETCH_LOOKAHEAD_SECONDS;
+    m_order_.clear();
+    for (u32 i = 0; i < regions.size(); i++) {
+        RegionState& region = m_regions_[i];
+        region.distance = std::min(regions[i].distance(position), regions[i].distance(lookahead));
+        if (region.distance <= m_prefetch_distance_) {
+            m_order_.push_back(i);
+        } else if (region.distance > m_prefetch_distance_ * PREFETCH_RELEASE_FACTOR && !region.meshes.empty()) {
+            release_region(region);
+        }
+    }
+    std::sort(m_order_.begin(), m_order_.end(), [this](u32 a, u32 b) {
+        return m_regions_[a].distance < m_regions_[b].distance;
+    });
+
+    std::erase_if(m_loading_, [this](AssetHandle handle) {
+        return m_meshes_.get_state(handle) != AssetState::LOADING;
+    });
+    for (const u32 index : m_order_) {
+        RegionState& region = m_regions_[index];
+        const std::vector<std::string>& paths = regions[index].meshes;
+        while (region.next_mesh < paths.size() && m_loading_.size() < MAX_PREFETCH_LOADS_IN_FLIGHT) {
+            const AssetHandle handle = m_meshes_.acquire(paths[region.next_mesh++], AssetPriority::BACKGROUND);
+            region.meshes.push_back(handle);
+            if (m_meshes_.get_state(handle) == AssetState::LOADING) {
+                m_loading_.push_back(handle);
+            }
+        }
+    }
+}
+
+void AssetPrefetcher::reset() {
+    for (RegionState& region : m_regions_) {
+        release_region(region);
+    }
+    m_regions_.assign(m_manifest_.regions().size(), RegionState{});
+    m_loading_.clear();
+}
+
+void AssetPrefetcher::set_recording(bool is_recording) {
+    if (is_recording == m_is_recording_) {
+        return;
+    }
+    m_is_recording_ = is_recording;
+    if (is_recording) {
+        // Prefetched assets would never count as a first use
+        reset();
+        m_meshes_.set_load_callback([this](const std::string& path) {
+            m_manifest_.record(m_position_, path);
+        });
+    } else {
+        m_meshes_.set_load_callback({});
+    }
+}
+
+void AssetPrefetcher::set_prefetch_distance(f32 distance) {
+    m_prefetch_distance_ = distance;
+}
+
+u32 AssetPrefetcher::get_prefetched_count() const {
+    u32 count = 0;
+    for (const RegionState& region : m_regions_) {
+        count += static_cast<u32>(region.meshes.size());
+    }
+    return count;
+}
+
+}
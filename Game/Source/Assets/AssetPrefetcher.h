@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "AssetCache.h"
+#include "common.h"
+#include "flecs.h"
+#include "LevelManifest.h"
+#include "MeshAsset.h"
+
+namespace engine {
+
+// Regions whose bounds come this close to the camera, now or where it is
+// heading, get their assets loaded
+static constexpr f32 DEFAULT_PREFETCH_DISTANCE = 48.0f;
+// Prefetched regions are let go once they are this much further than the
+// prefetch distance, so walking along a boundary does not reload them
+static constexpr f32 PREFETCH_RELEASE_FACTOR = 1.5f;
+// How far ahead the camera's velocity is extrapolated
+static constexpr f32 PREFETCH_LOOKAHEAD_SECONDS = 2.0f;
+// Background loads the prefetcher keeps in flight, the rest wait their turn
+static constexpr u32 MAX_PREFETCH_LOADS_IN_FLIGHT = 2;
+
+// Loads the assets of the level regions the player is approaching as
+// background jobs, nearest region first, and holds a reference to them until
+// the player moves away again. In recording mode it prefetches nothing and
+// tags every first use of an asset with the region the camera is in instead,
+// which builds the manifest for the next session.
+class AssetPrefetcher {
+    struct RegionState {
+        std::vector<AssetHandle> meshes;
+        // Next asset of the region's list to acquire
+        u32 next_mesh = 0;
+        f32 distance = 0.0f;
+    };
+
+    AssetCache<MeshAsset>& m_meshes_;
+    LevelManifest& m_manifest_;
+    std::vector<RegionState> m_regions_;
+    std::vector<u32> m_order_;
+    std::vector<AssetHandle> m_loading_;
+    glm::vec3 m_position_;
+    glm::vec3 m_velocity_;
+    bool m_has_position_;
+    bool m_is_recording_;
+    f32 m_prefetch_distance_;
+    flecs::system m_system_;
+
+    void release_region(RegionState& region);
+public:
+    AssetPrefetcher(flecs::world& world, AssetCache<MeshAsset>& meshes, LevelManifest& manifest);
+    AssetPrefetcher(const AssetPrefetcher&) = delete;
+    AssetPrefetcher& operator=(const AssetPrefetcher&) = delete;
+    AssetPrefetcher(AssetPrefetcher&&) = delete;
+    AssetPrefetcher& operator=(AssetPrefetcher&&) = delete;
+    ~AssetPrefetcher();
+
+    // Called every frame by the prefetcher's system with the camera position
+    void update(const glm::vec3& position, f32 delta_time);
+    // Drops every prefetched reference, needed after the manifest changes
+    void reset();
+    void set_recording(bool is_recording);
+    void set_prefetch_distance(f32 distance);
+    // Assets the prefetcher holds a reference to
+    [[nodiscard]] u32 get_prefetched_count() const;
+};
+
+}
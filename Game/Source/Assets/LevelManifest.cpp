@@ -0,0 +1,165 @@
+﻿#include "LevelManifest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "FileIO/FileIO.h"
+
+namespace engine {
+
+static constexpr u32 LEVEL_MANIFEST_MAGIC = 0x4D4C4753; // "SGLM"
+static constexpr u32 LEVEL_MANIFEST_VERSION = 1;
+
+struct LevelManifestHeader {
+    u32 magic;
+    u32 version;
+    u32 region_count;
+    u32 reserved;
+};
+
+// Bounds and mesh count, a region with no meshes takes up this much
+static constexpr size_t MIN_REGION_SIZE = 2 * sizeof(glm::vec3) + sizeof(u32);
+
+// Bounds checked reads over the mapped manifest
+struct LevelManifestReader {
+    const byte* current;
+    const byte* end;
+    bool failed = false;
+
+    [[nodiscard]] size_t remaining() const {
+        return end - current;
+    }
+
+    template <typename T>
+    T read() {
+        T value{};
+        if (static_cast<size_t>(end - current) < sizeof(T)) {
+            failed = true;
+            return value;
+        }
+        std::memcpy(&value, current, sizeof(T));
+        current += sizeof(T);
+        return value;
+    }
+
+    std::string read_string() {
+        const u32 length = read<u32>();
+        if (failed || static_cast<size_t>(end - current) < length) {
+            failed = true;
+            return {};
+        }
+        std::string value{reinterpret_cast<const char*>(current), length};
+        current += length;
+        return value;
+    }
+};
+
+template <typename T>
+static void write_value(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+bool LevelRegion::contains(const glm::vec3& position) const {
+    return glm::all(glm::greaterThanEqual(position, bounds_min)) && glm::all(glm::lessThan(position, bounds_max));
+}
+
+f32 LevelRegion::distance(const glm::vec3& position) const {
+    return glm::length(position - glm::clamp(position, bounds_min, bounds_max));
+}
+
+bool LevelManifest::load(const char* path) {
+    m_regions_.clear();
+    if (!std::filesystem::exists(path)) {
+        return false;
+    }
+    const io::MappedFile file{path, io::MapHint::SEQUENTIAL};
+    LevelManifestReader reader{file.data(), file.data() + file.size()};
+    const LevelManifestHeader header = reader.read<LevelManifestHeader>();
+    if (reader.failed || header.magic != LEVEL_MANIFEST_MAGIC || header.version != LEVEL_MANIFEST_VERSION) {
+        ENGINE_LOG_WARN("Ignoring stale or corrupt level manifest {}", path)
+        return false;
+    }
+    // Counts are untrusted, one that cannot fit in the rest of the file
+    // would otherwise reserve gigabytes
+    if (header.region_count > reader.remaining() / MIN_REGION_SIZE) {
+        ENGINE_LOG_WARN("Ignoring corrupt level manifest {}", path)
+        return false;
+    }
+    m_regions_.reserve(header.region_count);
+    for (u32 i = 0; i < header.region_count && !reader.failed; i++) {
+        LevelRegion& region = m_regions_.emplace_back();
+        region.bounds_min = reader.read<glm::vec3>();
+        region.bounds_max = reader.read<glm::vec3>();
+        const u32 mesh_count = reader.read<u32>();
+        // Every mesh path is at least its length
+        if (mesh_count > reader.remaining() / sizeof(u32)) {
+            reader.failed = true;
+            break;
+        }
+        region.meshes.reserve(mesh_count);
+        for (u32 j = 0; j < mesh_count && !reader.failed; j++) {
+            region.meshes.push_back(reader.read_string());
+        }
+    }
+    if (reader.failed) {
+        ENGINE_LOG_WARN("Ignoring truncated level manifest {}", path)
+        m_regions_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool LevelManifest::save(const char* path) const {
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        ENGINE_LOG_ERROR("Failed to write level manifest {}", path)
+        return false;
+    }
+    write_value(file, LevelManifestHeader{LEVEL_MANIFEST_MAGIC, LEVEL_MANIFEST_VERSION, static_cast<u32>(m_regions_.size()), 0});
+    for (const LevelRegion& region : m_regions_) {
+        write_value(file, region.bounds_min);
+        write_value(file, region.bounds_max);
+        write_value(file, static_cast<u32>(region.meshes.size()));
+        for (const std::string& mesh : region.meshes) {
+            write_value(file, static_cast<u32>(mesh.size()));
+            file.write(mesh.data(), static_cast<std::streamsize>(mesh.size()));
+        }
+    }
+    return file.good();
+}
+
+bool LevelManifest::record(const glm::vec3& position, std::string_view mesh_path) {
+    auto region = std::find_if(m_regions_.begin(), m_regions_.end(), [&](const LevelRegion& candidate) {
+        return candidate.contains(position);
+    });
+    if (region == m_regions_.end()) {
+        const glm::vec3 cell = glm::floor(position / LEVEL_REGION_SIZE) * LEVEL_REGION_SIZE;
+        m_regions_.push_back(LevelRegion{cell, cell + LEVEL_REGION_SIZE, {}});
+        region = m_regions_.end() - 1;
+    }
+    if (std::find(region->meshes.begin(), region->meshes.end(), mesh_path) != region->meshes.end()) {
+        return false;
+    }
+    region->meshes.emplace_back(mesh_path);
+    return true;
+}
+
+void LevelManifest::add_region(LevelRegion region) {
+    m_regions_.push_back(std::move(region));
+}
+
+std::span<const LevelRegion> LevelManifest::regions() const {
+    return m_regions_;
+}
+
+size_t LevelManifest::get_asset_count() const {
+    size_t count = 0;
+    for (const LevelRegion& region : m_regions_) {
+        count += region.meshes.size();
+    }
+    return count;
+}
+
+}
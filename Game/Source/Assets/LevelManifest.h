@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "common.h"
+
+namespace engine {
+
+// Edge length of the grid cells recorded assets are tagged with
+static constexpr f32 LEVEL_REGION_SIZE = 32.0f;
+
+// A box of the level and the meshes used inside it, by base path
+struct LevelRegion {
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+    std::vector<std::string> meshes;
+
+    [[nodiscard]] bool contains(const glm::vec3& position) const;
+    [[nodiscard]] f32 distance(const glm::vec3& position) const;
+};
+
+// Which assets each region of a level needs. Recorded by playing through the
+// level with an AssetPrefetcher in recording mode, regions can also be
+// authored by hand with any bounds.
+class LevelManifest {
+    std::vector<LevelRegion> m_regions_;
+public:
+    // A missing or corrupt manifest loads empty, which prefetches nothing
+    bool load(const char* path);
+    bool save(const char* path) const;
+
+    // Adds path to the first region containing position, or to a new grid
+    // cell around it. Returns false when the region already lists it.
+    bool record(const glm::vec3& position, std::string_view mesh_path);
+    void add_region(LevelRegion region);
+
+    [[nodiscard]] std::span<const LevelRegion> regions() const;
+    [[nodiscard]] size_t get_asset_count() const;
+};
+
+}
@@ -0,0 +1,46 @@
+﻿#include "MeshAsset.h"
+
+#include "Memory/Arena.h"
+
+namespace engine {
+
+void copy_mesh_metadata(MeshAsset& mesh) {
+    mesh.bounds = mesh.file.bounds();
+    mesh.skeleton.assign(mesh.file.skeleton().begin(), mesh.file.skeleton().end());
+    mesh.animations.assign(mesh.file.animations().begin(), mesh.file.animations().end());
+    mesh.animation_poses.assign(mesh.file.animation_poses().begin(), mesh.file.animation_poses().end());
+}
+
+bool load_mesh_asset(const std::string& base_path, MeshAsset& mesh, io::AssetIndex* asset_index, ThreadPool* thread_pool,
+    const io::PackFile* pack) {
+    const std::string mesh_path = base_path + ".mesh";
+    // Packed meshes were cooked by the AssetCooker, there is nothing to check
+    if (pack == nullptr || pack->find(mesh_path) == nullptr) {
+        // Warm path, a cooked mesh that is up to date is only mapped. The
+        // model is imported into the arena only when it has to be cooked.
+        const std::string source_path = find_model_source(base_path, asset_index);
+        const bool has_source = !source_path.empty();
+        const bool is_current = is_model_file_present(mesh_path, asset_index) && mesh.file.open(mesh_path.c_str()) &&
+            (!has_source || mesh.file.is_cooked_from(get_model_source_key(source_path, 0, asset_index)));
+        if (!is_current) {
+            mesh.file = MeshFile{};
+            Arena arena{MODEL_IMPORT_ARENA_SIZE};
+            VertexIndexInfo model{arena};
+            // A missing or broken model leaves the asset FAILED instead of empty
+            if (!model.load_model(arena, arena_string{base_path.data(), base_path.size(), STLArenaAllocator<char>{&arena}}, 0, asset_index, thread_pool)) {
+                return false;
+            }
+            if (!mesh.file.open(mesh_path.c_str())) {
+                ENGINE_LOG_ERROR("Failed to map the cooked mesh {}", mesh_path)
+                return false;
+            }
+        }
+    } else if (!mesh.file.open(*pack, mesh_path, thread_pool)) {
+        ENGINE_LOG_ERROR("{} in {} is not a mesh file", mesh_path, pack->get_path())
+        return false;
+    }
+    copy_mesh_metadata(mesh);
+    return mesh.file.header().index_count > 0;
+}
+
+}
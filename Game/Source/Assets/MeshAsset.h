@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "Models/MeshFile.h"
+
+namespace io {
+class AssetIndex;
+class PackFile;
+}
+
+namespace engine {
+
+class ThreadPool;
+
+// Cooked model mapped until the renderer uploads its packed sections. The
+// bounds, and the skeleton and animations of a skinned one, are copied out
+// and stay, entities and animation use them every frame.
+struct MeshAsset {
+    MeshFile file;
+    BoundingVolume bounds{};
+    std::vector<SkeletonJoint> skeleton;
+    std::vector<AnimationClip> animations;
+    std::vector<JointPose> animation_poses;
+};
+
+// Copies the bounds, skeleton and animations out of mesh.file
+void copy_mesh_metadata(MeshAsset& mesh);
+
+// Loads <base_path>.mesh on the calling worker thread, from the pack when it
+// holds one, otherwise from disk and cooked first when needed. The import
+// itself spreads over the pool.
+bool load_mesh_asset(const std::string& base_path, MeshAsset& mesh, io::AssetIndex* asset_index, ThreadPool* thread_pool,
+    const io::PackFile* pack = nullptr);
+
+}
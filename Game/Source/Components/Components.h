@@ -1,7 +1,12 @@
 ﻿#pragma once
 
+#include <cstdint>
+#include <string>
 #include <glm/glm.hpp>
 
+#include "Assets/AssetHandle.h"
+#include "Models/Bounds.h"
+
 namespace components {
 
 struct Transform3D {
@@ -81,4 +86,63 @@ struct Transform3D {
     }
 };
 
+// Object space bounds of the entity's mesh as cooked by the importer,
+// attached once the mesh is loaded
+struct Bounds {
+    glm::vec3 aabb_min{};
+    glm::vec3 aabb_max{};
+    glm::vec3 sphere_center{};
+    float sphere_radius = 0.0f;
+
+    [[nodiscard]] static Bounds from_volume(const BoundingVolume& volume) {
+        return Bounds{
+            glm::vec3{volume.aabb_min[0], volume.aabb_min[1], volume.aabb_min[2]},
+            glm::vec3{volume.aabb_max[0], volume.aabb_max[1], volume.aabb_max[2]},
+            glm::vec3{volume.sphere_center[0], volume.sphere_center[1], volume.sphere_center[2]},
+            volume.sphere_radius
+        };
+    }
+
+    // World space sphere, the radius scales with the largest axis
+    [[nodiscard]] glm::vec4 world_sphere(const Transform3D& transform) const {
+        const glm::vec3 center = glm::vec3{transform.as_matrix() * glm::vec4{sphere_center, 1.0f}};
+        const glm::vec3 scale = glm::abs(transform.scale);
+        return glm::vec4{center, sphere_radius * glm::max(scale.x, glm::max(scale.y, scale.z))};
+    }
+};
+
+// Texture file the entity's mesh samples, registered with the texture
+// streamer and replaced by a TextureRef on the next frame
+struct TextureSource {
+    std::string path;
+    float uv_repeat = 1.0f;
+};
+
+// Streamed texture sampled by the entity's mesh, requests levels from its
+// on-screen size every frame
+struct TextureRef {
+    std::uint32_t texture = ~0u;
+    // Times the texture repeats across the bounding sphere's diameter
+    float uv_repeat = 1.0f;
+};
+
+// Mesh the entity draws, holding one reference that is released with the component
+struct MeshRef {
+    engine::AssetHandle mesh;
+    // Id of the mesh's path, the renderer finds the GPU copy by it
+    engine::AssetId id = 0;
+};
+
+// Plays one of the clips of the entity's skinned mesh
+struct Animator {
+    // Index into the mesh's clips, out of range holds the bind pose
+    std::uint32_t clip = 0;
+    // Seconds into the clip
+    float time = 0.0f;
+    float speed = 1.0f;
+    bool looping = true;
+    // First joint of the entity's palette this frame, ~0u until its mesh is ready
+    std::uint32_t palette_offset = ~0u;
+};
+
 }
\ No newline at end of file
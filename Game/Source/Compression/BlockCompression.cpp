@@ -0,0 +1,288 @@
+﻿#include "BlockCompression.h"
+
+#include <cstring>
+
+namespace engine::compression {
+
+static constexpr u32 MIN_MATCH = 4;
+static constexpr u32 MAX_OFFSET = 65535;
+static constexpr u32 HASH_BITS = 14;
+// Matches never start within the last bytes of the input, which lets the
+// match finder read 4 bytes at a time without bounds checks.
+static constexpr size_t END_LITERALS = 8;
+
+static u32 read_u32(const byte* data) {
+    u32 value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static u32 hash_sequence(u32 sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static byte* write_length(byte* output, const byte* output_end, size_t length) {
+    while (length >= 255) {
+        if (output >= output_end) {
+            return nullptr;
+        }
+        *output++ = 255;
+        length -= 255;
+    }
+    if (output >= output_end) {
+        return nullptr;
+    }
+    *output++ = static_cast<byte>(length);
+    return output;
+}
+
+// Writes literals [anchor, literal_end) followed by an optional match
+static byte* write_sequence(byte* output, const byte* output_end, const byte* anchor, const byte* literal_end, u32 offset, size_t match_length) {
+    const size_t literal_length = literal_end - anchor;
+    if (output >= output_end) {
+        return nullptr;
+    }
+    byte* token = output++;
+    *token = static_cast<byte>((literal_length >= 15 ? 15 : literal_length) << 4);
+    if (literal_length >= 15) {
+        output = write_length(output, output_end, literal_length - 15);
+        if (output == nullptr) {
+            return nullptr;
+        }
+    }
+    if (static_cast<size_t>(output_end - output) < literal_length) {
+        return nullptr;
+    }
+    std::memcpy(output, anchor, literal_length);
+    output += literal_length;
+    if (match_length == 0) {
+        return output;
+    }
+
+    if (output_end - output < 2) {
+        return nullptr;
+    }
+    *output++ = static_cast<byte>(offset & 0xFF);
+    *output++ = static_cast<byte>(offset >> 8);
+    const size_t encoded_match = match_length - MIN_MATCH;
+    *token |= static_cast<byte>(encoded_match >= 15 ? 15 : encoded_match);
+    if (encoded_match >= 15) {
+        output = write_length(output, output_end, encoded_match - 15);
+    }
+    return output;
+}
+
+size_t lz_compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lz_compress(const byte* source, size_t source_size, byte* destination, size_t capacity) {
+    byte* output = destination;
+    const byte* const output_end = destination + capacity;
+    const byte* input = source;
+    const byte* anchor = source;
+    const byte* const input_end = source + source_size;
+
+    if (source_size > END_LITERALS + MIN_MATCH) {
+        // Positions are stored relative to source. An empty slot reads as
+        // position 0, a real position that is only used when its bytes match
+        u32 table[1 << HASH_BITS] = {};
+        const byte* const match_limit = input_end - END_LITERALS;
+        u32 misses = 0;
+        while (input < match_limit) {
+            const u32 sequence = read_u32(input);
+            const u32 hash = hash_sequence(sequence);
+            const byte* reference = source + table[hash];
+            table[hash] = static_cast<u32>(input - source);
+            // The candidate has to lie behind input (not true of slot 0 at the
+            // very start), within the 16 bit offset and start with the same 4 bytes
+            if (reference >= input || input - reference > MAX_OFFSET || read_u32(reference) != sequence) {
+                // Skip faster through data that does not compress
+                input += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            // Grow the match backwards into pending literals, then forwards
+            while (input > anchor && reference > source && input[-1] == reference[-1]) {
+                input--;
+                reference--;
+            }
+            size_t match_length = MIN_MATCH;
+            while (input + match_length < match_limit && input[match_length] == reference[match_length]) {
+                match_length++;
+            }
+            output = write_sequence(output, output_end, anchor, input, static_cast<u32>(input - reference), match_length);
+            if (output == nullptr) {
+                return 0;
+            }
+            input += match_length;
+            anchor = input;
+        }
+    }
+    output = write_sequence(output, output_end, anchor, input_end, 0, 0);
+    if (output == nullptr) {
+        return 0;
+    }
+    return output - destination;
+}
+
+static bool read_length(const byte*& input, const byte* input_end, size_t& length) {
+    byte value;
+    do {
+        if (input >= input_end) {
+            return false;
+        }
+        value = *input++;
+        length += value;
+    } while (value == 255);
+    return true;
+}
+
+bool lz_decompress(const byte* source, size_t source_size, byte* destination, size_t destination_size) {
+    const byte* input = source;
+    const byte* const input_end = source + source_size;
+    byte* output = destination;
+    byte* const output_end = destination + destination_size;
+
+    while (input < input_end) {
+        const byte token = *input++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(input, input_end, literal_length)) {
+            return false;
+        }
+        if (static_cast<size_t>(input_end - input) < literal_length || static_cast<size_t>(output_end - output) < literal_length) {
+            return false;
+        }
+        std::memcpy(output, input, literal_length);
+        input += literal_length;
+        output += literal_length;
+        if (input == input_end) {
+            // The last sequence carries literals only
+            break;
+        }
+
+        if (input_end - input < 2) {
+            return false;
+        }
+        const size_t offset = input[0] | (input[1] << 8);
+        input += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && !read_length(input, input_end, match_length)) {
+            return false;
+        }
+        match_length += MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(output - destination) || static_cast<size_t>(output_end - output) < match_length) {
+            return false;
+        }
+        const byte* match = output - offset;
+        if (offset >= match_length) {
+            std::memcpy(output, match, match_length);
+            output += match_length;
+        } else {
+            // Overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < match_length; i++) {
+                *output++ = match[i];
+            }
+        }
+    }
+    return output == output_end;
+}
+
+std::vector<byte> compress_blocks(const byte* source, size_t source_size, ThreadPool* thread_pool, u32 block_size) {
+    const u32 block_count = static_cast<u32>((source_size + block_size - 1) / block_size);
+    std::vector<std::vector<byte>> blocks(block_count);
+    const auto compress_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const size_t offset = i * block_size;
+            const size_t raw_size = std::min<size_t>(block_size, source_size - offset);
+            std::vector<byte>& block = blocks[i];
+            block.resize(lz_compress_bound(raw_size));
+            const size_t compressed_size = lz_compress(source + offset, raw_size, block.data(), block.size());
+            if (compressed_size == 0 || compressed_size >= raw_size) {
+                block.assign(source + offset, source + offset + raw_size);
+            } else {
+                block.resize(compressed_size);
+            }
+        }
+    };
+    if (thread_pool) {
+        thread_pool->parallel_for(block_count, 1, compress_range);
+    } else {
+        compress_range(0, block_count);
+    }
+
+    size_t total_size = sizeof(BlockStreamHeader) + block_count * sizeof(u32);
+    for (const std::vector<byte>& block : blocks) {
+        total_size += block.size();
+    }
+    std::vector<byte> stream(total_size);
+    const BlockStreamHeader header{BLOCK_STREAM_MAGIC, block_size, source_size, block_count, 0};
+    std::memcpy(stream.data(), &header, sizeof(header));
+    byte* sizes = stream.data() + sizeof(header);
+    byte* payload = sizes + block_count * sizeof(u32);
+    for (u32 i = 0; i < block_count; i++) {
+        const u32 stored_size = static_cast<u32>(blocks[i].size());
+        std::memcpy(sizes + i * sizeof(u32), &stored_size, sizeof(u32));
+        std::memcpy(payload, blocks[i].data(), stored_size);
+        payload += stored_size;
+    }
+    return stream;
+}
+
+bool is_block_stream(const byte* data, size_t size) {
+    return size >= sizeof(BlockStreamHeader) && read_u32(data) == BLOCK_STREAM_MAGIC;
+}
+
+u64 get_decompressed_size(const byte* data, size_t size) {
+    if (!is_block_stream(data, size)) {
+        return 0;
+    }
+    BlockStreamHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    return header.raw_size;
+}
+
+bool decompress_blocks(const byte* source, size_t source_size, byte* destination, size_t destination_size, ThreadPool* thread_pool) {
+    if (!is_block_stream(source, source_size)) {
+        return false;
+    }
+    BlockStreamHeader header;
+    std::memcpy(&header, source, sizeof(header));
+    const size_t table_end = sizeof(header) + static_cast<size_t>(header.block_count) * sizeof(u32);
+    if (header.raw_size != destination_size || header.block_size == 0 || table_end > source_size ||
+        header.block_count != (header.raw_size + header.block_size - 1) / header.block_size) {
+        return false;
+    }
+
+    // Prefix sum of the stored sizes gives every block its input offset
+    std::vector<size_t> offsets(header.block_count + 1);
+    offsets[0] = table_end;
+    for (u32 i = 0; i < header.block_count; i++) {
+        offsets[i + 1] = offsets[i] + read_u32(source + sizeof(header) + i * sizeof(u32));
+    }
+    if (offsets.back() != source_size) {
+        return false;
+    }
+
+    std::atomic<bool> succeeded{true};
+    const auto decompress_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const size_t output_offset = i * header.block_size;
+            const size_t raw_size = std::min<size_t>(header.block_size, destination_size - output_offset);
+            const size_t stored_size = offsets[i + 1] - offsets[i];
+            if (stored_size == raw_size) {
+                std::memcpy(destination + output_offset, source + offsets[i], raw_size);
+            } else if (!lz_decompress(source + offsets[i], stored_size, destination + output_offset, raw_size)) {
+                succeeded.store(false, std::memory_order_relaxed);
+            }
+        }
+    };
+    if (thread_pool) {
+        thread_pool->parallel_for(header.block_count, 1, decompress_range);
+    } else {
+        decompress_range(0, header.block_count);
+    }
+    return succeeded.load(std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "Threading/ThreadPool.h"
+
+namespace engine::compression {
+
+// Byte oriented LZ77 in the style of LZ4: every sequence is a token holding
+// the literal and match lengths, the literals, and a 16 bit match offset.
+// Decoding is a tight copy loop, which is what keeps load times bound by
+// memory bandwidth rather than by the codec.
+size_t lz_compress_bound(size_t size);
+// Returns the compressed size, or 0 when the output did not fit
+size_t lz_compress(const byte* source, size_t source_size, byte* destination, size_t capacity);
+// Fails on malformed input instead of reading or writing out of bounds
+bool lz_decompress(const byte* source, size_t source_size, byte* destination, size_t destination_size);
+
+static constexpr u32 BLOCK_STREAM_MAGIC = 0x5A424753; // "SGBZ"
+static constexpr u32 DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+// A block stream is a header, a table with the stored size of every block and
+// the blocks themselves. Blocks are compressed independently so both sides
+// can spread them over the thread pool. A block whose stored size equals its
+// raw size is kept uncompressed.
+struct BlockStreamHeader {
+    u32 magic;
+    u32 block_size;
+    u64 raw_size;
+    u32 block_count;
+    u32 reserved;
+};
+
+static_assert(sizeof(BlockStreamHeader) == 24, "Block stream headers are written to disk as is");
+
+std::vector<byte> compress_blocks(const byte* source, size_t source_size, ThreadPool* thread_pool = nullptr, u32 block_size = DEFAULT_BLOCK_SIZE);
+[[nodiscard]] bool is_block_stream(const byte* data, size_t size);
+// Raw size recorded in the stream header, 0 when data is not a block stream
+u64 get_decompressed_size(const byte* data, size_t size);
+bool decompress_blocks(const byte* source, size_t source_size, byte* destination, size_t destination_size, ThreadPool* thread_pool = nullptr);
+
+}
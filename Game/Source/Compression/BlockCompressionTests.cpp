@@ -0,0 +1,73 @@
+﻿#include <doctest/doctest.h>
+
+#include <cstring>
+#include <random>
+
+#include "BlockCompression.h"
+
+using namespace engine;
+
+static std::vector<byte> make_test_data(size_t size) {
+    // Repeating text with random bytes mixed in, so it has both matches and
+    // literal runs
+    std::vector<byte> data(size);
+    std::mt19937 random{1234};
+    const char* text = "the quick brown fox jumps over the lazy dog ";
+    const size_t text_length = std::strlen(text);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = random() % 8 == 0 ? static_cast<byte>(random()) : static_cast<byte>(text[i % text_length]);
+    }
+    return data;
+}
+
+TEST_CASE("LZ round trips and rejects a short destination") {
+    const std::vector<byte> data = make_test_data(100000);
+    std::vector<byte> compressed(compression::lz_compress_bound(data.size()));
+    const size_t compressed_size = compression::lz_compress(data.data(), data.size(), compressed.data(), compressed.size());
+    REQUIRE(compressed_size > 0);
+    CHECK(compressed_size < data.size());
+
+    std::vector<byte> decompressed(data.size());
+    REQUIRE(compression::lz_decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size()));
+    CHECK(decompressed == data);
+    CHECK_FALSE(compression::lz_decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size() - 1));
+}
+
+TEST_CASE("LZ round trips tiny and incompressible inputs") {
+    for (const size_t size : {size_t{0}, size_t{1}, size_t{7}, size_t{13}}) {
+        const std::vector<byte> data = make_test_data(size);
+        std::vector<byte> compressed(compression::lz_compress_bound(size));
+        const size_t compressed_size = compression::lz_compress(data.data(), size, compressed.data(), compressed.size());
+        std::vector<byte> decompressed(size);
+        CHECK(compression::lz_decompress(compressed.data(), compressed_size, decompressed.data(), size));
+        CHECK(decompressed == data);
+    }
+
+    std::vector<byte> noise(5000);
+    std::mt19937 random{99};
+    for (byte& value : noise) {
+        value = static_cast<byte>(random());
+    }
+    std::vector<byte> compressed(compression::lz_compress_bound(noise.size()));
+    const size_t compressed_size = compression::lz_compress(noise.data(), noise.size(), compressed.data(), compressed.size());
+    REQUIRE(compressed_size > 0);
+    std::vector<byte> decompressed(noise.size());
+    CHECK(compression::lz_decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size()));
+    CHECK(decompressed == noise);
+}
+
+TEST_CASE("Block streams round trip on and off the thread pool") {
+    const std::vector<byte> data = make_test_data(1 << 20);
+    ThreadPool thread_pool{2};
+    for (ThreadPool* pool : {static_cast<ThreadPool*>(nullptr), &thread_pool}) {
+        const std::vector<byte> stream = compression::compress_blocks(data.data(), data.size(), pool, 64 * 1024);
+        REQUIRE(compression::is_block_stream(stream.data(), stream.size()));
+        CHECK(compression::get_decompressed_size(stream.data(), stream.size()) == data.size());
+
+        std::vector<byte> decompressed(data.size());
+        REQUIRE(compression::decompress_blocks(stream.data(), stream.size(), decompressed.data(), decompressed.size(), pool));
+        CHECK(decompressed == data);
+        // A truncated stream fails instead of reading past its end
+        CHECK_FALSE(compression::decompress_blocks(stream.data(), stream.size() / 2, decompressed.data(), decompressed.size(), pool));
+    }
+}
@@ -0,0 +1,586 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "common.h"
+#include "Memory/Allocators/PoolAllocator.h"
+
+namespace engine::containers {
+
+// B+ tree for mutable ordered data. Nodes are fixed size chunks from a pool
+// allocator backed by an arena, values only live in the leaves and the leaves
+// are linked so range queries are a walk over contiguous arrays. Keys and
+// values are moved with memmove and never destroyed, so they must be trivially
+// copyable.
+template <typename K, typename V, size_t Order = 32, typename Compare = std::less<K>>
+class BTree {
+    static_assert(Order >= 4, "BTree order must be at least 4");
+    static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>,
+                  "BTree keys and values must be trivially copyable");
+
+    static constexpr size_t MIN_KEYS = Order / 2;
+
+    struct Node {
+        u32 count;
+        bool is_leaf;
+        K keys[Order];
+    };
+
+    struct Leaf : Node {
+        V values[Order];
+        Leaf* prev;
+        Leaf* next;
+    };
+
+    struct Inner : Node {
+        Node* children[Order + 1];
+    };
+
+    static constexpr size_t NODE_SIZE = sizeof(Leaf) > sizeof(Inner) ? sizeof(Leaf) : sizeof(Inner);
+    static_assert(alignof(Leaf) <= alignof(u64) && alignof(Inner) <= alignof(u64),
+                  "Pool chunks are only 8 byte aligned");
+
+    allocators::PoolAllocator m_node_pool_;
+    Node* m_root_;
+    Leaf* m_first_leaf_;
+    size_t m_size_;
+    Compare m_compare_;
+
+    Leaf* allocate_leaf();
+    Inner* allocate_inner();
+    void free_subtree(Node* node);
+
+    u32 key_index(const Node* node, const K& key) const;
+    u32 child_index(const Inner* node, const K& key) const;
+    Leaf* find_leaf(const K& key) const;
+
+    bool insert_recursive(Node* node, const K& key, const V& value, K& split_key, Node*& split_node);
+    bool erase_recursive(Node* node, const K& key);
+    void rebalance_child(Inner* parent, u32 index);
+public:
+    class Iterator {
+        friend class BTree;
+        Leaf* m_leaf_;
+        u32 m_index_;
+
+        Iterator(Leaf* leaf, u32 index) : m_leaf_(leaf), m_index_(index) {
+            skip_exhausted();
+        }
+
+        void skip_exhausted() {
+            while (m_leaf_ && m_index_ >= m_leaf_->count) {
+                m_leaf_ = m_leaf_->next;
+                m_index_ = 0;
+            }
+        }
+    public:
+        const K& key() const {
+            return m_leaf_->keys[m_index_];
+        }
+
+        V& value() const {
+            return m_leaf_->values[m_index_];
+        }
+
+        Iterator& operator++() {
+            m_index_++;
+            skip_exhausted();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return m_leaf_ == other.m_leaf_ && (m_leaf_ == nullptr || m_index_ == other.m_index_);
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+    };
+
+    explicit BTree(Arena* arena, size_t nodes_per_block = 64);
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+    BTree(BTree&&) = delete;
+    BTree& operator=(BTree&&) = delete;
+    ~BTree() = default;
+
+    // Replaces the contents with count sorted, unique keys. The tree is built
+    // bottom up from nearly full leaves instead of paying for count inserts.
+    void bulk_load(const K* sorted_keys, const V* values, size_t count);
+    void clear();
+
+    // Returns false and overwrites the value when the key already existed
+    bool insert_or_assign(const K& key, const V& value);
+    bool erase(const K& key);
+
+    V* find(const K& key);
+    const V* find(const K& key) const;
+    [[nodiscard]] bool contains(const K& key) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+    Iterator lower_bound(const K& key) const;
+    Iterator upper_bound(const K& key) const;
+
+    // Visits every key in [low, high) in order
+    template <typename Fn>
+    void for_each_in_range(const K& low, const K& high, Fn&& fn) const;
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+};
+
+template <typename K, typename V, size_t Order, typename Compare>
+BTree<K, V, Order, Compare>::BTree(Arena* arena, size_t nodes_per_block) : m_node_pool_(arena, nodes_per_block, NODE_SIZE), m_root_(nullptr), m_first_leaf_(nullptr), m_size_(0) {
+
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+typename BTree<K, V, Order, Compare>::Leaf* BTree<K, V, Order, Compare>::allocate_leaf() {
+    Leaf* leaf = static_cast<Leaf*>(m_node_pool_.allocate());
+    leaf->count = 0;
+    leaf->is_leaf = true;
+    leaf->prev = nullptr;
+    leaf->next = nullptr;
+    return leaf;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+typename BTree<K, V, Order, Compare>::Inner* BTree<K, V, Order, Compare>::allocate_inner() {
+    Inner* inner = static_cast<Inner*>(m_node_pool_.allocate());
+    inner->count = 0;
+    inner->is_leaf = false;
+    return inner;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+void BTree<K, V, Order, Compare>::free_subtree(Node* node) {
+    if (!node->is_leaf) {
+        Inner* inner = static_cast<Inner*>(node);
+        for (u32 i = 0; i <= inner->count; i++) {
+            free_subtree(inner->children[i]);
+        }
+    }
+    m_node_pool_.deallocate(node);
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+u32 BTree<K, V, Order, Compare>::key_index(const Node* node, const K& key) const {
+    return static_cast<u32>(std::lower_bound(node->keys, node->keys + node->count, key, m_compare_) - node->keys);
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+u32 BTree<K, V, Order, Compare>::child_index(const Inner* node, const K& key) const {
+    // Separator i is the smallest key of children[i + 1]
+    return static_cast<u32>(std::upper_bound(node->keys, node->keys + node->count, key, m_compare_) - node->keys);
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+typename BTree<K, V, Order, Compare>::Leaf* BTree<K, V, Order, Compare>::find_leaf(const K& key) const {
+    Node* node = m_root_;
+    if (node == nullptr) {
+        return nullptr;
+    }
+    while (!node->is_leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        node = inner->children[child_index(inner, key)];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+bool BTree<K, V, Order, Compare>::insert_recursive(Node* node, const K& key, const V& value, K& split_key, Node*& split_node) {
+    split_node = nullptr;
+    if (node->is_leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        const u32 index = key_index(leaf, key);
+        if (index < leaf->count && !m_compare_(key, leaf->keys[index])) {
+            leaf->values[index] = value;
+            return false;
+        }
+        if (leaf->count == Order) {
+            // Split in half, then insert into whichever side the key belongs to
+            Leaf* right = allocate_leaf();
+            const u32 half = Order / 2;
+            right->count = Order - half;
+            std::memcpy(right->keys, leaf->keys + half, sizeof(K) * right->count);
+            std::memcpy(right->values, leaf->values + half, sizeof(V) * right->count);
+            leaf->count = half;
+            right->next = leaf->next;
+            right->prev = leaf;
+            if (leaf->next) {
+                leaf->next->prev = right;
+            }
+            leaf->next = right;
+            Leaf* target = index <= half ? leaf : right;
+            const u32 target_index = index <= half ? index : index - half;
+            std::memmove(target->keys + target_index + 1, target->keys + target_index, sizeof(K) * (target->count - target_index));
+            std::memmove(target->values + target_index + 1, target->values + target_index, sizeof(V) * (target->count - target_index));
+            target->keys[target_index] = key;
+            target->values[target_index] = value;
+            target->count++;
+            split_key = right->keys[0];
+            split_node = right;
+            return true;
+        }
+        std::memmove(leaf->keys + index + 1, leaf->keys + index, sizeof(K) * (leaf->count - index));
+        std::memmove(leaf->values + index + 1, leaf->values + index, sizeof(V) * (leaf->count - index));
+        leaf->keys[index] = key;
+        leaf->values[index] = value;
+        leaf->count++;
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    const u32 index = child_index(inner, key);
+    K child_split_key;
+    Node* child_split_node;
+    const bool inserted = insert_recursive(inner->children[index], key, value, child_split_key, child_split_node);
+    if (child_split_node == nullptr) {
+        return inserted;
+    }
+
+    // Room for Order + 1 keys so the overflowing node can be split uniformly
+    K keys[Order + 1];
+    Node* children[Order + 2];
+    std::memcpy(keys, inner->keys, sizeof(K) * index);
+    keys[index] = child_split_key;
+    std::memcpy(keys + index + 1, inner->keys + index, sizeof(K) * (inner->count - index));
+    std::memcpy(children, inner->children, sizeof(Node*) * (index + 1));
+    children[index + 1] = child_split_node;
+    std::memcpy(children + index + 2, inner->children + index + 1, sizeof(Node*) * (inner->count - index));
+    const u32 total = inner->count + 1;
+
+    if (total <= Order) {
+        std::memcpy(inner->keys, keys, sizeof(K) * total);
+        std::memcpy(inner->children, children, sizeof(Node*) * (total + 1));
+        inner->count = total;
+        return inserted;
+    }
+
+    // The middle key moves up, it is not kept in either half
+    const u32 middle = total / 2;
+    Inner* right = allocate_inner();
+    inner->count = middle;
+    std::memcpy(inner->keys, keys, sizeof(K) * middle);
+    std::memcpy(inner->children, children, sizeof(Node*) * (middle + 1));
+    right->count = total - middle - 1;
+    std::memcpy(right->keys, keys + middle + 1, sizeof(K) * right->count);
+    std::memcpy(right->children, children + middle + 1, sizeof(Node*) * (right->count + 1));
+    split_key = keys[middle];
+    split_node = right;
+    return inserted;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+bool BTree<K, V, Order, Compare>::insert_or_assign(const K& key, const V& value) {
+    if (m_root_ == nullptr) {
+        m_first_leaf_ = allocate_leaf();
+        m_root_ = m_first_leaf_;
+    }
+    K split_key;
+    Node* split_node;
+    const bool inserted = insert_recursive(m_root_, key, value, split_key, split_node);
+    if (split_node) {
+        Inner* new_root = allocate_inner();
+        new_root->count = 1;
+        new_root->keys[0] = split_key;
+        new_root->children[0] = m_root_;
+        new_root->children[1] = split_node;
+        m_root_ = new_root;
+    }
+    if (inserted) {
+        m_size_++;
+    }
+    return inserted;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+void BTree<K, V, Order, Compare>::rebalance_child(Inner* parent, u32 index) {
+    Node* child = parent->children[index];
+    Node* left = index > 0 ? parent->children[index - 1] : nullptr;
+    Node* right = index < parent->count ? parent->children[index + 1] : nullptr;
+
+    if (child->is_leaf) {
+        Leaf* leaf = static_cast<Leaf*>(child);
+        if (left && left->count > MIN_KEYS) {
+            Leaf* left_leaf = static_cast<Leaf*>(left);
+            std::memmove(leaf->keys + 1, leaf->keys, sizeof(K) * leaf->count);
+            std::memmove(leaf->values + 1, leaf->values, sizeof(V) * leaf->count);
+            leaf->keys[0] = left_leaf->keys[left_leaf->count - 1];
+            leaf->values[0] = left_leaf->values[left_leaf->count - 1];
+            left_leaf->count--;
+            leaf->count++;
+            parent->keys[index - 1] = leaf->keys[0];
+            return;
+        }
+        if (right && right->count > MIN_KEYS) {
+            Leaf* right_leaf = static_cast<Leaf*>(right);
+            leaf->keys[leaf->count] = right_leaf->keys[0];
+            leaf->values[leaf->count] = right_leaf->values[0];
+            leaf->count++;
+            right_leaf->count--;
+            std::memmove(right_leaf->keys, right_leaf->keys + 1, sizeof(K) * right_leaf->count);
+            std::memmove(right_leaf->values, right_leaf->values + 1, sizeof(V) * right_leaf->count);
+            parent->keys[index] = right_leaf->keys[0];
+            return;
+        }
+        // Merge with a sibling, always folding the right node into the left one
+        const u32 merge_index = left ? index - 1 : index;
+        Leaf* dst = static_cast<Leaf*>(parent->children[merge_index]);
+        Leaf* src = static_cast<Leaf*>(parent->children[merge_index + 1]);
+        std::memcpy(dst->keys + dst->count, src->keys, sizeof(K) * src->count);
+        std::memcpy(dst->values + dst->count, src->values, sizeof(V) * src->count);
+        dst->count += src->count;
+        dst->next = src->next;
+        if (src->next) {
+            src->next->prev = dst;
+        }
+        m_node_pool_.deallocate(src);
+        std::memmove(parent->keys + merge_index, parent->keys + merge_index + 1, sizeof(K) * (parent->count - merge_index - 1));
+        std::memmove(parent->children + merge_index + 1, parent->children + merge_index + 2, sizeof(Node*) * (parent->count - merge_index - 1));
+        parent->count--;
+        return;
+    }
+
+    Inner* inner = static_cast<Inner*>(child);
+    if (left && left->count > MIN_KEYS) {
+        // Rotate right through the parent separator
+        Inner* left_inner = static_cast<Inner*>(left);
+        std::memmove(inner->keys + 1, inner->keys, sizeof(K) * inner->count);
+        std::memmove(inner->children + 1, inner->children, sizeof(Node*) * (inner->count + 1));
+        inner->keys[0] = parent->keys[index - 1];
+        inner->children[0] = left_inner->children[left_inner->count];
+        inner->count++;
+        parent->keys[index - 1] = left_inner->keys[left_inner->count - 1];
+        left_inner->count--;
+        return;
+    }
+    if (right && right->count > MIN_KEYS) {
+        // Rotate left through the parent separator
+        Inner* right_inner = static_cast<Inner*>(right);
+        inner->keys[inner->count] = parent->keys[index];
+        inner->children[inner->count + 1] = right_inner->children[0];
+        inner->count++;
+        parent->keys[index] = right_inner->keys[0];
+        std::memmove(right_inner->keys, right_inner->keys + 1, sizeof(K) * (right_inner->count - 1));
+        std::memmove(right_inner->children, right_inner->children + 1, sizeof(Node*) * right_inner->count);
+        right_inner->count--;
+        return;
+    }
+    // Merge pulls the separator down between the two halves
+    const u32 merge_index = left ? index - 1 : index;
+    Inner* dst = static_cast<Inner*>(parent->children[merge_index]);
+    Inner* src = static_cast<Inner*>(parent->children[merge_index + 1]);
+    dst->keys[dst->count] = parent->keys[merge_index];
+    std::memcpy(dst->keys + dst->count + 1, src->keys, sizeof(K) * src->count);
+    std::memcpy(dst->children + dst->count + 1, src->children, sizeof(Node*) * (src->count + 1));
+    dst->count += src->count + 1;
+    m_node_pool_.deallocate(src);
+    std::memmove(parent->keys + merge_index, parent->keys + merge_index + 1, sizeof(K) * (parent->count - merge_index - 1));
+    std::memmove(parent->children + merge_index + 1, parent->children + merge_index + 2, sizeof(Node*) * (parent->count - merge_index - 1));
+    parent->count--;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+bool BTree<K, V, Order, Compare>::erase_recursive(Node* node, const K& key) {
+    if (node->is_leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        const u32 index = key_index(leaf, key);
+        if (index == leaf->count || m_compare_(key, leaf->keys[index])) {
+            return false;
+        }
+        std::memmove(leaf->keys + index, leaf->keys + index + 1, sizeof(K) * (leaf->count - index - 1));
+        std::memmove(leaf->values + index, leaf->values + index + 1, sizeof(V) * (leaf->count - index - 1));
+        leaf->count--;
+        return true;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    const u32 index = child_index(inner, key);
+    if (!erase_recursive(inner->children[index], key)) {
+        return false;
+    }
+    // Separators only have to bound their subtrees, so a stale separator
+    // left behind by the erase is still valid and does not need updating.
+    if (inner->children[index]->count < MIN_KEYS) {
+        rebalance_child(inner, index);
+    }
+    return true;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+bool BTree<K, V, Order, Compare>::erase(const K& key) {
+    if (m_root_ == nullptr || !erase_recursive(m_root_, key)) {
+        return false;
+    }
+    m_size_--;
+    if (!m_root_->is_leaf && m_root_->count == 0) {
+        Node* old_root = m_root_;
+        m_root_ = static_cast<Inner*>(old_root)->children[0];
+        m_node_pool_.deallocate(old_root);
+    } else if (m_root_->is_leaf && m_root_->count == 0) {
+        m_node_pool_.deallocate(m_root_);
+        m_root_ = nullptr;
+        m_first_leaf_ = nullptr;
+    }
+    return true;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+void BTree<K, V, Order, Compare>::bulk_load(const K* sorted_keys, const V* values, size_t count) {
+    ENGINE_ASSERT(std::adjacent_find(sorted_keys, sorted_keys + count, [this](const K& a, const K& b) {
+        return !m_compare_(a, b);
+    }) == sorted_keys + count, "BTree::bulk_load requires sorted, unique keys")
+    clear();
+    if (count == 0) {
+        return;
+    }
+
+    // Spread the keys evenly over the fewest leaves that can hold them, which
+    // keeps every leaf at or above the minimum fill erase relies on.
+    std::vector<Node*> level;
+    level.reserve((count + Order - 1) / Order);
+    const size_t leaf_count = (count + Order - 1) / Order;
+    Leaf* previous = nullptr;
+    size_t consumed = 0;
+    for (size_t i = 0; i < leaf_count; i++) {
+        const size_t take = count / leaf_count + (i < count % leaf_count ? 1 : 0);
+        Leaf* leaf = allocate_leaf();
+        leaf->count = static_cast<u32>(take);
+        std::memcpy(leaf->keys, sorted_keys + consumed, sizeof(K) * take);
+        std::memcpy(leaf->values, values + consumed, sizeof(V) * take);
+        leaf->prev = previous;
+        if (previous) {
+            previous->next = leaf;
+        }
+        previous = leaf;
+        level.push_back(leaf);
+        consumed += take;
+    }
+    m_first_leaf_ = static_cast<Leaf*>(level.front());
+    m_size_ = count;
+
+    // Same even split for the inner levels until a single root remains
+    std::vector<Node*> parents;
+    while (level.size() > 1) {
+        const size_t parent_count = (level.size() + Order) / (Order + 1);
+        parents.clear();
+        size_t child = 0;
+        for (size_t p = 0; p < parent_count; p++) {
+            const size_t take = level.size() / parent_count + (p < level.size() % parent_count ? 1 : 0);
+            Inner* parent = allocate_inner();
+            for (size_t c = 0; c < take; c++, child++) {
+                parent->children[c] = level[child];
+                if (c > 0) {
+                    Node* leftmost = level[child];
+                    while (!leftmost->is_leaf) {
+                        leftmost = static_cast<Inner*>(leftmost)->children[0];
+                    }
+                    parent->keys[c - 1] = leftmost->keys[0];
+                }
+            }
+            parent->count = static_cast<u32>(take - 1);
+            parents.push_back(parent);
+        }
+        level.swap(parents);
+    }
+    m_root_ = level.front();
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+void BTree<K, V, Order, Compare>::clear() {
+    if (m_root_) {
+        free_subtree(m_root_);
+    }
+    m_root_ = nullptr;
+    m_first_leaf_ = nullptr;
+    m_size_ = 0;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+V* BTree<K, V, Order, Compare>::find(const K& key) {
+    Leaf* leaf = find_leaf(key);
+    if (leaf == nullptr) {
+        return nullptr;
+    }
+    const u32 index = key_index(leaf, key);
+    if (index == leaf->count || m_compare_(key, leaf->keys[index])) {
+        return nullptr;
+    }
+    return &leaf->values[index];
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+const V* BTree<K, V, Order, Compare>::find(const K& key) const {
+    return const_cast<BTree*>(this)->find(key);
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+bool BTree<K, V, Order, Compare>::contains(const K& key) const {
+    return find(key) != nullptr;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+typename BTree<K, V, Order, Compare>::Iterator BTree<K, V, Order, Compare>::begin() const {
+    return Iterator{m_first_leaf_, 0};
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+typename BTree<K, V, Order, Compare>::Iterator BTree<K, V, Order, Compare>::end() const {
+    return Iterator{nullptr, 0};
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+typename BTree<K, V, Order, Compare>::Iterator BTree<K, V, Order, Compare>::lower_bound(const K& key) const {
+    Leaf* leaf = find_leaf(key);
+    if (leaf == nullptr) {
+        return end();
+    }
+    return Iterator{leaf, key_index(leaf, key)};
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+typename BTree<K, V, Order, Compare>::Iterator BTree<K, V, Order, Compare>::upper_bound(const K& key) const {
+    Leaf* leaf = find_leaf(key);
+    if (leaf == nullptr) {
+        return end();
+    }
+    const u32 index = static_cast<u32>(std::upper_bound(leaf->keys, leaf->keys + leaf->count, key, m_compare_) - leaf->keys);
+    return Iterator{leaf, index};
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+template <typename Fn>
+void BTree<K, V, Order, Compare>::for_each_in_range(const K& low, const K& high, Fn&& fn) const {
+    Leaf* leaf = find_leaf(low);
+    if (leaf == nullptr) {
+        return;
+    }
+    u32 index = key_index(leaf, low);
+    while (leaf) {
+        for (; index < leaf->count; index++) {
+            if (!m_compare_(leaf->keys[index], high)) {
+                return;
+            }
+            fn(leaf->keys[index], leaf->values[index]);
+        }
+        leaf = leaf->next;
+        index = 0;
+    }
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+size_t BTree<K, V, Order, Compare>::size() const {
+    return m_size_;
+}
+
+template <typename K, typename V, size_t Order, typename Compare>
+bool BTree<K, V, Order, Compare>::empty() const {
+    return m_size_ == 0;
+}
+
+}
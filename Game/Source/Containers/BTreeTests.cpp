@@ -0,0 +1,84 @@
+﻿#include <doctest/doctest.h>
+
+#include <map>
+
+#include "BTree.h"
+
+using engine::containers::BTree;
+
+TEST_CASE("BTree inserts, overwrites and finds keys") {
+    Arena arena{1 << 20};
+    BTree<u32, u32, 4> tree{&arena};
+    CHECK(tree.empty());
+    CHECK(tree.insert_or_assign(5, 50));
+    CHECK(tree.insert_or_assign(1, 10));
+    CHECK_FALSE(tree.insert_or_assign(5, 55));
+    CHECK(tree.size() == 2);
+    REQUIRE(tree.find(5) != nullptr);
+    CHECK(*tree.find(5) == 55);
+    CHECK(tree.find(3) == nullptr);
+    CHECK(tree.contains(1));
+}
+
+TEST_CASE("BTree splits and merges nodes while staying ordered") {
+    Arena arena{4 << 20};
+    // A small order forces splits of leaves and inner nodes within a few keys
+    BTree<u32, u32, 4> tree{&arena};
+    std::map<u32, u32> expected;
+    for (u32 i = 0; i < 2000; i++) {
+        const u32 key = (i * 7919u) % 2003u;
+        tree.insert_or_assign(key, i);
+        expected[key] = i;
+    }
+    // Erasing every other key and then a whole run underflows nodes, which
+    // borrows from siblings and merges them
+    for (u32 key = 0; key < 2003; key += 2) {
+        CHECK(tree.erase(key) == (expected.erase(key) == 1));
+    }
+    for (u32 key = 1000; key < 1800; key++) {
+        CHECK(tree.erase(key) == (expected.erase(key) == 1));
+    }
+    CHECK_FALSE(tree.erase(4000));
+    REQUIRE(tree.size() == expected.size());
+
+    auto expected_it = expected.begin();
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++expected_it) {
+        REQUIRE(expected_it != expected.end());
+        CHECK(it.key() == expected_it->first);
+        CHECK(it.value() == expected_it->second);
+    }
+    CHECK(expected_it == expected.end());
+
+    for (const auto& [key, value] : expected) {
+        tree.erase(key);
+    }
+    CHECK(tree.empty());
+    CHECK(tree.begin() == tree.end());
+}
+
+TEST_CASE("BTree bulk loads and answers range queries") {
+    Arena arena{1 << 20};
+    BTree<u32, u32, 8> tree{&arena};
+    u32 keys[100];
+    u32 values[100];
+    for (u32 i = 0; i < 100; i++) {
+        keys[i] = i * 2;
+        values[i] = i;
+    }
+    tree.bulk_load(keys, values, 100);
+    CHECK(tree.size() == 100);
+    CHECK(tree.lower_bound(31).key() == 32);
+    CHECK(tree.upper_bound(32).key() == 34);
+    CHECK(tree.lower_bound(1000) == tree.end());
+
+    u32 visited = 0;
+    u32 previous = 0;
+    tree.for_each_in_range(10, 20, [&](const u32& key, const u32&) {
+        CHECK(key >= 10);
+        CHECK(key < 20);
+        CHECK((visited == 0 || key > previous));
+        previous = key;
+        visited++;
+    });
+    CHECK(visited == 5);
+}
@@ -0,0 +1,216 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <span>
+
+#include "common.h"
+
+namespace engine::containers {
+
+// Sorted map stored as two parallel arrays (keys, values) in an arena.
+// Lookups are a binary search over a dense key array, which keeps read-mostly
+// data like asset manifests and sorted draw keys in as few cache lines as
+// possible. Inserts and erases are O(n), prefer assign_sorted for bulk data.
+template <typename K, typename V, typename Compare = std::less<K>>
+class FlatMap {
+    arena_vector<K> m_keys_;
+    arena_vector<V> m_values_;
+    Compare m_compare_;
+public:
+    explicit FlatMap(Arena* arena);
+    FlatMap(Arena* arena, const K* sorted_keys, const V* values, size_t count);
+    FlatMap(const FlatMap& other) = default;
+    FlatMap& operator=(const FlatMap& other) = default;
+    FlatMap(FlatMap&& other) noexcept = default;
+    FlatMap& operator=(FlatMap&& other) noexcept = default;
+    ~FlatMap() = default;
+
+    // Bulk load. Keys must be sorted by Compare and unique.
+    void assign_sorted(const K* sorted_keys, const V* values, size_t count);
+    void reserve(size_t count);
+    void clear();
+
+    // Returns false and overwrites the value when the key already existed
+    bool insert_or_assign(const K& key, const V& value);
+    bool erase(const K& key);
+
+    V* find(const K& key);
+    const V* find(const K& key) const;
+    [[nodiscard]] bool contains(const K& key) const;
+
+    // Index of the first key not less than / greater than key
+    [[nodiscard]] size_t lower_bound(const K& key) const;
+    [[nodiscard]] size_t upper_bound(const K& key) const;
+
+    // Range queries over [low, high)
+    std::span<const K> keys_in_range(const K& low, const K& high) const;
+    std::span<V> values_in_range(const K& low, const K& high);
+    std::span<const V> values_in_range(const K& low, const K& high) const;
+    template <typename Fn>
+    void for_each_in_range(const K& low, const K& high, Fn&& fn) const;
+
+    const K& key_at(size_t index) const;
+    V& value_at(size_t index);
+    const V& value_at(size_t index) const;
+
+    std::span<const K> keys() const;
+    std::span<V> values();
+    std::span<const V> values() const;
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+};
+
+template <typename K, typename V, typename Compare>
+FlatMap<K, V, Compare>::FlatMap(Arena* arena) : m_keys_(STLArenaAllocator<K>{arena}), m_values_(STLArenaAllocator<V>{arena}) {
+
+}
+
+template <typename K, typename V, typename Compare>
+FlatMap<K, V, Compare>::FlatMap(Arena* arena, const K* sorted_keys, const V* values, size_t count) : FlatMap(arena) {
+    assign_sorted(sorted_keys, values, count);
+}
+
+template <typename K, typename V, typename Compare>
+void FlatMap<K, V, Compare>::assign_sorted(const K* sorted_keys, const V* values, size_t count) {
+    ENGINE_ASSERT(std::adjacent_find(sorted_keys, sorted_keys + count, [this](const K& a, const K& b) {
+        return !m_compare_(a, b);
+    }) == sorted_keys + count, "FlatMap::assign_sorted requires sorted, unique keys")
+    m_keys_.assign(sorted_keys, sorted_keys + count);
+    m_values_.assign(values, values + count);
+}
+
+template <typename K, typename V, typename Compare>
+void FlatMap<K, V, Compare>::reserve(size_t count) {
+    m_keys_.reserve(count);
+    m_values_.reserve(count);
+}
+
+template <typename K, typename V, typename Compare>
+void FlatMap<K, V, Compare>::clear() {
+    m_keys_.clear();
+    m_values_.clear();
+}
+
+template <typename K, typename V, typename Compare>
+bool FlatMap<K, V, Compare>::insert_or_assign(const K& key, const V& value) {
+    const size_t index = lower_bound(key);
+    if (index < m_keys_.size() && !m_compare_(key, m_keys_[index])) {
+        m_values_[index] = value;
+        return false;
+    }
+    m_keys_.insert(m_keys_.begin() + index, key);
+    m_values_.insert(m_values_.begin() + index, value);
+    return true;
+}
+
+template <typename K, typename V, typename Compare>
+bool FlatMap<K, V, Compare>::erase(const K& key) {
+    const size_t index = lower_bound(key);
+    if (index == m_keys_.size() || m_compare_(key, m_keys_[index])) {
+        return false;
+    }
+    m_keys_.erase(m_keys_.begin() + index);
+    m_values_.erase(m_values_.begin() + index);
+    return true;
+}
+
+template <typename K, typename V, typename Compare>
+V* FlatMap<K, V, Compare>::find(const K& key) {
+    const size_t index = lower_bound(key);
+    if (index == m_keys_.size() || m_compare_(key, m_keys_[index])) {
+        return nullptr;
+    }
+    return &m_values_[index];
+}
+
+template <typename K, typename V, typename Compare>
+const V* FlatMap<K, V, Compare>::find(const K& key) const {
+    return const_cast<FlatMap*>(this)->find(key);
+}
+
+template <typename K, typename V, typename Compare>
+bool FlatMap<K, V, Compare>::contains(const K& key) const {
+    return find(key) != nullptr;
+}
+
+template <typename K, typename V, typename Compare>
+size_t FlatMap<K, V, Compare>::lower_bound(const K& key) const {
+    return std::lower_bound(m_keys_.begin(), m_keys_.end(), key, m_compare_) - m_keys_.begin();
+}
+
+template <typename K, typename V, typename Compare>
+size_t FlatMap<K, V, Compare>::upper_bound(const K& key) const {
+    return std::upper_bound(m_keys_.begin(), m_keys_.end(), key, m_compare_) - m_keys_.begin();
+}
+
+template <typename K, typename V, typename Compare>
+std::span<const K> FlatMap<K, V, Compare>::keys_in_range(const K& low, const K& high) const {
+    const size_t first = lower_bound(low);
+    const size_t last = std::max(first, lower_bound(high));
+    return std::span<const K>{m_keys_.data() + first, last - first};
+}
+
+template <typename K, typename V, typename Compare>
+std::span<V> FlatMap<K, V, Compare>::values_in_range(const K& low, const K& high) {
+    const size_t first = lower_bound(low);
+    const size_t last = std::max(first, lower_bound(high));
+    return std::span<V>{m_values_.data() + first, last - first};
+}
+
+template <typename K, typename V, typename Compare>
+std::span<const V> FlatMap<K, V, Compare>::values_in_range(const K& low, const K& high) const {
+    return const_cast<FlatMap*>(this)->values_in_range(low, high);
+}
+
+template <typename K, typename V, typename Compare>
+template <typename Fn>
+void FlatMap<K, V, Compare>::for_each_in_range(const K& low, const K& high, Fn&& fn) const {
+    const size_t last = lower_bound(high);
+    for (size_t i = lower_bound(low); i < last; i++) {
+        fn(m_keys_[i], m_values_[i]);
+    }
+}
+
+template <typename K, typename V, typename Compare>
+const K& FlatMap<K, V, Compare>::key_at(size_t index) const {
+    return m_keys_[index];
+}
+
+template <typename K, typename V, typename Compare>
+V& FlatMap<K, V, Compare>::value_at(size_t index) {
+    return m_values_[index];
+}
+
+template <typename K, typename V, typename Compare>
+const V& FlatMap<K, V, Compare>::value_at(size_t index) const {
+    return m_values_[index];
+}
+
+template <typename K, typename V, typename Compare>
+std::span<const K> FlatMap<K, V, Compare>::keys() const {
+    return std::span<const K>{m_keys_.data(), m_keys_.size()};
+}
+
+template <typename K, typename V, typename Compare>
+std::span<V> FlatMap<K, V, Compare>::values() {
+    return std::span<V>{m_values_.data(), m_values_.size()};
+}
+
+template <typename K, typename V, typename Compare>
+std::span<const V> FlatMap<K, V, Compare>::values() const {
+    return std::span<const V>{m_values_.data(), m_values_.size()};
+}
+
+template <typename K, typename V, typename Compare>
+size_t FlatMap<K, V, Compare>::size() const {
+    return m_keys_.size();
+}
+
+template <typename K, typename V, typename Compare>
+bool FlatMap<K, V, Compare>::empty() const {
+    return m_keys_.empty();
+}
+
+}
@@ -0,0 +1,54 @@
+﻿#include <doctest/doctest.h>
+
+#include <map>
+
+#include "FlatMap.h"
+
+using engine::containers::FlatMap;
+
+TEST_CASE("FlatMap keeps keys sorted through inserts and erases") {
+    Arena arena{1 << 20};
+    FlatMap<u32, u32> map{&arena};
+    std::map<u32, u32> expected;
+    for (u32 i = 0; i < 500; i++) {
+        const u32 key = (i * 31u) % 499u;
+        map.insert_or_assign(key, i);
+        expected[key] = i;
+    }
+    for (u32 key = 0; key < 499; key += 3) {
+        CHECK(map.erase(key) == (expected.erase(key) == 1));
+    }
+    CHECK_FALSE(map.erase(1000));
+    REQUIRE(map.size() == expected.size());
+
+    size_t index = 0;
+    for (const auto& [key, value] : expected) {
+        CHECK(map.key_at(index) == key);
+        CHECK(map.value_at(index) == value);
+        index++;
+    }
+}
+
+TEST_CASE("FlatMap overwrites existing keys") {
+    Arena arena{1 << 16};
+    FlatMap<u32, u32> map{&arena};
+    CHECK(map.insert_or_assign(3, 30));
+    CHECK_FALSE(map.insert_or_assign(3, 33));
+    CHECK(map.size() == 1);
+    REQUIRE(map.find(3) != nullptr);
+    CHECK(*map.find(3) == 33);
+    CHECK(map.find(4) == nullptr);
+}
+
+TEST_CASE("FlatMap answers bound and range queries") {
+    Arena arena{1 << 16};
+    const u32 keys[] = {2, 4, 6, 8, 10};
+    const u32 values[] = {20, 40, 60, 80, 100};
+    FlatMap<u32, u32> map{&arena, keys, values, 5};
+    CHECK(map.lower_bound(4) == 1);
+    CHECK(map.upper_bound(4) == 2);
+    CHECK(map.lower_bound(11) == 5);
+    CHECK(map.keys_in_range(4, 9).size() == 3);
+    CHECK(map.values_in_range(4, 9)[0] == 40);
+    CHECK(map.keys_in_range(11, 20).empty());
+}
@@ -4,8 +4,11 @@
 #include <fstream>
 
 #include "common.h"
+#include "Animation/AnimationSystem.h"
+#include "Components/Components.h"
 #include "imgui.h"
 #include "Logging/Logger.h"
+#include "Rendering/HotReloader.h"
 #include "Rendering/Renderer.h"
 
 namespace engine {
@@ -13,19 +16,132 @@ namespace engine {
 constexpr int default_stack_size = 2 << 25;
 
 StealthEngine::StealthEngine() : m_temp_arena_((Logger::Init(), default_stack_size / 2)),
-     m_permanent_arena_(default_stack_size)
+     m_permanent_arena_(default_stack_size), m_io_service_(m_thread_pool_), m_asset_index_(&m_permanent_arena_, "."),
+     m_meshes_(m_thread_pool_, [this](const std::string& path, MeshAsset& mesh) {
+         return load_mesh_asset(path, mesh, &m_asset_index_, &m_thread_pool_, &m_asset_pack_);
+     }), m_prefetcher_(m_world_, m_meshes_, m_level_manifest_)
     {
+    constexpr const char* content_directories[] = {"Models", "Shaders"};
+    m_asset_index_.build(m_thread_pool_, "asset_index.cache", content_directories);
+    // Shipped builds carry their content in a pack made by the AssetPacker tool
+    if (std::filesystem::exists("Assets.pak")) {
+        m_asset_pack_.open("Assets.pak");
+    }
+
+    // Async read callbacks are delivered at the start of every frame
+    m_world_.system("Poll Async IO")
+        .kind(flecs::OnLoad)
+        .run([this](flecs::iter&) {
+            m_io_service_.poll();
+            m_meshes_.update();
+        });
+    // Entities hold one reference each, so a mesh shared by many props is
+    // loaded once and unloaded with the last of them
+    m_world_.component<components::MeshRef>()
+        .on_remove([this](components::MeshRef& mesh_ref) {
+            m_meshes_.release(mesh_ref.mesh);
+        });
+    // Runs after the poll, which publishes this frame's loads
+    m_world_.system<const components::MeshRef>("Attach Mesh Bounds")
+        .kind(flecs::OnLoad)
+        .without<components::Bounds>()
+        .each([this](flecs::entity entity, const components::MeshRef& mesh_ref) {
+            if (const MeshAsset* mesh = m_meshes_.get(mesh_ref.mesh)) {
+                entity.set(components::Bounds::from_volume(mesh->bounds));
+            }
+        });
 }
 
 void StealthEngine::run() {
     ENGINE_LOG_INFO("Engine starting...")
-    Renderer renderer{m_world_};
+    Renderer renderer{m_world_, &m_asset_pack_};
+    // Finished reads upload from the IO poll, before anything draws
+    TextureStreamer texture_streamer{m_world_, m_io_service_, [&renderer](const TextureUpload& upload) {
+        renderer.upload_texture(upload);
+    }, [&renderer](TextureHandle, const char* path, u32 level) {
+        renderer.shrink_texture(path, level);
+    }, DEFAULT_TEXTURE_BUDGET, &m_asset_pack_};
+    int framebuffer_width = 0;
+    int framebuffer_height = 0;
+    glfwGetFramebufferSize(renderer.window, &framebuffer_width, &framebuffer_height);
+    texture_streamer.set_viewport_height(static_cast<f32>(framebuffer_height));
+    AnimationSystem animation_system{m_world_, m_meshes_, m_thread_pool_};
+    m_meshes_.set_ready_callback([&renderer](AssetHandle, const std::string& path, MeshAsset& mesh) {
+        // The packed sections go to the GPU as cooked, with every LOD and
+        // meshlet. Nothing waits for the copy, the renderer draws the mesh
+        // from the frame that waits for it on the GPU. Animation keeps the
+        // skeleton, the mapping can go.
+        renderer.upload_mesh(path, mesh.file);
+        mesh.file = MeshFile{};
+    });
+    m_meshes_.set_unload_callback([&renderer](const std::string& path) {
+        renderer.remove_mesh(path);
+    });
+#ifndef DIST
+    // Edited models and shaders are re-cooked and swapped in while running
+    constexpr const char* watched_directories[] = {"Models", "Shaders"};
+    HotReloader hot_reloader{m_world_, renderer, m_meshes_, m_thread_pool_, &m_asset_index_, watched_directories};
+#endif
     renderer.render();
+    m_meshes_.set_ready_callback({});
+    m_meshes_.set_unload_callback({});
+    if (!m_recording_path_.empty()) {
+        m_prefetcher_.set_recording(false);
+        if (m_level_manifest_.save(m_recording_path_.c_str())) {
+            ENGINE_LOG_INFO("Recorded {} level assets to {}", m_level_manifest_.get_asset_count(), m_recording_path_)
+        }
+        m_recording_path_.clear();
+    }
 }
 
 flecs::world& StealthEngine::get_world() {
     return m_world_;
 }
 
+ThreadPool& StealthEngine::get_thread_pool() {
+    return m_thread_pool_;
+}
+
+io::AsyncIOService& StealthEngine::get_io_service() {
+    return m_io_service_;
+}
+
+const io::AssetIndex& StealthEngine::get_asset_index() const {
+    return m_asset_index_;
+}
+
+const io::PackFile& StealthEngine::get_asset_pack() const {
+    return m_asset_pack_;
+}
+
+AssetCache<MeshAsset>& StealthEngine::get_meshes() {
+    return m_meshes_;
+}
+
+flecs::entity StealthEngine::spawn_mesh(std::string_view mesh_path, const components::Transform3D& transform, const std::string& texture_path) {
+    flecs::entity entity = m_world_.entity()
+        .set(transform)
+        .set(components::MeshRef{m_meshes_.acquire(mesh_path), get_asset_id(mesh_path)});
+    if (!texture_path.empty()) {
+        entity.set(components::TextureSource{texture_path});
+    }
+    return entity;
+}
+
+void StealthEngine::load_level(const char* manifest_path) {
+    m_prefetcher_.set_recording(false);
+    m_recording_path_.clear();
+    m_level_manifest_.load(manifest_path);
+    m_prefetcher_.reset();
+}
+
+void StealthEngine::record_level(const char* manifest_path) {
+    // Regions already recorded keep their assets, new first uses are added
+    m_level_manifest_.load(manifest_path);
+    m_prefetcher_.reset();
+    m_prefetcher_.set_recording(true);
+    m_recording_path_ = manifest_path;
+}
+
 
 }
\ No newline at end of file
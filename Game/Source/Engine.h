@@ -1,13 +1,33 @@
 #pragma once
 
+#include "Assets/AssetCache.h"
+#include "Assets/AssetPrefetcher.h"
+#include "Assets/LevelManifest.h"
+#include "Assets/MeshAsset.h"
+#include "Components/Components.h"
+#include "FileIO/AssetIndex.h"
+#include "FileIO/AsyncIO.h"
+#include "FileIO/PackFile.h"
 #include "Memory/Arena.h"
+#include "Threading/ThreadPool.h"
 #include "../Vendor/flecs/flecs.h"
 
 namespace engine {
 	class StealthEngine {
 	    Arena m_temp_arena_;
 	    Arena m_permanent_arena_;
+	    ThreadPool m_thread_pool_;
+	    io::AsyncIOService m_io_service_;
+	    io::AssetIndex m_asset_index_;
+	    io::PackFile m_asset_pack_;
+	    // Declared before the world, whose MeshRef hooks release into it as it is destroyed
+	    AssetCache<MeshAsset> m_meshes_;
 	    flecs::world m_world_;
+	    LevelManifest m_level_manifest_;
+	    // Destroyed first, its references go back to the cache while it is alive
+	    AssetPrefetcher m_prefetcher_;
+	    // Where the recorded manifest is written once run() returns, empty when not recording
+	    std::string m_recording_path_;
 	public:
 	    StealthEngine();
 	    StealthEngine(const StealthEngine&) = delete;
@@ -18,6 +38,19 @@ namespace engine {
 
 	    void run();
 	    flecs::world& get_world();
+	    ThreadPool& get_thread_pool();
+	    io::AsyncIOService& get_io_service();
+	    const io::AssetIndex& get_asset_index() const;
+	    const io::PackFile& get_asset_pack() const;
+	    // Meshes by base path, uploaded to the renderer as they become ready
+	    AssetCache<MeshAsset>& get_meshes();
+	    // Entity drawing the mesh at base path, its Bounds are attached once the
+	    // mesh is loaded. A texture path adds a streamed TextureRef the same way.
+	    flecs::entity spawn_mesh(std::string_view mesh_path, const components::Transform3D& transform, const std::string& texture_path = {});
+	    // Prefetches the level's assets from a manifest as the camera approaches them
+	    void load_level(const char* manifest_path);
+	    // Records which assets each region uses while playing, saved when run() returns
+	    void record_level(const char* manifest_path);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,262 @@
+﻿#include "AssetIndex.h"
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+#include "FileIO.h"
+#include "Hashing/Hash.h"
+
+namespace io {
+
+static constexpr u32 ASSET_INDEX_MAGIC = 0x49414753; // "SGAI"
+static constexpr u32 ASSET_INDEX_VERSION = 1;
+
+struct AssetIndexHeader {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 path_table_size;
+};
+
+struct ScannedFile {
+    std::string relative_path;
+    u64 size;
+    i64 modified_time;
+};
+
+u64 hash_asset_path(std::string_view relative_path) {
+    return engine::hash::xxh64(relative_path);
+}
+
+static std::string normalize_path(const std::filesystem::path& path) {
+    std::string result = path.generic_string();
+    if (result.starts_with("./")) {
+        result.erase(0, 2);
+    }
+    return result;
+}
+
+static void scan_directory(engine::ThreadPool& thread_pool, engine::JobCounter& counter, const std::filesystem::path& root, const std::filesystem::path& directory, std::mutex& files_mutex, std::vector<ScannedFile>& files) {
+    std::vector<ScannedFile> local_files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_directory(error)) {
+            // Linked directories are not followed, a link back up the tree
+            // would be scanned forever
+            if (entry.is_symlink(error)) {
+                continue;
+            }
+            // Every sub directory becomes its own job so wide trees fan out
+            std::filesystem::path sub_directory = entry.path();
+            thread_pool.submit([&thread_pool, &counter, &root, sub_directory, &files_mutex, &files] {
+                scan_directory(thread_pool, counter, root, sub_directory, files_mutex, files);
+            }, &counter);
+        } else if (entry.is_regular_file(error)) {
+            const u64 size = entry.file_size(error);
+            const i64 modified_time = entry.last_write_time(error).time_since_epoch().count();
+            local_files.push_back(ScannedFile{normalize_path(std::filesystem::relative(entry.path(), root, error)), size, modified_time});
+        }
+    }
+    if (error) {
+        ENGINE_LOG_WARN("Error while scanning {}: {}", directory.string(), error.message())
+    }
+    std::lock_guard lock{files_mutex};
+    files.insert(files.end(), std::make_move_iterator(local_files.begin()), std::make_move_iterator(local_files.end()));
+}
+
+AssetIndex::AssetIndex(Arena* arena, const char* root_path) : m_arena_(arena), m_root_(root_path, STLArenaAllocator<char>{arena}),
+    m_entries_(STLArenaAllocator<AssetEntry>{arena}), m_path_table_(STLArenaAllocator<char>{arena}) {
+    while (!m_root_.empty() && (m_root_.back() == '/' || m_root_.back() == '\\')) {
+        m_root_.pop_back();
+    }
+}
+
+void AssetIndex::load_cache(const char* cache_path, robin_hood::unordered_flat_map<u64, AssetEntry>& cached) const {
+    if (!std::filesystem::exists(cache_path)) {
+        return;
+    }
+    const MappedFile cache{cache_path, MapHint::SEQUENTIAL};
+    if (cache.size() < sizeof(AssetIndexHeader)) {
+        return;
+    }
+    AssetIndexHeader header;
+    std::memcpy(&header, cache.data(), sizeof(header));
+    const size_t expected_size = sizeof(header) + header.entry_count * sizeof(AssetEntry) + header.path_table_size;
+    if (header.magic != ASSET_INDEX_MAGIC || header.version != ASSET_INDEX_VERSION || cache.size() != expected_size) {
+        ENGINE_LOG_WARN("Ignoring stale or corrupt asset index cache {}", cache_path)
+        return;
+    }
+    cached.reserve(header.entry_count);
+    const byte* entry_data = cache.data() + sizeof(header);
+    for (u32 i = 0; i < header.entry_count; i++) {
+        AssetEntry entry;
+        std::memcpy(&entry, entry_data + i * sizeof(AssetEntry), sizeof(entry));
+        cached.emplace(entry.path_hash, entry);
+    }
+}
+
+void AssetIndex::build(engine::ThreadPool& thread_pool, const char* cache_path, std::span<const char* const> content_directories) {
+    robin_hood::unordered_flat_map<u64, AssetEntry> cached;
+    load_cache(cache_path, cached);
+
+    const std::filesystem::path root{m_root_.c_str()};
+    std::mutex files_mutex;
+    std::vector<ScannedFile> files;
+    engine::JobCounter counter;
+    if (content_directories.empty()) {
+        scan_directory(thread_pool, counter, root, root, files_mutex, files);
+    }
+    for (const char* content_directory : content_directories) {
+        scan_directory(thread_pool, counter, root, root / content_directory, files_mutex, files);
+    }
+    thread_pool.wait(counter);
+
+    std::unique_lock lock{m_mutex_};
+    m_entries_.clear();
+    m_path_table_.clear();
+    m_lookup_.clear();
+    m_refreshed_.clear();
+    m_removed_.clear();
+    m_entries_.reserve(files.size());
+    m_lookup_.reserve(files.size());
+    size_t path_table_size = 0;
+    for (const ScannedFile& file : files) {
+        path_table_size += file.relative_path.size();
+    }
+    m_path_table_.reserve(path_table_size);
+
+    std::vector<u32> stale_entries;
+    for (const ScannedFile& file : files) {
+        AssetEntry entry{};
+        entry.path_hash = hash_asset_path(file.relative_path);
+        entry.size = file.size;
+        entry.modified_time = file.modified_time;
+        entry.path_offset = static_cast<u32>(m_path_table_.size());
+        entry.path_length = static_cast<u32>(file.relative_path.size());
+        m_path_table_.insert(m_path_table_.end(), file.relative_path.begin(), file.relative_path.end());
+
+        const auto cached_entry = cached.find(entry.path_hash);
+        if (cached_entry != cached.end() && cached_entry->second.size == entry.size && cached_entry->second.modified_time == entry.modified_time) {
+            entry.content_hash = cached_entry->second.content_hash;
+        } else {
+            stale_entries.push_back(static_cast<u32>(m_entries_.size()));
+        }
+        m_lookup_.emplace(entry.path_hash, static_cast<u32>(m_entries_.size()));
+        m_entries_.push_back(entry);
+    }
+
+    thread_pool.parallel_for(stale_entries.size(), 4, [this, &stale_entries](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            AssetEntry& entry = m_entries_[stale_entries[i]];
+            const std::string full_path = std::string{m_root_.c_str()} + '/' + std::string{get_relative_path(entry)};
+            const MappedFile mapping{full_path.c_str(), MapHint::SEQUENTIAL};
+            entry.content_hash = engine::hash::xxh64(mapping.data(), mapping.size());
+        }
+    });
+
+    ENGINE_LOG_INFO("Indexed {} assets under {}, {} needed hashing", m_entries_.size(), m_root_.c_str(), stale_entries.size())
+    if (!stale_entries.empty() || cached.size() != m_entries_.size()) {
+        save_cache(cache_path);
+    }
+}
+
+bool AssetIndex::save_cache(const char* cache_path) const {
+    std::ofstream file{cache_path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        ENGINE_LOG_WARN("Failed to write asset index cache {}", cache_path)
+        return false;
+    }
+    const AssetIndexHeader header{ASSET_INDEX_MAGIC, ASSET_INDEX_VERSION, static_cast<u32>(m_entries_.size()), static_cast<u32>(m_path_table_.size())};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(m_entries_.data()), static_cast<std::streamsize>(m_entries_.size() * sizeof(AssetEntry)));
+    file.write(m_path_table_.data(), static_cast<std::streamsize>(m_path_table_.size()));
+    return file.good();
+}
+
+std::string_view AssetIndex::strip_root(std::string_view path) const {
+    const std::string_view root{m_root_.c_str(), m_root_.size()};
+    if (path.size() > root.size() && path.starts_with(root) && (path[root.size()] == '/' || path[root.size()] == '\\')) {
+        path.remove_prefix(root.size() + 1);
+    }
+    while (path.starts_with("./")) {
+        path.remove_prefix(2);
+    }
+    return path;
+}
+
+const AssetEntry* AssetIndex::find_entry(u64 path_hash) const {
+    if (const auto refreshed = m_refreshed_.find(path_hash); refreshed != m_refreshed_.end()) {
+        return &refreshed->second;
+    }
+    if (m_removed_.contains(path_hash)) {
+        return nullptr;
+    }
+    const auto it = m_lookup_.find(path_hash);
+    return it == m_lookup_.end() ? nullptr : &m_entries_[it->second];
+}
+
+std::optional<AssetEntry> AssetIndex::find(std::string_view path) const {
+    std::shared_lock lock{m_mutex_};
+    const AssetEntry* entry = find_entry(hash_asset_path(strip_root(path)));
+    return entry ? std::optional<AssetEntry>{*entry} : std::nullopt;
+}
+
+bool AssetIndex::contains(std::string_view path) const {
+    return find(path).has_value();
+}
+
+std::optional<AssetEntry> AssetIndex::refresh(std::string_view path) {
+    const std::string_view relative_path = strip_root(path);
+    const u64 path_hash = hash_asset_path(relative_path);
+    const std::string full_path = std::string{m_root_.c_str()} + '/' + std::string{relative_path};
+    std::error_code error;
+    const u64 size = std::filesystem::file_size(full_path, error);
+    const i64 modified_time = error ? 0 : std::filesystem::last_write_time(full_path, error).time_since_epoch().count();
+    if (error) {
+        std::unique_lock lock{m_mutex_};
+        m_refreshed_.erase(path_hash);
+        m_removed_.insert(path_hash);
+        return std::nullopt;
+    }
+    {
+        std::shared_lock lock{m_mutex_};
+        const AssetEntry* entry = find_entry(path_hash);
+        if (entry && entry->size == size && entry->modified_time == modified_time) {
+            return *entry;
+        }
+    }
+
+    // Hashed outside the lock, lookups of other files go on meanwhile
+    AssetEntry entry{};
+    entry.path_hash = path_hash;
+    entry.size = size;
+    entry.modified_time = modified_time;
+    const MappedFile mapping{full_path.c_str(), MapHint::SEQUENTIAL};
+    entry.content_hash = engine::hash::xxh64(mapping.data(), mapping.size());
+    std::unique_lock lock{m_mutex_};
+    m_removed_.erase(path_hash);
+    m_refreshed_[path_hash] = entry;
+    return entry;
+}
+
+std::string_view AssetIndex::get_relative_path(const AssetEntry& entry) const {
+    return std::string_view{m_path_table_.data() + entry.path_offset, entry.path_length};
+}
+
+arena_string AssetIndex::get_full_path(const AssetEntry& entry) const {
+    arena_string full_path{m_root_.c_str(), STLArenaAllocator<char>{m_arena_}};
+    full_path += '/';
+    full_path += get_relative_path(entry);
+    return full_path;
+}
+
+std::span<const AssetEntry> AssetIndex::entries() const {
+    return std::span<const AssetEntry>{m_entries_.data(), m_entries_.size()};
+}
+
+const arena_string& AssetIndex::get_root() const {
+    return m_root_;
+}
+
+}
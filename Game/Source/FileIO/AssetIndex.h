@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string_view>
+
+#include "common.h"
+#include "robin_hood.h"
+#include "Threading/ThreadPool.h"
+
+namespace io {
+
+struct AssetEntry {
+    // xxh64 of the path relative to the index root with '/' separators
+    u64 path_hash;
+    u64 size;
+    i64 modified_time;
+    u64 content_hash;
+    u32 path_offset;
+    u32 path_length;
+};
+
+// Recursive index of every file under a content root. Built once at startup
+// with the directory walk and the hashing spread over the thread pool, after
+// which existence, size and content hash queries are hash table lookups. The
+// result is persisted to a cache file so unchanged files are never re-read.
+// Files written or edited after the build are picked up through refresh().
+class AssetIndex {
+    Arena* m_arena_;
+    arena_string m_root_;
+    arena_vector<AssetEntry> m_entries_;
+    arena_vector<char> m_path_table_;
+    robin_hood::unordered_flat_map<u64, u32> m_lookup_;
+    // Entries refresh() found changed, new or gone since the build. They live
+    // on the heap since refreshes come from worker threads and the arena is
+    // not theirs to allocate from.
+    robin_hood::unordered_flat_map<u64, AssetEntry> m_refreshed_;
+    robin_hood::unordered_flat_set<u64> m_removed_;
+    mutable std::shared_mutex m_mutex_;
+
+    std::string_view strip_root(std::string_view path) const;
+    // Caller holds m_mutex_
+    const AssetEntry* find_entry(u64 path_hash) const;
+    void load_cache(const char* cache_path, robin_hood::unordered_flat_map<u64, AssetEntry>& cached) const;
+public:
+    AssetIndex(Arena* arena, const char* root_path);
+    AssetIndex(const AssetIndex&) = delete;
+    AssetIndex& operator=(const AssetIndex&) = delete;
+    AssetIndex(AssetIndex&&) = delete;
+    AssetIndex& operator=(AssetIndex&&) = delete;
+    ~AssetIndex() = default;
+
+    // Walks the tree, or only the given sub directories of the root, and fills
+    // the index. Entries whose size and modification time match the cache keep
+    // their cached content hash, everything else is hashed again. The cache is
+    // rewritten when anything changed.
+    void build(engine::ThreadPool& thread_pool, const char* cache_path, std::span<const char* const> content_directories = {});
+    bool save_cache(const char* cache_path) const;
+
+    // Paths may be relative to the root or start with the root itself. Safe
+    // to call while other threads refresh.
+    std::optional<AssetEntry> find(std::string_view path) const;
+    [[nodiscard]] bool contains(std::string_view path) const;
+    // Stats one file and returns its entry, re-hashing it only when its size
+    // or modification time changed. New files are added and missing ones
+    // dropped, so callers that write files keep the index current.
+    std::optional<AssetEntry> refresh(std::string_view path);
+
+    // Cover the files of the last build, not the refreshed ones
+    std::string_view get_relative_path(const AssetEntry& entry) const;
+    arena_string get_full_path(const AssetEntry& entry) const;
+    std::span<const AssetEntry> entries() const;
+    const arena_string& get_root() const;
+};
+
+u64 hash_asset_path(std::string_view relative_path);
+
+}
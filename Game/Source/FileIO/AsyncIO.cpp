@@ -0,0 +1,432 @@
+﻿#include "AsyncIO.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+
+#ifdef WINDOWS
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ENGINE_HAS_IO_URING 1
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace io {
+
+ReadBatch::ReadBatch(std::span<const ReadRequest> requests, Callback on_complete) : m_requests_(requests.begin(), requests.end()), m_results_(requests.size(), ReadResult{0, 0}), m_on_complete_(std::move(on_complete)) {
+    m_pending_.remaining.store(static_cast<u32>(requests.size()), std::memory_order_relaxed);
+}
+
+bool ReadBatch::is_complete() const {
+    return m_pending_.remaining.load(std::memory_order_acquire) == 0;
+}
+
+bool ReadBatch::succeeded() const {
+    for (const ReadResult& result : m_results_) {
+        if (result.error != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::span<const ReadRequest> ReadBatch::requests() const {
+    return m_requests_;
+}
+
+std::span<const ReadResult> ReadBatch::results() const {
+    return m_results_;
+}
+
+i32 read_file_range(const char* path, u64 offset, u64 size, void* destination, u64& bytes_read) {
+    bytes_read = 0;
+#ifdef WINDOWS
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return ENOENT;
+    }
+    i32 error = 0;
+    while (bytes_read < size) {
+        const u64 position = offset + bytes_read;
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(position);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+        const DWORD to_read = static_cast<DWORD>(std::min<u64>(size - bytes_read, 1u << 30));
+        DWORD read = 0;
+        if (!ReadFile(file, static_cast<byte*>(destination) + bytes_read, to_read, &read, &overlapped)) {
+            error = GetLastError() == ERROR_HANDLE_EOF ? 0 : EIO;
+            break;
+        }
+        if (read == 0) {
+            break;
+        }
+        bytes_read += read;
+    }
+    CloseHandle(file);
+    return error;
+#else
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    i32 error = 0;
+    while (bytes_read < size) {
+        const ssize_t read = pread(fd, static_cast<byte*>(destination) + bytes_read, size - bytes_read, static_cast<off_t>(offset + bytes_read));
+        if (read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno;
+            break;
+        }
+        if (read == 0) {
+            break;
+        }
+        bytes_read += static_cast<u64>(read);
+    }
+    close(fd);
+    return error;
+#endif
+}
+
+#ifdef ENGINE_HAS_IO_URING
+
+// Minimal io_uring over the raw syscalls so there is no liburing dependency.
+// Only the submission thread touches the rings.
+class IoUring {
+public:
+    struct Submission {
+        ReadBatchHandle batch;
+        u32 index;
+    };
+
+    struct InFlightRead {
+        ReadBatchHandle batch;
+        u32 index;
+        int fd;
+        u64 bytes_read;
+        iovec vector;
+    };
+
+    moodycamel::BlockingConcurrentQueue<Submission> submissions;
+    std::deque<InFlightRead*> waiting;
+    u32 in_flight = 0;
+    // Queued in the SQ but not yet consumed by io_uring_enter
+    u32 unsubmitted = 0;
+    // Set once io_uring_enter fails for good, later reads fail with it
+    int error = 0;
+    bool running = true;
+
+    int ring_fd = -1;
+    u32 sq_entries = 0;
+    // Reads in flight are capped at this so completions never overflow the CQ
+    u32 cq_entries = 0;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    u32* sq_head = nullptr;
+    u32* sq_tail = nullptr;
+    u32* sq_mask = nullptr;
+    u32* sq_array = nullptr;
+    u32* cq_head = nullptr;
+    u32* cq_tail = nullptr;
+    u32* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    bool init(u32 queue_depth) {
+        io_uring_params params{};
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (ring_fd < 0) {
+            return false;
+        }
+        sq_entries = params.sq_entries;
+        cq_entries = params.cq_entries;
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) {
+            sq_ring = nullptr;
+            return false;
+        }
+        if (single_mmap) {
+            cq_ring = sq_ring;
+        } else {
+            cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED) {
+                cq_ring = nullptr;
+                return false;
+            }
+        }
+        void* sqe_memory = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqe_memory == MAP_FAILED) {
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqe_memory);
+
+        byte* sq = static_cast<byte*>(sq_ring);
+        sq_head = reinterpret_cast<u32*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<u32*>(sq + params.sq_off.array);
+        byte* cq = static_cast<byte*>(cq_ring);
+        cq_head = reinterpret_cast<u32*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    ~IoUring() {
+        if (sqes) {
+            munmap(sqes, sq_entries * sizeof(io_uring_sqe));
+        }
+        if (cq_ring && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring) {
+            munmap(sq_ring, sq_ring_size);
+        }
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+    }
+
+    // Queues a readv for whatever part of the request is still missing
+    bool push_read(InFlightRead* read) {
+        const u32 tail = *sq_tail;
+        const u32 head = std::atomic_ref<u32>{*sq_head}.load(std::memory_order_acquire);
+        if (tail - head >= sq_entries || in_flight >= cq_entries) {
+            return false;
+        }
+        const ReadRequest& request = read->batch->requests()[read->index];
+        read->vector.iov_base = static_cast<byte*>(request.destination) + read->bytes_read;
+        read->vector.iov_len = request.size - read->bytes_read;
+
+        const u32 slot = tail & *sq_mask;
+        io_uring_sqe& sqe = sqes[slot];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = read->fd;
+        sqe.off = request.offset + read->bytes_read;
+        sqe.addr = reinterpret_cast<u64>(&read->vector);
+        sqe.len = 1;
+        sqe.user_data = reinterpret_cast<u64>(read);
+        sq_array[slot] = slot;
+        std::atomic_ref<u32>{*sq_tail}.store(tail + 1, std::memory_order_release);
+        in_flight++;
+        unsubmitted++;
+        return true;
+    }
+
+    // Takes back the SQEs the kernel never consumed, they are the newest ones
+    // so the tail simply moves back over them
+    void take_back_unsubmitted(std::deque<InFlightRead*>& reads) {
+        const u32 tail = *sq_tail;
+        for (u32 position = tail - unsubmitted; position != tail; position++) {
+            reads.push_back(reinterpret_cast<InFlightRead*>(sqes[sq_array[position & *sq_mask]].user_data));
+        }
+        std::atomic_ref<u32>{*sq_tail}.store(tail - unsubmitted, std::memory_order_release);
+        in_flight -= unsubmitted;
+        unsubmitted = 0;
+    }
+
+    int enter(u32 to_submit, u32 min_complete) const {
+        return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+    }
+};
+
+void AsyncIOService::uring_loop() {
+    IoUring& ring = *m_uring_;
+    while (ring.running || ring.in_flight > 0 || !ring.waiting.empty()) {
+        // Sleep on the request queue only when the kernel has nothing for us
+        IoUring::Submission submission;
+        bool has_submission;
+        if (ring.in_flight == 0 && ring.waiting.empty()) {
+            ring.submissions.wait_dequeue(submission);
+            has_submission = true;
+        } else {
+            has_submission = ring.submissions.try_dequeue(submission);
+        }
+        while (has_submission) {
+            if (submission.batch == nullptr) {
+                ring.running = false;
+            } else if (ring.error != 0) {
+                complete_request(submission.batch, submission.index, 0, ring.error);
+            } else {
+                const ReadRequest& request = submission.batch->requests()[submission.index];
+                const int fd = open(request.path, O_RDONLY | O_CLOEXEC);
+                if (fd < 0) {
+                    complete_request(submission.batch, submission.index, 0, errno);
+                } else if (request.size == 0) {
+                    close(fd);
+                    complete_request(submission.batch, submission.index, 0, 0);
+                } else {
+                    ring.waiting.push_back(new IoUring::InFlightRead{std::move(submission.batch), submission.index, fd, 0, {}});
+                }
+            }
+            has_submission = ring.submissions.try_dequeue(submission);
+        }
+
+        while (!ring.waiting.empty() && ring.push_read(ring.waiting.front())) {
+            ring.waiting.pop_front();
+        }
+        if (ring.in_flight == 0) {
+            continue;
+        }
+        // The kernel may consume fewer SQEs than asked, the rest go again on
+        // the next pass. EBUSY means the CQ has to be reaped first.
+        const int entered = ring.enter(ring.unsubmitted, 1);
+        if (entered >= 0) {
+            ring.unsubmitted -= static_cast<u32>(entered);
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            if (ring.error == 0) {
+                ring.error = errno;
+                ENGINE_LOG_ERROR("io_uring_enter failed with errno {}, failing pending reads", ring.error)
+            }
+            ring.take_back_unsubmitted(ring.waiting);
+            for (IoUring::InFlightRead* read : ring.waiting) {
+                close(read->fd);
+                complete_request(read->batch, read->index, read->bytes_read, ring.error);
+                delete read;
+            }
+            ring.waiting.clear();
+            // Reads the kernel already took still post completions, keep
+            // reaping without spinning hot
+            std::this_thread::yield();
+        }
+
+        u32 head = *ring.cq_head;
+        const u32 tail = std::atomic_ref<u32>{*ring.cq_tail}.load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = ring.cqes[head & *ring.cq_mask];
+            IoUring::InFlightRead* read = reinterpret_cast<IoUring::InFlightRead*>(cqe.user_data);
+            ring.in_flight--;
+            const ReadRequest& request = read->batch->requests()[read->index];
+            if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+                ring.waiting.push_back(read);
+                continue;
+            }
+            if (cqe.res > 0) {
+                read->bytes_read += static_cast<u64>(cqe.res);
+                if (read->bytes_read < request.size) {
+                    // Short read, go again for the remainder
+                    ring.waiting.push_back(read);
+                    continue;
+                }
+            }
+            close(read->fd);
+            complete_request(read->batch, read->index, read->bytes_read, cqe.res < 0 ? -cqe.res : 0);
+            delete read;
+        }
+        std::atomic_ref<u32>{*ring.cq_head}.store(head, std::memory_order_release);
+    }
+}
+
+#else
+
+class IoUring {};
+
+void AsyncIOService::uring_loop() {
+
+}
+
+#endif
+
+AsyncIOService::AsyncIOService(engine::ThreadPool& thread_pool, u32 queue_depth) : m_thread_pool_(thread_pool) {
+#ifdef ENGINE_HAS_IO_URING
+    m_uring_ = std::make_unique<IoUring>();
+    if (m_uring_->init(queue_depth)) {
+        m_uring_thread_ = std::thread{&AsyncIOService::uring_loop, this};
+        ENGINE_LOG_INFO("Async IO using io_uring with {} entries", m_uring_->sq_entries)
+    } else {
+        ENGINE_LOG_WARN("io_uring unavailable (errno {}), falling back to the thread pool", errno)
+        m_uring_.reset();
+    }
+#endif
+}
+
+AsyncIOService::~AsyncIOService() {
+#ifdef ENGINE_HAS_IO_URING
+    if (m_uring_) {
+        // An empty submission tells the ring thread to drain and exit
+        m_uring_->submissions.enqueue(IoUring::Submission{nullptr, 0});
+        m_uring_thread_.join();
+    }
+#endif
+    m_thread_pool_.wait(m_pool_reads_);
+}
+
+void AsyncIOService::complete_request(const ReadBatchHandle& batch, u32 index, u64 bytes_read, i32 error) {
+    batch->m_results_[index] = ReadResult{bytes_read, error};
+    if (batch->m_pending_.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_completed_.enqueue(batch);
+    }
+}
+
+void AsyncIOService::submit_to_thread_pool(const ReadBatchHandle& batch) {
+    for (u32 i = 0; i < batch->m_requests_.size(); i++) {
+        m_thread_pool_.submit([this, batch, i] {
+            const ReadRequest& request = batch->m_requests_[i];
+            u64 bytes_read = 0;
+            const i32 error = read_file_range(request.path, request.offset, request.size, request.destination, bytes_read);
+            complete_request(batch, i, bytes_read, error);
+        }, &m_pool_reads_);
+    }
+}
+
+ReadBatchHandle AsyncIOService::submit(std::span<const ReadRequest> requests, ReadBatch::Callback on_complete) {
+    ReadBatchHandle batch = std::make_shared<ReadBatch>(requests, std::move(on_complete));
+    if (requests.empty()) {
+        m_completed_.enqueue(batch);
+        return batch;
+    }
+#ifdef ENGINE_HAS_IO_URING
+    if (m_uring_) {
+        for (u32 i = 0; i < requests.size(); i++) {
+            m_uring_->submissions.enqueue(IoUring::Submission{batch, i});
+        }
+        return batch;
+    }
+#endif
+    submit_to_thread_pool(batch);
+    return batch;
+}
+
+u32 AsyncIOService::poll() {
+    u32 completed = 0;
+    ReadBatchHandle batch;
+    while (m_completed_.try_dequeue(batch)) {
+        if (batch->m_on_complete_) {
+            batch->m_on_complete_(*batch);
+        }
+        completed++;
+    }
+    return completed;
+}
+
+void AsyncIOService::wait(const ReadBatchHandle& batch) {
+    m_thread_pool_.wait(batch->m_pending_);
+    poll();
+}
+
+bool AsyncIOService::is_using_io_uring() const {
+    return m_uring_ != nullptr;
+}
+
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "blockingconcurrentqueue.h"
+#include "common.h"
+#include "Threading/ThreadPool.h"
+
+namespace io {
+
+struct ReadRequest {
+    // Must stay alive until the batch completes
+    const char* path;
+    u64 offset;
+    u64 size;
+    void* destination;
+};
+
+struct ReadResult {
+    u64 bytes_read;
+    // 0 on success, otherwise an errno style code
+    i32 error;
+};
+
+class ReadBatch {
+    friend class AsyncIOService;
+public:
+    using Callback = std::function<void(const ReadBatch&)>;
+private:
+    std::vector<ReadRequest> m_requests_;
+    std::vector<ReadResult> m_results_;
+    Callback m_on_complete_;
+    engine::JobCounter m_pending_;
+public:
+    ReadBatch(std::span<const ReadRequest> requests, Callback on_complete);
+
+    [[nodiscard]] bool is_complete() const;
+    [[nodiscard]] bool succeeded() const;
+    std::span<const ReadRequest> requests() const;
+    std::span<const ReadResult> results() const;
+};
+
+using ReadBatchHandle = std::shared_ptr<ReadBatch>;
+
+class IoUring;
+
+// Services batches of positional reads off the main thread. On Linux requests
+// go through an io_uring owned by a dedicated submission thread, everywhere
+// else (or when the kernel refuses to create a ring) each read becomes a job
+// on the thread pool. Completion callbacks only ever run inside poll() or
+// wait(), which makes them safe to touch main thread state such as arenas.
+class AsyncIOService {
+    engine::ThreadPool& m_thread_pool_;
+    // Pool reads still running, the destructor waits for them since they
+    // complete through this service
+    engine::JobCounter m_pool_reads_;
+    moodycamel::ConcurrentQueue<ReadBatchHandle> m_completed_;
+    std::unique_ptr<IoUring> m_uring_;
+    std::thread m_uring_thread_;
+
+    void complete_request(const ReadBatchHandle& batch, u32 index, u64 bytes_read, i32 error);
+    void submit_to_thread_pool(const ReadBatchHandle& batch);
+    void uring_loop();
+public:
+    explicit AsyncIOService(engine::ThreadPool& thread_pool, u32 queue_depth = 128);
+    AsyncIOService(const AsyncIOService&) = delete;
+    AsyncIOService& operator=(const AsyncIOService&) = delete;
+    AsyncIOService(AsyncIOService&&) = delete;
+    AsyncIOService& operator=(AsyncIOService&&) = delete;
+    ~AsyncIOService();
+
+    ReadBatchHandle submit(std::span<const ReadRequest> requests, ReadBatch::Callback on_complete = {});
+    // Runs callbacks of finished batches on the calling thread. Returns how
+    // many batches were completed.
+    u32 poll();
+    // Blocks until the batch is done, running pool jobs while waiting, then polls
+    void wait(const ReadBatchHandle& batch);
+
+    [[nodiscard]] bool is_using_io_uring() const;
+};
+
+// Synchronous positional read used by the thread pool path and by anything
+// that needs a single blocking read. Returns 0 or an errno style code.
+i32 read_file_range(const char* path, u64 offset, u64 size, void* destination, u64& bytes_read);
+
+}
@@ -1,11 +1,413 @@
 ﻿#include "FileIO.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
 #include <regex>
 
+#ifdef WINDOWS
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace io {
 
+#ifdef WINDOWS
+
+// Queried once, advise ranges are rounded to it
+static size_t get_page_size() {
+    static const size_t page_size = [] {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return static_cast<size_t>(info.dwPageSize);
+    }();
+    return page_size;
+}
+
+static void advise_range(const byte* data, size_t length, MapHint hint) {
+    // The cache manager has no per range sequential/random hint for views,
+    // only prefetching is worth doing here.
+    if (hint == MapHint::WILL_NEED && length > 0) {
+        WIN32_MEMORY_RANGE_ENTRY range{const_cast<byte*>(data), length};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+MappedFile::MappedFile() : m_data_(nullptr), m_size_(0), m_file_handle_(nullptr), m_mapping_handle_(nullptr) {
+
+}
+
+MappedFile::MappedFile(const char* path, MapHint hint) : MappedFile() {
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (hint == MapHint::SEQUENTIAL) {
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    } else if (hint == MapHint::RANDOM) {
+        flags |= FILE_FLAG_RANDOM_ACCESS;
+    }
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    ENGINE_ASSERT(file != INVALID_HANDLE_VALUE, "Failed to open file {}", path)
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    m_file_handle_ = file;
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    m_size_ = static_cast<size_t>(file_size.QuadPart);
+    if (m_size_ == 0) {
+        return;
+    }
+    m_mapping_handle_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ENGINE_ASSERT(m_mapping_handle_ != nullptr, "Failed to create file mapping for {}", path)
+    if (m_mapping_handle_ == nullptr) {
+        m_size_ = 0;
+        return;
+    }
+    m_data_ = static_cast<const byte*>(MapViewOfFile(m_mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+    ENGINE_ASSERT(m_data_ != nullptr, "Failed to map view of {}", path)
+    if (m_data_ == nullptr) {
+        m_size_ = 0;
+        return;
+    }
+    advise_range(m_data_, m_size_, hint);
+}
+
+void MappedFile::unmap() noexcept {
+    if (m_data_) {
+        UnmapViewOfFile(m_data_);
+    }
+    if (m_mapping_handle_) {
+        CloseHandle(m_mapping_handle_);
+    }
+    if (m_file_handle_) {
+        CloseHandle(m_file_handle_);
+    }
+    m_data_ = nullptr;
+    m_size_ = 0;
+    m_mapping_handle_ = nullptr;
+    m_file_handle_ = nullptr;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : m_data_(other.m_data_), m_size_(other.m_size_), m_file_handle_(other.m_file_handle_), m_mapping_handle_(other.m_mapping_handle_) {
+    other.m_data_ = nullptr;
+    other.m_size_ = 0;
+    other.m_file_handle_ = nullptr;
+    other.m_mapping_handle_ = nullptr;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_data_ = other.m_data_;
+        m_size_ = other.m_size_;
+        m_file_handle_ = other.m_file_handle_;
+        m_mapping_handle_ = other.m_mapping_handle_;
+        other.m_data_ = nullptr;
+        other.m_size_ = 0;
+        other.m_file_handle_ = nullptr;
+        other.m_mapping_handle_ = nullptr;
+    }
+    return *this;
+}
+
+bool MappedFile::is_valid() const {
+    return m_file_handle_ != nullptr;
+}
+
+#else
+
+// Queried once, 16K and 64K pages exist on ARM
+static size_t get_page_size() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+static void advise_range(const byte* data, size_t length, MapHint hint) {
+    int advice = MADV_NORMAL;
+    switch (hint) {
+        case MapHint::NORMAL:
+            advice = MADV_NORMAL;
+            break;
+        case MapHint::SEQUENTIAL:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case MapHint::RANDOM:
+            advice = MADV_RANDOM;
+            break;
+        case MapHint::WILL_NEED:
+            advice = MADV_WILLNEED;
+            break;
+    }
+    if (length > 0) {
+        madvise(const_cast<byte*>(data), length, advice);
+    }
+}
+
+MappedFile::MappedFile() : m_data_(nullptr), m_size_(0) {
+
+}
+
+MappedFile::MappedFile(const char* path, MapHint hint) : MappedFile() {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    ENGINE_ASSERT(fd >= 0, "Failed to open file {}", path)
+    if (fd < 0) {
+        return;
+    }
+    struct stat file_stat{};
+    fstat(fd, &file_stat);
+    m_size_ = static_cast<size_t>(file_stat.st_size);
+    if (m_size_ == 0) {
+        // mmap rejects empty ranges, an empty file is still a valid mapping
+        static constexpr byte empty_file[1]{};
+        close(fd);
+        m_data_ = empty_file;
+        return;
+    }
+    void* mapping = mmap(nullptr, m_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    ENGINE_ASSERT(mapping != MAP_FAILED, "Failed to map file {}", path)
+    if (mapping == MAP_FAILED) {
+        m_size_ = 0;
+        return;
+    }
+    m_data_ = static_cast<const byte*>(mapping);
+    advise_range(m_data_, m_size_, hint);
+}
+
+void MappedFile::unmap() noexcept {
+    if (m_data_ && m_size_ > 0) {
+        munmap(const_cast<byte*>(m_data_), m_size_);
+    }
+    m_data_ = nullptr;
+    m_size_ = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : m_data_(other.m_data_), m_size_(other.m_size_) {
+    other.m_data_ = nullptr;
+    other.m_size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_data_ = other.m_data_;
+        m_size_ = other.m_size_;
+        other.m_data_ = nullptr;
+        other.m_size_ = 0;
+    }
+    return *this;
+}
+
+bool MappedFile::is_valid() const {
+    return m_data_ != nullptr;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::advise(MapHint hint, size_t offset, size_t length) const {
+    if (offset >= m_size_) {
+        return;
+    }
+    const size_t aligned_offset = offset & ~(get_page_size() - 1);
+    length = std::min(length + (offset - aligned_offset), m_size_ - aligned_offset);
+    advise_range(m_data_ + aligned_offset, length, hint);
+}
+
+ArrayRef<const byte> MappedFile::bytes() const {
+    return ArrayRef<const byte>{m_size_ > 0 ? m_data_ : nullptr, m_size_};
+}
+
+std::string_view MappedFile::as_string_view() const {
+    return std::string_view{reinterpret_cast<const char*>(m_data_), m_size_};
+}
+
+const byte* MappedFile::data() const {
+    return m_data_;
+}
+
+size_t MappedFile::size() const {
+    return m_size_;
+}
+
+static void close_stream_file(intptr_t file) {
+#ifdef WINDOWS
+    CloseHandle(reinterpret_cast<HANDLE>(file));
+#else
+    close(static_cast<int>(file));
+#endif
+}
+
+FileStream::FileStream(Arena* arena, const char* path, u64 chunk_size) : m_buffer_(nullptr), m_chunks_{}, m_file_(-1), m_file_size_(0),
+    m_chunk_size_(chunk_size), m_read_offset_(0), m_consumed_(0), m_fill_index_(0), m_consume_index_(0), m_error_(0), m_stopping_(false) {
+    ENGINE_ASSERT(chunk_size > 0, "FileStream chunk size must not be zero")
+#ifdef WINDOWS
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER file_size{};
+    if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &file_size)) {
+        m_file_ = reinterpret_cast<intptr_t>(file);
+        m_file_size_ = static_cast<u64>(file_size.QuadPart);
+    } else if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+#else
+    const int descriptor = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat file_stat{};
+    if (descriptor >= 0 && fstat(descriptor, &file_stat) == 0) {
+        m_file_ = descriptor;
+        m_file_size_ = static_cast<u64>(file_stat.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    } else if (descriptor >= 0) {
+        close(descriptor);
+    }
+#endif
+    if (m_file_ == -1) {
+        ENGINE_LOG_ERROR("Failed to open {} for streaming", path)
+        return;
+    }
+    // Small files do not need two full sized buffers
+    m_chunk_size_ = std::max<u64>(1, std::min(m_chunk_size_, m_file_size_));
+    m_buffer_ = static_cast<byte*>(arena->push(2 * m_chunk_size_));
+    if (m_buffer_ == nullptr) {
+        ENGINE_LOG_ERROR("No room in the arena for the {} bytes streaming {} needs", 2 * m_chunk_size_, path)
+        close_stream_file(m_file_);
+        m_file_ = -1;
+        return;
+    }
+    m_chunks_[0] = Chunk{m_buffer_, 0, 0, ChunkState::FREE};
+    m_chunks_[1] = Chunk{m_buffer_ + m_chunk_size_, 0, 0, ChunkState::FREE};
+    m_reader_ = std::thread{&FileStream::reader_loop, this};
+}
+
+FileStream::~FileStream() {
+    {
+        std::lock_guard lock{m_mutex_};
+        m_stopping_ = true;
+    }
+    m_chunk_free_.notify_one();
+    if (m_reader_.joinable()) {
+        m_reader_.join();
+    }
+    if (m_file_ != -1) {
+        close_stream_file(m_file_);
+    }
+}
+
+i32 FileStream::read_at(u64 offset, u64 size, byte* destination) const {
+    u64 bytes_read = 0;
+    while (bytes_read < size) {
+        const u64 position = offset + bytes_read;
+#ifdef WINDOWS
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(position);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+        DWORD read = 0;
+        if (!ReadFile(reinterpret_cast<HANDLE>(m_file_), destination + bytes_read, static_cast<DWORD>(size - bytes_read), &read, &overlapped)) {
+            return EIO;
+        }
+#else
+        const ssize_t read = pread(static_cast<int>(m_file_), destination + bytes_read, size - bytes_read, static_cast<off_t>(position));
+        if (read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+#endif
+        if (read == 0) {
+            // The file shrank underneath the stream
+            return EIO;
+        }
+        bytes_read += static_cast<u64>(read);
+    }
+    return 0;
+}
+
+void FileStream::reader_loop() {
+    while (true) {
+        Chunk* chunk;
+        u64 offset;
+        {
+            std::unique_lock lock{m_mutex_};
+            m_chunk_free_.wait(lock, [this] {
+                return m_stopping_ || m_chunks_[m_fill_index_].state == ChunkState::FREE;
+            });
+            if (m_stopping_ || m_read_offset_ >= m_file_size_ || m_error_ != 0) {
+                return;
+            }
+            chunk = &m_chunks_[m_fill_index_];
+            offset = m_read_offset_;
+        }
+        // The reader owns a FREE chunk, the read itself runs unlocked
+        const u64 size = std::min(m_chunk_size_, m_file_size_ - offset);
+        const i32 error = read_at(offset, size, chunk->data);
+        {
+            std::lock_guard lock{m_mutex_};
+            chunk->offset = offset;
+            chunk->size = size;
+            chunk->state = ChunkState::READY;
+            m_error_ = error;
+            m_read_offset_ = offset + size;
+            m_fill_index_ ^= 1;
+        }
+        m_chunk_ready_.notify_one();
+    }
+}
+
+bool FileStream::next(FileChunk& chunk) {
+    if (m_file_ == -1) {
+        return false;
+    }
+    std::unique_lock lock{m_mutex_};
+    Chunk& previous = m_chunks_[m_consume_index_ ^ 1];
+    if (previous.state == ChunkState::IN_USE) {
+        previous.state = ChunkState::FREE;
+        m_chunk_free_.notify_one();
+    }
+    if (m_consumed_ >= m_file_size_) {
+        return false;
+    }
+    Chunk& current = m_chunks_[m_consume_index_];
+    m_chunk_ready_.wait(lock, [this, &current] {
+        return current.state == ChunkState::READY || m_error_ != 0;
+    });
+    if (current.state != ChunkState::READY || m_error_ != 0) {
+        return false;
+    }
+    current.state = ChunkState::IN_USE;
+    m_consumed_ = current.offset + current.size;
+    m_consume_index_ ^= 1;
+    chunk = FileChunk{ArrayRef<const byte>{current.data, current.size}, current.offset};
+    return true;
+}
+
+bool FileStream::is_valid() const {
+    return m_file_ != -1;
+}
+
+i32 FileStream::get_error() {
+    std::lock_guard lock{m_mutex_};
+    return m_error_;
+}
+
+u64 FileStream::size() const {
+    return m_file_size_;
+}
+
+u64 FileStream::get_chunk_size() const {
+    return m_chunk_size_;
+}
+
 RawFile::RawFile(Arena* arena, const arena_string& file_path) : RawFile(arena, file_path.c_str()) {
     
 }
@@ -41,27 +443,21 @@ RawFile& RawFile::operator=(RawFile&& other) noexcept {
 }
 
 arena_vector<byte> RawFile::read_raw_bytes() const {
-    std::ifstream file{m_file_path_.data(), std::ios::binary | std::ios::ate};
-    ENGINE_ASSERT(file.is_open(), "Failed to open file {}", m_file_path_.data())
-    file.seekg(0, std::ios::end);
-    const std::streamsize file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    arena_vector<byte> raw_bytes{static_cast<size_t>(file_size), STLArenaAllocator<byte>{m_arena_}};
-    file.read(reinterpret_cast<char*>(raw_bytes.data()), file_size);
-    file.close();
-    return raw_bytes;
+    const MappedFile mapping = map(MapHint::SEQUENTIAL);
+    return arena_vector<byte>{mapping.data(), mapping.data() + mapping.size(), STLArenaAllocator<byte>{m_arena_}};
 }
 
 arena_string RawFile::read_contents() const {
-    std::ifstream file{m_file_path_.data(), std::ios::binary | std::ios::ate};
-    ENGINE_ASSERT(file.is_open(), "Failed to open file {}", m_file_path_.data())
-    file.seekg(0, std::ios::end);
-    const std::streamsize file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    arena_string raw_bytes{static_cast<u64>(file_size), ' ', STLArenaAllocator<char>{m_arena_}};
-    file.read(raw_bytes.data(), file_size);
-    file.close();
-    return raw_bytes;
+    const MappedFile mapping = map(MapHint::SEQUENTIAL);
+    return arena_string{mapping.as_string_view(), STLArenaAllocator<char>{m_arena_}};
+}
+
+MappedFile RawFile::map(MapHint hint) const {
+    return MappedFile{m_file_path_.c_str(), hint};
+}
+
+FileStream RawFile::stream(u64 chunk_size) const {
+    return FileStream{m_arena_, m_file_path_.c_str(), chunk_size};
 }
 
 arena_string RawFile::get_file_extension() const {
@@ -93,12 +489,27 @@ Folder::Folder(Arena* arena, const char* path) : m_arena_(arena), m_folder_path_
 arena_vector<RawFile> Folder::read_all_files() {
     arena_vector<RawFile> files = MAKE_ARENA_VECTOR(m_arena_, RawFile);
     files.reserve(m_files_.size());
-    for (u32 i = 0; i < files.size(); i++) {
-        files[i] = RawFile{m_arena_, m_files_[i]};
+    for (const arena_string& file_path : m_files_) {
+        files.emplace_back(m_arena_, file_path);
     }
     return files;
 }
 
+ReadBatchHandle Folder::read_all_files_async(AsyncIOService& io_service, ReadBatch::Callback on_complete) const {
+    arena_vector<ReadRequest> requests = MAKE_ARENA_VECTOR(m_arena_, ReadRequest);
+    requests.reserve(m_files_.size());
+    for (const arena_string& file_path : m_files_) {
+        std::error_code error;
+        const u64 file_size = std::filesystem::file_size(file_path.c_str(), error);
+        if (error) {
+            ENGINE_LOG_WARN("Skipping {}, could not stat it: {}", file_path.c_str(), error.message())
+            continue;
+        }
+        requests.push_back(ReadRequest{file_path.c_str(), 0, file_size, m_arena_->push(file_size)});
+    }
+    return io_service.submit(requests, std::move(on_complete));
+}
+
 RawFile Folder::read_file(const arena_string& path) const {
     return RawFile{m_arena_, path};
 }
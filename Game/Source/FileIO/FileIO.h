@@ -1,7 +1,13 @@
 ﻿#pragma once
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
+#include <string_view>
+#include <thread>
 
+#include "AsyncIO.h"
 #include "common.h"
+#include "Containers/ArrayRef.h"
 
 namespace io {
 
@@ -13,6 +19,111 @@ enum Resource: byte {
     CPP_HEADER
 };
 
+// Access pattern hints forwarded to madvise / the Win32 file cache
+enum class MapHint : byte {
+    NORMAL,
+    SEQUENTIAL,
+    RANDOM,
+    WILL_NEED
+};
+
+// Read only view of a whole file mapped into the address space. Pages are
+// faulted in by the OS on first touch and released when the mapping dies, so
+// nothing is copied into an arena.
+class MappedFile {
+    const byte* m_data_;
+    size_t m_size_;
+#ifdef WINDOWS
+    void* m_file_handle_;
+    void* m_mapping_handle_;
+#endif
+
+    void unmap() noexcept;
+public:
+    MappedFile();
+    MappedFile(const char* path, MapHint hint);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    // Re-advises a sub range, offset is rounded down to the page size
+    void advise(MapHint hint, size_t offset, size_t length) const;
+
+    [[nodiscard]] ArrayRef<const byte> bytes() const;
+    [[nodiscard]] std::string_view as_string_view() const;
+    [[nodiscard]] const byte* data() const;
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool is_valid() const;
+};
+
+// A chunk handed out by FileStream, the view points into the stream's own
+// buffer and stays valid until the next call to FileStream::next
+struct FileChunk {
+    ArrayRef<const byte> bytes;
+    u64 offset;
+};
+
+// Reads a file front to back in fixed size chunks through two buffers. A
+// background thread fills one buffer while the caller parses the other, so
+// files far larger than any arena are processed with 2 * chunk_size bytes.
+class FileStream {
+    enum class ChunkState : byte {
+        FREE,
+        READY,
+        IN_USE
+    };
+
+    struct Chunk {
+        byte* data;
+        u64 offset;
+        u64 size;
+        ChunkState state;
+    };
+
+    // Both chunks, pushed once so an exhausted arena fails open instead of
+    // the first read
+    byte* m_buffer_;
+    Chunk m_chunks_[2];
+    // HANDLE on Windows, file descriptor elsewhere
+    intptr_t m_file_;
+    u64 m_file_size_;
+    u64 m_chunk_size_;
+    u64 m_read_offset_;
+    u64 m_consumed_;
+    u32 m_fill_index_;
+    u32 m_consume_index_;
+    i32 m_error_;
+    bool m_stopping_;
+    std::mutex m_mutex_;
+    std::condition_variable m_chunk_ready_;
+    std::condition_variable m_chunk_free_;
+    std::thread m_reader_;
+
+    void reader_loop();
+    i32 read_at(u64 offset, u64 size, byte* destination) const;
+public:
+    static constexpr u64 DEFAULT_CHUNK_SIZE = 1 << 20;
+
+    FileStream(Arena* arena, const char* path, u64 chunk_size = DEFAULT_CHUNK_SIZE);
+    FileStream(const FileStream&) = delete;
+    FileStream& operator=(const FileStream&) = delete;
+    FileStream(FileStream&&) = delete;
+    FileStream& operator=(FileStream&&) = delete;
+    ~FileStream();
+
+    // Releases the previous chunk and blocks until the next one is read.
+    // Returns false at the end of the file or after a read error.
+    bool next(FileChunk& chunk);
+
+    [[nodiscard]] bool is_valid() const;
+    // errno style code of the first failed read, 0 otherwise
+    [[nodiscard]] i32 get_error();
+    [[nodiscard]] u64 size() const;
+    [[nodiscard]] u64 get_chunk_size() const;
+};
+
 class RawFile {
     Arena* m_arena_;
     arena_string m_file_path_;
@@ -27,6 +138,10 @@ public:
 
     arena_vector<byte> read_raw_bytes() const;
     arena_string read_contents() const;
+    [[nodiscard]] MappedFile map(MapHint hint = MapHint::SEQUENTIAL) const;
+    // Incremental alternative to read_raw_bytes for files larger than the
+    // arena, the chunk buffers come from the arena
+    [[nodiscard]] FileStream stream(u64 chunk_size = FileStream::DEFAULT_CHUNK_SIZE) const;
     [[nodiscard]] arena_string get_file_extension() const;
     arena_string& get_file_path();
     arena_string copy_file_path() const;
@@ -45,6 +160,10 @@ public:
     ~Folder() = default;
 
     arena_vector<RawFile> read_all_files();
+    // Reads every file into buffers pushed on the folder's arena. Must be
+    // called on the thread that owns the arena and the folder has to outlive
+    // the batch, the requests point at its paths.
+    ReadBatchHandle read_all_files_async(AsyncIOService& io_service, ReadBatch::Callback on_complete) const;
     RawFile read_file(const arena_string& path) const;
     RawFile read_file(const char* path) const;
     RawFile read_file(u32 index) const;
@@ -0,0 +1,128 @@
+﻿#include "FileWatcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__) && __has_include(<sys/inotify.h>)
+#define ENGINE_HAS_INOTIFY 1
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace io {
+
+FileWatcher::FileWatcher(std::span<const char* const> directories, std::chrono::milliseconds scan_interval) : m_inotify_fd_(-1), m_scan_interval_(scan_interval) {
+    for (const char* directory : directories) {
+        m_directories_.emplace_back(directory);
+    }
+#ifdef ENGINE_HAS_INOTIFY
+    m_inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd_ < 0) {
+        ENGINE_LOG_WARN("inotify unavailable ({}), falling back to polling for file changes", std::strerror(errno))
+    }
+#endif
+    if (m_inotify_fd_ >= 0) {
+        for (const std::string& directory : m_directories_) {
+            watch_directory(directory);
+        }
+    } else {
+        // Record the current write times so the first scan reports nothing
+        scan(nullptr);
+    }
+    m_last_scan_ = std::chrono::steady_clock::now();
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef ENGINE_HAS_INOTIFY
+    if (m_inotify_fd_ >= 0) {
+        close(m_inotify_fd_);
+    }
+#endif
+}
+
+void FileWatcher::watch_directory(const std::string& directory) {
+#ifdef ENGINE_HAS_INOTIFY
+    // Editors commonly save through a temporary file and a rename, so moves
+    // into the directory count as writes too
+    const int watch = inotify_add_watch(m_inotify_fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watch < 0) {
+        ENGINE_LOG_WARN("Failed to watch {}: {}", directory, std::strerror(errno))
+        return;
+    }
+    m_watched_directories_[watch] = directory;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        // Linked directories are skipped like the polling scan does
+        if (entry.is_directory(error) && !entry.is_symlink(error)) {
+            watch_directory(entry.path().generic_string());
+        }
+    }
+#endif
+}
+
+void FileWatcher::scan(std::vector<std::string>* changed_paths) {
+    std::error_code error;
+    for (const std::string& directory : m_directories_) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            const std::filesystem::file_time_type write_time = entry.last_write_time(error);
+            auto [it, inserted] = m_write_times_.try_emplace(entry.path().generic_string(), write_time);
+            if (!inserted && it->second == write_time) {
+                continue;
+            }
+            it->second = write_time;
+            if (changed_paths) {
+                changed_paths->push_back(it->first);
+            }
+        }
+    }
+}
+
+void FileWatcher::poll(std::vector<std::string>& changed_paths) {
+    const size_t first_new = changed_paths.size();
+    if (m_inotify_fd_ < 0) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_last_scan_ < m_scan_interval_) {
+            return;
+        }
+        m_last_scan_ = now;
+        scan(&changed_paths);
+    }
+#ifdef ENGINE_HAS_INOTIFY
+    alignas(inotify_event) char buffer[4096];
+    while (m_inotify_fd_ >= 0) {
+        const ssize_t length = read(m_inotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            const auto directory = m_watched_directories_.find(event->wd);
+            if (event->len == 0 || directory == m_watched_directories_.end()) {
+                continue;
+            }
+            std::string path = directory->second + "/" + event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watch_directory(path);
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                changed_paths.push_back(std::move(path));
+            }
+        }
+    }
+#endif
+    // A single save can produce several events for the same file
+    std::sort(changed_paths.begin() + static_cast<std::ptrdiff_t>(first_new), changed_paths.end());
+    changed_paths.erase(std::unique(changed_paths.begin() + static_cast<std::ptrdiff_t>(first_new), changed_paths.end()), changed_paths.end());
+}
+
+bool FileWatcher::is_using_inotify() const {
+    return m_inotify_fd_ >= 0;
+}
+
+}
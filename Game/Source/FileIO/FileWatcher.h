@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "robin_hood.h"
+
+namespace io {
+
+// Reports files that changed under a set of directories. On Linux changes come
+// from inotify and cost one non-blocking read per poll, everywhere else the
+// directories are rescanned for new write times at most once per interval.
+class FileWatcher {
+    std::vector<std::string> m_directories_;
+    int m_inotify_fd_;
+    robin_hood::unordered_map<int, std::string> m_watched_directories_;
+    robin_hood::unordered_map<std::string, std::filesystem::file_time_type> m_write_times_;
+    std::chrono::steady_clock::time_point m_last_scan_;
+    std::chrono::milliseconds m_scan_interval_;
+
+    void watch_directory(const std::string& directory);
+    void scan(std::vector<std::string>* changed_paths);
+public:
+    explicit FileWatcher(std::span<const char* const> directories, std::chrono::milliseconds scan_interval = std::chrono::milliseconds{250});
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    FileWatcher(FileWatcher&&) = delete;
+    FileWatcher& operator=(FileWatcher&&) = delete;
+    ~FileWatcher();
+
+    // Appends every file written since the last poll, each path at most once.
+    // Paths use forward slashes and start with the watched directory.
+    void poll(std::vector<std::string>& changed_paths);
+    [[nodiscard]] bool is_using_inotify() const;
+};
+
+}
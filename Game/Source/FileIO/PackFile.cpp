@@ -0,0 +1,360 @@
+﻿#include "PackFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "AssetIndex.h"
+#include "Compression/BlockCompression.h"
+#include "Hashing/Hash.h"
+
+namespace io {
+
+PackedFile::PackedFile(Arena* arena, const PackFile* pack, const PackEntry* entry) : m_pack_(pack), m_entry_(entry), m_arena_(arena) {
+
+}
+
+bool PackedFile::is_valid() const {
+    return m_entry_ != nullptr;
+}
+
+ArrayRef<const byte> PackedFile::bytes() const {
+    if (m_entry_ == nullptr) {
+        return ArrayRef<const byte>{nullptr, 0};
+    }
+    return m_pack_->get_stored_bytes(*m_entry_);
+}
+
+bool PackedFile::is_compressed() const {
+    return m_entry_ != nullptr && m_entry_->compression != PackCompression::NONE;
+}
+
+bool PackedFile::read_into(byte* destination, engine::ThreadPool* thread_pool) const {
+    if (m_entry_ == nullptr) {
+        return false;
+    }
+    const ArrayRef<const byte> stored = bytes();
+    switch (m_entry_->compression) {
+        case PackCompression::NONE:
+            std::memcpy(destination, stored.data(), stored.size());
+            return true;
+        case PackCompression::BLOCK_LZ:
+            if (!engine::compression::decompress_blocks(stored.data(), stored.size(), destination, m_entry_->size, thread_pool)) {
+                ENGINE_LOG_ERROR("Pack entry {} is corrupt", get_name())
+                return false;
+            }
+            return true;
+    }
+    ENGINE_LOG_ERROR("Pack entry {} uses an unknown compression {}", get_name(), static_cast<u32>(m_entry_->compression))
+    return false;
+}
+
+arena_vector<byte> PackedFile::read_raw_bytes(engine::ThreadPool* thread_pool) const {
+    if (!is_compressed()) {
+        const ArrayRef<const byte> stored = bytes();
+        return arena_vector<byte>{stored.data(), stored.data() + stored.size(), STLArenaAllocator<byte>{m_arena_}};
+    }
+    arena_vector<byte> contents(m_entry_->size, STLArenaAllocator<byte>{m_arena_});
+    if (!read_into(contents.data(), thread_pool)) {
+        contents.clear();
+    }
+    return contents;
+}
+
+arena_string PackedFile::read_contents(engine::ThreadPool* thread_pool) const {
+    if (!is_compressed()) {
+        const ArrayRef<const byte> stored = bytes();
+        return arena_string{reinterpret_cast<const char*>(stored.data()), stored.size(), STLArenaAllocator<char>{m_arena_}};
+    }
+    arena_string contents(m_entry_->size, '\0', STLArenaAllocator<char>{m_arena_});
+    if (!read_into(reinterpret_cast<byte*>(contents.data()), thread_pool)) {
+        contents.clear();
+    }
+    return contents;
+}
+
+arena_string PackedFile::get_file_extension() const {
+    const std::string_view name = get_name();
+    const size_t slash = name.find_last_of('/');
+    const size_t dot = name.find_last_of('.');
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) {
+        return arena_string{"", STLArenaAllocator<char>{m_arena_}};
+    }
+    return arena_string{name.substr(dot + 1), STLArenaAllocator<char>{m_arena_}};
+}
+
+std::string_view PackedFile::get_name() const {
+    return m_pack_->get_name(*m_entry_);
+}
+
+u64 PackedFile::size() const {
+    return m_entry_->size;
+}
+
+u64 PackedFile::content_hash() const {
+    return m_entry_->content_hash;
+}
+
+PackFile::PackFile() : m_header_(nullptr), m_entries_(nullptr), m_names_(nullptr) {
+
+}
+
+PackFile::PackFile(const char* path) : PackFile() {
+    open(path);
+}
+
+bool PackFile::open(const char* path) {
+    m_header_ = nullptr;
+    m_entries_ = nullptr;
+    m_names_ = nullptr;
+    m_mapping_ = MappedFile{path, MapHint::RANDOM};
+    if (m_mapping_.size() < sizeof(PackHeader)) {
+        ENGINE_LOG_ERROR("{} is not a pack file", path)
+        return false;
+    }
+    const PackHeader* header = reinterpret_cast<const PackHeader*>(m_mapping_.data());
+    if (header->magic != PACK_MAGIC || header->version != PACK_VERSION) {
+        ENGINE_LOG_ERROR("{} has an unsupported pack header", path)
+        return false;
+    }
+    const u64 file_size = m_mapping_.size();
+    const u64 toc_end = header->toc_offset + static_cast<u64>(header->entry_count) * sizeof(PackEntry);
+    if (header->toc_offset < sizeof(PackHeader) || header->toc_offset > file_size || toc_end > file_size || header->name_table_offset > file_size
+        || header->name_table_size > file_size - header->name_table_offset) {
+        ENGINE_LOG_ERROR("{} is truncated", path)
+        return false;
+    }
+    // Entry data lies between the header and the table of contents. Every
+    // entry is checked once here so reads never leave the mapping.
+    const PackEntry* entries = reinterpret_cast<const PackEntry*>(m_mapping_.data() + header->toc_offset);
+    for (u32 i = 0; i < header->entry_count; i++) {
+        const PackEntry& entry = entries[i];
+        if (entry.offset < sizeof(PackHeader) || entry.offset > header->toc_offset || entry.stored_size > header->toc_offset - entry.offset
+            || entry.name_offset > header->name_table_size || entry.name_length > header->name_table_size - entry.name_offset
+            || (entry.compression == PackCompression::NONE && entry.size != entry.stored_size)) {
+            ENGINE_LOG_ERROR("{} is corrupt, entry {} lies outside the file", path, i)
+            return false;
+        }
+        // find() binary searches the table, which only works in hash order
+        if (i > 0 && entry.name_hash < entries[i - 1].name_hash) {
+            ENGINE_LOG_ERROR("{} is corrupt, its table of contents is not sorted at entry {}", path, i)
+            return false;
+        }
+    }
+    m_path_ = path;
+    m_header_ = header;
+    m_entries_ = entries;
+    m_names_ = reinterpret_cast<const char*>(m_mapping_.data() + header->name_table_offset);
+    // Every lookup goes through the table of contents, fault it in up front
+    m_mapping_.advise(MapHint::WILL_NEED, header->toc_offset, toc_end - header->toc_offset);
+    ENGINE_LOG_INFO("Mounted {} with {} entries", path, header->entry_count)
+    return true;
+}
+
+bool PackFile::is_open() const {
+    return m_header_ != nullptr;
+}
+
+const std::string& PackFile::get_path() const {
+    return m_path_;
+}
+
+const PackEntry* PackFile::find(u64 name_hash) const {
+    if (m_header_ == nullptr) {
+        return nullptr;
+    }
+    const PackEntry* end = m_entries_ + m_header_->entry_count;
+    const PackEntry* entry = std::lower_bound(m_entries_, end, name_hash, [](const PackEntry& entry, u64 hash) {
+        return entry.name_hash < hash;
+    });
+    if (entry == end || entry->name_hash != name_hash) {
+        return nullptr;
+    }
+    return entry;
+}
+
+const PackEntry* PackFile::find(std::string_view name) const {
+    const PackEntry* entry = find(hash_asset_path(name));
+    // Guard against hash collisions, names are cheap to compare
+    if (entry && get_name(*entry) != name) {
+        return nullptr;
+    }
+    return entry;
+}
+
+PackedFile PackFile::get_file(Arena* arena, std::string_view name) const {
+    return PackedFile{arena, this, find(name)};
+}
+
+std::span<const PackEntry> PackFile::entries() const {
+    if (m_header_ == nullptr) {
+        return {};
+    }
+    return std::span<const PackEntry>{m_entries_, m_header_->entry_count};
+}
+
+std::string_view PackFile::get_name(const PackEntry& entry) const {
+    return std::string_view{m_names_ + entry.name_offset, entry.name_length};
+}
+
+ArrayRef<const byte> PackFile::get_stored_bytes(const PackEntry& entry) const {
+    return ArrayRef<const byte>{m_mapping_.data() + entry.offset, entry.stored_size};
+}
+
+PackCompression get_default_pack_compression(std::string_view name) {
+    constexpr std::string_view stored_extensions[] = {".tex", ".png", ".jpg", ".ogg", ".mp3", ".zip"};
+    for (const std::string_view extension : stored_extensions) {
+        if (name.ends_with(extension)) {
+            return PackCompression::NONE;
+        }
+    }
+    return PackCompression::BLOCK_LZ;
+}
+
+PackBuilder::PackBuilder(u32 alignment, engine::ThreadPool* thread_pool) : m_alignment_(alignment), m_thread_pool_(thread_pool) {
+    ENGINE_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0, "Pack alignment must be a power of two")
+}
+
+void PackBuilder::add_file(std::string_view name, std::string_view source_path, PackCompression compression) {
+    m_pending_.push_back(PendingEntry{std::string{name}, std::string{source_path}, compression});
+}
+
+u32 PackBuilder::add_directory(std::string_view root, std::string_view directory, PackCompression (*choose_compression)(std::string_view name)) {
+    const std::filesystem::path root_path{root};
+    u32 added = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root_path / directory)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        const std::string name = std::filesystem::relative(entry.path(), root_path).generic_string();
+        add_file(name, entry.path().string(), choose_compression(name));
+        added++;
+    }
+    return added;
+}
+
+// Copies an entry stored as is through a FileStream, hashing it on the way.
+// Level data and audio banks can be far larger than memory, the copy only
+// ever holds two chunks.
+static bool write_streamed(Arena& arena, const char* source_path, std::ofstream& file, PackEntry& entry) {
+    FileStream stream{&arena, source_path};
+    if (!stream.is_valid()) {
+        return false;
+    }
+    engine::hash::Xxh64Stream hash;
+    FileChunk chunk;
+    while (stream.next(chunk)) {
+        hash.update(chunk.bytes.data(), chunk.bytes.size());
+        file.write(reinterpret_cast<const char*>(chunk.bytes.data()), static_cast<std::streamsize>(chunk.bytes.size()));
+    }
+    if (stream.get_error() != 0) {
+        ENGINE_LOG_ERROR("Failed to read {} while packing it: {}", source_path, std::strerror(stream.get_error()))
+        return false;
+    }
+    entry.size = stream.size();
+    entry.stored_size = stream.size();
+    entry.content_hash = hash.digest();
+    return true;
+}
+
+bool PackBuilder::write(const char* output_path) const {
+    const std::vector<PendingEntry>& pending = m_pending_;
+    std::vector<PackEntry> entries(pending.size());
+    std::string names;
+    for (size_t i = 0; i < pending.size(); i++) {
+        entries[i] = PackEntry{};
+        entries[i].name_hash = hash_asset_path(pending[i].name);
+        entries[i].name_offset = static_cast<u32>(names.size());
+        entries[i].name_length = static_cast<u32>(pending[i].name.size());
+        entries[i].compression = pending[i].compression;
+        names += pending[i].name;
+    }
+    // Index permutation sorted by hash, the table of contents is searched by it
+    std::vector<u32> order(entries.size());
+    for (u32 i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&entries](u32 a, u32 b) {
+        return entries[a].name_hash < entries[b].name_hash;
+    });
+    for (size_t i = 1; i < order.size(); i++) {
+        if (entries[order[i]].name_hash == entries[order[i - 1]].name_hash) {
+            ENGINE_LOG_ERROR("Pack names {} and {} collide", pending[order[i]].name, pending[order[i - 1]].name)
+            return false;
+        }
+    }
+
+    std::ofstream file{output_path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        ENGINE_LOG_ERROR("Failed to create pack {}", output_path)
+        return false;
+    }
+    const auto align_up = [this](u64 value) {
+        return (value + m_alignment_ - 1) & ~static_cast<u64>(m_alignment_ - 1);
+    };
+    const auto pad_to = [&file](u64 position) {
+        static constexpr char zeros[256]{};
+        u64 current = static_cast<u64>(file.tellp());
+        while (current < position) {
+            const u64 amount = std::min<u64>(position - current, sizeof(zeros));
+            file.write(zeros, static_cast<std::streamsize>(amount));
+            current += amount;
+        }
+    };
+
+    // Data first, the table of contents is only known once everything is written
+    u64 offset = align_up(sizeof(PackHeader));
+    Arena stream_arena{2 * FileStream::DEFAULT_CHUNK_SIZE};
+    for (const u32 index : order) {
+        PackEntry& entry = entries[index];
+        entry.offset = offset;
+        pad_to(offset);
+        if (entry.compression == PackCompression::NONE) {
+            stream_arena.clear();
+            if (!write_streamed(stream_arena, pending[index].source_path.c_str(), file, entry)) {
+                return false;
+            }
+            offset = align_up(offset + entry.stored_size);
+            continue;
+        }
+        const MappedFile source{pending[index].source_path.c_str(), MapHint::SEQUENTIAL};
+        if (!source.is_valid()) {
+            return false;
+        }
+        entry.size = source.size();
+        entry.content_hash = engine::hash::xxh64(source.data(), source.size());
+        std::vector<byte> compressed = engine::compression::compress_blocks(source.data(), source.size(), m_thread_pool_);
+        if (compressed.size() >= source.size()) {
+            entry.compression = PackCompression::NONE;
+        }
+        const byte* stored = entry.compression == PackCompression::NONE ? source.data() : compressed.data();
+        entry.stored_size = entry.compression == PackCompression::NONE ? source.size() : compressed.size();
+        file.write(reinterpret_cast<const char*>(stored), static_cast<std::streamsize>(entry.stored_size));
+        offset = align_up(offset + entry.stored_size);
+    }
+
+    PackHeader header{};
+    header.magic = PACK_MAGIC;
+    header.version = PACK_VERSION;
+    header.entry_count = static_cast<u32>(entries.size());
+    header.alignment = m_alignment_;
+    header.toc_offset = offset;
+    header.name_table_offset = header.toc_offset + entries.size() * sizeof(PackEntry);
+    header.name_table_size = names.size();
+    pad_to(header.toc_offset);
+    for (const u32 index : order) {
+        file.write(reinterpret_cast<const char*>(&entries[index]), sizeof(PackEntry));
+    }
+    file.write(names.data(), static_cast<std::streamsize>(names.size()));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ENGINE_LOG_INFO("Wrote {} entries to {}", entries.size(), output_path)
+    return file.good();
+}
+
+size_t PackBuilder::get_entry_count() const {
+    return m_pending_.size();
+}
+
+}
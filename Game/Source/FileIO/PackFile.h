@@ -0,0 +1,142 @@
+﻿#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "common.h"
+#include "FileIO.h"
+
+namespace engine {
+class ThreadPool;
+}
+
+namespace io {
+
+static constexpr u32 PACK_MAGIC = 0x4B504753; // "SGPK"
+static constexpr u32 PACK_VERSION = 1;
+
+// Stored per entry, readers reject values they do not know so new codecs
+// can be added without a version bump
+enum class PackCompression : u8 {
+    NONE,
+    // engine::compression block stream, decompressed in parallel on load
+    BLOCK_LZ
+};
+
+struct PackHeader {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 alignment;
+    u64 toc_offset;
+    u64 name_table_offset;
+    u64 name_table_size;
+};
+
+// Table of contents entry, the table is sorted by name_hash. Names are paths
+// relative to the packed root and hashed like AssetIndex paths.
+struct PackEntry {
+    u64 name_hash;
+    u64 offset;
+    u64 stored_size;
+    u64 size;
+    u64 content_hash;
+    u32 name_offset;
+    u32 name_length;
+    PackCompression compression;
+    u8 padding[7];
+};
+
+static_assert(sizeof(PackHeader) == 40 && sizeof(PackEntry) == 56, "Pack structures are written to disk as is");
+
+// BLOCK_LZ for everything the loaders read whole, like meshes and shaders.
+// Textures are streamed as ranges of their entry and media is compressed
+// already, both are stored as is.
+PackCompression get_default_pack_compression(std::string_view name);
+
+class PackFile;
+
+// RawFile-like view of one entry inside a mounted pack
+class PackedFile {
+    const PackFile* m_pack_;
+    const PackEntry* m_entry_;
+    Arena* m_arena_;
+public:
+    PackedFile(Arena* arena, const PackFile* pack, const PackEntry* entry);
+
+    [[nodiscard]] bool is_valid() const;
+    // Zero copy view of the stored bytes, only the uncompressed contents for
+    // entries stored without compression
+    [[nodiscard]] ArrayRef<const byte> bytes() const;
+    [[nodiscard]] bool is_compressed() const;
+    // Decompresses into destination, which must hold size() bytes. Blocks of
+    // compressed entries are spread over thread_pool when one is given.
+    bool read_into(byte* destination, engine::ThreadPool* thread_pool = nullptr) const;
+    arena_vector<byte> read_raw_bytes(engine::ThreadPool* thread_pool = nullptr) const;
+    arena_string read_contents(engine::ThreadPool* thread_pool = nullptr) const;
+    [[nodiscard]] arena_string get_file_extension() const;
+    [[nodiscard]] std::string_view get_name() const;
+    [[nodiscard]] u64 size() const;
+    [[nodiscard]] u64 content_hash() const;
+};
+
+// Read side of the pack format. The whole archive is mapped once and the
+// table of contents is binary searched in place, so mounting costs one open
+// and touching an asset costs the page faults of its own bytes.
+class PackFile {
+    MappedFile m_mapping_;
+    // Uncompressed entries are also read straight from the file at their offset
+    std::string m_path_;
+    const PackHeader* m_header_;
+    const PackEntry* m_entries_;
+    const char* m_names_;
+public:
+    PackFile();
+    explicit PackFile(const char* path);
+    PackFile(const PackFile&) = delete;
+    PackFile& operator=(const PackFile&) = delete;
+    PackFile(PackFile&&) noexcept = default;
+    PackFile& operator=(PackFile&&) noexcept = default;
+    ~PackFile() = default;
+
+    bool open(const char* path);
+    [[nodiscard]] bool is_open() const;
+    [[nodiscard]] const std::string& get_path() const;
+
+    const PackEntry* find(u64 name_hash) const;
+    const PackEntry* find(std::string_view name) const;
+    PackedFile get_file(Arena* arena, std::string_view name) const;
+
+    std::span<const PackEntry> entries() const;
+    std::string_view get_name(const PackEntry& entry) const;
+    ArrayRef<const byte> get_stored_bytes(const PackEntry& entry) const;
+};
+
+// Write side of the pack format, used by the AssetPacker tool
+class PackBuilder {
+    struct PendingEntry {
+        std::string name;
+        std::string source_path;
+        PackCompression compression;
+    };
+
+    std::vector<PendingEntry> m_pending_;
+    u32 m_alignment_;
+    engine::ThreadPool* m_thread_pool_;
+public:
+    // Compressed entries are compressed block parallel on thread_pool
+    explicit PackBuilder(u32 alignment = 64, engine::ThreadPool* thread_pool = nullptr);
+
+    void add_file(std::string_view name, std::string_view source_path, PackCompression compression = PackCompression::NONE);
+    // Adds every regular file under root/directory, named relative to root,
+    // stored with what choose_compression picks for the name
+    u32 add_directory(std::string_view root, std::string_view directory,
+        PackCompression (*choose_compression)(std::string_view name) = get_default_pack_compression);
+    // Entries that do not shrink under compression are stored uncompressed
+    bool write(const char* output_path) const;
+
+    [[nodiscard]] size_t get_entry_count() const;
+};
+
+}
@@ -0,0 +1,138 @@
+﻿#include "Hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace engine::hash {
+
+static constexpr u64 PRIME_1 = 0x9E3779B185EBCA87ull;
+static constexpr u64 PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr u64 PRIME_3 = 0x165667B19E3779F9ull;
+static constexpr u64 PRIME_4 = 0x85EBCA77C2B2AE63ull;
+static constexpr u64 PRIME_5 = 0x27D4EB2F165667C5ull;
+
+static u64 rotate_left(u64 value, u32 amount) {
+    return (value << amount) | (value >> (64 - amount));
+}
+
+static u64 read_u64(const byte* data) {
+    u64 value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static u32 read_u32(const byte* data) {
+    u32 value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static u64 round(u64 accumulator, u64 input) {
+    accumulator += input * PRIME_2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * PRIME_1;
+}
+
+static u64 merge_round(u64 accumulator, u64 value) {
+    accumulator ^= round(0, value);
+    return accumulator * PRIME_1 + PRIME_4;
+}
+
+static u64 merge_lanes(u64 lane_1, u64 lane_2, u64 lane_3, u64 lane_4) {
+    u64 hash = rotate_left(lane_1, 1) + rotate_left(lane_2, 7) + rotate_left(lane_3, 12) + rotate_left(lane_4, 18);
+    hash = merge_round(hash, lane_1);
+    hash = merge_round(hash, lane_2);
+    hash = merge_round(hash, lane_3);
+    return merge_round(hash, lane_4);
+}
+
+// Mixes in the last partial stripe and avalanches
+static u64 finalize(u64 hash, const byte* input, const byte* end) {
+    while (input + 8 <= end) {
+        hash ^= round(0, read_u64(input));
+        hash = rotate_left(hash, 27) * PRIME_1 + PRIME_4;
+        input += 8;
+    }
+    if (input + 4 <= end) {
+        hash ^= static_cast<u64>(read_u32(input)) * PRIME_1;
+        hash = rotate_left(hash, 23) * PRIME_2 + PRIME_3;
+        input += 4;
+    }
+    while (input < end) {
+        hash ^= static_cast<u64>(*input) * PRIME_5;
+        hash = rotate_left(hash, 11) * PRIME_1;
+        input++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+u64 xxh64(const void* data, size_t length, u64 seed) {
+    const byte* input = static_cast<const byte*>(data);
+    const byte* const end = input + length;
+    u64 hash;
+
+    if (length >= 32) {
+        u64 lane_1 = seed + PRIME_1 + PRIME_2;
+        u64 lane_2 = seed + PRIME_2;
+        u64 lane_3 = seed;
+        u64 lane_4 = seed - PRIME_1;
+        const byte* const stripe_limit = end - 32;
+        do {
+            lane_1 = round(lane_1, read_u64(input));
+            lane_2 = round(lane_2, read_u64(input + 8));
+            lane_3 = round(lane_3, read_u64(input + 16));
+            lane_4 = round(lane_4, read_u64(input + 24));
+            input += 32;
+        } while (input <= stripe_limit);
+        hash = merge_lanes(lane_1, lane_2, lane_3, lane_4);
+    } else {
+        hash = seed + PRIME_5;
+    }
+    return finalize(hash + static_cast<u64>(length), input, end);
+}
+
+Xxh64Stream::Xxh64Stream(u64 seed)
+    : m_lanes_{seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1}, m_stripe_{}, m_stripe_size_(0), m_length_(0), m_seed_(seed) {
+
+}
+
+void Xxh64Stream::update(const void* data, size_t length) {
+    const byte* input = static_cast<const byte*>(data);
+    const byte* const end = input + length;
+    m_length_ += length;
+    // Top up a stripe left over from the previous piece first
+    if (m_stripe_size_ > 0) {
+        const size_t amount = std::min<size_t>(sizeof(m_stripe_) - m_stripe_size_, length);
+        std::memcpy(m_stripe_ + m_stripe_size_, input, amount);
+        m_stripe_size_ += static_cast<u32>(amount);
+        input += amount;
+        if (m_stripe_size_ < sizeof(m_stripe_)) {
+            return;
+        }
+        for (u32 lane = 0; lane < 4; lane++) {
+            m_lanes_[lane] = round(m_lanes_[lane], read_u64(m_stripe_ + lane * 8));
+        }
+        m_stripe_size_ = 0;
+    }
+    while (end - input >= 32) {
+        for (u32 lane = 0; lane < 4; lane++) {
+            m_lanes_[lane] = round(m_lanes_[lane], read_u64(input + lane * 8));
+        }
+        input += 32;
+    }
+    std::memcpy(m_stripe_, input, static_cast<size_t>(end - input));
+    m_stripe_size_ = static_cast<u32>(end - input);
+}
+
+u64 Xxh64Stream::digest() const {
+    const u64 hash = m_length_ >= 32 ? merge_lanes(m_lanes_[0], m_lanes_[1], m_lanes_[2], m_lanes_[3]) : m_seed_ + PRIME_5;
+    return finalize(hash + m_length_, m_stripe_, m_stripe_ + m_stripe_size_);
+}
+
+}
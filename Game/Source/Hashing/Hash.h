@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <string_view>
+
+#include "common.h"
+
+namespace engine::hash {
+
+// XXH64, four independent accumulator lanes over 32 byte stripes so the
+// compiler can keep them in registers and overlap the multiplies.
+u64 xxh64(const void* data, size_t length, u64 seed = 0);
+
+inline u64 xxh64(std::string_view string, u64 seed = 0) {
+    return xxh64(string.data(), string.size(), seed);
+}
+
+// XXH64 of data that arrives in pieces, e.g. the chunks of a FileStream.
+// digest() equals xxh64 over everything passed to update().
+class Xxh64Stream {
+    u64 m_lanes_[4];
+    byte m_stripe_[32];
+    u32 m_stripe_size_;
+    u64 m_length_;
+    u64 m_seed_;
+public:
+    explicit Xxh64Stream(u64 seed = 0);
+
+    void update(const void* data, size_t length);
+    [[nodiscard]] u64 digest() const;
+};
+
+inline u64 combine(u64 seed, u64 value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+}
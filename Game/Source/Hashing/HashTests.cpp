@@ -0,0 +1,30 @@
+﻿#include <doctest/doctest.h>
+
+#include <string_view>
+
+#include "Hash.h"
+
+using namespace engine;
+
+TEST_CASE("xxh64 matches the reference values") {
+    CHECK(hash::xxh64(std::string_view{}) == 0xEF46DB3751D8E999ull);
+    CHECK(hash::xxh64(std::string_view{"abc"}) == 0x44BC2CF5AD770999ull);
+    CHECK(hash::xxh64(std::string_view{"Nobody inspects the spammish repetition"}) == 0xFBCEA83C8A378BF1ull);
+    CHECK(hash::xxh64(std::string_view{"abc"}, 1) != hash::xxh64(std::string_view{"abc"}));
+}
+
+TEST_CASE("Xxh64Stream matches xxh64 over any split") {
+    byte data[300];
+    for (u32 i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<byte>(i * 37 + 11);
+    }
+    for (const size_t length : {size_t{0}, size_t{5}, size_t{31}, size_t{32}, size_t{33}, size_t{300}}) {
+        for (const size_t split : {size_t{0}, size_t{1}, size_t{17}, size_t{32}, size_t{64}}) {
+            const size_t first = split < length ? split : length;
+            hash::Xxh64Stream stream{7};
+            stream.update(data, first);
+            stream.update(data + first, length - first);
+            CHECK(stream.digest() == hash::xxh64(data, length, 7));
+        }
+    }
+}
@@ -27,7 +27,7 @@ void* StackAllocator::allocate(size_t amount) {
     }
     uint64_t* current_pos = m_data_ + m_size_;
     if (m_size_ + amount > m_stack_size_) {
-        // Introduce a linked list type setup with stack allocators
+        // Arena chains another stack allocator
         return nullptr;
     }
     m_size_ += amount;
@@ -43,7 +43,7 @@ void* StackAllocator::allocate(size_t amount, size_t alignment) {
     size_t padding = aligned_pos - current_pos;
     size_t new_size = m_size_ + padding;
     if (new_size > m_stack_size_) {
-        // Introduce a linked list type setup with stack allocators
+        // Arena chains another stack allocator
         return nullptr;
     }
     m_size_ = new_size;
@@ -76,6 +76,11 @@ size_t StackAllocator::get_stack_size() const {
     return m_size_;
 }
 
+bool StackAllocator::owns(const void* ptr) const {
+    const auto address = reinterpret_cast<uintptr_t>(ptr);
+    return address >= reinterpret_cast<uintptr_t>(m_data_) && address <= reinterpret_cast<uintptr_t>(m_data_ + m_stack_size_);
+}
+
 bool StackAllocator::operator==(const StackAllocator& other) const {
     return m_data_ == other.m_data_;
 }
@@ -25,6 +25,7 @@ namespace allocators
 
         [[nodiscard]] uint64_t* get_current_pos() const;
         size_t get_stack_size() const;
+        [[nodiscard]] bool owns(const void* ptr) const;
 
         bool operator==(const StackAllocator&) const;
         bool operator!=(const StackAllocator&) const;
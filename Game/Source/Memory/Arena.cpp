@@ -1,44 +1,68 @@
 ﻿#include "Arena.h"
 
+#include <algorithm>
 #include <cstring>
-#include <filesystem>
 
-Arena::Arena(size_t size) : m_stack_(size) {
-    
+static constexpr size_t DEFAULT_BLOCK_SIZE = 2 << 20;
+
+Arena::Arena() : Arena(DEFAULT_BLOCK_SIZE) {
+
+}
+
+Arena::Arena(size_t size) : m_block_size_(size) {
+    add_block(size);
+}
+
+allocators::StackAllocator& Arena::add_block(size_t size) {
+    return *m_blocks_.emplace_back(std::make_unique<allocators::StackAllocator>(std::max(size, m_block_size_)));
 }
 
 void* Arena::push(size_t size) {
-    return m_stack_.allocate(size);
+    if (void* data = m_blocks_.back()->allocate(size); data != nullptr || size == 0) {
+        return data;
+    }
+    return add_block(size).allocate(size);
 }
 
 void* Arena::push(size_t size, size_t alignment) {
-    return m_stack_.allocate(size, alignment);
+    if (void* data = m_blocks_.back()->allocate(size, alignment); data != nullptr || size == 0) {
+        return data;
+    }
+    return add_block(size + alignment).allocate(size, alignment);
 }
 
 void* Arena::push_zero(size_t size) {
-    void* data = m_stack_.allocate(size);
-    memset(data, 0, size);
+    void* data = push(size);
+    if (data != nullptr) {
+        memset(data, 0, size);
+    }
     return data;
 }
 
 void* Arena::push_zero(size_t size, size_t alignment) {
-    void* data = m_stack_.allocate(size, alignment);
-    memset(data, 0, size);
+    void* data = push(size, alignment);
+    if (data != nullptr) {
+        memset(data, 0, size);
+    }
     return data;
 }
 
 void Arena::pop(size_t size) {
-    m_stack_.free_bytes(size);
+    m_blocks_.back()->free_bytes(size);
 }
 
 size_t Arena::get_position() const {
-    return m_stack_.get_stack_size();
+    return m_blocks_.back()->get_stack_size();
 }
 
 void Arena::set_position(uint64_t* position) {
-    m_stack_.free_to_marker(position);
+    while (m_blocks_.size() > 1 && !m_blocks_.back()->owns(position)) {
+        m_blocks_.pop_back();
+    }
+    m_blocks_.back()->free_to_marker(position);
 }
 
 void Arena::clear() {
-    m_stack_.clear();
-}
\ No newline at end of file
+    m_blocks_.resize(1);
+    m_blocks_.front()->clear();
+}
@@ -1,10 +1,18 @@
 ﻿#pragma once
+#include <memory>
+#include <vector>
+
 #include "Allocators/StackAllocator.h"
 
+// Stack of blocks. A push that does not fit the last block chains a new one
+// of at least the initial size, so an arena never runs out before the heap.
 class Arena {
-    allocators::StackAllocator m_stack_;
+    std::vector<std::unique_ptr<allocators::StackAllocator>> m_blocks_;
+    size_t m_block_size_;
+
+    allocators::StackAllocator& add_block(size_t size);
 public:
-    Arena() = default;
+    Arena();
     Arena(size_t size);
     ~Arena() = default;
 
@@ -13,9 +21,13 @@ public:
     void* push_zero(size_t size);
     void* push_zero(size_t size, size_t alignment);
 
+    // Pops from the last block
     void pop(size_t size);
 
+    // Position in the last block
     size_t get_position() const;
+    // Frees everything pushed after position, along with the blocks chained since
     void set_position(uint64_t* position);
+    // Keeps only the first block
     void clear();
 };
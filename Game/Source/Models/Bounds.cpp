@@ -0,0 +1,141 @@
+﻿#include "Bounds.h"
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "Simd.h"
+#include "Vertex.h"
+
+void compute_aabb(std::span<const Vertex> vertices, glm::vec3& bounds_min, glm::vec3& bounds_max) {
+    if (vertices.empty()) {
+        bounds_min = glm::vec3{0.0f};
+        bounds_max = glm::vec3{0.0f};
+        return;
+    }
+#ifdef ENGINE_HAS_SSE
+    // Loads position and the first color component, the fourth lane is ignored.
+    // Two accumulator pairs keep consecutive min/max independent of each other.
+    static_assert(offsetof(Vertex, position) + sizeof(f32) * 4 <= sizeof(Vertex), "Position loads would read past the vertex");
+    __m128 min0 = _mm_loadu_ps(&vertices[0].position.x);
+    __m128 max0 = min0;
+    __m128 min1 = min0;
+    __m128 max1 = min0;
+    size_t i = 1;
+    for (; i + 1 < vertices.size(); i += 2) {
+        const __m128 a = _mm_loadu_ps(&vertices[i].position.x);
+        const __m128 b = _mm_loadu_ps(&vertices[i + 1].position.x);
+        min0 = _mm_min_ps(min0, a);
+        max0 = _mm_max_ps(max0, a);
+        min1 = _mm_min_ps(min1, b);
+        max1 = _mm_max_ps(max1, b);
+    }
+    if (i < vertices.size()) {
+        const __m128 a = _mm_loadu_ps(&vertices[i].position.x);
+        min0 = _mm_min_ps(min0, a);
+        max0 = _mm_max_ps(max0, a);
+    }
+    alignas(16) f32 lanes_min[4];
+    alignas(16) f32 lanes_max[4];
+    _mm_store_ps(lanes_min, _mm_min_ps(min0, min1));
+    _mm_store_ps(lanes_max, _mm_max_ps(max0, max1));
+    bounds_min = glm::vec3{lanes_min[0], lanes_min[1], lanes_min[2]};
+    bounds_max = glm::vec3{lanes_max[0], lanes_max[1], lanes_max[2]};
+#else
+    bounds_min = vertices[0].position;
+    bounds_max = vertices[0].position;
+    for (const Vertex& vertex : vertices) {
+        bounds_min = glm::min(bounds_min, vertex.position);
+        bounds_max = glm::max(bounds_max, vertex.position);
+    }
+#endif
+}
+
+void compute_bounding_sphere(std::span<const glm::vec3> points, glm::vec3& center, f32& radius) {
+    if (points.empty()) {
+        center = glm::vec3{0.0f};
+        radius = 0.0f;
+        return;
+    }
+    static constexpr u32 DIRECTION_COUNT = 7;
+    static const glm::vec3 directions[DIRECTION_COUNT] = {
+        {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+        {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, -1.0f}, {1.0f, -1.0f, 1.0f}, {1.0f, -1.0f, -1.0f}
+    };
+    u32 min_point[DIRECTION_COUNT]{};
+    u32 max_point[DIRECTION_COUNT]{};
+    f32 min_projection[DIRECTION_COUNT];
+    f32 max_projection[DIRECTION_COUNT];
+    for (u32 d = 0; d < DIRECTION_COUNT; d++) {
+        min_projection[d] = std::numeric_limits<f32>::max();
+        max_projection[d] = std::numeric_limits<f32>::lowest();
+    }
+    glm::vec3 box_min = points[0];
+    glm::vec3 box_max = points[0];
+    for (u32 i = 0; i < points.size(); i++) {
+        box_min = glm::min(box_min, points[i]);
+        box_max = glm::max(box_max, points[i]);
+        for (u32 d = 0; d < DIRECTION_COUNT; d++) {
+            const f32 projection = glm::dot(points[i], directions[d]);
+            if (projection < min_projection[d]) {
+                min_projection[d] = projection;
+                min_point[d] = i;
+            }
+            if (projection > max_projection[d]) {
+                max_projection[d] = projection;
+                max_point[d] = i;
+            }
+        }
+    }
+
+    f32 widest = -1.0f;
+    for (u32 d = 0; d < DIRECTION_COUNT; d++) {
+        const glm::vec3 span = points[max_point[d]] - points[min_point[d]];
+        const f32 distance = glm::dot(span, span);
+        if (distance > widest) {
+            widest = distance;
+            center = (points[max_point[d]] + points[min_point[d]]) * 0.5f;
+        }
+    }
+    radius = glm::sqrt(widest) * 0.5f;
+    // Ritter's pass, grow just enough to take in every point outside
+    for (const glm::vec3& point : points) {
+        const f32 distance = glm::length(point - center);
+        if (distance > radius) {
+            const f32 grown_radius = (radius + distance) * 0.5f;
+            center += (point - center) * ((grown_radius - radius) / distance);
+            radius = grown_radius;
+        }
+    }
+
+    const glm::vec3 box_center = (box_min + box_max) * 0.5f;
+    f32 box_radius = 0.0f;
+    for (const glm::vec3& point : points) {
+        box_radius = glm::max(box_radius, glm::length(point - box_center));
+    }
+    if (box_radius < radius) {
+        center = box_center;
+        radius = box_radius;
+    }
+}
+
+BoundingVolume compute_bounding_volume(std::span<const Vertex> vertices) {
+    BoundingVolume volume{};
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+    compute_aabb(vertices, bounds_min, bounds_max);
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[i] = vertices[i].position;
+    }
+    glm::vec3 center;
+    f32 radius;
+    compute_bounding_sphere(positions, center, radius);
+    for (u32 axis = 0; axis < 3; axis++) {
+        volume.aabb_min[axis] = bounds_min[axis];
+        volume.aabb_max[axis] = bounds_max[axis];
+        volume.sphere_center[axis] = center[axis];
+    }
+    volume.sphere_radius = radius;
+    return volume;
+}
@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include <span>
+#include <glm/glm.hpp>
+
+#include "common.h"
+
+struct Vertex;
+
+// Object space box and sphere around a mesh or submesh
+struct BoundingVolume {
+    f32 aabb_min[3];
+    f32 aabb_max[3];
+    f32 sphere_center[3];
+    f32 sphere_radius;
+};
+
+static_assert(sizeof(BoundingVolume) == 40, "Bounding volumes are written to mesh files as is");
+
+// Min/max reduction over the vertex positions, with SSE where available
+void compute_aabb(std::span<const Vertex> vertices, glm::vec3& bounds_min, glm::vec3& bounds_max);
+// Starts from the most distant pair of extremal points along seven directions
+// (Larsson 2008) and grows the sphere to contain every point. The box centred
+// sphere is used instead when it happens to be smaller.
+void compute_bounding_sphere(std::span<const glm::vec3> points, glm::vec3& center, f32& radius);
+BoundingVolume compute_bounding_volume(std::span<const Vertex> vertices);
@@ -0,0 +1,330 @@
+﻿#include "MeshFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+#ifdef WINDOWS
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+static u32 get_process_id() {
+#ifdef WINDOWS
+    return static_cast<u32>(_getpid());
+#else
+    return static_cast<u32>(getpid());
+#endif
+}
+
+MeshFile::MeshFile() : m_data_(nullptr), m_size_(0), m_header_(nullptr), m_sections_(nullptr) {
+
+}
+
+MeshFile::MeshFile(const char* path) : MeshFile() {
+    open(path);
+}
+
+bool MeshFile::open(const char* path) {
+    m_decompressed_ = {};
+    m_mapping_ = io::MappedFile{path, io::MapHint::SEQUENTIAL};
+    m_data_ = m_mapping_.data();
+    m_size_ = m_mapping_.size();
+    return parse(path);
+}
+
+bool MeshFile::open(const io::PackFile& pack, std::string_view name, engine::ThreadPool* thread_pool) {
+    m_mapping_ = io::MappedFile{};
+    m_decompressed_ = {};
+    m_data_ = nullptr;
+    m_size_ = 0;
+    const io::PackedFile file = pack.get_file(nullptr, name);
+    if (!file.is_valid()) {
+        m_header_ = nullptr;
+        m_sections_ = nullptr;
+        return false;
+    }
+    if (file.is_compressed()) {
+        m_decompressed_.resize(file.size());
+        if (!file.read_into(m_decompressed_.data(), thread_pool)) {
+            m_header_ = nullptr;
+            m_sections_ = nullptr;
+            return false;
+        }
+        m_data_ = m_decompressed_.data();
+        m_size_ = m_decompressed_.size();
+    } else {
+        m_data_ = file.bytes().data();
+        m_size_ = file.bytes().size();
+    }
+    return parse(name);
+}
+
+bool MeshFile::parse(std::string_view name) {
+    m_header_ = nullptr;
+    m_sections_ = nullptr;
+    if (m_size_ < sizeof(MeshFileHeader)) {
+        return false;
+    }
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(m_data_);
+    if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION) {
+        return false;
+    }
+    const u64 table_end = sizeof(MeshFileHeader) + static_cast<u64>(header->section_count) * sizeof(MeshSection);
+    if (table_end > m_size_) {
+        ENGINE_LOG_ERROR("Mesh file {} is truncated", name)
+        return false;
+    }
+    const MeshSection* sections = reinterpret_cast<const MeshSection*>(m_data_ + sizeof(MeshFileHeader));
+    for (u32 i = 0; i < header->section_count; i++) {
+        if (sections[i].offset > m_size_ || sections[i].size > m_size_ - sections[i].offset) {
+            ENGINE_LOG_ERROR("Mesh file {} is truncated", name)
+            return false;
+        }
+    }
+    m_header_ = header;
+    m_sections_ = sections;
+    return true;
+}
+
+bool MeshFile::is_valid() const {
+    return m_header_ != nullptr;
+}
+
+bool MeshFile::is_cooked_from(u64 source_key) const {
+    return m_header_->source_key == source_key && m_header_->importer_version == MODEL_IMPORTER_VERSION;
+}
+
+const MeshFileHeader& MeshFile::header() const {
+    return *m_header_;
+}
+
+ArrayRef<const byte> MeshFile::get_section(MeshSectionType type) const {
+    if (m_header_ == nullptr) {
+        return ArrayRef<const byte>{nullptr, 0};
+    }
+    for (u32 i = 0; i < m_header_->section_count; i++) {
+        if (m_sections_[i].type == type) {
+            return ArrayRef<const byte>{m_data_ + m_sections_[i].offset, m_sections_[i].size};
+        }
+    }
+    return ArrayRef<const byte>{nullptr, 0};
+}
+
+std::span<const Vertex> MeshFile::vertices() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::VERTICES);
+    return std::span<const Vertex>{reinterpret_cast<const Vertex*>(section.data()), section.size() / sizeof(Vertex)};
+}
+
+std::span<const u32> MeshFile::indices(u32 lod) const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::INDICES);
+    const std::span<const u32> all_indices{reinterpret_cast<const u32*>(section.data()), section.size() / sizeof(u32)};
+    const std::span<const MeshLod> levels = lods();
+    if (levels.empty()) {
+        return lod == 0 ? all_indices : std::span<const u32>{};
+    }
+    if (lod >= levels.size() || levels[lod].index_offset + levels[lod].index_count > all_indices.size()) {
+        return {};
+    }
+    return all_indices.subspan(levels[lod].index_offset, levels[lod].index_count);
+}
+
+std::span<const Submesh> MeshFile::submeshes() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::SUBMESHES);
+    return std::span<const Submesh>{reinterpret_cast<const Submesh*>(section.data()), section.size() / sizeof(Submesh)};
+}
+
+std::span<const MeshLod> MeshFile::submesh_lods(u32 submesh) const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::SUBMESH_LODS);
+    const std::span<const MeshLod> all_lods{reinterpret_cast<const MeshLod*>(section.data()), section.size() / sizeof(MeshLod)};
+    const size_t lod_count = lods().size();
+    if (lod_count == 0 || (submesh + 1) * lod_count > all_lods.size()) {
+        return {};
+    }
+    return all_lods.subspan(submesh * lod_count, lod_count);
+}
+
+std::span<const MeshLod> MeshFile::lods() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::LODS);
+    return std::span<const MeshLod>{reinterpret_cast<const MeshLod*>(section.data()), section.size() / sizeof(MeshLod)};
+}
+
+std::span<const Meshlet> MeshFile::meshlets() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::MESHLETS);
+    return std::span<const Meshlet>{reinterpret_cast<const Meshlet*>(section.data()), section.size() / sizeof(Meshlet)};
+}
+
+std::span<const SkeletonJoint> MeshFile::skeleton() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::SKELETON);
+    return std::span<const SkeletonJoint>{reinterpret_cast<const SkeletonJoint*>(section.data()), section.size() / sizeof(SkeletonJoint)};
+}
+
+std::span<const AnimationClip> MeshFile::animations() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::ANIMATION_CLIPS);
+    return std::span<const AnimationClip>{reinterpret_cast<const AnimationClip*>(section.data()), section.size() / sizeof(AnimationClip)};
+}
+
+std::span<const JointPose> MeshFile::animation_poses() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::ANIMATION_POSES);
+    return std::span<const JointPose>{reinterpret_cast<const JointPose*>(section.data()), section.size() / sizeof(JointPose)};
+}
+
+BoundingVolume MeshFile::bounds() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::BOUNDS);
+    BoundingVolume volume{};
+    if (section.size() == sizeof(BoundingVolume)) {
+        std::memcpy(&volume, section.data(), sizeof(BoundingVolume));
+        return volume;
+    }
+    if (m_header_ == nullptr) {
+        return volume;
+    }
+    f32 extent_squared = 0.0f;
+    for (u32 axis = 0; axis < 3; axis++) {
+        volume.aabb_min[axis] = m_header_->bounds_min[axis];
+        volume.aabb_max[axis] = m_header_->bounds_max[axis];
+        volume.sphere_center[axis] = (m_header_->bounds_min[axis] + m_header_->bounds_max[axis]) * 0.5f;
+        const f32 half_extent = (m_header_->bounds_max[axis] - m_header_->bounds_min[axis]) * 0.5f;
+        extent_squared += half_extent * half_extent;
+    }
+    volume.sphere_radius = glm::sqrt(extent_squared);
+    return volume;
+}
+
+VertexLayout MeshFile::get_vertex_layout() const {
+    const ArrayRef<const byte> section = get_section(MeshSectionType::VERTEX_LAYOUT);
+    if (section.size() != sizeof(VertexLayout) || packed_vertices().size() == 0) {
+        return FULL_VERTEX_LAYOUT;
+    }
+    VertexLayout layout;
+    std::memcpy(&layout, section.data(), sizeof(VertexLayout));
+    return layout;
+}
+
+IndexFormat MeshFile::get_index_format() const {
+    if (m_header_ == nullptr) {
+        return IndexFormat::UINT32;
+    }
+    for (u32 i = 0; i < m_header_->section_count; i++) {
+        if (m_sections_[i].type == MeshSectionType::PACKED_INDICES) {
+            return m_sections_[i].element_size == sizeof(u16) ? IndexFormat::UINT16 : IndexFormat::UINT32;
+        }
+    }
+    return IndexFormat::UINT32;
+}
+
+ArrayRef<const byte> MeshFile::packed_vertices() const {
+    const bool is_packed = get_section(MeshSectionType::PACKED_VERTICES).size() != 0;
+    return get_section(is_packed ? MeshSectionType::PACKED_VERTICES : MeshSectionType::VERTICES);
+}
+
+ArrayRef<const byte> MeshFile::packed_indices() const {
+    const bool is_packed = get_section(MeshSectionType::PACKED_INDICES).size() != 0;
+    return get_section(is_packed ? MeshSectionType::PACKED_INDICES : MeshSectionType::INDICES);
+}
+
+MeshFileWriter::MeshFileWriter(u64 source_key) : m_header_{}, m_layout_(FULL_VERTEX_LAYOUT), m_bounds_{} {
+    m_header_.magic = MESH_FILE_MAGIC;
+    m_header_.version = MESH_FILE_VERSION;
+    m_header_.source_key = source_key;
+    m_header_.importer_version = MODEL_IMPORTER_VERSION;
+}
+
+void MeshFileWriter::set_mesh(std::span<const Vertex> vertices, std::span<const u32> indices, std::span<const Submesh> submeshes) {
+    m_header_.vertex_count = static_cast<u32>(vertices.size());
+    m_header_.index_count = static_cast<u32>(indices.size());
+    m_header_.submesh_count = static_cast<u32>(submeshes.size());
+    m_header_.vertex_stride = sizeof(Vertex);
+    m_bounds_ = compute_bounding_volume(vertices);
+    for (u32 axis = 0; axis < 3; axis++) {
+        m_header_.bounds_min[axis] = m_bounds_.aabb_min[axis];
+        m_header_.bounds_max[axis] = m_bounds_.aabb_max[axis];
+    }
+    add_section(MeshSectionType::VERTICES, vertices);
+    add_section(MeshSectionType::INDICES, indices);
+    add_section(MeshSectionType::SUBMESHES, submeshes);
+    add_section(MeshSectionType::BOUNDS, std::span<const BoundingVolume>{&m_bounds_, 1});
+}
+
+void MeshFileWriter::set_lods(std::span<const MeshLod> lods) {
+    if (!lods.empty()) {
+        m_header_.index_count = lods[0].index_count;
+    }
+    add_section(MeshSectionType::LODS, lods);
+}
+
+void MeshFileWriter::set_packed_mesh(const VertexLayout& layout, std::span<const byte> vertices, IndexFormat index_format, std::span<const byte> indices) {
+    m_layout_ = layout;
+    m_sections_.push_back(PendingSection{MeshSectionType::PACKED_VERTICES, layout.get_stride(), vertices.data(), vertices.size_bytes()});
+    m_sections_.push_back(PendingSection{MeshSectionType::PACKED_INDICES, get_index_size(index_format), indices.data(), indices.size_bytes()});
+    add_section(MeshSectionType::VERTEX_LAYOUT, std::span<const VertexLayout>{&m_layout_, 1});
+}
+
+const MeshFileHeader& MeshFileWriter::header() const {
+    return m_header_;
+}
+
+const BoundingVolume& MeshFileWriter::bounds() const {
+    return m_bounds_;
+}
+
+bool MeshFileWriter::write(const char* path) const {
+    const auto align_up = [](u64 value) {
+        return (value + MESH_SECTION_ALIGNMENT - 1) & ~static_cast<u64>(MESH_SECTION_ALIGNMENT - 1);
+    };
+    MeshFileHeader header = m_header_;
+    header.section_count = static_cast<u32>(m_sections_.size());
+    std::vector<MeshSection> sections(m_sections_.size());
+    u64 offset = align_up(sizeof(MeshFileHeader) + sections.size() * sizeof(MeshSection));
+    for (size_t i = 0; i < sections.size(); i++) {
+        sections[i] = MeshSection{m_sections_[i].type, m_sections_[i].element_size, offset, m_sections_[i].size};
+        offset = align_up(offset + m_sections_[i].size);
+    }
+
+    // Written next to the target and renamed over it. Mesh files are mapped
+    // while they are uploaded, truncating one in place would pull the pages
+    // out from under the reader. The temp name is unique per process and
+    // write, a hot reload cook and a cache cook of one model can overlap.
+    static std::atomic<u32> write_counter{0};
+    const std::string temp_path = std::string{path} + '.' + std::to_string(get_process_id()) + '.' + std::to_string(write_counter++) + ".tmp";
+    std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        ENGINE_LOG_ERROR("Failed to create mesh file {}", path)
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(sections.data()), static_cast<std::streamsize>(sections.size() * sizeof(MeshSection)));
+    for (size_t i = 0; i < sections.size(); i++) {
+        static constexpr char zeros[MESH_SECTION_ALIGNMENT]{};
+        const u64 padding = sections[i].offset - static_cast<u64>(file.tellp());
+        file.write(zeros, static_cast<std::streamsize>(padding));
+        file.write(static_cast<const char*>(m_sections_[i].data), static_cast<std::streamsize>(m_sections_[i].size));
+    }
+    file.close();
+    std::error_code error;
+    if (file.fail() || (std::filesystem::rename(temp_path, path, error), error)) {
+        ENGINE_LOG_ERROR("Failed to write mesh file {}", path)
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+u32 select_lod(std::span<const MeshLod> lods, f32 distance, f32 pixels_per_unit, f32 max_pixel_error) {
+    if (distance <= 0.0f) {
+        return 0;
+    }
+    // Errors grow with the level, the first one that is too coarse ends the search
+    u32 selected = 0;
+    for (u32 lod = 1; lod < lods.size(); lod++) {
+        if (lods[lod].error * pixels_per_unit / distance > max_pixel_error) {
+            break;
+        }
+        selected = lod;
+    }
+    return selected;
+}
@@ -0,0 +1,196 @@
+﻿#pragma once
+
+#include <span>
+#include <vector>
+
+#include "common.h"
+#include "Containers/ArrayRef.h"
+#include "FileIO/FileIO.h"
+#include "FileIO/PackFile.h"
+#include "Bounds.h"
+#include "Skeleton.h"
+#include "Vertex.h"
+#include "VertexLayout.h"
+
+static constexpr u32 MESH_FILE_MAGIC = 0x534D4753; // "SGMS"
+// 2 added the skin attributes to Vertex and VertexLayout
+static constexpr u32 MESH_FILE_VERSION = 2;
+// Bumped whenever the import pipeline changes its output, cooked meshes
+// written by an older importer are re-cooked on load
+static constexpr u32 MODEL_IMPORTER_VERSION = 10;
+static constexpr u32 MESH_SECTION_ALIGNMENT = 64;
+
+enum class MeshSectionType : u32 {
+    VERTICES,
+    INDICES,
+    SUBMESHES,
+    // GPU ready copies of the vertices and indices in the layout of the
+    // VERTEX_LAYOUT section, the index size is the section's element size
+    PACKED_VERTICES,
+    PACKED_INDICES,
+    VERTEX_LAYOUT,
+    LODS,
+    MESHLETS,
+    // Box and sphere of the whole mesh, a single BoundingVolume
+    BOUNDS,
+    // MeshLod per submesh and level, submesh major, lods().size() per submesh
+    SUBMESH_LODS,
+    // Only in skinned meshes, see Skeleton.h
+    SKELETON,
+    ANIMATION_CLIPS,
+    ANIMATION_POSES
+};
+
+struct MeshFileHeader {
+    u32 magic;
+    u32 version;
+    // Source contents and import flags the mesh was cooked from, 0 if unknown
+    u64 source_key;
+    u32 importer_version;
+    u32 section_count;
+    u32 vertex_count;
+    // Indices of LOD 0, lower levels follow them in the index sections
+    u32 index_count;
+    u32 submesh_count;
+    u32 vertex_stride;
+    f32 bounds_min[3];
+    f32 bounds_max[3];
+};
+
+// Sections follow the header, their data is aligned to MESH_SECTION_ALIGNMENT
+struct MeshSection {
+    MeshSectionType type;
+    u32 element_size;
+    u64 offset;
+    u64 size;
+};
+
+// One level of detail, a range of the index buffer over the shared vertices.
+// Levels hold every submesh in order, submeshes with a shorter chain repeat
+// their coarsest level.
+// error is how far the level deviates from the full mesh in mesh units, with
+// attribute changes counted as distance, so it errs on the coarse side.
+struct MeshLod {
+    u32 index_offset;
+    u32 index_count;
+    f32 error;
+    u32 reserved;
+};
+
+// Small cluster of LOD 0 triangles, a contiguous range of its indices, with
+// the bounds to cull it on its own. Every triangle normal lies within
+// the cone around cone_axis, cone_cutoff is 1 when they spread too far for
+// the cone to ever be backfacing.
+struct Meshlet {
+    u32 index_offset;
+    u32 triangle_count;
+    u32 vertex_count;
+    f32 cone_cutoff;
+    f32 center[3];
+    f32 radius;
+    f32 cone_apex[3];
+    f32 cone_axis[3];
+    // Submesh whose base vertex the indices are relative to
+    u32 submesh;
+    u32 reserved;
+};
+
+static_assert(sizeof(MeshFileHeader) == 64 && sizeof(MeshSection) == 24 && sizeof(Submesh) == 64 && sizeof(MeshLod) == 16 && sizeof(Meshlet) == 64,
+    "Mesh file structures are written to disk as is");
+
+// Picks the coarsest level whose error projects to at most max_pixel_error
+// pixels at distance. pixels_per_unit is the projected size of one unit at
+// distance 1, viewport height / (2 * tan(vertical fov / 2)).
+u32 select_lod(std::span<const MeshLod> lods, f32 distance, f32 pixels_per_unit, f32 max_pixel_error = 1.0f);
+
+// Cooked mesh mapped straight from disk or a mounted pack. Every accessor is a
+// view into the mapping, so vertex and index data go to GPU upload without a
+// copy or parse.
+class MeshFile {
+    io::MappedFile m_mapping_;
+    // Holds a pack entry that was stored compressed
+    std::vector<byte> m_decompressed_;
+    const byte* m_data_;
+    size_t m_size_;
+    const MeshFileHeader* m_header_;
+    const MeshSection* m_sections_;
+
+    bool parse(std::string_view name);
+public:
+    MeshFile();
+    explicit MeshFile(const char* path);
+    MeshFile(const MeshFile&) = delete;
+    MeshFile& operator=(const MeshFile&) = delete;
+    MeshFile(MeshFile&&) noexcept = default;
+    MeshFile& operator=(MeshFile&&) noexcept = default;
+    ~MeshFile() = default;
+
+    bool open(const char* path);
+    // Views an uncompressed entry in place, the pack has to outlive the mesh.
+    // Compressed entries are decompressed on thread_pool into memory of its own.
+    bool open(const io::PackFile& pack, std::string_view name, engine::ThreadPool* thread_pool = nullptr);
+    [[nodiscard]] bool is_valid() const;
+    // Cooked by the current importer from a source with this key
+    [[nodiscard]] bool is_cooked_from(u64 source_key) const;
+    const MeshFileHeader& header() const;
+
+    // Empty when the section is missing
+    ArrayRef<const byte> get_section(MeshSectionType type) const;
+    std::span<const Vertex> vertices() const;
+    std::span<const u32> indices(u32 lod = 0) const;
+    std::span<const Submesh> submeshes() const;
+    // Levels of one submesh, empty when the mesh has no LOD chain
+    std::span<const MeshLod> submesh_lods(u32 submesh) const;
+    // Empty when the mesh has no LOD chain, indices() is then LOD 0
+    std::span<const MeshLod> lods() const;
+    std::span<const Meshlet> meshlets() const;
+    // Empty for static meshes
+    std::span<const SkeletonJoint> skeleton() const;
+    std::span<const AnimationClip> animations() const;
+    std::span<const JointPose> animation_poses() const;
+    // Sphere around the header box for files cooked without a BOUNDS section
+    BoundingVolume bounds() const;
+
+    // FULL_VERTEX_LAYOUT and the plain sections when nothing was packed
+    VertexLayout get_vertex_layout() const;
+    IndexFormat get_index_format() const;
+    ArrayRef<const byte> packed_vertices() const;
+    ArrayRef<const byte> packed_indices() const;
+};
+
+// Collects sections and writes them as a mesh file. Section data is referenced,
+// not copied, and has to stay alive until write returns.
+class MeshFileWriter {
+    struct PendingSection {
+        MeshSectionType type;
+        u32 element_size;
+        const void* data;
+        u64 size;
+    };
+
+    std::vector<PendingSection> m_sections_;
+    MeshFileHeader m_header_;
+    VertexLayout m_layout_;
+    BoundingVolume m_bounds_;
+public:
+    explicit MeshFileWriter(u64 source_key);
+
+    // Adds the vertex, index, submesh and bounds sections and records counts
+    // and the box in the header
+    void set_mesh(std::span<const Vertex> vertices, std::span<const u32> indices, std::span<const Submesh> submeshes);
+    // Adds vertices and indices packed with pack_vertices and pack_indices,
+    // UNORM16 positions have to be relative to the bounds set_mesh recorded
+    void set_packed_mesh(const VertexLayout& layout, std::span<const byte> vertices, IndexFormat index_format, std::span<const byte> indices);
+    // Records the LOD chain generate_lods appended to the indices of set_mesh
+    void set_lods(std::span<const MeshLod> lods);
+    template <typename T>
+    void add_section(MeshSectionType type, std::span<const T> elements);
+    const MeshFileHeader& header() const;
+    const BoundingVolume& bounds() const;
+    bool write(const char* path) const;
+};
+
+template <typename T>
+void MeshFileWriter::add_section(MeshSectionType type, std::span<const T> elements) {
+    m_sections_.push_back(PendingSection{type, static_cast<u32>(sizeof(T)), elements.data(), elements.size_bytes()});
+}
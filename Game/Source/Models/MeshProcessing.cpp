@@ -0,0 +1,823 @@
+﻿#include "MeshProcessing.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include "Bounds.h"
+#include "robin_hood.h"
+
+static Vertex snap_to_grid(const Vertex& vertex, f32 inverse_epsilon) {
+    const auto snap = [inverse_epsilon](auto value) {
+        return glm::floor(value * inverse_epsilon + 0.5f);
+    };
+    return Vertex{snap(vertex.position), snap(vertex.color), snap(vertex.normal), snap(vertex.uv), vertex.joints, vertex.weights};
+}
+
+WeldStats weld_vertices(arena_vector<Vertex>& vertices, arena_vector<u32>& indices, f32 epsilon) {
+    const u32 vertex_count = static_cast<u32>(vertices.size());
+    robin_hood::unordered_flat_map<Vertex, u32> unique_vertices;
+    unique_vertices.reserve(vertex_count);
+    std::vector<u32> remap(vertex_count);
+    const f32 inverse_epsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+
+    u32 unique_count = 0;
+    for (u32 i = 0; i < vertex_count; i++) {
+        const Vertex key = epsilon > 0.0f ? snap_to_grid(vertices[i], inverse_epsilon) : vertices[i];
+        auto [it, inserted] = unique_vertices.try_emplace(key, unique_count);
+        if (inserted) {
+            // Compacting in place is safe, unique_count never passes i
+            vertices[unique_count++] = vertices[i];
+        }
+        remap[i] = it->second;
+    }
+    vertices.resize(unique_count);
+    for (u32& index : indices) {
+        index = remap[index];
+    }
+    return WeldStats{vertex_count, unique_count};
+}
+
+// FIFO cache simulation shared by the statistics and the overdraw pass
+class VertexCacheSimulator {
+    std::vector<u32> m_timestamps_;
+    u32 m_time_;
+    u32 m_cache_size_;
+public:
+    VertexCacheSimulator(u32 vertex_count, u32 cache_size) : m_timestamps_(vertex_count, 0), m_time_(cache_size + 1), m_cache_size_(cache_size) {
+
+    }
+
+    void reset() {
+        // Moving time past every timestamp empties the cache
+        m_time_ += m_cache_size_ + 1;
+    }
+
+    // Returns true when the vertex had to be shaded
+    bool access(u32 vertex) {
+        if (m_time_ - m_timestamps_[vertex] > m_cache_size_) {
+            m_timestamps_[vertex] = m_time_++;
+            return true;
+        }
+        return false;
+    }
+};
+
+VertexCacheStats analyze_vertex_cache(std::span<const u32> indices, u32 vertex_count, u32 cache_size) {
+    VertexCacheSimulator cache{vertex_count, cache_size};
+    u32 shaded = 0;
+    for (const u32 index : indices) {
+        shaded += cache.access(index);
+    }
+    const u32 triangle_count = static_cast<u32>(indices.size() / 3);
+    return VertexCacheStats{
+        shaded,
+        triangle_count == 0 ? 0.0f : static_cast<f32>(shaded) / static_cast<f32>(triangle_count),
+        vertex_count == 0 ? 0.0f : static_cast<f32>(shaded) / static_cast<f32>(vertex_count)
+    };
+}
+
+std::vector<u32> optimize_vertex_cache(std::span<u32> indices, u32 vertex_count, u32 cache_size) {
+    const u32 triangle_count = static_cast<u32>(indices.size() / 3);
+    std::vector<u32> cluster_starts;
+    if (triangle_count == 0) {
+        return cluster_starts;
+    }
+
+    // Vertex to triangle adjacency as offsets into one flat array
+    std::vector<u32> live_triangles(vertex_count, 0);
+    for (const u32 index : indices) {
+        live_triangles[index]++;
+    }
+    std::vector<u32> adjacency_offsets(vertex_count + 1, 0);
+    std::inclusive_scan(live_triangles.begin(), live_triangles.end(), adjacency_offsets.begin() + 1);
+    std::vector<u32> adjacency(indices.size());
+    std::vector<u32> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (u32 i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<u32> timestamps(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<u32> dead_end_stack;
+    std::vector<u32> candidates;
+    std::vector<u32> output;
+    output.reserve(indices.size());
+    u32 time = cache_size + 1;
+    u32 cursor = 0;
+
+    const auto skip_dead_end = [&]() -> i64 {
+        while (!dead_end_stack.empty()) {
+            const u32 vertex = dead_end_stack.back();
+            dead_end_stack.pop_back();
+            if (live_triangles[vertex] > 0) {
+                return vertex;
+            }
+        }
+        while (cursor < vertex_count) {
+            if (live_triangles[cursor] > 0) {
+                return cursor;
+            }
+            cursor++;
+        }
+        return -1;
+    };
+
+    i64 fanning_vertex = skip_dead_end();
+    cluster_starts.push_back(0);
+    while (fanning_vertex >= 0) {
+        candidates.clear();
+        const u32 fan = static_cast<u32>(fanning_vertex);
+        for (u32 i = adjacency_offsets[fan]; i < adjacency_offsets[fan + 1]; i++) {
+            const u32 triangle = adjacency[i];
+            if (emitted[triangle]) {
+                continue;
+            }
+            for (u32 corner = 0; corner < 3; corner++) {
+                const u32 vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                dead_end_stack.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+                if (time - timestamps[vertex] > cache_size) {
+                    timestamps[vertex] = time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // Prefer the candidate that will still be in the cache after its
+        // remaining triangles are emitted, the oldest of those first
+        i64 best = -1;
+        i64 best_priority = -1;
+        for (const u32 vertex : candidates) {
+            if (live_triangles[vertex] == 0) {
+                continue;
+            }
+            i64 priority = 0;
+            if (time - timestamps[vertex] + 2 * live_triangles[vertex] <= cache_size) {
+                priority = time - timestamps[vertex];
+            }
+            if (priority > best_priority) {
+                best = vertex;
+                best_priority = priority;
+            }
+        }
+        if (best < 0) {
+            best = skip_dead_end();
+            if (best >= 0 && output.size() < indices.size()) {
+                cluster_starts.push_back(static_cast<u32>(output.size() / 3));
+            }
+        }
+        fanning_vertex = best;
+    }
+    std::copy(output.begin(), output.end(), indices.begin());
+    return cluster_starts;
+}
+
+void optimize_overdraw(std::span<u32> indices, std::span<const Vertex> vertices, std::span<const u32> cluster_starts, f32 threshold, u32 cache_size) {
+    const u32 triangle_count = static_cast<u32>(indices.size() / 3);
+    if (triangle_count == 0 || cluster_starts.empty()) {
+        return;
+    }
+    const u32 vertex_count = static_cast<u32>(vertices.size());
+    const f32 mesh_acmr = analyze_vertex_cache(indices, vertex_count, cache_size).acmr;
+
+    // Soft boundaries: start a new cluster wherever the cache has warmed up
+    // enough that the restart penalty stays within the threshold
+    std::vector<u32> clusters;
+    VertexCacheSimulator cache{vertex_count, cache_size};
+    for (size_t c = 0; c < cluster_starts.size(); c++) {
+        const u32 end = c + 1 < cluster_starts.size() ? cluster_starts[c + 1] : triangle_count;
+        u32 start = cluster_starts[c];
+        const size_t first_cluster = clusters.size();
+        clusters.push_back(start);
+        cache.reset();
+        u32 shaded = 0;
+        for (u32 triangle = start; triangle < end; triangle++) {
+            for (u32 corner = 0; corner < 3; corner++) {
+                shaded += cache.access(indices[triangle * 3 + corner]);
+            }
+            const u32 triangles_in_cluster = triangle - start + 1;
+            if (triangle + 1 < end && static_cast<f32>(shaded) <= threshold * mesh_acmr * static_cast<f32>(triangles_in_cluster)) {
+                start = triangle + 1;
+                clusters.push_back(start);
+                cache.reset();
+                shaded = 0;
+            }
+        }
+        // A tail that never warmed up is cheaper left attached to its predecessor
+        if (clusters.size() > first_cluster + 1 && static_cast<f32>(shaded) > threshold * mesh_acmr * static_cast<f32>(end - start)) {
+            clusters.pop_back();
+        }
+    }
+
+    glm::vec3 mesh_centroid{0.0f};
+    for (const Vertex& vertex : vertices) {
+        mesh_centroid += vertex.position;
+    }
+    mesh_centroid /= static_cast<f32>(std::max<u32>(vertex_count, 1));
+
+    // Clusters facing away from the centre are on the outside of the mesh and
+    // likely to occlude the others, so they sort first
+    std::vector<f32> sort_keys(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        const u32 end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+        glm::vec3 centroid{0.0f};
+        glm::vec3 normal{0.0f};
+        f32 area = 0.0f;
+        for (u32 triangle = clusters[c]; triangle < end; triangle++) {
+            const glm::vec3& a = vertices[indices[triangle * 3]].position;
+            const glm::vec3& b = vertices[indices[triangle * 3 + 1]].position;
+            const glm::vec3& d = vertices[indices[triangle * 3 + 2]].position;
+            const glm::vec3 face_normal = glm::cross(b - a, d - a);
+            const f32 face_area = glm::length(face_normal);
+            centroid += (a + b + d) * (face_area / 3.0f);
+            normal += face_normal;
+            area += face_area;
+        }
+        centroid = area > 0.0f ? centroid / area : centroid;
+        const f32 normal_length = glm::length(normal);
+        sort_keys[c] = normal_length > 0.0f ? glm::dot(centroid - mesh_centroid, normal / normal_length) : 0.0f;
+    }
+
+    std::vector<u32> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sort_keys](u32 a, u32 b) {
+        return sort_keys[a] > sort_keys[b];
+    });
+    std::vector<u32> reordered;
+    reordered.reserve(indices.size());
+    for (const u32 cluster : order) {
+        const u32 end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangle_count;
+        reordered.insert(reordered.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + end * 3);
+    }
+    std::copy(reordered.begin(), reordered.end(), indices.begin());
+}
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& position) const noexcept {
+        return robin_hood::hash_bytes(&position, sizeof(glm::vec3));
+    }
+};
+
+// Maps every vertex to the first vertex with the same position
+static std::vector<u32> get_position_remap(std::span<const Vertex> vertices) {
+    std::vector<u32> remap(vertices.size());
+    robin_hood::unordered_flat_map<glm::vec3, u32, PositionHash> first_by_position;
+    first_by_position.reserve(vertices.size());
+    for (u32 i = 0; i < vertices.size(); i++) {
+        remap[i] = first_by_position.try_emplace(vertices[i].position, i).first->second;
+    }
+    return remap;
+}
+
+// Bounding sphere and normal cone of the triangles of one meshlet
+static void compute_meshlet_bounds(Meshlet& meshlet, std::span<const u32> indices, std::span<const Vertex> vertices, std::span<const glm::vec3> points) {
+    glm::vec3 center;
+    f32 radius;
+    compute_bounding_sphere(points, center, radius);
+
+    glm::vec3 axis{0.0f};
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangle_count);
+    for (u32 i = 0; i < meshlet.triangle_count * 3; i += 3) {
+        const glm::vec3& a = vertices[indices[i]].position;
+        const glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - a, vertices[indices[i + 2]].position - a);
+        const f32 length = glm::length(normal);
+        normals.push_back(length > 0.0f ? normal / length : glm::vec3{0.0f});
+        axis += normals.back();
+    }
+    const f32 axis_length = glm::length(axis);
+    axis = axis_length > 0.0f ? axis / axis_length : glm::vec3{0.0f, 0.0f, 1.0f};
+    f32 min_dot = 1.0f;
+    for (const glm::vec3& normal : normals) {
+        // Degenerate triangles are invisible from any side
+        if (normal != glm::vec3{0.0f}) {
+            min_dot = glm::min(min_dot, glm::dot(axis, normal));
+        }
+    }
+
+    // The apex sits far enough behind the triangles that every point the cone
+    // test accepts sees all of them from behind
+    f32 apex_distance = 0.0f;
+    if (min_dot > 0.1f) {
+        for (u32 i = 0; i < normals.size(); i++) {
+            if (normals[i] == glm::vec3{0.0f}) {
+                continue;
+            }
+            const f32 direction = glm::dot(axis, normals[i]);
+            const f32 distance = glm::dot(center - vertices[indices[i * 3]].position, normals[i]);
+            apex_distance = glm::max(apex_distance, distance / direction);
+        }
+    }
+    const glm::vec3 apex = center - axis * apex_distance;
+    for (u32 i = 0; i < 3; i++) {
+        meshlet.center[i] = center[i];
+        meshlet.cone_apex[i] = apex[i];
+        meshlet.cone_axis[i] = axis[i];
+    }
+    meshlet.radius = radius;
+    // sin of the cone's spread, cones that are too wide never cull
+    meshlet.cone_cutoff = min_dot > 0.1f ? glm::sqrt(1.0f - min_dot * min_dot) : 1.0f;
+}
+
+std::vector<Meshlet> build_meshlets(std::span<u32> indices, std::span<const Vertex> vertices, u32 max_vertices, u32 max_triangles) {
+    const u32 triangle_count = static_cast<u32>(indices.size() / 3);
+    const u32 vertex_count = static_cast<u32>(vertices.size());
+    std::vector<Meshlet> meshlets;
+    if (triangle_count == 0) {
+        return meshlets;
+    }
+
+    // Triangles around every position. Going by position rather than vertex
+    // lets meshlets grow across hard edges and seams.
+    const std::vector<u32> positions = get_position_remap(vertices);
+    std::vector<u32> triangle_offsets(vertex_count + 1, 0);
+    for (const u32 index : indices) {
+        triangle_offsets[positions[index] + 1]++;
+    }
+    std::partial_sum(triangle_offsets.begin(), triangle_offsets.end(), triangle_offsets.begin());
+    std::vector<u32> vertex_triangles(indices.size());
+    {
+        std::vector<u32> cursor(triangle_offsets.begin(), triangle_offsets.end() - 1);
+        for (u32 i = 0; i < indices.size(); i++) {
+            vertex_triangles[cursor[positions[indices[i]]]++] = i / 3;
+        }
+    }
+    std::vector<glm::vec3> triangle_normals(triangle_count);
+    for (u32 triangle = 0; triangle < triangle_count; triangle++) {
+        const glm::vec3& a = vertices[indices[triangle * 3]].position;
+        const glm::vec3 normal = glm::cross(vertices[indices[triangle * 3 + 1]].position - a, vertices[indices[triangle * 3 + 2]].position - a);
+        const f32 length = glm::length(normal);
+        triangle_normals[triangle] = length > 0.0f ? normal / length : glm::vec3{0.0f};
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    // Meshlet a vertex was last added to plus one, so membership needs no clearing
+    std::vector<u32> vertex_meshlet(vertex_count, 0);
+    std::vector<u32> output;
+    output.reserve(indices.size());
+    std::vector<u32> meshlet_vertices;
+    std::vector<glm::vec3> meshlet_points;
+    u32 seed = 0;
+    while (true) {
+        while (seed < triangle_count && emitted[seed]) {
+            seed++;
+        }
+        if (seed == triangle_count) {
+            break;
+        }
+        const u32 meshlet_id = static_cast<u32>(meshlets.size()) + 1;
+        Meshlet meshlet{};
+        meshlet.index_offset = static_cast<u32>(output.size());
+        meshlet_vertices.clear();
+        glm::vec3 normal_sum{0.0f};
+        const auto get_new_vertices = [&](u32 triangle) {
+            u32 added = 0;
+            for (u32 corner = 0; corner < 3; corner++) {
+                added += vertex_meshlet[indices[triangle * 3 + corner]] != meshlet_id;
+            }
+            return added;
+        };
+        const auto emit = [&](u32 triangle) {
+            for (u32 corner = 0; corner < 3; corner++) {
+                const u32 index = indices[triangle * 3 + corner];
+                if (vertex_meshlet[index] != meshlet_id) {
+                    vertex_meshlet[index] = meshlet_id;
+                    meshlet_vertices.push_back(index);
+                }
+                output.push_back(index);
+            }
+            emitted[triangle] = true;
+            normal_sum += triangle_normals[triangle];
+            meshlet.triangle_count++;
+        };
+
+        emit(seed);
+        while (meshlet.triangle_count < max_triangles) {
+            const f32 normal_length = glm::length(normal_sum);
+            const glm::vec3 meshlet_normal = normal_length > 0.0f ? normal_sum / normal_length : glm::vec3{0.0f};
+            u32 best = triangle_count;
+            f32 best_score = std::numeric_limits<f32>::max();
+            for (const u32 vertex : meshlet_vertices) {
+                const u32 position = positions[vertex];
+                for (u32 t = triangle_offsets[position]; t < triangle_offsets[position + 1]; t++) {
+                    const u32 triangle = vertex_triangles[t];
+                    if (emitted[triangle]) {
+                        continue;
+                    }
+                    const u32 added = get_new_vertices(triangle);
+                    if (meshlet_vertices.size() + added > max_vertices) {
+                        continue;
+                    }
+                    const f32 score = static_cast<f32>(added) + 0.25f * (1.0f - glm::dot(meshlet_normal, triangle_normals[triangle]));
+                    if (score < best_score) {
+                        best_score = score;
+                        best = triangle;
+                    }
+                }
+            }
+            if (best == triangle_count) {
+                break;
+            }
+            emit(best);
+        }
+
+        meshlet.vertex_count = static_cast<u32>(meshlet_vertices.size());
+        meshlet_points.clear();
+        for (const u32 vertex : meshlet_vertices) {
+            meshlet_points.push_back(vertices[vertex].position);
+        }
+        compute_meshlet_bounds(meshlet, std::span<const u32>{output}.subspan(meshlet.index_offset), vertices, meshlet_points);
+        meshlets.push_back(meshlet);
+    }
+    std::copy(output.begin(), output.end(), indices.begin());
+    // Growing by adjacency loses some of the cache order the meshlets came from
+    for (const Meshlet& meshlet : meshlets) {
+        optimize_vertex_cache(indices.subspan(meshlet.index_offset, meshlet.triangle_count * 3), vertex_count);
+    }
+    return meshlets;
+}
+
+void optimize_vertex_fetch(arena_vector<Vertex>& vertices, std::span<u32> indices) {
+    static constexpr u32 UNUSED = ~0u;
+    std::vector<u32> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (u32& index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = static_cast<u32>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.assign(reordered.begin(), reordered.end());
+}
+
+namespace {
+
+// Sum of squared distances to a set of planes (Garland and Heckbert 1997),
+// each plane weighted by the area of its triangle
+struct Quadric {
+    f32 a00, a11, a22, a01, a02, a12;
+    f32 b0, b1, b2;
+    f32 c;
+    f32 weight;
+
+    static Quadric from_plane(const glm::vec3& normal, f32 distance, f32 weight) {
+        return Quadric{
+            weight * normal.x * normal.x, weight * normal.y * normal.y, weight * normal.z * normal.z,
+            weight * normal.x * normal.y, weight * normal.x * normal.z, weight * normal.y * normal.z,
+            weight * normal.x * distance, weight * normal.y * distance, weight * normal.z * distance,
+            weight * distance * distance,
+            weight
+        };
+    }
+
+    void add(const Quadric& other) {
+        a00 += other.a00;
+        a11 += other.a11;
+        a22 += other.a22;
+        a01 += other.a01;
+        a02 += other.a02;
+        a12 += other.a12;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // Mean squared distance of point to the planes
+    [[nodiscard]] f32 evaluate(const glm::vec3& point) const {
+        const f32 x = point.x;
+        const f32 y = point.y;
+        const f32 z = point.z;
+        const f32 error = a00 * x * x + a11 * y * y + a22 * z * z + 2.0f * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2.0f * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0f ? glm::max(error, 0.0f) / weight : 0.0f;
+    }
+};
+
+// Moves every vertex at the from position onto the to position
+struct Collapse {
+    u32 from;
+    u32 to;
+    f32 cost;
+};
+
+// Weight of attribute changes against squared position error in a mesh
+// scaled to unit size. A 30 degree normal change costs about as much as
+// moving the vertex 1.6% of the mesh size.
+constexpr f32 ATTRIBUTE_WEIGHT = 1e-3f;
+
+f32 get_attribute_error(const Vertex& a, const Vertex& b) {
+    const glm::vec3 normal = a.normal - b.normal;
+    const glm::vec3 color = a.color - b.color;
+    const glm::vec2 uv = a.uv - b.uv;
+    // Collapsing onto a vertex bound to other joints tears the surface once it animates
+    const glm::vec4 skin = a.joints == b.joints ? (glm::vec4{a.weights} - glm::vec4{b.weights}) / 255.0f : glm::vec4{1.0f};
+    return ATTRIBUTE_WEIGHT * (glm::dot(normal, normal) + glm::dot(color, color) + glm::dot(uv, uv) + glm::dot(skin, skin));
+}
+
+// Vertices that only differ in their normal, e.g. along hard edges
+bool is_same_surface(const Vertex& a, const Vertex& b) {
+    return a.color == b.color && a.uv == b.uv && a.joints == b.joints && a.weights == b.weights;
+}
+
+u64 get_edge_key(u32 a, u32 b) {
+    return static_cast<u64>(a) << 32 | b;
+}
+
+f32 get_mesh_extent(std::span<const Vertex> vertices) {
+    if (vertices.empty()) {
+        return 0.0f;
+    }
+    glm::vec3 bounds_min = vertices[0].position;
+    glm::vec3 bounds_max = vertices[0].position;
+    for (const Vertex& vertex : vertices) {
+        bounds_min = glm::min(bounds_min, vertex.position);
+        bounds_max = glm::max(bounds_max, vertex.position);
+    }
+    const glm::vec3 extent = bounds_max - bounds_min;
+    return glm::max(extent.x, glm::max(extent.y, extent.z));
+}
+
+}
+
+f32 simplify(std::span<const Vertex> vertices, std::span<const u32> indices, u32 target_index_count, f32 target_error, std::vector<u32>& destination) {
+    destination.assign(indices.begin(), indices.end());
+    const u32 vertex_count = static_cast<u32>(vertices.size());
+    const f32 extent = get_mesh_extent(vertices);
+    if (indices.size() <= target_index_count || extent == 0.0f) {
+        return 0.0f;
+    }
+
+    // Work on a unit sized copy so errors and attribute weights are relative
+    std::vector<glm::vec3> positions(vertex_count);
+    for (u32 i = 0; i < vertex_count; i++) {
+        positions[i] = vertices[i].position / extent;
+    }
+
+    // Vertices sharing a position are one simplification vertex, identified
+    // by the first of them. The others are linked in a ring through next_wedge.
+    const std::vector<u32> canonical = get_position_remap(vertices);
+    std::vector<u32> next_wedge(vertex_count);
+    for (u32 i = 0; i < vertex_count; i++) {
+        const u32 first = canonical[i];
+        next_wedge[i] = first == i ? i : next_wedge[first];
+        next_wedge[first] = i;
+    }
+
+    // Every directed edge of a closed manifold surface has exactly one twin,
+    // vertices on borders and non-manifold edges never move
+    std::vector<bool> locked(vertex_count, false);
+    {
+        robin_hood::unordered_flat_map<u64, u32> edge_counts;
+        edge_counts.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (u32 corner = 0; corner < 3; corner++) {
+                const u32 a = canonical[indices[i + corner]];
+                const u32 b = canonical[indices[i + (corner + 1) % 3]];
+                if (a != b) {
+                    edge_counts[get_edge_key(a, b)]++;
+                }
+            }
+        }
+        for (const auto& [key, count] : edge_counts) {
+            const u32 a = static_cast<u32>(key >> 32);
+            const u32 b = static_cast<u32>(key);
+            const auto twin = edge_counts.find(get_edge_key(b, a));
+            if (count != 1 || twin == edge_counts.end() || twin->second != 1) {
+                locked[a] = true;
+                locked[b] = true;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertex_count, Quadric{});
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const glm::vec3& a = positions[indices[i]];
+        const glm::vec3& b = positions[indices[i + 1]];
+        const glm::vec3& c = positions[indices[i + 2]];
+        const glm::vec3 normal = glm::cross(b - a, c - a);
+        const f32 length = glm::length(normal);
+        if (length == 0.0f) {
+            continue;
+        }
+        const glm::vec3 unit_normal = normal / length;
+        const Quadric quadric = Quadric::from_plane(unit_normal, -glm::dot(unit_normal, a), length * 0.5f);
+        quadrics[canonical[indices[i]]].add(quadric);
+        quadrics[canonical[indices[i + 1]]].add(quadric);
+        quadrics[canonical[indices[i + 2]]].add(quadric);
+    }
+
+    const f32 error_limit = target_error * target_error;
+    f32 result_error = 0.0f;
+    std::vector<u32> remap(vertex_count);
+    std::vector<bool> collapsed_this_pass(vertex_count);
+    std::vector<bool> referenced(vertex_count);
+    std::vector<u32> triangle_offsets(vertex_count + 1);
+    std::vector<u32> vertex_triangles;
+    std::vector<Collapse> collapses;
+    std::vector<std::pair<u32, u32>> wedge_pairs;
+    robin_hood::unordered_flat_set<u64> wedge_edges;
+
+    // Pairs every vertex at the from position with one at the to position it
+    // shares an edge with, which keeps seams on the seam. Vertices without
+    // such an edge borrow the partner of a vertex at their position that only
+    // differs in its normal. Returns the largest attribute change or a
+    // negative value when some vertex has no partner.
+    const auto pair_wedges = [&](u32 from, u32 to, std::vector<std::pair<u32, u32>>& pairs) {
+        pairs.clear();
+        u32 wedge = from;
+        do {
+            if (referenced[wedge]) {
+                u32 partner = vertex_count;
+                u32 target = to;
+                do {
+                    if (referenced[target] && wedge_edges.contains(get_edge_key(wedge, target))) {
+                        partner = target;
+                        break;
+                    }
+                    target = next_wedge[target];
+                } while (target != to);
+                pairs.emplace_back(wedge, partner);
+            }
+            wedge = next_wedge[wedge];
+        } while (wedge != from);
+
+        f32 attribute_error = 0.0f;
+        for (auto& [wedge_to_pair, partner] : pairs) {
+            if (partner == vertex_count) {
+                for (const auto& [sibling, sibling_partner] : pairs) {
+                    if (sibling_partner != vertex_count && is_same_surface(vertices[wedge_to_pair], vertices[sibling])) {
+                        partner = sibling_partner;
+                        break;
+                    }
+                }
+                if (partner == vertex_count) {
+                    return -1.0f;
+                }
+            }
+            attribute_error = glm::max(attribute_error, get_attribute_error(vertices[wedge_to_pair], vertices[partner]));
+        }
+        return attribute_error;
+    };
+
+    while (destination.size() > target_index_count) {
+        const u32 triangle_count = static_cast<u32>(destination.size() / 3);
+
+        // Triangles around every simplification vertex
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for (const u32 index : destination) {
+            triangle_offsets[canonical[index] + 1]++;
+        }
+        std::partial_sum(triangle_offsets.begin(), triangle_offsets.end(), triangle_offsets.begin());
+        vertex_triangles.resize(destination.size());
+        {
+            std::vector<u32> cursor(triangle_offsets.begin(), triangle_offsets.end() - 1);
+            for (u32 i = 0; i < destination.size(); i++) {
+                vertex_triangles[cursor[canonical[destination[i]]]++] = i / 3;
+            }
+        }
+        wedge_edges.clear();
+        std::fill(referenced.begin(), referenced.end(), false);
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            for (u32 corner = 0; corner < 3; corner++) {
+                const u32 a = destination[i + corner];
+                const u32 b = destination[i + (corner + 1) % 3];
+                wedge_edges.insert(get_edge_key(a, b));
+                wedge_edges.insert(get_edge_key(b, a));
+                referenced[a] = true;
+            }
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            for (u32 corner = 0; corner < 3; corner++) {
+                for (u32 direction = 0; direction < 2; direction++) {
+                    const u32 from_vertex = canonical[destination[i + (corner + direction) % 3]];
+                    const u32 to_vertex = canonical[destination[i + (corner + 1 - direction) % 3]];
+                    if (from_vertex == to_vertex || locked[from_vertex]) {
+                        continue;
+                    }
+                    const f32 attribute_error = pair_wedges(from_vertex, to_vertex, wedge_pairs);
+                    if (attribute_error < 0.0f) {
+                        continue;
+                    }
+                    Quadric quadric = quadrics[from_vertex];
+                    quadric.add(quadrics[to_vertex]);
+                    collapses.push_back(Collapse{from_vertex, to_vertex, quadric.evaluate(positions[to_vertex]) + attribute_error});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        // Positions are resolved through remap, a neighbour may already have
+        // moved earlier in this pass
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(collapsed_this_pass.begin(), collapsed_this_pass.end(), false);
+        const auto would_flip = [&](u32 from_vertex, u32 to_vertex) {
+            for (u32 t = triangle_offsets[from_vertex]; t < triangle_offsets[from_vertex + 1]; t++) {
+                const u32 triangle = vertex_triangles[t];
+                u32 corners[3];
+                bool contains_target = false;
+                for (u32 corner = 0; corner < 3; corner++) {
+                    corners[corner] = canonical[remap[destination[triangle * 3 + corner]]];
+                    contains_target |= corners[corner] == to_vertex;
+                }
+                if (contains_target) {
+                    continue;
+                }
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (u32 corner = 0; corner < 3; corner++) {
+                    before[corner] = positions[corners[corner]];
+                    after[corner] = corners[corner] == from_vertex ? positions[to_vertex] : before[corner];
+                }
+                const glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normal_before, normal_after) <= 0.25f * glm::length(normal_before) * glm::length(normal_after)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        const u32 triangles_to_remove = triangle_count - target_index_count / 3;
+        u32 removed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (collapse.cost > error_limit || removed >= triangles_to_remove) {
+                break;
+            }
+            const u32 from_vertex = collapse.from;
+            const u32 to_vertex = collapse.to;
+            if (collapsed_this_pass[from_vertex] || collapsed_this_pass[to_vertex] || would_flip(from_vertex, to_vertex)) {
+                continue;
+            }
+            pair_wedges(from_vertex, to_vertex, wedge_pairs);
+            for (const auto& [wedge, partner] : wedge_pairs) {
+                remap[wedge] = partner;
+            }
+            for (u32 t = triangle_offsets[from_vertex]; t < triangle_offsets[from_vertex + 1]; t++) {
+                const u32 triangle = vertex_triangles[t];
+                for (u32 corner = 0; corner < 3; corner++) {
+                    removed += canonical[destination[triangle * 3 + corner]] == to_vertex;
+                }
+            }
+            quadrics[to_vertex].add(quadrics[from_vertex]);
+            collapsed_this_pass[from_vertex] = true;
+            collapsed_this_pass[to_vertex] = true;
+            result_error = glm::max(result_error, collapse.cost);
+        }
+        if (removed == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < destination.size(); i += 3) {
+            const u32 a = remap[destination[i]];
+            const u32 b = remap[destination[i + 1]];
+            const u32 c = remap[destination[i + 2]];
+            if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c]) {
+                continue;
+            }
+            destination[write++] = a;
+            destination[write++] = b;
+            destination[write++] = c;
+        }
+        destination.resize(write);
+    }
+    return glm::sqrt(result_error);
+}
+
+void generate_lods(std::span<const Vertex> vertices, arena_vector<u32>& indices, std::vector<MeshLod>& lods, f32 max_error) {
+    lods.clear();
+    lods.push_back(MeshLod{0, static_cast<u32>(indices.size()), 0.0f, 0});
+    const f32 extent = get_mesh_extent(vertices);
+    // Every level simplifies the full mesh, so the error is measured against
+    // the original surface rather than accumulated over levels
+    const std::vector<u32> base{indices.begin(), indices.end()};
+    std::vector<u32> simplified;
+    while (lods.size() < MAX_MESH_LODS) {
+        const u32 previous_count = lods.back().index_count;
+        const u32 target_count = previous_count / 6 * 3;
+        if (target_count < MIN_LOD_INDEX_COUNT) {
+            break;
+        }
+        const f32 error = simplify(vertices, base, target_count, max_error, simplified);
+        // Stuck on locked vertices or the error limit, further levels would
+        // cost memory without saving much
+        if (simplified.size() > previous_count * 17 / 20) {
+            break;
+        }
+        optimize_vertex_cache(simplified, static_cast<u32>(vertices.size()));
+        const f32 lod_error = glm::max(error * extent, lods.back().error);
+        lods.push_back(MeshLod{static_cast<u32>(indices.size()), static_cast<u32>(simplified.size()), lod_error, 0});
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+    }
+}
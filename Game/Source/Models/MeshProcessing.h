@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <span>
+#include <vector>
+
+#include "common.h"
+#include "MeshFile.h"
+#include "Vertex.h"
+
+struct WeldStats {
+    u32 vertices_before;
+    u32 vertices_after;
+
+    [[nodiscard]] f32 get_reduction() const {
+        return vertices_before == 0 ? 0.0f : 1.0f - static_cast<f32>(vertices_after) / static_cast<f32>(vertices_before);
+    }
+};
+
+// Merges duplicate vertices and rewrites indices to match, keeping the first
+// occurrence of every vertex so the order of the remaining ones is stable.
+// epsilon 0 merges exact duplicates, otherwise vertices whose attributes fall
+// into the same epsilon sized grid cell are merged.
+WeldStats weld_vertices(arena_vector<Vertex>& vertices, arena_vector<u32>& indices, f32 epsilon = 0.0f);
+
+// Post-transform cache behaviour of an index buffer under a simulated FIFO
+// cache. ACMR is vertex shader invocations per triangle (0.5 is ideal for
+// large regular meshes), ATVR is invocations per unique vertex (1.0 is ideal).
+struct VertexCacheStats {
+    u32 shaded_vertices;
+    f32 acmr;
+    f32 atvr;
+};
+
+static constexpr u32 DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyze_vertex_cache(std::span<const u32> indices, u32 vertex_count, u32 cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+// Reorders triangles for post-transform cache reuse with Tipsify (Sander et
+// al. 2007). Returns the first triangle of every cluster, a cluster ending
+// wherever the walk had to jump to an unrelated part of the mesh.
+std::vector<u32> optimize_vertex_cache(std::span<u32> indices, u32 vertex_count, u32 cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+// Splits clusters wherever the part before the split already shades fewer
+// than threshold times the mesh ACMR, then orders them so outward facing
+// clusters draw first and occlude the rest. Lower thresholds split less and
+// keep more of the vertex cache gains, 0 only reorders the Tipsify clusters.
+void optimize_overdraw(std::span<u32> indices, std::span<const Vertex> vertices, std::span<const u32> cluster_starts,
+    f32 threshold = 0.75f, u32 cache_size = DEFAULT_VERTEX_CACHE_SIZE);
+
+static constexpr u32 MAX_MESHLET_VERTICES = 64;
+static constexpr u32 MAX_MESHLET_TRIANGLES = 124;
+
+// Regroups triangles into meshlets of at most max_vertices unique vertices and
+// max_triangles triangles and rewrites indices so every meshlet is a
+// contiguous range. Meshlets grow over shared edges, preferring triangles
+// that add no new vertices and face the same way, which keeps their bounding
+// spheres small and normal cones narrow.
+std::vector<Meshlet> build_meshlets(std::span<u32> indices, std::span<const Vertex> vertices, u32 max_vertices = MAX_MESHLET_VERTICES,
+    u32 max_triangles = MAX_MESHLET_TRIANGLES);
+
+// Renumbers vertices in the order the index buffer first uses them, so vertex
+// fetch walks memory linearly. Unreferenced vertices are dropped.
+void optimize_vertex_fetch(arena_vector<Vertex>& vertices, std::span<u32> indices);
+
+// Collapses edges in order of quadric error until indices shrink to
+// target_index_count or the next collapse would exceed target_error. Vertices
+// only move onto their neighbours, so the result indexes the same vertex
+// buffer. Border and non-manifold vertices are locked, vertices on attribute
+// seams only move along the seam and attribute changes add to the error.
+// Errors are relative to the largest extent of the mesh, the return value is
+// the error of the result.
+f32 simplify(std::span<const Vertex> vertices, std::span<const u32> indices, u32 target_index_count, f32 target_error, std::vector<u32>& destination);
+
+static constexpr u32 MAX_MESH_LODS = 8;
+static constexpr u32 MIN_LOD_INDEX_COUNT = 3 * 64;
+
+// Builds a LOD chain halving the triangle count per level until simplification
+// stalls or max_error (relative to the mesh extent) is reached. The levels are
+// appended to indices behind LOD 0, lods receives one entry per level.
+void generate_lods(std::span<const Vertex> vertices, arena_vector<u32>& indices, std::vector<MeshLod>& lods, f32 max_error = 0.05f);
@@ -0,0 +1,633 @@
+﻿#include "ObjParser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "assimp/postprocess.h"
+#include "robin_hood.h"
+#include "Threading/ThreadPool.h"
+
+static constexpr u32 OBJ_SUPPORTED_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenNormals |
+    aiProcess_GenSmoothNormals | aiProcess_ValidateDataStructure | aiProcess_ImproveCacheLocality;
+// Chunks smaller than this cost more to schedule than they take to parse
+static constexpr size_t MIN_OBJ_CHUNK_SIZE = 64 << 10;
+static constexpr u32 UNUSED_INDEX = ~0u;
+
+namespace {
+
+enum class ObjLineType : u8 {
+    POSITION,
+    UV,
+    NORMAL,
+    FACE,
+    // o, g and usemtl, all of them start a new submesh
+    OBJECT,
+    GROUP,
+    MATERIAL,
+    OTHER
+};
+
+// Corner of a triangle, indices into the file wide attribute arrays
+struct ObjCorner {
+    u32 position;
+    u32 uv;
+    u32 normal;
+
+    bool operator==(const ObjCorner&) const = default;
+};
+
+struct ObjCornerHash {
+    size_t operator()(const ObjCorner& corner) const noexcept {
+        return robin_hood::hash_bytes(&corner, sizeof(ObjCorner));
+    }
+};
+
+// Hashes the bits of a position, -0 is folded into 0 by the callers
+struct ObjPositionHash {
+    size_t operator()(const glm::vec3& position) const noexcept {
+        return robin_hood::hash_bytes(&position, sizeof(glm::vec3));
+    }
+};
+
+struct ObjCounts {
+    u32 positions;
+    u32 uvs;
+    u32 normals;
+    u32 triangles;
+};
+
+// A submesh boundary inside a chunk, at the first triangle after it
+struct ObjBoundary {
+    u32 triangle;
+    // Empty unless the boundary is a material change
+    std::string_view material;
+};
+
+// A face with more than three corners, emitted as a fan until its positions are known
+struct ObjPolygon {
+    u32 first_triangle;
+    u32 corner_count;
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    // Counts of the chunk itself, then the first index of the chunk in the file
+    ObjCounts counts;
+    ObjCounts first;
+    std::vector<ObjBoundary> boundaries;
+    std::vector<ObjPolygon> polygons;
+    bool has_colors;
+};
+
+// Cursor over one line, which never contains the newline
+struct ObjLine {
+    const char* current;
+    const char* end;
+
+    void skip_spaces() {
+        while (current < end && (*current == ' ' || *current == '\t')) {
+            current++;
+        }
+    }
+
+    bool at_end() {
+        skip_spaces();
+        return current >= end;
+    }
+
+    f32 next_float() {
+        skip_spaces();
+        f32 value = 0.0f;
+        current = std::from_chars(current, end, value).ptr;
+        return value;
+    }
+
+    // Resolves OBJ's 1 based and negative relative indices to 0 based ones
+    u32 next_index(u32 count) {
+        i64 value = 0;
+        const std::from_chars_result result = std::from_chars(current, end, value);
+        if (result.ec != std::errc{}) {
+            return UNUSED_INDEX;
+        }
+        current = result.ptr;
+        const i64 index = value < 0 ? count + value : value - 1;
+        return index < 0 || index >= count ? UNUSED_INDEX : static_cast<u32>(index);
+    }
+
+    std::string_view rest() {
+        skip_spaces();
+        return std::string_view{current, static_cast<size_t>(end - current)};
+    }
+};
+
+}
+
+static ObjLineType get_line_type(ObjLine& line) {
+    line.skip_spaces();
+    const auto keyword = [&line](std::string_view name) {
+        const size_t length = static_cast<size_t>(line.end - line.current);
+        if (length < name.size() || std::memcmp(line.current, name.data(), name.size()) != 0) {
+            return false;
+        }
+        if (length > name.size() && line.current[name.size()] != ' ' && line.current[name.size()] != '\t') {
+            return false;
+        }
+        line.current += name.size();
+        return true;
+    };
+    if (line.current >= line.end) {
+        return ObjLineType::OTHER;
+    }
+    switch (*line.current) {
+    case 'v':
+        if (keyword("v")) {
+            return ObjLineType::POSITION;
+        }
+        if (keyword("vt")) {
+            return ObjLineType::UV;
+        }
+        if (keyword("vn")) {
+            return ObjLineType::NORMAL;
+        }
+        break;
+    case 'f':
+        if (keyword("f")) {
+            return ObjLineType::FACE;
+        }
+        break;
+    case 'o':
+        if (keyword("o")) {
+            return ObjLineType::OBJECT;
+        }
+        break;
+    case 'g':
+        if (keyword("g")) {
+            return ObjLineType::GROUP;
+        }
+        break;
+    case 'u':
+        if (keyword("usemtl")) {
+            return ObjLineType::MATERIAL;
+        }
+        break;
+    default:
+        break;
+    }
+    return ObjLineType::OTHER;
+}
+
+// Calls fn for every line between begin and end, memchr finds the newlines
+// with the C library's vectorized scan
+template <typename Fn>
+static void for_each_line(const char* begin, const char* end, Fn&& fn) {
+    while (begin < end) {
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+        const char* line_end = newline ? newline : end;
+        ObjLine line{begin, line_end > begin && line_end[-1] == '\r' ? line_end - 1 : line_end};
+        fn(line);
+        begin = newline ? newline + 1 : end;
+    }
+}
+
+static u32 count_face_corners(ObjLine line) {
+    u32 corners = 0;
+    while (!line.at_end()) {
+        corners++;
+        while (line.current < line.end && *line.current != ' ' && *line.current != '\t') {
+            line.current++;
+        }
+    }
+    return corners;
+}
+
+// First pass, counts attributes and triangles so the second pass can write
+// every chunk into its own range of the file wide arrays
+static void count_chunk(ObjChunk& chunk) {
+    chunk.counts = ObjCounts{};
+    for_each_line(chunk.begin, chunk.end, [&chunk](ObjLine& line) {
+        switch (get_line_type(line)) {
+        case ObjLineType::POSITION:
+            chunk.counts.positions++;
+            break;
+        case ObjLineType::UV:
+            chunk.counts.uvs++;
+            break;
+        case ObjLineType::NORMAL:
+            chunk.counts.normals++;
+            break;
+        case ObjLineType::FACE: {
+            const u32 corners = count_face_corners(line);
+            chunk.counts.triangles += corners >= 3 ? corners - 2 : 0;
+            break;
+        }
+        default:
+            break;
+        }
+    });
+}
+
+struct ObjData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjCorner> corners;
+    ObjCounts totals;
+};
+
+static void parse_chunk(ObjChunk& chunk, ObjData& data) {
+    ObjCounts cursor = chunk.first;
+    chunk.has_colors = false;
+    std::vector<ObjCorner> polygon;
+    for_each_line(chunk.begin, chunk.end, [&](ObjLine& line) {
+        switch (get_line_type(line)) {
+        case ObjLineType::POSITION: {
+            const f32 x = line.next_float();
+            const f32 y = line.next_float();
+            const f32 z = line.next_float();
+            data.positions[cursor.positions] = glm::vec3{x, y, z};
+            // Vertex colors are an extension some exporters add behind the position
+            if (!line.at_end()) {
+                const f32 r = line.next_float();
+                const f32 g = line.next_float();
+                const f32 b = line.next_float();
+                data.colors[cursor.positions] = glm::vec3{r, g, b};
+                chunk.has_colors = true;
+            } else {
+                data.colors[cursor.positions] = glm::vec3{1.0f};
+            }
+            cursor.positions++;
+            break;
+        }
+        case ObjLineType::UV: {
+            const f32 u = line.next_float();
+            const f32 v = line.at_end() ? 0.0f : line.next_float();
+            data.uvs[cursor.uvs++] = glm::vec2{u, v};
+            break;
+        }
+        case ObjLineType::NORMAL: {
+            const f32 x = line.next_float();
+            const f32 y = line.next_float();
+            const f32 z = line.next_float();
+            data.normals[cursor.normals++] = glm::vec3{x, y, z};
+            break;
+        }
+        case ObjLineType::FACE: {
+            polygon.clear();
+            while (!line.at_end()) {
+                // v, v/vt, v//vn or v/vt/vn, counts so far resolve relative indices
+                ObjCorner corner{line.next_index(cursor.positions), UNUSED_INDEX, UNUSED_INDEX};
+                if (line.current < line.end && *line.current == '/') {
+                    line.current++;
+                    if (line.current < line.end && *line.current != '/') {
+                        corner.uv = line.next_index(cursor.uvs);
+                    }
+                    if (line.current < line.end && *line.current == '/') {
+                        line.current++;
+                        corner.normal = line.next_index(cursor.normals);
+                    }
+                }
+                while (line.current < line.end && *line.current != ' ' && *line.current != '\t') {
+                    line.current++;
+                }
+                polygon.push_back(corner);
+            }
+            if (polygon.size() > 3) {
+                chunk.polygons.push_back(ObjPolygon{cursor.triangles, static_cast<u32>(polygon.size())});
+            }
+            for (u32 i = 2; i < polygon.size(); i++) {
+                ObjCorner* triangle = &data.corners[static_cast<size_t>(cursor.triangles++) * 3];
+                triangle[0] = polygon[0];
+                triangle[1] = polygon[i - 1];
+                triangle[2] = polygon[i];
+            }
+            break;
+        }
+        case ObjLineType::OBJECT:
+        case ObjLineType::GROUP:
+            chunk.boundaries.push_back(ObjBoundary{cursor.triangles, {}});
+            break;
+        case ObjLineType::MATERIAL:
+            chunk.boundaries.push_back(ObjBoundary{cursor.triangles, line.rest()});
+            break;
+        default:
+            break;
+        }
+    });
+}
+
+// Buffers reused by every polygon of a chunk
+struct ObjPolygonScratch {
+    std::vector<ObjCorner> corners;
+    std::vector<glm::vec2> points;
+    std::vector<u32> remaining;
+};
+
+static f32 cross_2d(glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// Replaces the fan of a polygon by ear clipping in the plane of its Newell
+// normal, so concave faces do not fold over. Convex ones keep their fan.
+static void triangulate_polygon(const ObjPolygon& polygon, ObjData& data, ObjPolygonScratch& scratch) {
+    ObjCorner* fan = &data.corners[static_cast<size_t>(polygon.first_triangle) * 3];
+    std::vector<ObjCorner>& corners = scratch.corners;
+    std::vector<glm::vec2>& points = scratch.points;
+    std::vector<u32>& remaining = scratch.remaining;
+    corners.clear();
+    corners.push_back(fan[0]);
+    corners.push_back(fan[1]);
+    for (u32 i = 0; i < polygon.corner_count - 2; i++) {
+        corners.push_back(fan[i * 3 + 2]);
+    }
+    glm::vec3 normal{0.0f};
+    for (size_t i = 0; i < corners.size(); i++) {
+        if (corners[i].position == UNUSED_INDEX) {
+            return;
+        }
+        const glm::vec3 current = data.positions[corners[i].position];
+        const glm::vec3 next = data.positions[corners[(i + 1) % corners.size()].position];
+        normal += glm::vec3{(current.y - next.y) * (current.z + next.z), (current.z - next.z) * (current.x + next.x),
+            (current.x - next.x) * (current.y + next.y)};
+    }
+    // Drop the dominant axis, ordered so the projection winds counter clockwise
+    const glm::vec3 extent = glm::abs(normal);
+    const u32 axis = extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2;
+    u32 u = (axis + 1) % 3;
+    u32 v = (axis + 2) % 3;
+    if (normal[axis] < 0.0f) {
+        std::swap(u, v);
+    }
+    points.clear();
+    for (const ObjCorner& corner : corners) {
+        const glm::vec3 position = data.positions[corner.position];
+        points.push_back(glm::vec2{position[u], position[v]});
+    }
+
+    // Remaining corners as indices into corners, clipping from the second one on
+    // reproduces the fan whenever every corner is an ear
+    remaining.resize(corners.size());
+    for (u32 i = 0; i < remaining.size(); i++) {
+        remaining[i] = i;
+    }
+    ObjCorner* triangle = fan;
+    while (remaining.size() > 3) {
+        size_t ear = 1;
+        for (size_t candidate = 1; candidate <= remaining.size(); candidate++) {
+            const size_t index = candidate % remaining.size();
+            const glm::vec2 previous = points[remaining[(index + remaining.size() - 1) % remaining.size()]];
+            const glm::vec2 current = points[remaining[index]];
+            const glm::vec2 next = points[remaining[(index + 1) % remaining.size()]];
+            if (cross_2d(previous, current, next) <= 0.0f) {
+                continue;
+            }
+            bool is_ear = true;
+            for (u32 other : remaining) {
+                const glm::vec2 point = points[other];
+                if (point == previous || point == current || point == next) {
+                    continue;
+                }
+                if (cross_2d(previous, current, point) >= 0.0f && cross_2d(current, next, point) >= 0.0f && cross_2d(next, previous, point) >= 0.0f) {
+                    is_ear = false;
+                    break;
+                }
+            }
+            if (is_ear) {
+                ear = index;
+                break;
+            }
+        }
+        // Self intersecting or degenerate polygons without an ear keep clipping the second corner
+        const size_t previous = (ear + remaining.size() - 1) % remaining.size();
+        const size_t next = (ear + 1) % remaining.size();
+        triangle[0] = corners[remaining[previous]];
+        triangle[1] = corners[remaining[ear]];
+        triangle[2] = corners[remaining[next]];
+        triangle += 3;
+        remaining.erase(remaining.begin() + static_cast<std::ptrdiff_t>(ear));
+    }
+    triangle[0] = corners[remaining[0]];
+    triangle[1] = corners[remaining[1]];
+    triangle[2] = corners[remaining[2]];
+}
+
+struct ObjSubmesh {
+    u32 first_triangle;
+    u32 triangle_count;
+    u32 material_slot;
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+};
+
+// Emits the vertices of one submesh, corners with the same attribute indices
+// become one vertex. Missing normals are generated when the flags ask for it.
+static void build_submesh(const ObjData& data, u32 import_flags, bool has_colors, ObjSubmesh& submesh) {
+    const std::span<const ObjCorner> corners{data.corners.data() + static_cast<size_t>(submesh.first_triangle) * 3, static_cast<size_t>(submesh.triangle_count) * 3};
+    const bool flat_normals = (import_flags & aiProcess_GenNormals) != 0;
+    const bool smooth_normals = (import_flags & aiProcess_GenSmoothNormals) != 0;
+    const bool flip_uvs = (import_flags & aiProcess_FlipUVs) != 0;
+
+    // Sums of the unit face normals around every position, as assimp does.
+    // Keyed by value so seams exported as duplicated positions are smoothed across.
+    robin_hood::unordered_flat_map<glm::vec3, glm::vec3, ObjPositionHash> smoothed;
+    if (smooth_normals) {
+        for (size_t i = 0; i < corners.size(); i += 3) {
+            if (corners[i].normal != UNUSED_INDEX || corners[i].position == UNUSED_INDEX || corners[i + 1].position == UNUSED_INDEX
+                || corners[i + 2].position == UNUSED_INDEX) {
+                continue;
+            }
+            const glm::vec3 normal = glm::cross(data.positions[corners[i + 1].position] - data.positions[corners[i].position],
+                data.positions[corners[i + 2].position] - data.positions[corners[i].position]);
+            const f32 length = glm::length(normal);
+            if (length == 0.0f) {
+                continue;
+            }
+            for (size_t corner = i; corner < i + 3; corner++) {
+                smoothed[data.positions[corners[corner].position] + 0.0f] += normal / length;
+            }
+        }
+    }
+
+    robin_hood::unordered_flat_map<ObjCorner, u32, ObjCornerHash> unique_corners;
+    unique_corners.reserve(corners.size() / 2);
+    submesh.indices.reserve(corners.size());
+    for (size_t i = 0; i < corners.size(); i += 3) {
+        // Faces pointing at positions that do not exist are dropped
+        if (corners[i].position == UNUSED_INDEX || corners[i + 1].position == UNUSED_INDEX || corners[i + 2].position == UNUSED_INDEX) {
+            continue;
+        }
+        glm::vec3 face_normal{0.0f};
+        if (flat_normals) {
+            const glm::vec3 normal = glm::cross(data.positions[corners[i + 1].position] - data.positions[corners[i].position],
+                data.positions[corners[i + 2].position] - data.positions[corners[i].position]);
+            const f32 length = glm::length(normal);
+            face_normal = length > 0.0f ? normal / length : glm::vec3{0.0f};
+        }
+        for (size_t corner_index = i; corner_index < i + 3; corner_index++) {
+            const ObjCorner& corner = corners[corner_index];
+            // Corners with a generated flat normal never share their vertex
+            const bool is_generated = flat_normals && corner.normal == UNUSED_INDEX;
+            if (!is_generated) {
+                auto [it, inserted] = unique_corners.try_emplace(corner, static_cast<u32>(submesh.vertices.size()));
+                if (!inserted) {
+                    submesh.indices.push_back(it->second);
+                    continue;
+                }
+            }
+            Vertex vertex;
+            vertex.position = data.positions[corner.position];
+            vertex.color = has_colors ? data.colors[corner.position] : glm::vec3{1.0f};
+            vertex.uv = glm::vec2{0.0f};
+            if (corner.uv != UNUSED_INDEX) {
+                vertex.uv = data.uvs[corner.uv];
+                if (flip_uvs) {
+                    vertex.uv.y = 1.0f - vertex.uv.y;
+                }
+            }
+            if (corner.normal != UNUSED_INDEX) {
+                vertex.normal = data.normals[corner.normal];
+            } else if (is_generated) {
+                vertex.normal = face_normal;
+            } else if (smooth_normals) {
+                const glm::vec3 normal = smoothed[vertex.position + 0.0f];
+                const f32 length = glm::length(normal);
+                vertex.normal = length > 0.0f ? normal / length : glm::vec3{0.0f};
+            } else {
+                vertex.normal = glm::vec3{0.0f};
+            }
+            submesh.indices.push_back(static_cast<u32>(submesh.vertices.size()));
+            submesh.vertices.push_back(vertex);
+        }
+    }
+}
+
+bool can_parse_obj(u32 import_flags) {
+    return (import_flags & ~OBJ_SUPPORTED_IMPORT_FLAGS) == 0;
+}
+
+bool parse_obj(std::span<const byte> contents, u32 import_flags, engine::ThreadPool* thread_pool, arena_vector<Vertex>& vertices,
+    arena_vector<u32>& indices, arena_vector<Submesh>& submeshes) {
+    const char* text = reinterpret_cast<const char*>(contents.data());
+    const char* text_end = text + contents.size();
+
+    // Chunks end on line boundaries, a few per thread to even out the load
+    const size_t thread_count = thread_pool ? thread_pool->get_thread_count() + 1 : 1;
+    const size_t chunk_count = std::max<size_t>(1, std::min(thread_count * 4, contents.size() / MIN_OBJ_CHUNK_SIZE));
+    std::vector<ObjChunk> chunks;
+    chunks.reserve(chunk_count);
+    const char* chunk_begin = text;
+    for (size_t i = 1; i <= chunk_count && chunk_begin < text_end; i++) {
+        const char* chunk_end = i == chunk_count ? text_end : text + contents.size() * i / chunk_count;
+        if (chunk_end < chunk_begin) {
+            continue;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(chunk_end, '\n', static_cast<size_t>(text_end - chunk_end)));
+        chunk_end = newline ? newline + 1 : text_end;
+        chunks.push_back(ObjChunk{chunk_begin, chunk_end, {}, {}, {}, {}, false});
+        chunk_begin = chunk_end;
+    }
+    const auto for_each_chunk = [&chunks, thread_pool](auto&& fn) {
+        const auto run = [&chunks, &fn](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                fn(chunks[i]);
+            }
+        };
+        if (thread_pool) {
+            thread_pool->parallel_for(chunks.size(), 1, run);
+        } else {
+            run(0, chunks.size());
+        }
+    };
+
+    for_each_chunk([](ObjChunk& chunk) {
+        count_chunk(chunk);
+    });
+    ObjData data{};
+    for (ObjChunk& chunk : chunks) {
+        chunk.first = data.totals;
+        data.totals.positions += chunk.counts.positions;
+        data.totals.uvs += chunk.counts.uvs;
+        data.totals.normals += chunk.counts.normals;
+        data.totals.triangles += chunk.counts.triangles;
+    }
+    if (data.totals.triangles == 0) {
+        return false;
+    }
+    data.positions.resize(data.totals.positions);
+    data.colors.resize(data.totals.positions);
+    data.uvs.resize(data.totals.uvs);
+    data.normals.resize(data.totals.normals);
+    data.corners.resize(static_cast<size_t>(data.totals.triangles) * 3);
+    // Relative indices only need the counts before their line, which the
+    // first pass already knows for every chunk
+    for_each_chunk([&data](ObjChunk& chunk) {
+        parse_chunk(chunk, data);
+    });
+    // Faces may use positions another chunk parses, so polygons wait for all of them
+    for_each_chunk([&data](ObjChunk& chunk) {
+        ObjPolygonScratch scratch;
+        for (const ObjPolygon& polygon : chunk.polygons) {
+            triangulate_polygon(polygon, data, scratch);
+        }
+    });
+
+    // Material slots in order of first use
+    std::vector<ObjSubmesh> obj_submeshes;
+    std::vector<std::string_view> materials;
+    bool has_colors = false;
+    u32 material_slot = 0;
+    u32 first_triangle = 0;
+    const auto close_submesh = [&](u32 end_triangle) {
+        if (end_triangle > first_triangle) {
+            obj_submeshes.push_back(ObjSubmesh{first_triangle, end_triangle - first_triangle, material_slot, {}, {}});
+        }
+        first_triangle = end_triangle;
+    };
+    for (const ObjChunk& chunk : chunks) {
+        has_colors |= chunk.has_colors;
+        for (const ObjBoundary& boundary : chunk.boundaries) {
+            close_submesh(boundary.triangle);
+            if (!boundary.material.empty()) {
+                const auto it = std::find(materials.begin(), materials.end(), boundary.material);
+                material_slot = static_cast<u32>(it - materials.begin());
+                if (it == materials.end()) {
+                    materials.push_back(boundary.material);
+                }
+            }
+        }
+    }
+    close_submesh(data.totals.triangles);
+
+    const auto build_submeshes = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            build_submesh(data, import_flags, has_colors, obj_submeshes[i]);
+        }
+    };
+    if (thread_pool) {
+        thread_pool->parallel_for(obj_submeshes.size(), 1, build_submeshes);
+    } else {
+        build_submeshes(0, obj_submeshes.size());
+    }
+
+    vertices.clear();
+    indices.clear();
+    submeshes.clear();
+    for (const ObjSubmesh& obj_submesh : obj_submeshes) {
+        if (obj_submesh.indices.empty()) {
+            continue;
+        }
+        Submesh& submesh = submeshes.emplace_back();
+        submesh.index_offset = static_cast<u32>(indices.size());
+        submesh.index_count = static_cast<u32>(obj_submesh.indices.size());
+        submesh.vertex_offset = static_cast<u32>(vertices.size());
+        submesh.vertex_count = static_cast<u32>(obj_submesh.vertices.size());
+        submesh.material_slot = obj_submesh.material_slot;
+        vertices.insert(vertices.end(), obj_submesh.vertices.begin(), obj_submesh.vertices.end());
+        indices.insert(indices.end(), obj_submesh.indices.begin(), obj_submesh.indices.end());
+    }
+    return !submeshes.empty();
+}
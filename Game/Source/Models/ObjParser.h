@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include <span>
+
+#include "common.h"
+#include "Vertex.h"
+
+namespace engine {
+class ThreadPool;
+}
+
+// Whether parse_obj honours every import flag, anything else goes through Assimp
+bool can_parse_obj(u32 import_flags);
+
+// Reads Wavefront OBJ text straight into engine vertices without building an
+// Assimp scene. Objects, groups and material changes start new submeshes,
+// polygons are ear clipped and corners sharing position, uv and normal
+// indices share a vertex. Chunks of lines parse in parallel on the pool.
+// Returns false when the file holds no faces.
+bool parse_obj(std::span<const byte> contents, u32 import_flags, engine::ThreadPool* thread_pool, arena_vector<Vertex>& vertices,
+    arena_vector<u32>& indices, arena_vector<Submesh>& submeshes);
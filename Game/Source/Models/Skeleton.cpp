@@ -0,0 +1,323 @@
+﻿#include "Skeleton.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Hashing/Hash.h"
+#include "Vertex.h"
+#include "assimp/anim.h"
+#include "assimp/scene.h"
+#include "robin_hood.h"
+
+namespace {
+
+struct Influence {
+    u32 joint;
+    f32 weight;
+};
+
+std::string_view to_string_view(const aiString& string) {
+    return std::string_view{string.data, string.length};
+}
+
+// Assimp matrices are row major
+glm::mat4 to_glm(const aiMatrix4x4& matrix) {
+    return glm::mat4{
+        matrix.a1, matrix.b1, matrix.c1, matrix.d1,
+        matrix.a2, matrix.b2, matrix.c2, matrix.d2,
+        matrix.a3, matrix.b3, matrix.c3, matrix.d3,
+        matrix.a4, matrix.b4, matrix.c4, matrix.d4
+    };
+}
+
+JointPose to_pose(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    return JointPose{glm::vec4{translation, 0.0f}, glm::vec4{rotation.x, rotation.y, rotation.z, rotation.w}, glm::vec4{scale, 0.0f}};
+}
+
+// Splits an affine transform without shear into translation, rotation and scale
+JointPose decompose(const glm::mat4& matrix) {
+    glm::mat3 basis{matrix};
+    glm::vec3 scale{glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2])};
+    // A mirrored basis is folded into the sign of the first axis
+    if (glm::determinant(basis) < 0.0f) {
+        scale.x = -scale.x;
+    }
+    for (u32 axis = 0; axis < 3; axis++) {
+        if (scale[axis] != 0.0f) {
+            basis[axis] /= scale[axis];
+        }
+    }
+    return to_pose(glm::vec3{matrix[3]}, glm::normalize(glm::quat_cast(basis)), scale);
+}
+
+// Last key at or before time, keys are sorted by time
+template <typename Key>
+u32 find_key(const Key* keys, u32 key_count, f64 time) {
+    const Key* next = std::upper_bound(keys, keys + key_count, time, [](f64 value, const Key& key) {
+        return value < key.mTime;
+    });
+    return next == keys ? 0 : static_cast<u32>(next - keys) - 1;
+}
+
+template <typename Key>
+f32 get_key_blend(const Key* keys, u32 key, f64 time) {
+    const f64 span = keys[key + 1].mTime - keys[key].mTime;
+    return span > 0.0 ? static_cast<f32>(std::clamp((time - keys[key].mTime) / span, 0.0, 1.0)) : 0.0f;
+}
+
+glm::vec3 sample_vector(const aiVectorKey* keys, u32 key_count, f64 time, const glm::vec3& fallback) {
+    if (key_count == 0) {
+        return fallback;
+    }
+    const u32 key = find_key(keys, key_count, time);
+    const glm::vec3 value{keys[key].mValue.x, keys[key].mValue.y, keys[key].mValue.z};
+    if (key + 1 >= key_count) {
+        return value;
+    }
+    const glm::vec3 next{keys[key + 1].mValue.x, keys[key + 1].mValue.y, keys[key + 1].mValue.z};
+    return glm::mix(value, next, get_key_blend(keys, key, time));
+}
+
+glm::quat sample_rotation(const aiQuatKey* keys, u32 key_count, f64 time, const glm::quat& fallback) {
+    if (key_count == 0) {
+        return fallback;
+    }
+    const u32 key = find_key(keys, key_count, time);
+    const glm::quat value{keys[key].mValue.w, keys[key].mValue.x, keys[key].mValue.y, keys[key].mValue.z};
+    if (key + 1 >= key_count) {
+        return glm::normalize(value);
+    }
+    const glm::quat next{keys[key + 1].mValue.w, keys[key + 1].mValue.x, keys[key + 1].mValue.y, keys[key + 1].mValue.z};
+    return glm::normalize(glm::slerp(value, next, get_key_blend(keys, key, time)));
+}
+
+// Files without a tick rate get the 25 assimp's own tools assume
+f64 get_ticks_per_second(const aiAnimation* animation) {
+    return animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+}
+
+f32 get_duration(const aiAnimation* animation) {
+    return static_cast<f32>(std::max(animation->mDuration, 0.0) / get_ticks_per_second(animation));
+}
+
+// Rounded up so the frames span the clip exactly, the last one lands on its end
+u32 get_frame_count(f32 duration) {
+    return static_cast<u32>(std::ceil(duration * ANIMATION_SAMPLE_RATE - 0.001f)) + 1;
+}
+
+// Normalizes to 255 in total, the rounding error goes to the heaviest
+// influence so the weights always sum to exactly one
+void quantize_influences(const std::array<Influence, MAX_JOINT_INFLUENCES>& influences, Vertex& vertex) {
+    f32 total = 0.0f;
+    for (const Influence& influence : influences) {
+        total += influence.weight;
+    }
+    i32 sum = 0;
+    for (u32 i = 0; i < MAX_JOINT_INFLUENCES; i++) {
+        const i32 weight = static_cast<i32>(std::lround(influences[i].weight / total * 255.0f));
+        vertex.weights[i] = static_cast<u8>(weight);
+        vertex.joints[i] = weight > 0 ? static_cast<u8>(influences[i].joint) : 0;
+        sum += weight;
+    }
+    vertex.weights[0] = static_cast<u8>(vertex.weights[0] + 255 - sum);
+}
+
+}
+
+u64 get_joint_name_hash(std::string_view name) {
+    return engine::hash::xxh64(name);
+}
+
+u32 find_joint(std::span<const SkeletonJoint> joints, std::string_view name) {
+    const u64 name_hash = get_joint_name_hash(name);
+    for (u32 i = 0; i < joints.size(); i++) {
+        if (joints[i].name_hash == name_hash) {
+            return i;
+        }
+    }
+    return NO_JOINT;
+}
+
+u32 find_animation(std::span<const AnimationClip> clips, std::string_view name) {
+    const u64 name_hash = get_joint_name_hash(name);
+    for (u32 i = 0; i < clips.size(); i++) {
+        if (clips[i].name_hash == name_hash) {
+            return i;
+        }
+    }
+    return NO_ANIMATION;
+}
+
+bool has_skin_weights(std::span<const Vertex> vertices) {
+    return std::any_of(vertices.begin(), vertices.end(), [](const Vertex& vertex) {
+        return vertex.weights[0] != 0;
+    });
+}
+
+void import_skeleton(const aiScene* scene, arena_vector<SkeletonJoint>& joints) {
+    joints.clear();
+    robin_hood::unordered_flat_map<std::string_view, const aiBone*> bones;
+    for (u32 i = 0; i < scene->mNumMeshes; i++) {
+        const aiMesh* mesh = scene->mMeshes[i];
+        for (u32 j = 0; j < mesh->mNumBones; j++) {
+            bones.try_emplace(to_string_view(mesh->mBones[j]->mName), mesh->mBones[j]);
+        }
+    }
+    if (bones.empty()) {
+        return;
+    }
+
+    robin_hood::unordered_flat_set<const aiNode*> used_nodes;
+    const auto use_node = [&used_nodes](const aiNode* node) {
+        // Stops at the first ancestor that is already in
+        while (node != nullptr && used_nodes.insert(node).second) {
+            node = node->mParent;
+        }
+    };
+    const auto use_mesh_nodes = [&](auto& self, const aiNode* node) -> void {
+        if (node->mNumMeshes > 0) {
+            use_node(node);
+        }
+        for (u32 i = 0; i < node->mNumChildren; i++) {
+            self(self, node->mChildren[i]);
+        }
+    };
+    for (const auto& [name, bone] : bones) {
+        use_node(scene->mRootNode->FindNode(bone->mName));
+    }
+    use_mesh_nodes(use_mesh_nodes, scene->mRootNode);
+
+    // Depth first, so every parent is added before its children
+    const auto add_joints = [&](auto& self, const aiNode* node, i32 parent) -> void {
+        if (!used_nodes.contains(node)) {
+            return;
+        }
+        const std::string_view name = to_string_view(node->mName);
+        const auto bone = bones.find(name);
+        SkeletonJoint& joint = joints.emplace_back();
+        joint.inverse_bind = bone == bones.end() ? glm::mat4{1.0f} : to_glm(bone->second->mOffsetMatrix);
+        joint.bind_pose = decompose(to_glm(node->mTransformation));
+        joint.parent = parent;
+        joint.reserved = 0;
+        joint.name_hash = get_joint_name_hash(name);
+        const i32 index = static_cast<i32>(joints.size()) - 1;
+        for (u32 i = 0; i < node->mNumChildren; i++) {
+            self(self, node->mChildren[i], index);
+        }
+    };
+    add_joints(add_joints, scene->mRootNode, -1);
+
+    if (joints.size() > MAX_SKELETON_JOINTS) {
+        ENGINE_LOG_ERROR("Skeleton has {} joints, at most {} are supported, importing it static", joints.size(), MAX_SKELETON_JOINTS)
+        joints.clear();
+    }
+}
+
+void import_skin_weights(const aiMesh* mesh, std::span<const SkeletonJoint> joints, u32 node_joint, std::span<Vertex> vertices) {
+    if (joints.empty()) {
+        return;
+    }
+    std::vector<std::array<Influence, MAX_JOINT_INFLUENCES>> influences(vertices.size());
+    for (u32 i = 0; i < mesh->mNumBones; i++) {
+        const aiBone* bone = mesh->mBones[i];
+        const u32 joint = find_joint(joints, to_string_view(bone->mName));
+        if (joint == NO_JOINT) {
+            continue;
+        }
+        for (u32 j = 0; j < bone->mNumWeights; j++) {
+            const aiVertexWeight& weight = bone->mWeights[j];
+            if (weight.mVertexId >= influences.size()) {
+                continue;
+            }
+            // Kept sorted heaviest first, one lighter than all four is dropped
+            std::array<Influence, MAX_JOINT_INFLUENCES>& slots = influences[weight.mVertexId];
+            if (weight.mWeight <= slots[MAX_JOINT_INFLUENCES - 1].weight) {
+                continue;
+            }
+            u32 slot = MAX_JOINT_INFLUENCES - 1;
+            while (slot > 0 && slots[slot - 1].weight < weight.mWeight) {
+                slots[slot] = slots[slot - 1];
+                slot--;
+            }
+            slots[slot] = Influence{joint, weight.mWeight};
+        }
+    }
+    for (u32 i = 0; i < vertices.size(); i++) {
+        if (influences[i][0].weight > 0.0f) {
+            quantize_influences(influences[i], vertices[i]);
+        } else if (node_joint != NO_JOINT) {
+            // Rigid parts, and any vertex the artist left unweighted, follow the mesh's node
+            vertices[i].joints = glm::u8vec4{static_cast<u8>(node_joint), 0, 0, 0};
+            vertices[i].weights = glm::u8vec4{255, 0, 0, 0};
+        }
+    }
+}
+
+void import_animations(const aiScene* scene, std::span<const SkeletonJoint> joints, arena_vector<AnimationClip>& clips,
+    arena_vector<JointPose>& poses) {
+    clips.clear();
+    poses.clear();
+    if (joints.empty()) {
+        return;
+    }
+    const u32 joint_count = static_cast<u32>(joints.size());
+    // Sized up front, growing would leave every smaller copy behind in the arena
+    size_t pose_count = 0;
+    for (u32 i = 0; i < scene->mNumAnimations; i++) {
+        pose_count += static_cast<size_t>(get_frame_count(get_duration(scene->mAnimations[i]))) * joint_count;
+    }
+    clips.reserve(scene->mNumAnimations);
+    poses.reserve(pose_count);
+
+    std::vector<const aiNodeAnim*> channels(joint_count);
+    std::vector<glm::quat> previous_rotations(joint_count);
+    for (u32 i = 0; i < scene->mNumAnimations; i++) {
+        const aiAnimation* animation = scene->mAnimations[i];
+        std::fill(channels.begin(), channels.end(), nullptr);
+        for (u32 j = 0; j < animation->mNumChannels; j++) {
+            const u32 joint = find_joint(joints, to_string_view(animation->mChannels[j]->mNodeName));
+            if (joint != NO_JOINT) {
+                channels[joint] = animation->mChannels[j];
+            }
+        }
+        const f64 ticks_per_second = get_ticks_per_second(animation);
+        const f32 duration = get_duration(animation);
+
+        AnimationClip& clip = clips.emplace_back();
+        clip = AnimationClip{};
+        const std::string_view name = to_string_view(animation->mName);
+        const size_t name_length = std::min(name.size(), sizeof(clip.name) - 1);
+        std::copy_n(name.data(), name_length, clip.name);
+        clip.name_hash = get_joint_name_hash(name);
+        clip.duration = duration;
+        clip.frame_count = get_frame_count(duration);
+        clip.sample_rate = clip.frame_count > 1 ? static_cast<f32>(clip.frame_count - 1) / duration : ANIMATION_SAMPLE_RATE;
+        clip.pose_offset = static_cast<u32>(poses.size());
+        poses.resize(poses.size() + static_cast<size_t>(clip.frame_count) * joint_count);
+
+        for (u32 frame = 0; frame < clip.frame_count; frame++) {
+            const f64 time = std::min(static_cast<f64>(frame) / clip.sample_rate, static_cast<f64>(duration)) * ticks_per_second;
+            JointPose* frame_poses = poses.data() + clip.pose_offset + static_cast<size_t>(frame) * joint_count;
+            for (u32 joint = 0; joint < joint_count; joint++) {
+                const JointPose& bind_pose = joints[joint].bind_pose;
+                const aiNodeAnim* channel = channels[joint];
+                if (channel == nullptr) {
+                    frame_poses[joint] = bind_pose;
+                    continue;
+                }
+                const glm::quat bind_rotation{bind_pose.rotation.w, bind_pose.rotation.x, bind_pose.rotation.y, bind_pose.rotation.z};
+                glm::quat rotation = sample_rotation(channel->mRotationKeys, channel->mNumRotationKeys, time, bind_rotation);
+                // Neighbouring frames in the same hemisphere blend along the short arc
+                if (frame > 0 && glm::dot(rotation, previous_rotations[joint]) < 0.0f) {
+                    rotation = -rotation;
+                }
+                previous_rotations[joint] = rotation;
+                frame_poses[joint] = to_pose(sample_vector(channel->mPositionKeys, channel->mNumPositionKeys, time, glm::vec3{bind_pose.translation}),
+                    rotation, sample_vector(channel->mScalingKeys, channel->mNumScalingKeys, time, glm::vec3{bind_pose.scale}));
+            }
+        }
+    }
+}
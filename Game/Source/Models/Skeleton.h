@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include <span>
+#include <string_view>
+#include <glm/glm.hpp>
+
+#include "common.h"
+
+struct aiMesh;
+struct aiScene;
+struct Vertex;
+
+// Joints a vertex is skinned to, lighter influences are dropped on import
+static constexpr u32 MAX_JOINT_INFLUENCES = 4;
+// Joint indices are stored in a byte per influence
+static constexpr u32 MAX_SKELETON_JOINTS = 256;
+// Rate clips are resampled to on import, so sampling one at runtime is a
+// blend of two neighbouring frames instead of a search through its keys
+static constexpr f32 ANIMATION_SAMPLE_RATE = 30.0f;
+static constexpr u32 NO_JOINT = ~0u;
+static constexpr u32 NO_ANIMATION = ~0u;
+
+// Transform of a joint relative to its parent. rotation is a unit quaternion
+// in xyzw order, the w of translation and scale is unused. Whole vectors so
+// every part is a single SIMD load.
+struct JointPose {
+    glm::vec4 translation;
+    glm::vec4 rotation;
+    glm::vec4 scale;
+};
+
+// Joints are stored parents first, so one forward pass over them composes the
+// whole hierarchy
+struct SkeletonJoint {
+    // Takes mesh space to the joint's space in the bind pose. Identity for
+    // joints no vertex is weighted to, their palette entry is then the joint's
+    // own transform, which is what meshes rigidly attached to them need.
+    glm::mat4 inverse_bind;
+    JointPose bind_pose;
+    // Index of the parent joint, -1 for the root
+    i32 parent;
+    u32 reserved;
+    u64 name_hash;
+};
+
+// Clip resampled at sample_rate, frame_count poses of every joint starting at
+// pose_offset, frame major. The last frame is at duration, and consecutive
+// rotations are kept in the same hemisphere so they blend without a sign check.
+struct AnimationClip {
+    // Truncated, always zero terminated
+    char name[32];
+    u64 name_hash;
+    // In seconds
+    f32 duration;
+    f32 sample_rate;
+    u32 frame_count;
+    u32 pose_offset;
+    u32 reserved[2];
+};
+
+static_assert(sizeof(JointPose) == 48 && sizeof(SkeletonJoint) == 128 && sizeof(AnimationClip) == 64,
+    "Skeletons and animations are written to mesh files as is");
+
+u64 get_joint_name_hash(std::string_view name);
+// NO_JOINT and NO_ANIMATION when there is none with the name
+u32 find_joint(std::span<const SkeletonJoint> joints, std::string_view name);
+u32 find_animation(std::span<const AnimationClip> clips, std::string_view name);
+// True when any vertex is weighted to a joint
+bool has_skin_weights(std::span<const Vertex> vertices);
+
+// Joints for every bone the scene's meshes are skinned to, the nodes above
+// them up to the root and the nodes of meshes without bones, so those follow
+// the skeleton rigidly. Empty when nothing in the scene is skinned.
+void import_skeleton(const aiScene* scene, arena_vector<SkeletonJoint>& joints);
+// Writes the heaviest MAX_JOINT_INFLUENCES of the mesh's bone weights into its
+// vertices, quantized to unorm8. node_joint takes every vertex of a mesh
+// without bones, NO_JOINT leaves them unskinned.
+void import_skin_weights(const aiMesh* mesh, std::span<const SkeletonJoint> joints, u32 node_joint, std::span<Vertex> vertices);
+// Resamples every animation of the scene at ANIMATION_SAMPLE_RATE, joints
+// without a channel hold their bind pose
+void import_animations(const aiScene* scene, std::span<const SkeletonJoint> joints, arena_vector<AnimationClip>& clips,
+    arena_vector<JointPose>& poses);
@@ -1,10 +1,23 @@
 ﻿#include "Vertex.h"
+#include <algorithm>
 #include <array>
+#include <charconv>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <memory>
 
 #include "assimp/Importer.hpp"
+#include "Compression/BlockCompression.h"
+#include "FileIO/AssetIndex.h"
+#include "FileIO/FileIO.h"
+#include "Hashing/Hash.h"
+#include "MeshFile.h"
+#include "MeshProcessing.h"
+#include "ObjParser.h"
+#include "Threading/ThreadPool.h"
 #include "assimp/mesh.h"
+#include "assimp/postprocess.h"
 #include "assimp/scene.h"
 
 VkVertexInputBindingDescription Vertex::get_binding_descriptions() {
@@ -15,7 +28,7 @@ VkVertexInputBindingDescription Vertex::get_binding_descriptions() {
     return binding_description;
 }
 
-std::array<VkVertexInputAttributeDescription, 4> Vertex::get_attribute_descriptions() {
+std::array<VkVertexInputAttributeDescription, 6> Vertex::get_attribute_descriptions() {
     VkVertexInputAttributeDescription position_attribute;
     position_attribute.binding = 0;
     position_attribute.location = 0;
@@ -39,17 +52,95 @@ std::array<VkVertexInputAttributeDescription, 4> Vertex::get_attribute_descripti
     texture_attribute.location = 3;
     texture_attribute.format = VK_FORMAT_R32G32B32_SFLOAT;
     texture_attribute.offset = offsetof(Vertex, uv);
+
+    VkVertexInputAttributeDescription joints_attribute;
+    joints_attribute.binding = 0;
+    joints_attribute.location = 4;
+    joints_attribute.format = VK_FORMAT_R8G8B8A8_UINT;
+    joints_attribute.offset = offsetof(Vertex, joints);
+
+    VkVertexInputAttributeDescription weights_attribute;
+    weights_attribute.binding = 0;
+    weights_attribute.location = 5;
+    weights_attribute.format = VK_FORMAT_R8G8B8A8_UNORM;
+    weights_attribute.offset = offsetof(Vertex, weights);
     
-    return {position_attribute, color_attribute, normal_attribute, texture_attribute};
+    return {position_attribute, color_attribute, normal_attribute, texture_attribute, joints_attribute, weights_attribute};
 }
 
-VertexIndexInfo::VertexIndexInfo(Arena& model_arena) : vertices(MAKE_ARENA_VECTOR(&model_arena, Vertex)), indices(MAKE_ARENA_VECTOR(&model_arena, u32)) {
+VertexIndexInfo::VertexIndexInfo(Arena& model_arena) : vertices(MAKE_ARENA_VECTOR(&model_arena, Vertex)), indices(MAKE_ARENA_VECTOR(&model_arena, u32)),
+    submeshes(MAKE_ARENA_VECTOR(&model_arena, Submesh)), skeleton(MAKE_ARENA_VECTOR(&model_arena, SkeletonJoint)),
+    animations(MAKE_ARENA_VECTOR(&model_arena, AnimationClip)), animation_poses(MAKE_ARENA_VECTOR(&model_arena, JointPose)) {
     
 }
 
-void process_mesh(aiMesh* mesh, arena_vector<Vertex>& vertices, arena_vector<u32>& indices) {
+bool is_model_source(std::string_view path) {
+    return std::any_of(std::begin(MODEL_SOURCE_EXTENSIONS), std::end(MODEL_SOURCE_EXTENSIONS), [path](const char* extension) {
+        return path.ends_with(extension);
+    });
+}
+
+// URIs in glTF are percent encoded, e.g. spaces as %20
+static std::string decode_uri(std::string_view uri) {
+    std::string path;
+    path.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); i++) {
+        u32 value = 0;
+        if (uri[i] == '%' && i + 2 < uri.size() && std::from_chars(uri.data() + i + 1, uri.data() + i + 3, value, 16).ptr == uri.data() + i + 3) {
+            path += static_cast<char>(value);
+            i += 2;
+        } else {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+
+std::vector<std::string> get_model_dependencies(std::string_view source_path) {
+    std::vector<std::string> dependencies;
+    if (!source_path.ends_with(".gltf")) {
+        return dependencies;
+    }
+    const io::MappedFile file{std::string{source_path}.c_str(), io::MapHint::SEQUENTIAL};
+    const std::string_view json{reinterpret_cast<const char*>(file.data()), file.size()};
+    const std::filesystem::path directory = std::filesystem::path{source_path}.parent_path();
+    // Every "uri" key of buffers and images, without parsing the whole document
+    constexpr std::string_view key = "\"uri\"";
+    for (size_t position = json.find(key); position != std::string_view::npos; position = json.find(key, position)) {
+        position += key.size();
+        while (position < json.size() && (json[position] == ' ' || json[position] == '\t' || json[position] == '\r' || json[position] == '\n'
+                || json[position] == ':')) {
+            position++;
+        }
+        if (position >= json.size() || json[position] != '"') {
+            continue;
+        }
+        std::string uri;
+        for (position++; position < json.size() && json[position] != '"'; position++) {
+            if (json[position] == '\\' && position + 1 < json.size()) {
+                position++;
+            }
+            uri += json[position];
+        }
+        // Embedded data is part of the source itself
+        if (!uri.empty() && !uri.starts_with("data:")) {
+            dependencies.push_back((directory / decode_uri(uri)).lexically_normal().generic_string());
+        }
+    }
+    return dependencies;
+}
+
+// An imported mesh and the node it hangs from, whose joint takes its unweighted vertices
+struct SceneMesh {
+    const aiMesh* mesh;
+    const aiNode* node;
+};
+
+// Writes the mesh into its submesh's ranges, face indices stay relative to its first vertex
+static void process_mesh(const SceneMesh& scene_mesh, std::span<const SkeletonJoint> skeleton, std::span<Vertex> vertices, std::span<u32> indices) {
+    const aiMesh* mesh = scene_mesh.mesh;
     for (u32 i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
+        Vertex& vertex = vertices[i];
 
         vertex.position = {
             mesh->mVertices[i].x,
@@ -85,77 +176,434 @@ void process_mesh(aiMesh* mesh, arena_vector<Vertex>& vertices, arena_vector<u32
         } else {
             vertex.color = {1.0f, 1.0f, 1.0f};
         }
-        vertices.push_back(vertex);
     }
 
     for (u32 i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        indices.push_back(face.mIndices[0]);
-        indices.push_back(face.mIndices[1]);
-        indices.push_back(face.mIndices[2]);
+        const aiFace& face = mesh->mFaces[i];
+        indices[i * 3] = face.mIndices[0];
+        indices[i * 3 + 1] = face.mIndices[1];
+        indices[i * 3 + 2] = face.mIndices[2];
     }
+
+    import_skin_weights(mesh, skeleton, find_joint(skeleton, std::string_view{scene_mesh.node->mName.data, scene_mesh.node->mName.length}), vertices);
 }
 
-void process_node(aiNode* node, const aiScene* scene, arena_vector<Vertex>& vertices, arena_vector<u32>& indices) {
+// Meshes in the order a depth first walk of the scene reaches them
+static void collect_meshes(const aiNode* node, const aiScene* scene, std::vector<SceneMesh>& meshes) {
     for (u32 i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        process_mesh(mesh, vertices, indices);
+        meshes.push_back(SceneMesh{scene->mMeshes[node->mMeshes[i]], node});
     }
     for (u32 i = 0; i < node->mNumChildren; i++) {
-        process_node(node->mChildren[i], scene, vertices, indices);
+        collect_meshes(node->mChildren[i], scene, meshes);
+    }
+}
+
+// Sizes the buffers for every mesh up front, then converts the meshes in
+// parallel, each into its own disjoint range. The skeleton comes first, the
+// meshes look their joints up in it.
+static void process_scene(const aiScene* scene, engine::ThreadPool* thread_pool, VertexIndexInfo& model) {
+    arena_vector<Vertex>& vertices = model.vertices;
+    arena_vector<u32>& indices = model.indices;
+    arena_vector<Submesh>& submeshes = model.submeshes;
+    import_skeleton(scene, model.skeleton);
+    import_animations(scene, model.skeleton, model.animations, model.animation_poses);
+    std::vector<SceneMesh> meshes;
+    collect_meshes(scene->mRootNode, scene, meshes);
+    u32 vertex_count = 0;
+    u32 index_count = 0;
+    for (const SceneMesh& scene_mesh : meshes) {
+        const aiMesh* mesh = scene_mesh.mesh;
+        Submesh& submesh = submeshes.emplace_back();
+        submesh.index_offset = index_count;
+        submesh.index_count = mesh->mNumFaces * 3;
+        submesh.vertex_offset = vertex_count;
+        submesh.vertex_count = mesh->mNumVertices;
+        submesh.material_slot = mesh->mMaterialIndex;
+        vertex_count += submesh.vertex_count;
+        index_count += submesh.index_count;
+    }
+    vertices.resize(vertex_count);
+    indices.resize(index_count);
+    const auto process_meshes = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Submesh& submesh = submeshes[i];
+            process_mesh(meshes[i], model.skeleton, std::span<Vertex>{vertices}.subspan(submesh.vertex_offset, submesh.vertex_count),
+                std::span<u32>{indices}.subspan(submesh.index_offset, submesh.index_count));
+        }
+    };
+    if (thread_pool) {
+        thread_pool->parallel_for(meshes.size(), 1, process_meshes);
+    } else {
+        process_meshes(0, meshes.size());
+    }
+}
+
+// A submesh run through the import pipeline on its own, so welding and
+// reordering never move vertices or triangles across submeshes. Submeshes
+// cook on worker threads, each allocating from its own arena.
+struct CookedSubmesh {
+    std::unique_ptr<Arena> arena;
+    arena_vector<Vertex> vertices;
+    // LOD 0 followed by the lower levels, relative to the submesh's vertices
+    arena_vector<u32> indices;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    WeldStats weld_stats;
+    VertexCacheStats stats_before;
+    VertexCacheStats stats_after;
+    u32 material_slot;
+
+    explicit CookedSubmesh(const Submesh& submesh);
+};
+
+// Room for the submesh, its LOD chain and the vector growth behind it, which
+// the arena never gets back, so it rarely has to chain a second block.
+// Arenas are sized in pushed bytes.
+CookedSubmesh::CookedSubmesh(const Submesh& submesh)
+    : arena(std::make_unique<Arena>((submesh.vertex_count * sizeof(Vertex) + submesh.index_count * sizeof(u32) * 3) * 2 + 1024)),
+      vertices(MAKE_ARENA_VECTOR(arena.get(), Vertex)), indices(MAKE_ARENA_VECTOR(arena.get(), u32)), weld_stats{}, stats_before{}, stats_after{},
+      material_slot(submesh.material_slot) {
+
+}
+
+static void cook_submesh(CookedSubmesh& submesh) {
+    submesh.weld_stats = weld_vertices(submesh.vertices, submesh.indices);
+    const u32 vertex_count = static_cast<u32>(submesh.vertices.size());
+    submesh.stats_before = analyze_vertex_cache(submesh.indices, vertex_count);
+    const std::vector<u32> clusters = optimize_vertex_cache(submesh.indices, vertex_count);
+    optimize_overdraw(submesh.indices, submesh.vertices, clusters);
+    submesh.meshlets = build_meshlets(submesh.indices, submesh.vertices);
+    optimize_vertex_fetch(submesh.vertices, submesh.indices);
+    submesh.stats_after = analyze_vertex_cache(submesh.indices, static_cast<u32>(submesh.vertices.size()));
+    generate_lods(submesh.vertices, submesh.indices, submesh.lods);
+}
+
+// Cursor over the text of a processed model
+struct ProcessedReader {
+    const char* current;
+    const char* end;
+
+    template <typename T>
+    T next() {
+        while (current < end && (*current == ' ' || *current == '\n' || *current == '\r')) {
+            current++;
+        }
+        T value{};
+        current = std::from_chars(current, end, value).ptr;
+        return value;
+    }
+};
+
+static void parse_processed(ProcessedReader reader, arena_vector<Vertex>& vertices, arena_vector<u32>& indices) {
+    const u32 vertices_count = reader.next<u32>();
+    vertices.clear();
+    vertices.reserve(vertices_count);
+    for (u32 i = 0; i < vertices_count; i++) {
+        Vertex vertex;
+        vertex.position = {reader.next<f32>(), reader.next<f32>(), reader.next<f32>()};
+        vertex.color = {reader.next<f32>(), reader.next<f32>(), reader.next<f32>()};
+        vertex.normal = {reader.next<f32>(), reader.next<f32>(), reader.next<f32>()};
+        vertex.uv = {reader.next<f32>(), reader.next<f32>()};
+        vertices.push_back(vertex);
+    }
+    const u32 indices_count = reader.next<u32>();
+    indices.clear();
+    indices.reserve(indices_count);
+    for (u32 i = 0; i < indices_count; i++) {
+        indices.push_back(reader.next<u32>());
+    }
+}
+
+// Header of the text .processed files that preceded MeshFile. They are only
+// read to migrate them, a matching source key makes a re-import unnecessary.
+static constexpr u32 PROCESSED_MAGIC = 0x4D504753; // "SGPM"
+static constexpr u32 PROCESSED_IMPORTER_VERSION = 1;
+
+struct ProcessedHeader {
+    u32 magic;
+    u32 importer_version;
+    u64 source_key;
+};
+
+// Parses a legacy .processed file, returns false when it cannot be used
+static bool read_processed(Arena& temp_arena, const io::MappedFile& file, bool has_source, u64 source_key, engine::ThreadPool* thread_pool,
+    arena_vector<Vertex>& vertices, arena_vector<u32>& indices) {
+    ProcessedHeader header{};
+    const bool has_header = file.size() >= sizeof(ProcessedHeader) && std::memcmp(file.data(), &PROCESSED_MAGIC, sizeof(u32)) == 0;
+    if (has_header) {
+        std::memcpy(&header, file.data(), sizeof(header));
+    }
+    // Without the source there is nothing to validate against
+    if (has_source && (!has_header || header.importer_version != PROCESSED_IMPORTER_VERSION || header.source_key != source_key)) {
+        return false;
+    }
+    const size_t header_size = has_header ? sizeof(ProcessedHeader) : 0;
+    const byte* data = file.data() + header_size;
+    const size_t size = file.size() - header_size;
+    if (!engine::compression::is_block_stream(data, size)) {
+        // Processed files written before compression are plain text
+        const char* text = reinterpret_cast<const char*>(data);
+        parse_processed(ProcessedReader{text, text + size}, vertices, indices);
+        return !indices.empty();
+    }
+    arena_vector<byte> contents = MAKE_ARENA_VECTOR(&temp_arena, byte);
+    contents.resize(engine::compression::get_decompressed_size(data, size));
+    if (!engine::compression::decompress_blocks(data, size, contents.data(), contents.size(), thread_pool)) {
+        return false;
+    }
+    const char* text = reinterpret_cast<const char*>(contents.data());
+    parse_processed(ProcessedReader{text, text + contents.size()}, vertices, indices);
+    return !indices.empty();
+}
+
+bool is_model_file_present(std::string_view path, io::AssetIndex* asset_index) {
+    // Files written since the index was built are only on disk
+    return (asset_index && asset_index->contains(path)) || std::filesystem::exists(path);
+}
+
+std::string find_model_source(std::string_view base_model_path, io::AssetIndex* asset_index) {
+#if defined(DIST) && !defined(ASSET_COOKER)
+    // Shipped content is cooked offline by the AssetCooker, sources are never
+    // hashed or imported at startup
+    return {};
+#else
+    std::string source_path;
+    for (const char* extension : MODEL_SOURCE_EXTENSIONS) {
+        source_path.assign(base_model_path).append(extension);
+        if (is_model_file_present(source_path, asset_index)) {
+            return source_path;
+        }
     }
+    return {};
+#endif
 }
 
-void VertexIndexInfo::load_model(Arena& temp_arena, const arena_string& base_model_path, u32 import_flags) {
-    arena_string obj_path = base_model_path + ".obj";
-    arena_string model_path = base_model_path + ".processed";
-    bool has_been_processed = std::filesystem::exists(model_path);
-    if (std::filesystem::exists(obj_path) && !has_been_processed) {
+u64 get_model_source_key(std::string_view source_path, u32 import_flags, io::AssetIndex* asset_index) {
+    // The asset index already hashed the source and only hashes it again when
+    // it was edited since, otherwise hash it here
+    const std::string path{source_path};
+    u64 source_key;
+    const std::optional<io::AssetEntry> entry = asset_index ? asset_index->refresh(path) : std::nullopt;
+    if (entry) {
+        source_key = entry->content_hash;
+    } else {
+        const io::MappedFile source{path.c_str(), io::MapHint::SEQUENTIAL};
+        source_key = engine::hash::xxh64(source.data(), source.size());
+    }
+    source_key = engine::hash::combine(source_key, import_flags);
+    // Edits to the buffers and images a source references re-cook it too
+    for (const std::string& dependency : get_model_dependencies(path)) {
+        const std::optional<io::AssetEntry> entry = asset_index ? asset_index->refresh(dependency) : std::nullopt;
+        if (entry) {
+            source_key = engine::hash::combine(source_key, entry->content_hash);
+        } else {
+            const io::MappedFile file{dependency.c_str(), io::MapHint::SEQUENTIAL};
+            source_key = engine::hash::combine(source_key, engine::hash::xxh64(file.data(), file.size()));
+        }
+    }
+    return source_key;
+}
+
+bool VertexIndexInfo::load_model(Arena& temp_arena, const arena_string& base_model_path, u32 import_flags, io::AssetIndex* asset_index, engine::ThreadPool* thread_pool) {
+    const std::string found_source = find_model_source(base_model_path, asset_index);
+    arena_string source_path{found_source.data(), found_source.size(), base_model_path.get_allocator()};
+    arena_string mesh_path = base_model_path + ".mesh";
+    arena_string processed_path = base_model_path + ".processed";
+    const auto file_exists = [asset_index](const arena_string& path) {
+        return is_model_file_present(path, asset_index);
+    };
+    const bool has_source = !source_path.empty();
+    const u64 source_key = has_source ? get_model_source_key(source_path, import_flags, asset_index) : 0;
+
+    // Warm path, the cooked mesh is mapped and copied without any parsing
+    if (file_exists(mesh_path)) {
+        const MeshFile mesh{mesh_path.c_str()};
+        if (mesh.is_valid() && (!has_source || mesh.is_cooked_from(source_key))) {
+            vertices.assign(mesh.vertices().begin(), mesh.vertices().end());
+            indices.assign(mesh.indices().begin(), mesh.indices().end());
+            submeshes.assign(mesh.submeshes().begin(), mesh.submeshes().end());
+            bounds = mesh.bounds();
+            skeleton.assign(mesh.skeleton().begin(), mesh.skeleton().end());
+            animations.assign(mesh.animations().begin(), mesh.animations().end());
+            animation_poses.assign(mesh.animation_poses().begin(), mesh.animation_poses().end());
+            return true;
+        }
+    }
+
+    vertices.clear();
+    indices.clear();
+    submeshes.clear();
+    skeleton.clear();
+    animations.clear();
+    animation_poses.clear();
+    bool loaded = false;
+    if (file_exists(processed_path)) {
+        const io::MappedFile processed_file{processed_path.c_str(), io::MapHint::SEQUENTIAL};
+        loaded = read_processed(temp_arena, processed_file, has_source, source_key, thread_pool, vertices, indices);
+        if (loaded) {
+            ENGINE_LOG_INFO("Migrating {} to {}", processed_path.c_str(), mesh_path.c_str())
+            // Processed files hold the already flattened model
+            Submesh submesh{};
+            submesh.index_count = static_cast<u32>(indices.size());
+            submesh.vertex_count = static_cast<u32>(vertices.size());
+            submeshes.push_back(submesh);
+        }
+    }
+    const bool is_obj = source_path.ends_with(".obj");
+    if (!loaded && has_source && is_obj && can_parse_obj(import_flags)) {
+        const io::MappedFile source{source_path.c_str(), io::MapHint::SEQUENTIAL};
+        loaded = parse_obj(std::span<const byte>{source.data(), source.size()}, import_flags, thread_pool, vertices, indices, submeshes);
+    }
+    // Assimp handles the other formats, the import flags the OBJ parser does
+    // not and the OBJ files it rejects. Only triangles are converted, so
+    // polygons are always split first.
+    if (!loaded && has_source) {
         Assimp::Importer importer;
 
-        const aiScene* scene = importer.ReadFile(obj_path.c_str(), import_flags);
-        ENGINE_ASSERT(scene, "Failed to load model")
+        const aiScene* scene = importer.ReadFile(source_path.c_str(), import_flags | aiProcess_Triangulate);
+        if (scene == nullptr) {
+            ENGINE_LOG_ERROR("Failed to import {}: {}", source_path.c_str(), importer.GetErrorString())
+            return false;
+        }
         vertices.clear();
         indices.clear();
     
-        process_node(scene->mRootNode, scene, vertices, indices);
-        vertices.resize(vertices.size());
-        indices.resize(indices.size());
-        
-        // Write out custom format
-        std::ofstream file{model_path.c_str()};
-        file << vertices.size() << "\n";
-        for (auto& [position, color, normal, uv] : vertices) {
-            file << position.x << ' ' << position.y << ' ' << position.z << "\n";
-            file << color.r << ' ' << color.g << ' ' << color.b << "\n";
-            file << normal.x << ' ' << normal.y << ' ' << normal.z << "\n";
-            file << uv.x << ' ' << uv.y << "\n";
-        }
-        file << indices.size() << "\n";
-        for (auto& index : indices) {
-            file << index << "\n";
-        }
-    } else if (has_been_processed) {
-        std::ifstream file{model_path.c_str(), std::ios::binary};
-        file.seekg(0, std::ios::beg);
-        u32 vertices_count;
-        file >> vertices_count;
-        vertices.resize(vertices_count);
-        for (u32 i = 0; i < vertices_count; i++) {
-            Vertex vertex;
-            file >> vertex.position.x >> vertex.position.y >> vertex.position.z;
-            file >> vertex.color.r >> vertex.color.g >> vertex.color.b;
-            file >> vertex.normal.x >> vertex.normal.y >> vertex.normal.z;
-            file >> vertex.uv.x >> vertex.uv.y;
-            vertices.push_back(vertex);
-        }
-        u32 indices_count;
-        file >> indices_count;
-        indices.resize(indices_count);
-        for (u32 i = 0; i < indices_count; i++) {
-            u32 index;
-            file >> index;
-            indices.push_back(index);
+        process_scene(scene, thread_pool, *this);
+        loaded = true;
+        if (!skeleton.empty()) {
+            ENGINE_LOG_INFO("Imported {} with {} joints and {} animations", base_model_path.c_str(), skeleton.size(), animations.size())
+        }
+    }
+    if (!loaded || submeshes.empty()) {
+#if defined(DIST) && !defined(ASSET_COOKER)
+        ENGINE_LOG_ERROR("No cooked mesh for {}, run the AssetCooker", base_model_path.c_str())
+#else
+        if (!has_source) {
+            ENGINE_LOG_ERROR("No cooked mesh or model source for {}", base_model_path.c_str())
+        } else {
+            ENGINE_LOG_ERROR("{} has no triangles to cook", source_path.c_str())
+        }
+#endif
+        return false;
+    }
+
+    std::vector<CookedSubmesh> cooked;
+    cooked.reserve(submeshes.size());
+    for (const Submesh& submesh : submeshes) {
+        cooked.emplace_back(submesh);
+    }
+    const auto cook_submeshes = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto first_vertex = vertices.begin() + submeshes[i].vertex_offset;
+            const auto first_index = indices.begin() + submeshes[i].index_offset;
+            cooked[i].vertices.assign(first_vertex, first_vertex + submeshes[i].vertex_count);
+            cooked[i].indices.assign(first_index, first_index + submeshes[i].index_count);
+            cook_submesh(cooked[i]);
         }
+    };
+    if (thread_pool) {
+        thread_pool->parallel_for(cooked.size(), 1, cook_submeshes);
+    } else {
+        cook_submeshes(0, cooked.size());
     }
+
+    // Indices are laid out level by level so every level of the whole model
+    // stays one contiguous range, LOD 0 of all submeshes first
+    u32 lod_count = 0;
+    for (const CookedSubmesh& submesh : cooked) {
+        lod_count = glm::max(lod_count, static_cast<u32>(submesh.lods.size()));
+    }
+    vertices.clear();
+    indices.clear();
+    submeshes.clear();
+    std::vector<MeshLod> lods(lod_count, MeshLod{});
+    std::vector<MeshLod> submesh_lods(cooked.size() * lod_count);
+    for (u32 lod = 0; lod < lod_count; lod++) {
+        lods[lod].index_offset = static_cast<u32>(indices.size());
+        for (u32 i = 0; i < cooked.size(); i++) {
+            const CookedSubmesh& submesh = cooked[i];
+            const MeshLod& level = submesh.lods[glm::min(lod, static_cast<u32>(submesh.lods.size()) - 1)];
+            submesh_lods[i * lod_count + lod] = MeshLod{static_cast<u32>(indices.size()), level.index_count, level.error, 0};
+            const auto first_index = submesh.indices.begin() + level.index_offset;
+            indices.insert(indices.end(), first_index, first_index + level.index_count);
+            lods[lod].error = glm::max(lods[lod].error, level.error);
+        }
+        lods[lod].index_count = static_cast<u32>(indices.size()) - lods[lod].index_offset;
+    }
+
+    std::vector<Meshlet> meshlets;
+    WeldStats weld_stats{};
+    u32 shaded_before = 0;
+    u32 shaded_after = 0;
+    u32 max_submesh_vertices = 0;
+    for (u32 i = 0; i < cooked.size(); i++) {
+        const CookedSubmesh& cooked_submesh = cooked[i];
+        Submesh& submesh = submeshes.emplace_back();
+        submesh.index_offset = submesh_lods[i * lod_count].index_offset;
+        submesh.index_count = submesh_lods[i * lod_count].index_count;
+        submesh.vertex_offset = static_cast<u32>(vertices.size());
+        submesh.vertex_count = static_cast<u32>(cooked_submesh.vertices.size());
+        submesh.bounds = compute_bounding_volume(cooked_submesh.vertices);
+        submesh.material_slot = cooked_submesh.material_slot;
+        vertices.insert(vertices.end(), cooked_submesh.vertices.begin(), cooked_submesh.vertices.end());
+        for (Meshlet meshlet : cooked_submesh.meshlets) {
+            meshlet.index_offset += submesh.index_offset;
+            meshlet.submesh = i;
+            meshlets.push_back(meshlet);
+        }
+        weld_stats.vertices_before += cooked_submesh.weld_stats.vertices_before;
+        weld_stats.vertices_after += cooked_submesh.weld_stats.vertices_after;
+        shaded_before += cooked_submesh.stats_before.shaded_vertices;
+        shaded_after += cooked_submesh.stats_after.shaded_vertices;
+        max_submesh_vertices = glm::max(max_submesh_vertices, submesh.vertex_count);
+    }
+    const f32 triangle_count = static_cast<f32>(lods[0].index_count / 3);
+    ENGINE_LOG_INFO("Welded {}: {} -> {} vertices ({:.1f}% fewer)", base_model_path.c_str(), weld_stats.vertices_before, weld_stats.vertices_after,
+        weld_stats.get_reduction() * 100.0f)
+    ENGINE_LOG_INFO("Optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", base_model_path.c_str(), shaded_before / triangle_count,
+        shaded_after / triangle_count, shaded_before / static_cast<f32>(weld_stats.vertices_after), shaded_after / static_cast<f32>(vertices.size()))
+    ENGINE_LOG_INFO("Split {} into {} submeshes and {} meshlets", base_model_path.c_str(), submeshes.size(), meshlets.size())
+    for (u32 lod = 1; lod < lods.size(); lod++) {
+        ENGINE_LOG_INFO("LOD {} of {}: {} triangles, error {:.5f}", lod, base_model_path.c_str(), lods[lod].index_count / 3, lods[lod].error)
+    }
+
+    MeshFileWriter writer{source_key};
+    writer.set_mesh(vertices, indices, submeshes);
+    writer.set_lods(lods);
+    writer.add_section(MeshSectionType::SUBMESH_LODS, std::span<const MeshLod>{submesh_lods});
+    writer.add_section(MeshSectionType::MESHLETS, std::span<const Meshlet>{meshlets});
+    if (!skeleton.empty()) {
+        writer.add_section(MeshSectionType::SKELETON, std::span<const SkeletonJoint>{skeleton});
+        writer.add_section(MeshSectionType::ANIMATION_CLIPS, std::span<const AnimationClip>{animations});
+        writer.add_section(MeshSectionType::ANIMATION_POSES, std::span<const JointPose>{animation_poses});
+    }
+    bounds = writer.bounds();
+    // GPU copies in the compact layout, 20 (28 skinned) instead of 52 bytes per vertex
+    const glm::vec3 bounds_min{writer.header().bounds_min[0], writer.header().bounds_min[1], writer.header().bounds_min[2]};
+    const glm::vec3 bounds_max{writer.header().bounds_max[0], writer.header().bounds_max[1], writer.header().bounds_max[2]};
+    // Indices only reach the largest submesh, so a model can use 16-bit indices
+    // even with more vertices than they address in total
+    const IndexFormat index_format = get_index_format(max_submesh_vertices);
+    arena_vector<byte> packed_vertices = MAKE_ARENA_VECTOR(&temp_arena, byte);
+    arena_vector<byte> packed_indices = MAKE_ARENA_VECTOR(&temp_arena, byte);
+    const VertexLayout layout = skeleton.empty() ? COMPACT_VERTEX_LAYOUT : COMPACT_SKINNED_VERTEX_LAYOUT;
+    pack_vertices(layout, vertices, bounds_min, bounds_max, packed_vertices);
+    pack_indices(index_format, indices, packed_indices);
+    writer.set_packed_mesh(layout, packed_vertices, index_format, packed_indices);
+    if (writer.write(mesh_path.c_str()) && asset_index) {
+        asset_index->refresh(mesh_path.c_str());
+    }
+    // Callers get LOD 0, the lower levels are only used from the mesh file
+    indices.resize(lods[0].index_count);
+    return true;
+}
+
+void load_models(std::span<const ModelImport> imports, engine::ThreadPool& thread_pool, u32 import_flags, io::AssetIndex* asset_index) {
+    thread_pool.parallel_for(imports.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Arena temp_arena{MODEL_IMPORT_ARENA_SIZE};
+            const arena_string base_path{imports[i].base_path, STLArenaAllocator<char>{&temp_arena}};
+            imports[i].model->load_model(temp_arena, base_path, import_flags, asset_index, &thread_pool);
+        }
+    });
 }
@@ -1,32 +1,114 @@
 ﻿#pragma once
 
+#include <bit>
+#include <span>
+#include <string_view>
 #include <vulkan/vulkan_core.h>
 #include <glm/glm.hpp>
+#include <glm/ext/vector_uint4_sized.hpp>
 
 #include "common.h"
+#include "Bounds.h"
+#include "Skeleton.h"
+
+namespace engine {
+class ThreadPool;
+}
+
+namespace io {
+class AssetIndex;
+}
 
 struct Vertex {
     glm::vec3 position;
     glm::vec3 color;
     glm::vec3 normal;
     glm::vec2 uv;
+    // Up to four skeleton joints, heaviest first, with unorm8 weights summing
+    // to 255. All zero for vertices of static meshes.
+    glm::u8vec4 joints{0};
+    glm::u8vec4 weights{0};
 
     static VkVertexInputBindingDescription get_binding_descriptions();
-    static std::array<VkVertexInputAttributeDescription, 4> get_attribute_descriptions();
+    static std::array<VkVertexInputAttributeDescription, 6> get_attribute_descriptions();
 
     bool operator==(const Vertex& other) const {
-        return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
+        return position == other.position && color == other.color && normal == other.normal && uv == other.uv && joints == other.joints
+            && weights == other.weights;
     }
 };
 
+// Independently drawable range of a mesh, one per imported mesh. Its indices
+// are relative to vertex_offset, which is the base vertex of its draws.
+struct Submesh {
+    u32 index_offset;
+    u32 index_count;
+    u32 vertex_offset;
+    u32 vertex_count;
+    // Over the submesh's vertex range
+    BoundingVolume bounds;
+    u32 material_slot;
+    u32 reserved;
+};
+
 struct VertexIndexInfo {
     VertexIndexInfo(Arena& model_arena);
     arena_vector<Vertex> vertices;
+    // LOD 0 of every submesh, each relative to its base vertex
     arena_vector<uint32_t> indices;
+    arena_vector<Submesh> submeshes;
+    BoundingVolume bounds{};
+    // Empty for static models, see Skeleton.h
+    arena_vector<SkeletonJoint> skeleton;
+    arena_vector<AnimationClip> animations;
+    arena_vector<JointPose> animation_poses;
 
-    void load_model(Arena& temp_arena, const arena_string& base_model_path, u32 import_flags = 0);
+    // Loads <base>.mesh, cooking it from the model source next to it or
+    // migrating a legacy <base>.processed when it is missing or stale. With an asset index the
+    // existence checks are index lookups first, the source is refreshed in it
+    // and a newly cooked mesh added. Returns false when there is neither a
+    // usable cooked mesh nor a source that imports.
+    bool load_model(Arena& temp_arena, const arena_string& base_model_path, u32 import_flags = 0, io::AssetIndex* asset_index = nullptr,
+        engine::ThreadPool* thread_pool = nullptr);
 };
 
+// Model sources load_model cooks from, in the order they are looked for.
+// Everything but OBJ goes through assimp, which also brings skeletons.
+static constexpr const char* MODEL_SOURCE_EXTENSIONS[] = {".obj", ".gltf", ".glb", ".dae"};
+
+bool is_model_source(std::string_view path);
+
+// Whether a model file is in the asset index or, written since it was built,
+// on disk
+bool is_model_file_present(std::string_view path, io::AssetIndex* asset_index = nullptr);
+
+// Source next to base_model_path that load_model cooks from, empty when there
+// is none. Shipped builds never look for sources.
+std::string find_model_source(std::string_view base_model_path, io::AssetIndex* asset_index = nullptr);
+
+// Hash of a source, the files it depends on and the import flags. A cooked
+// mesh stores the key of its source and is stale when it no longer matches.
+u64 get_model_source_key(std::string_view source_path, u32 import_flags = 0, io::AssetIndex* asset_index = nullptr);
+
+// Files a model source reads besides itself, the external buffers and images
+// a .gltf references by URI, as paths next to the source. Their contents are
+// part of the cooked mesh's source key.
+std::vector<std::string> get_model_dependencies(std::string_view source_path);
+
+// First block of the arena a model imports into. Larger models chain more
+// blocks, the processing pipeline allocates in proportion to the triangles.
+static constexpr size_t MODEL_IMPORT_ARENA_SIZE = 16 << 20;
+
+struct ModelImport {
+    // Has to live in an arena no other model of the batch allocates from
+    VertexIndexInfo* model;
+    const char* base_path;
+};
+
+// Loads the models concurrently, one job each. The import of every model
+// spreads over the pool as well, so a batch of one still uses every core.
+void load_models(std::span<const ModelImport> imports, engine::ThreadPool& thread_pool, u32 import_flags = 0, io::AssetIndex* asset_index = nullptr);
+
 template <typename T>
 void hash_combine(std::size_t& seed, const T& value) {
     seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
@@ -51,6 +133,9 @@ struct hash<Vertex> {
 
         hash_combine(seed, vertex.uv.x);
         hash_combine(seed, vertex.uv.y);
+
+        hash_combine(seed, std::bit_cast<u32>(vertex.joints));
+        hash_combine(seed, std::bit_cast<u32>(vertex.weights));
         return seed;
     }
 };
@@ -0,0 +1,248 @@
+﻿#include "VertexLayout.h"
+
+#include <cstring>
+#include <limits>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+
+struct AttributeFormat {
+    VkFormat format;
+    u32 size;
+};
+
+AttributeFormat get_position_format(PositionFormat format) {
+    switch (format) {
+        case PositionFormat::FLOAT16:
+            return {VK_FORMAT_R16G16B16A16_SFLOAT, 8};
+        case PositionFormat::UNORM16:
+            return {VK_FORMAT_R16G16B16A16_UNORM, 8};
+        case PositionFormat::FLOAT32:
+            break;
+    }
+    return {VK_FORMAT_R32G32B32_SFLOAT, 12};
+}
+
+AttributeFormat get_color_format(ColorFormat format) {
+    if (format == ColorFormat::UNORM8) {
+        return {VK_FORMAT_R8G8B8A8_UNORM, 4};
+    }
+    return {VK_FORMAT_R32G32B32_SFLOAT, 12};
+}
+
+AttributeFormat get_normal_format(NormalFormat format) {
+    if (format == NormalFormat::OCTAHEDRAL_SNORM16) {
+        return {VK_FORMAT_R16G16_SNORM, 4};
+    }
+    return {VK_FORMAT_R32G32B32_SFLOAT, 12};
+}
+
+AttributeFormat get_uv_format(UVFormat format) {
+    if (format == UVFormat::FLOAT16) {
+        return {VK_FORMAT_R16G16_SFLOAT, 4};
+    }
+    return {VK_FORMAT_R32G32_SFLOAT, 8};
+}
+
+// Formats in attribute location order, the skin ones are unused for NONE
+std::array<AttributeFormat, MAX_VERTEX_ATTRIBUTES> get_attribute_formats(const VertexLayout& layout) {
+    return {get_position_format(layout.position), get_color_format(layout.color), get_normal_format(layout.normal), get_uv_format(layout.uv),
+        AttributeFormat{VK_FORMAT_R8G8B8A8_UINT, 4}, AttributeFormat{VK_FORMAT_R8G8B8A8_UNORM, 4}};
+}
+
+template <typename T>
+void write_value(byte*& destination, const T& value) {
+    std::memcpy(destination, &value, sizeof(T));
+    destination += sizeof(T);
+}
+
+template <typename T>
+T read_value(const byte*& source) {
+    T value;
+    std::memcpy(&value, source, sizeof(T));
+    source += sizeof(T);
+    return value;
+}
+
+glm::vec3 get_quantization_scale(const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+    const glm::vec3 extent = bounds_max - bounds_min;
+    // Flat axes all quantize to 0
+    return glm::vec3{
+        extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+    };
+}
+
+}
+
+u32 VertexLayout::get_stride() const {
+    const std::array<AttributeFormat, MAX_VERTEX_ATTRIBUTES> formats = get_attribute_formats(*this);
+    u32 stride = 0;
+    for (u32 location = 0; location < get_attribute_count(); location++) {
+        stride += formats[location].size;
+    }
+    return stride;
+}
+
+u32 VertexLayout::get_attribute_count() const {
+    return skin == SkinFormat::NONE ? MAX_VERTEX_ATTRIBUTES - 2 : MAX_VERTEX_ATTRIBUTES;
+}
+
+VkVertexInputBindingDescription VertexLayout::get_binding_descriptions() const {
+    VkVertexInputBindingDescription binding_description{};
+    binding_description.binding = 0;
+    binding_description.stride = get_stride();
+    binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return binding_description;
+}
+
+std::array<VkVertexInputAttributeDescription, MAX_VERTEX_ATTRIBUTES> VertexLayout::get_attribute_descriptions() const {
+    std::array<VkVertexInputAttributeDescription, MAX_VERTEX_ATTRIBUTES> descriptions{};
+    const std::array<AttributeFormat, MAX_VERTEX_ATTRIBUTES> formats = get_attribute_formats(*this);
+    u32 offset = 0;
+    for (u32 location = 0; location < get_attribute_count(); location++) {
+        descriptions[location].binding = 0;
+        descriptions[location].location = location;
+        descriptions[location].format = formats[location].format;
+        descriptions[location].offset = offset;
+        offset += formats[location].size;
+    }
+    return descriptions;
+}
+
+glm::vec2 encode_octahedral(const glm::vec3& normal) {
+    const f32 length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+    if (length == 0.0f) {
+        return glm::vec2{0.0f};
+    }
+    glm::vec2 encoded = glm::vec2{normal.x, normal.y} / length;
+    if (normal.z < 0.0f) {
+        // Fold the lower hemisphere over the diagonals
+        const glm::vec2 sign{encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f};
+        encoded = (1.0f - glm::abs(glm::vec2{encoded.y, encoded.x})) * sign;
+    }
+    return encoded;
+}
+
+glm::vec3 decode_octahedral(const glm::vec2& encoded) {
+    glm::vec3 normal{encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y)};
+    const f32 fold = glm::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    const f32 length = glm::length(normal);
+    return length > 0.0f ? normal / length : normal;
+}
+
+void pack_vertices(const VertexLayout& layout, std::span<const Vertex> vertices, const glm::vec3& bounds_min, const glm::vec3& bounds_max,
+    arena_vector<byte>& packed) {
+    const u32 stride = layout.get_stride();
+    const glm::vec3 scale = get_quantization_scale(bounds_min, bounds_max);
+    packed.resize(vertices.size() * stride);
+    byte* destination = packed.data();
+    for (const Vertex& vertex : vertices) {
+        switch (layout.position) {
+            case PositionFormat::FLOAT32:
+                write_value(destination, vertex.position);
+                break;
+            case PositionFormat::FLOAT16:
+                write_value(destination, glm::packHalf4x16(glm::vec4{vertex.position, 1.0f}));
+                break;
+            case PositionFormat::UNORM16:
+                write_value(destination, glm::packUnorm4x16(glm::vec4{(vertex.position - bounds_min) * scale, 0.0f}));
+                break;
+        }
+        if (layout.color == ColorFormat::UNORM8) {
+            write_value(destination, glm::packUnorm4x8(glm::vec4{vertex.color, 1.0f}));
+        } else {
+            write_value(destination, vertex.color);
+        }
+        if (layout.normal == NormalFormat::OCTAHEDRAL_SNORM16) {
+            write_value(destination, glm::packSnorm2x16(encode_octahedral(vertex.normal)));
+        } else {
+            write_value(destination, vertex.normal);
+        }
+        if (layout.uv == UVFormat::FLOAT16) {
+            write_value(destination, glm::packHalf2x16(vertex.uv));
+        } else {
+            write_value(destination, vertex.uv);
+        }
+        if (layout.skin == SkinFormat::UINT8) {
+            write_value(destination, vertex.joints);
+            write_value(destination, vertex.weights);
+        }
+    }
+}
+
+Vertex unpack_vertex(const VertexLayout& layout, const byte* packed, const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+    Vertex vertex;
+    switch (layout.position) {
+        case PositionFormat::FLOAT32:
+            vertex.position = read_value<glm::vec3>(packed);
+            break;
+        case PositionFormat::FLOAT16:
+            vertex.position = glm::vec3{glm::unpackHalf4x16(read_value<glm::uint64>(packed))};
+            break;
+        case PositionFormat::UNORM16:
+            vertex.position = bounds_min + glm::vec3{glm::unpackUnorm4x16(read_value<glm::uint64>(packed))} * (bounds_max - bounds_min);
+            break;
+    }
+    if (layout.color == ColorFormat::UNORM8) {
+        vertex.color = glm::vec3{glm::unpackUnorm4x8(read_value<glm::uint32>(packed))};
+    } else {
+        vertex.color = read_value<glm::vec3>(packed);
+    }
+    if (layout.normal == NormalFormat::OCTAHEDRAL_SNORM16) {
+        vertex.normal = decode_octahedral(glm::unpackSnorm2x16(read_value<glm::uint32>(packed)));
+    } else {
+        vertex.normal = read_value<glm::vec3>(packed);
+    }
+    if (layout.uv == UVFormat::FLOAT16) {
+        vertex.uv = glm::unpackHalf2x16(read_value<glm::uint32>(packed));
+    } else {
+        vertex.uv = read_value<glm::vec2>(packed);
+    }
+    if (layout.skin == SkinFormat::UINT8) {
+        vertex.joints = read_value<glm::u8vec4>(packed);
+        vertex.weights = read_value<glm::u8vec4>(packed);
+    }
+    return vertex;
+}
+
+glm::mat4 get_position_dequantization(const VertexLayout& layout, const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+    if (layout.position != PositionFormat::UNORM16) {
+        return glm::mat4{1.0f};
+    }
+    glm::mat4 dequantization{1.0f};
+    dequantization[0][0] = bounds_max.x - bounds_min.x;
+    dequantization[1][1] = bounds_max.y - bounds_min.y;
+    dequantization[2][2] = bounds_max.z - bounds_min.z;
+    dequantization[3] = glm::vec4{bounds_min, 1.0f};
+    return dequantization;
+}
+
+IndexFormat get_index_format(u32 vertex_count) {
+    // 0xFFFF is left free, it is the primitive restart index of UINT16
+    return vertex_count <= std::numeric_limits<u16>::max() ? IndexFormat::UINT16 : IndexFormat::UINT32;
+}
+
+u32 get_index_size(IndexFormat format) {
+    return format == IndexFormat::UINT16 ? sizeof(u16) : sizeof(u32);
+}
+
+VkIndexType get_index_type(IndexFormat format) {
+    return format == IndexFormat::UINT16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+void pack_indices(IndexFormat format, std::span<const u32> indices, arena_vector<byte>& packed) {
+    packed.resize(indices.size_bytes() / sizeof(u32) * get_index_size(format));
+    if (format == IndexFormat::UINT32) {
+        std::memcpy(packed.data(), indices.data(), indices.size_bytes());
+        return;
+    }
+    byte* destination = packed.data();
+    for (const u32 index : indices) {
+        ENGINE_ASSERT(index < std::numeric_limits<u16>::max(), "Index does not fit into 16 bits")
+        write_value(destination, static_cast<u16>(index));
+    }
+}
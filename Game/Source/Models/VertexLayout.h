@@ -0,0 +1,101 @@
+﻿#pragma once
+
+#include <array>
+#include <span>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "Vertex.h"
+
+// Storage formats of the vertex attributes on the GPU. Every attribute takes a
+// multiple of four bytes so the ones after it stay aligned.
+enum class PositionFormat : u8 {
+    FLOAT32,
+    // Four halfs, the fourth is 1
+    FLOAT16,
+    // Four unorm16 relative to the mesh bounds, see get_position_dequantization
+    UNORM16
+};
+
+enum class NormalFormat : u8 {
+    FLOAT32,
+    // Octahedral mapping in two snorm16, the vertex shader decodes it
+    OCTAHEDRAL_SNORM16
+};
+
+enum class ColorFormat : u8 {
+    FLOAT32,
+    // rgba8 unorm, alpha is 1
+    UNORM8
+};
+
+enum class UVFormat : u8 {
+    FLOAT32,
+    FLOAT16
+};
+
+enum class SkinFormat : u8 {
+    // Static mesh, the joints and weights are not stored
+    NONE,
+    // Four uint8 joint indices followed by four unorm8 weights
+    UINT8
+};
+
+enum class IndexFormat : u8 {
+    UINT32,
+    UINT16
+};
+
+// Attributes of a skinned layout, static ones leave out the last two
+static constexpr u32 MAX_VERTEX_ATTRIBUTES = 6;
+
+// Vertex layout a mesh is packed to for the GPU. The attributes keep the
+// locations of Vertex (position, color, normal, uv, joints, weights) in that
+// order.
+struct VertexLayout {
+    PositionFormat position;
+    NormalFormat normal;
+    ColorFormat color;
+    UVFormat uv;
+    SkinFormat skin;
+    u8 reserved[3];
+
+    [[nodiscard]] u32 get_stride() const;
+    [[nodiscard]] u32 get_attribute_count() const;
+    [[nodiscard]] VkVertexInputBindingDescription get_binding_descriptions() const;
+    // Only the first get_attribute_count() are used
+    [[nodiscard]] std::array<VkVertexInputAttributeDescription, MAX_VERTEX_ATTRIBUTES> get_attribute_descriptions() const;
+
+    bool operator==(const VertexLayout& other) const = default;
+};
+
+static_assert(sizeof(VertexLayout) == 8, "Vertex layouts are written to mesh files as is");
+
+// Same data and size as Vertex
+static constexpr VertexLayout FULL_VERTEX_LAYOUT{PositionFormat::FLOAT32, NormalFormat::FLOAT32, ColorFormat::FLOAT32, UVFormat::FLOAT32, SkinFormat::UINT8, {}};
+// 20 bytes, positions are quantized to 1/65535 of the mesh bounds
+static constexpr VertexLayout COMPACT_VERTEX_LAYOUT{PositionFormat::UNORM16, NormalFormat::OCTAHEDRAL_SNORM16, ColorFormat::UNORM8, UVFormat::FLOAT16,
+    SkinFormat::NONE, {}};
+// 28 bytes, COMPACT_VERTEX_LAYOUT with the joints and weights
+static constexpr VertexLayout COMPACT_SKINNED_VERTEX_LAYOUT{PositionFormat::UNORM16, NormalFormat::OCTAHEDRAL_SNORM16, ColorFormat::UNORM8,
+    UVFormat::FLOAT16, SkinFormat::UINT8, {}};
+
+// Packs vertices into layout. bounds are only used by UNORM16 positions and
+// have to contain every position.
+void pack_vertices(const VertexLayout& layout, std::span<const Vertex> vertices, const glm::vec3& bounds_min, const glm::vec3& bounds_max,
+    arena_vector<byte>& packed);
+// Unpacks a single vertex, for tools and validation
+Vertex unpack_vertex(const VertexLayout& layout, const byte* packed, const glm::vec3& bounds_min, const glm::vec3& bounds_max);
+// Maps a UNORM16 position in [0, 1] back to the mesh bounds. Folded into the
+// model matrix it costs the vertex shader nothing.
+glm::mat4 get_position_dequantization(const VertexLayout& layout, const glm::vec3& bounds_min, const glm::vec3& bounds_max);
+
+// Smallest index format that can address vertex_count vertices
+IndexFormat get_index_format(u32 vertex_count);
+u32 get_index_size(IndexFormat format);
+VkIndexType get_index_type(IndexFormat format);
+void pack_indices(IndexFormat format, std::span<const u32> indices, arena_vector<byte>& packed);
+
+glm::vec2 encode_octahedral(const glm::vec3& normal);
+glm::vec3 decode_octahedral(const glm::vec2& encoded);
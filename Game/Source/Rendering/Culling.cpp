@@ -0,0 +1,99 @@
+﻿#include "Culling.h"
+
+namespace engine {
+
+Frustum Frustum::from_matrix(const glm::mat4& matrix) {
+    // Gribb and Hartmann, each plane is a sum of rows of the matrix
+    const auto row = [&matrix](u32 index) {
+        return glm::vec4{matrix[0][index], matrix[1][index], matrix[2][index], matrix[3][index]};
+    };
+    Frustum frustum{};
+    frustum.planes[0] = row(3) + row(0);
+    frustum.planes[1] = row(3) - row(0);
+    frustum.planes[2] = row(3) + row(1);
+    frustum.planes[3] = row(3) - row(1);
+    frustum.planes[4] = row(2);
+    frustum.planes[5] = row(3) - row(2);
+    for (glm::vec4& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3{plane});
+    }
+    return frustum;
+}
+
+bool Frustum::intersects_sphere(const glm::vec3& center, f32 radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3{plane}, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_cone_backfacing(const glm::vec3& apex, const glm::vec3& axis, f32 cutoff, const glm::vec3& camera_position) {
+    const glm::vec3 view_direction = apex - camera_position;
+    const f32 length = glm::length(view_direction);
+    return length > 0.0f && glm::dot(view_direction, axis) >= cutoff * length;
+}
+
+void cull_meshlets(std::span<const Meshlet> meshlets, const Frustum& frustum, const glm::vec3& camera_position, std::vector<u32>& visible) {
+    visible.clear();
+    for (u32 i = 0; i < meshlets.size(); i++) {
+        const Meshlet& meshlet = meshlets[i];
+        const glm::vec3 center{meshlet.center[0], meshlet.center[1], meshlet.center[2]};
+        if (!frustum.intersects_sphere(center, meshlet.radius)) {
+            continue;
+        }
+        const glm::vec3 apex{meshlet.cone_apex[0], meshlet.cone_apex[1], meshlet.cone_apex[2]};
+        const glm::vec3 axis{meshlet.cone_axis[0], meshlet.cone_axis[1], meshlet.cone_axis[2]};
+        if (meshlet.cone_cutoff < 1.0f && is_cone_backfacing(apex, axis, meshlet.cone_cutoff, camera_position)) {
+            continue;
+        }
+        visible.push_back(i);
+    }
+}
+
+void cull_submeshes(std::span<const Submesh> submeshes, const Frustum& frustum, std::vector<u32>& visible) {
+    visible.clear();
+    for (u32 i = 0; i < submeshes.size(); i++) {
+        const BoundingVolume& bounds = submeshes[i].bounds;
+        const glm::vec3 center{bounds.sphere_center[0], bounds.sphere_center[1], bounds.sphere_center[2]};
+        if (frustum.intersects_sphere(center, bounds.sphere_radius)) {
+            visible.push_back(i);
+        }
+    }
+}
+
+void write_draw_commands(std::span<const Submesh> submeshes, std::span<const MeshLod> submesh_lods, std::span<const u32> visible, u32 lod,
+    std::vector<VkDrawIndexedIndirectCommand>& commands) {
+    const size_t lod_count = submeshes.empty() ? 0 : submesh_lods.size() / submeshes.size();
+    for (const u32 index : visible) {
+        const Submesh& submesh = submeshes[index];
+        VkDrawIndexedIndirectCommand command{};
+        command.instanceCount = 1;
+        command.vertexOffset = static_cast<i32>(submesh.vertex_offset);
+        if (lod_count == 0) {
+            command.firstIndex = submesh.index_offset;
+            command.indexCount = submesh.index_count;
+        } else {
+            const MeshLod& level = submesh_lods[index * lod_count + glm::min<size_t>(lod, lod_count - 1)];
+            command.firstIndex = level.index_offset;
+            command.indexCount = level.index_count;
+        }
+        commands.push_back(command);
+    }
+}
+
+void write_meshlet_draw_commands(std::span<const Meshlet> meshlets, std::span<const Submesh> submeshes, std::span<const u32> visible,
+    std::vector<VkDrawIndexedIndirectCommand>& commands) {
+    for (const u32 index : visible) {
+        const Meshlet& meshlet = meshlets[index];
+        VkDrawIndexedIndirectCommand command{};
+        command.indexCount = meshlet.triangle_count * 3;
+        command.instanceCount = 1;
+        command.firstIndex = meshlet.index_offset;
+        command.vertexOffset = meshlet.submesh < submeshes.size() ? static_cast<i32>(submeshes[meshlet.submesh].vertex_offset) : 0;
+        commands.push_back(command);
+    }
+}
+
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include "common.h"
+#include "Models/MeshFile.h"
+
+namespace engine {
+
+// Six planes facing into the view volume, xyz is the normal and w the distance
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Planes of a projection * view matrix with 0 to 1 depth. Passing
+    // projection * view * model gives them in the model's object space.
+    static Frustum from_matrix(const glm::mat4& matrix);
+    [[nodiscard]] bool intersects_sphere(const glm::vec3& center, f32 radius) const;
+};
+
+// True when every triangle within the cone faces away from camera_position
+bool is_cone_backfacing(const glm::vec3& apex, const glm::vec3& axis, f32 cutoff, const glm::vec3& camera_position);
+
+// Writes the indices of the meshlets that intersect the frustum and have at
+// least one triangle facing the camera. Frustum and camera position are in
+// the mesh's object space.
+void cull_meshlets(std::span<const Meshlet> meshlets, const Frustum& frustum, const glm::vec3& camera_position, std::vector<u32>& visible);
+
+// Writes the indices of the submeshes whose bounding spheres intersect the
+// frustum, which is in the mesh's object space
+void cull_submeshes(std::span<const Submesh> submeshes, const Frustum& frustum, std::vector<u32>& visible);
+
+// Appends one indexed indirect draw per visible submesh at the given level,
+// clamped to the chain's length, ready for vkCmdDrawIndexedIndirect.
+// submesh_lods is MeshFile's SUBMESH_LODS table, empty draws LOD 0.
+void write_draw_commands(std::span<const Submesh> submeshes, std::span<const MeshLod> submesh_lods, std::span<const u32> visible, u32 lod,
+    std::vector<VkDrawIndexedIndirectCommand>& commands);
+
+// Appends one indexed indirect draw per visible meshlet, a range of LOD 0
+// drawn with the base vertex of the meshlet's submesh
+void write_meshlet_draw_commands(std::span<const Meshlet> meshlets, std::span<const Submesh> submeshes, std::span<const u32> visible,
+    std::vector<VkDrawIndexedIndirectCommand>& commands);
+
+}
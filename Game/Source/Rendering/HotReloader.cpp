@@ -0,0 +1,181 @@
+﻿#include "HotReloader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "Hashing/Hash.h"
+#include "Memory/Arena.h"
+#include "Renderer.h"
+#include "ShaderCompiler.h"
+
+namespace engine {
+
+static std::string_view get_extension(std::string_view path) {
+    const size_t dot = path.find_last_of('.');
+    return dot == std::string_view::npos ? std::string_view{} : path.substr(dot + 1);
+}
+
+HotReloader::HotReloader(flecs::world& world, Renderer& renderer, AssetCache<MeshAsset>& meshes, ThreadPool& thread_pool, io::AssetIndex* asset_index,
+    std::span<const char* const> directories, u32 model_import_flags)
+    : m_world_(world), m_renderer_(renderer), m_meshes_(meshes), m_thread_pool_(thread_pool), m_asset_index_(asset_index), m_watcher_(directories), m_directories_(directories.begin(), directories.end()),
+      m_model_import_flags_(model_import_flags) {
+    m_system_ = world.system("Hot Reload")
+        .kind(flecs::OnLoad)
+        .run([this](flecs::iter&) {
+            update();
+        });
+    m_mesh_ref_query_ = world.query<const components::MeshRef>();
+    ENGINE_LOG_INFO("Hot reload watching {} directories ({})", directories.size(), m_watcher_.is_using_inotify() ? "inotify" : "polling")
+}
+
+HotReloader::~HotReloader() {
+    m_system_.destruct();
+    m_mesh_ref_query_.destruct();
+    m_thread_pool_.wait(m_in_flight_);
+}
+
+void HotReloader::update() {
+    m_changed_paths_.clear();
+    m_watcher_.poll(m_changed_paths_);
+    for (const std::string& path : m_changed_paths_) {
+        schedule_cook(path);
+    }
+    std::string dependent_source;
+    while (m_dependent_sources_.try_dequeue(dependent_source)) {
+        schedule_cook(dependent_source);
+    }
+
+    CookedAsset asset;
+    while (m_cooked_.try_dequeue(asset)) {
+        apply(asset);
+    }
+}
+
+void HotReloader::schedule_cook(const std::string& path) {
+    const std::string_view extension = get_extension(path);
+    if (!is_model_source(path) && extension != "spv" && !is_shader_source(path)) {
+        // Cooked outputs showing up are never referenced by a source
+        if (extension != "mesh" && extension != "tex" && extension != "processed" && extension != "tmp") {
+            find_dependent_sources(path);
+        }
+        return;
+    }
+    const u32 generation = ++m_generations_[path];
+    m_thread_pool_.submit([this, path, generation] {
+        CookedAsset asset;
+        asset.path = path;
+        asset.generation = generation;
+        if (is_model_source(asset.path)) {
+            cook_model(asset);
+        } else {
+            cook_shader(asset);
+        }
+        m_cooked_.enqueue(std::move(asset));
+    }, &m_in_flight_);
+}
+
+void HotReloader::find_dependent_sources(const std::string& path) {
+    // Reading every .gltf is left to the pool, edits of other files are rare
+    // but should not cost the frame anything
+    m_thread_pool_.submit([this, path] {
+        const std::string changed_path = std::filesystem::path{path}.lexically_normal().generic_string();
+        for (const std::string& directory : m_directories_) {
+            std::error_code error;
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error)) {
+                const std::string source_path = entry.path().generic_string();
+                if (!source_path.ends_with(".gltf")) {
+                    continue;
+                }
+                const std::vector<std::string> dependencies = get_model_dependencies(source_path);
+                if (std::ranges::find(dependencies, changed_path) != dependencies.end()) {
+                    m_dependent_sources_.enqueue(source_path);
+                }
+            }
+        }
+    }, &m_in_flight_);
+}
+
+void HotReloader::apply(CookedAsset& asset) {
+    if (!asset.succeeded || asset.generation != m_generations_[asset.path]) {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    if (is_model_source(asset.path)) {
+        // Meshes are addressed by their path without the extension
+        const std::string name = asset.path.substr(0, asset.path.rfind('.'));
+        if (!m_renderer_.meshes.contains(name)) {
+            return;
+        }
+        m_renderer_.upload_mesh(name, asset.mesh.file);
+        asset.mesh.file = MeshFile{};
+        // Culling and animation read the cached bounds and skeleton, entities
+        // got their Bounds from the old mesh
+        const AssetId id = get_asset_id(name);
+        const components::Bounds bounds = components::Bounds::from_volume(asset.mesh.bounds);
+        m_meshes_.replace(id, std::move(asset.mesh));
+        m_world_.defer_begin();
+        m_mesh_ref_query_.each([id, &bounds](flecs::entity entity, const components::MeshRef& mesh_ref) {
+            if (mesh_ref.id == id) {
+                entity.set(bounds);
+            }
+        });
+        m_world_.defer_end();
+    } else {
+        // Compiling a source writes its .spv, which then shows up as a change
+        // of its own. Identical binaries are skipped.
+        const std::string spirv_path = get_extension(asset.path) == "spv" ? asset.path : asset.path + ".spv";
+        const u64 hash = hash::xxh64(asset.spirv.data(), asset.spirv.size() * sizeof(u32));
+        u64& applied_hash = m_applied_shader_hashes_[spirv_path];
+        if (applied_hash == hash) {
+            return;
+        }
+        applied_hash = hash;
+        if (m_renderer_.reload_shader(spirv_path, std::move(asset.spirv)) == 0) {
+            return;
+        }
+    }
+    const auto elapsed = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start);
+    ENGINE_LOG_INFO("Hot reloaded {} in {:.2f}ms", asset.path, elapsed.count())
+}
+
+void HotReloader::cook_model(CookedAsset& asset) const {
+    Arena arena{MODEL_IMPORT_ARENA_SIZE};
+    VertexIndexInfo model{arena};
+    // load_model sees the new source hash and re-imports, which rewrites the
+    // cooked .mesh that is then uploaded. A broken or half-written source
+    // fails here and the uploaded mesh stays.
+    const std::string base_path = asset.path.substr(0, asset.path.rfind('.'));
+    if (!model.load_model(arena, arena_string{base_path.data(), base_path.size(), STLArenaAllocator<char>{&arena}}, m_model_import_flags_, m_asset_index_,
+            &m_thread_pool_)) {
+        ENGINE_LOG_WARN("Keeping the previous {}, it failed to import", asset.path)
+        return;
+    }
+    asset.succeeded = asset.mesh.file.open((base_path + ".mesh").c_str()) && asset.mesh.file.header().index_count > 0;
+    if (asset.succeeded) {
+        copy_mesh_metadata(asset.mesh);
+    }
+}
+
+void HotReloader::cook_shader(CookedAsset& asset) {
+    std::ifstream file{asset.path, std::ios::binary};
+    const std::string contents{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    if (get_extension(asset.path) == "spv") {
+        asset.spirv.resize(contents.size() / sizeof(u32));
+        std::memcpy(asset.spirv.data(), contents.data(), asset.spirv.size() * sizeof(u32));
+        asset.succeeded = !asset.spirv.empty();
+        return;
+    }
+
+    // Keep the running pipeline, a typo should not take the frame down
+    if (!compile_shader(asset.path, contents, asset.spirv)) {
+        return;
+    }
+    std::ofstream output{asset.path + ".spv", std::ios::binary | std::ios::trunc};
+    output.write(reinterpret_cast<const char*>(asset.spirv.data()), static_cast<std::streamsize>(asset.spirv.size() * sizeof(u32)));
+    asset.succeeded = true;
+}
+
+}
@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Assets/AssetCache.h"
+#include "Assets/MeshAsset.h"
+#include "common.h"
+#include "Components/Components.h"
+#include "concurrentqueue.h"
+#include "flecs.h"
+#include "FileIO/AssetIndex.h"
+#include "FileIO/FileWatcher.h"
+#include "Models/MeshFile.h"
+#include "robin_hood.h"
+#include "Threading/ThreadPool.h"
+
+namespace engine {
+
+class Renderer;
+
+// Re-cooks changed models and shaders on the thread pool and swaps the results
+// into the renderer from an OnLoad system, so GPU objects only change between
+// frames and the rest of the frame never waits on a cook.
+class HotReloader {
+    struct CookedAsset {
+        std::string path;
+        u32 generation = 0;
+        bool succeeded = false;
+        // The re-cooked mesh, its file is uploaded as is and the rest replaces
+        // the cached asset
+        MeshAsset mesh;
+        std::vector<u32> spirv;
+    };
+
+    flecs::world& m_world_;
+    Renderer& m_renderer_;
+    AssetCache<MeshAsset>& m_meshes_;
+    ThreadPool& m_thread_pool_;
+    // Shared with the asset cache's loads, so both see the same source hashes
+    // and cooked meshes
+    io::AssetIndex* m_asset_index_;
+    io::FileWatcher m_watcher_;
+    std::vector<std::string> m_directories_;
+    moodycamel::ConcurrentQueue<CookedAsset> m_cooked_;
+    // Model sources found to reference a changed file, cooked on the next update
+    moodycamel::ConcurrentQueue<std::string> m_dependent_sources_;
+    // Bumped on every change so a slow cook never overwrites a newer one
+    robin_hood::unordered_map<std::string, u32> m_generations_;
+    robin_hood::unordered_map<std::string, u64> m_applied_shader_hashes_;
+    std::vector<std::string> m_changed_paths_;
+    JobCounter m_in_flight_;
+    flecs::system m_system_;
+    // Entities whose Bounds follow a reloaded mesh
+    flecs::query<const components::MeshRef> m_mesh_ref_query_;
+    u32 m_model_import_flags_;
+
+    void schedule_cook(const std::string& path);
+    // Looks for the .gltf files referencing a changed buffer or image
+    void find_dependent_sources(const std::string& path);
+    void apply(CookedAsset& asset);
+    void cook_model(CookedAsset& asset) const;
+    static void cook_shader(CookedAsset& asset);
+public:
+    HotReloader(flecs::world& world, Renderer& renderer, AssetCache<MeshAsset>& meshes, ThreadPool& thread_pool, io::AssetIndex* asset_index,
+        std::span<const char* const> directories, u32 model_import_flags = 0);
+    HotReloader(const HotReloader&) = delete;
+    HotReloader& operator=(const HotReloader&) = delete;
+    HotReloader(HotReloader&&) = delete;
+    HotReloader& operator=(HotReloader&&) = delete;
+    ~HotReloader();
+
+    // Starts cooks for changed files and applies the ones that finished
+    void update();
+};
+
+}
@@ -1,5 +1,8 @@
 ﻿#include "Renderer.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <shaderc/shaderc.hpp>
 #include <vuk/Future.hpp>
 #include <vuk/RenderGraph.hpp>
@@ -13,10 +16,29 @@
 #include <vuk/Partials.hpp>
 
 #include "flecs.h"
+#include "Animation/AnimationSystem.h"
+#include "Culling.h"
 
 namespace engine {
 
-Renderer::Renderer(flecs::world& world) : m_world_(world), window(1200, 800, "Game") {
+// Matches the uniform block of the mesh vertex shaders
+struct MeshUniforms {
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 normal;
+};
+
+// Matches the uniform block of skinned.vert
+struct SkinnedMeshUniforms {
+    MeshUniforms mesh;
+    glm::mat4 dequantization;
+    u32 palette_offset;
+};
+
+static_assert(sizeof(vuk::DrawIndexedIndirectCommand) == sizeof(VkDrawIndexedIndirectCommand), "Draw commands are handed to vuk as is");
+
+Renderer::Renderer(flecs::world& world, const io::PackFile* pack) : m_world_(world), m_pack_(pack), window(1200, 800, "Game") {
     vkb::InstanceBuilder instance_builder;
     instance_builder.request_validation_layers()
         .set_app_name("Stealth Game")
@@ -114,11 +136,322 @@ Renderer::Renderer(flecs::world& world) : m_world_(world), window(1200, 800, "Ga
     ImGui_ImplGlfw_InitForVulkan(window, true);
     imgui_data = util::ImGui_ImplVuk_Init(*superframe_allocator);
 
+    constexpr const char* cube_shaders[] = {"Shaders/global.frag.spv", "Shaders/global.vert.spv"};
+    create_pipeline("cube", cube_shaders);
+    // Meshes packed to the compact layouts, skinned ones without an animator
+    // leave the joints unread and stay in the bind pose
+    constexpr const char* mesh_shaders[] = {"Shaders/global.frag.spv", "Shaders/compact.vert.spv"};
+    create_pipeline("mesh", mesh_shaders);
+    constexpr const char* skinned_shaders[] = {"Shaders/global.frag.spv", "Shaders/skinned.vert.spv"};
+    create_pipeline("skinned", skinned_shaders);
+
+    // Mesh entities are drawn from a camera singleton, a default one looks
+    // down +z from the origin until the game sets its own
+    if (!m_world_.has<Camera>()) {
+        m_world_.set(Camera{glm::radians(50.0f), 1200.0f / 800.0f, 0.1f, 1000.0f});
+    }
+    m_mesh_query_ = m_world_.query<const components::Transform3D, const components::MeshRef, const components::Bounds, const components::Animator*>();
+}
+
+Renderer::~Renderer() {
+    m_mesh_query_.destruct();
+    // Their buffers go back to the allocator, which is destroyed first
+    m_pending_mesh_uploads_.clear();
+}
+
+void Renderer::create_pipeline(const char* name, std::span<const char* const> spirv_paths) {
     vuk::PipelineBaseCreateInfo create_info;
-    create_info.add_spirv(util::read_spirv("Shaders/global.frag.spv"), "Global Fragment Shader");
-    create_info.add_spirv(util::read_spirv("Shaders/global.vert.spv"), "Global Vertex Shader");
-    context->create_named_pipeline("cube", create_info);
-    
+    std::vector<std::string>& shaders = pipeline_shaders[name];
+    shaders.clear();
+    for (const char* path : spirv_paths) {
+        auto [binary, inserted] = shader_binaries.try_emplace(path);
+        if (inserted) {
+            const io::PackedFile packed = m_pack_ ? m_pack_->get_file(nullptr, path) : io::PackedFile{nullptr, nullptr, nullptr};
+            if (packed.is_valid()) {
+                binary->second.resize((packed.size() + sizeof(u32) - 1) / sizeof(u32));
+                packed.read_into(reinterpret_cast<byte*>(binary->second.data()));
+            } else {
+                binary->second = util::read_spirv(path);
+            }
+        }
+        create_info.add_spirv(binary->second, path);
+        shaders.emplace_back(path);
+    }
+    context->create_named_pipeline(vuk::Name{name}, std::move(create_info));
+}
+
+u32 Renderer::reload_shader(const std::string& spirv_path, std::vector<u32> spirv) {
+    shader_binaries[spirv_path] = std::move(spirv);
+    u32 rebuilt = 0;
+    for (const auto& [name, shaders] : pipeline_shaders) {
+        if (std::find(shaders.begin(), shaders.end(), spirv_path) == shaders.end()) {
+            continue;
+        }
+        vuk::PipelineBaseCreateInfo create_info;
+        for (const std::string& path : shaders) {
+            create_info.add_spirv(shader_binaries[path], path);
+        }
+        context->create_named_pipeline(vuk::Name{name}, std::move(create_info));
+        rebuilt++;
+    }
+    return rebuilt;
+}
+
+void Renderer::upload_mesh(const std::string& name, std::span<const Vertex> vertices, std::span<const u32> indices, std::span<const Submesh> submeshes) {
+    const BoundingVolume bounds = compute_bounding_volume(vertices);
+    const glm::vec3 bounds_min{bounds.aabb_min[0], bounds.aabb_min[1], bounds.aabb_min[2]};
+    const glm::vec3 bounds_max{bounds.aabb_max[0], bounds.aabb_max[1], bounds.aabb_max[2]};
+    u32 max_submesh_vertices = 0;
+    for (const Submesh& submesh : submeshes) {
+        max_submesh_vertices = glm::max(max_submesh_vertices, submesh.vertex_count);
+    }
+    const IndexFormat index_format = get_index_format(max_submesh_vertices);
+    // Skinned meshes keep their joints and weights whatever the layout says
+    VertexLayout layout = mesh_layout;
+    layout.skin = has_skin_weights(vertices) ? SkinFormat::UINT8 : SkinFormat::NONE;
+    // Arenas are sized in pushed bytes, each buffer is resized once
+    Arena arena{vertices.size() * layout.get_stride() + indices.size() * get_index_size(index_format) + 64};
+    arena_vector<byte> packed_vertices = MAKE_ARENA_VECTOR(&arena, byte);
+    arena_vector<byte> packed_indices = MAKE_ARENA_VECTOR(&arena, byte);
+    pack_vertices(layout, vertices, bounds_min, bounds_max, packed_vertices);
+    pack_indices(index_format, indices, packed_indices);
+
+    GpuMesh mesh;
+    mesh.index_count = static_cast<u32>(indices.size());
+    mesh.lods.assign(1, MeshLod{0, mesh.index_count, 0.0f, 0});
+    mesh.submeshes.assign(submeshes.begin(), submeshes.end());
+    mesh.layout = layout;
+    mesh.index_type = get_index_type(index_format);
+    mesh.dequantization = get_position_dequantization(layout, bounds_min, bounds_max);
+    mesh.bounds = bounds;
+    queue_mesh_upload(name, std::move(mesh), packed_vertices, packed_indices);
+}
+
+void Renderer::upload_mesh(const std::string& name, const MeshFile& mesh_file) {
+    const ArrayRef<const byte> packed_vertices = mesh_file.packed_vertices();
+    const ArrayRef<const byte> packed_indices = mesh_file.packed_indices();
+    const MeshFileHeader& header = mesh_file.header();
+    const glm::vec3 bounds_min{header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]};
+    const glm::vec3 bounds_max{header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]};
+
+    GpuMesh mesh;
+    mesh.index_count = header.index_count;
+    mesh.lods.assign(mesh_file.lods().begin(), mesh_file.lods().end());
+    if (mesh.lods.empty()) {
+        mesh.lods.push_back(MeshLod{0, mesh.index_count, 0.0f, 0});
+    }
+    mesh.submeshes.assign(mesh_file.submeshes().begin(), mesh_file.submeshes().end());
+    for (u32 i = 0; i < mesh.submeshes.size(); i++) {
+        const std::span<const MeshLod> levels = mesh_file.submesh_lods(i);
+        mesh.submesh_lods.insert(mesh.submesh_lods.end(), levels.begin(), levels.end());
+    }
+    mesh.meshlets.assign(mesh_file.meshlets().begin(), mesh_file.meshlets().end());
+    mesh.layout = mesh_file.get_vertex_layout();
+    mesh.index_type = get_index_type(mesh_file.get_index_format());
+    mesh.dequantization = get_position_dequantization(mesh.layout, bounds_min, bounds_max);
+    mesh.bounds = mesh_file.bounds();
+    queue_mesh_upload(name, std::move(mesh), std::span<const byte>{packed_vertices.data(), packed_vertices.size()},
+        std::span<const byte>{packed_indices.data(), packed_indices.size()});
+}
+
+void Renderer::queue_mesh_upload(const std::string& name, GpuMesh mesh, std::span<const byte> vertices, std::span<const byte> indices) {
+    // The data is copied to staging memory here, the mapped file can go
+    // right after
+    auto [vertex_buffer, vertex_upload] = vuk::create_buffer(*superframe_allocator, vuk::MemoryUsage::eGPUonly, vuk::DomainFlagBits::eTransferOnGraphics,
+        vertices);
+    auto [index_buffer, index_upload] = vuk::create_buffer(*superframe_allocator, vuk::MemoryUsage::eGPUonly, vuk::DomainFlagBits::eTransferOnGraphics,
+        indices);
+    mesh.vertices = std::move(vertex_buffer);
+    mesh.indices = std::move(index_buffer);
+    m_pending_mesh_uploads_.push_back(PendingMeshUpload{name, std::move(mesh), std::move(vertex_upload), std::move(index_upload)});
+}
+
+void Renderer::remove_mesh(const std::string& name) {
+    std::erase_if(m_pending_mesh_uploads_, [&name](const PendingMeshUpload& upload) {
+        return upload.name == name;
+    });
+    mesh_ids.erase(get_asset_id(name));
+    meshes.erase(name);
+}
+
+void Renderer::collect_mesh_draws(const Camera& camera, f32 viewport_height, u32 palette_count) {
+    m_draws_.clear();
+    m_draw_commands_.clear();
+    const glm::mat4 view_projection = camera.get_projection() * camera.get_view();
+    const Frustum frustum = Frustum::from_matrix(view_projection);
+    const glm::vec3 camera_position{glm::inverse(camera.get_view())[3]};
+    // Projected size of one unit at distance 1, LOD errors are measured with it
+    const f32 pixels_per_unit = viewport_height * 0.5f * std::abs(camera.get_projection()[1][1]);
+    m_mesh_query_.each([&](const components::Transform3D& transform, const components::MeshRef& mesh_ref, const components::Bounds& bounds,
+        const components::Animator* animator) {
+        const auto it = mesh_ids.find(mesh_ref.id);
+        if (it == mesh_ids.end()) {
+            return;
+        }
+        const GpuMesh& mesh = *it->second;
+        const glm::vec3 scale = glm::abs(transform.scale);
+        const f32 max_scale = glm::max(scale.x, glm::max(scale.y, scale.z));
+        const glm::vec4 sphere = bounds.world_sphere(transform);
+        if (max_scale == 0.0f || !frustum.intersects_sphere(glm::vec3{sphere}, sphere.w)) {
+            return;
+        }
+        // Submesh and meshlet bounds are in object space, the planes and the
+        // camera are brought there instead
+        const glm::mat4 model = transform.as_matrix();
+        const Frustum object_frustum = Frustum::from_matrix(view_projection * model);
+        // LOD errors are in object units and grow with the scale
+        const f32 distance = glm::max(glm::distance(glm::vec3{sphere}, camera_position) - sphere.w, 0.0f);
+        const u32 lod = select_lod(mesh.lods, distance / max_scale, pixels_per_unit, max_lod_pixel_error);
+        // The cube pipeline of FULL_VERTEX_LAYOUT has no skinned variant
+        const bool is_skinned = animator != nullptr && animator->palette_offset < palette_count && mesh.layout.skin == SkinFormat::UINT8 &&
+            mesh.layout != FULL_VERTEX_LAYOUT;
+        MeshDraw draw{&mesh, is_skinned ? model : model * mesh.dequantization, glm::mat4{transform.normal_matrix()}, static_cast<u32>(m_draw_commands_.size()),
+            0, is_skinned ? animator->palette_offset : ~0u};
+        // Meshlets only split LOD 0, coarser levels are culled per submesh
+        if (lod == 0 && !mesh.meshlets.empty()) {
+            const glm::vec3 object_camera{glm::inverse(model) * glm::vec4{camera_position, 1.0f}};
+            cull_meshlets(mesh.meshlets, object_frustum, object_camera, m_visible_);
+            write_meshlet_draw_commands(mesh.meshlets, mesh.submeshes, m_visible_, m_draw_commands_);
+        } else {
+            cull_submeshes(mesh.submeshes, object_frustum, m_visible_);
+            write_draw_commands(mesh.submeshes, mesh.submesh_lods, m_visible_, lod, m_draw_commands_);
+        }
+        draw.command_count = static_cast<u32>(m_draw_commands_.size()) - draw.first_command;
+        if (draw.command_count > 0) {
+            m_draws_.push_back(draw);
+        }
+    });
+}
+
+void Renderer::draw_meshes(vuk::CommandBuffer& command_buffer, const Camera& camera, const vuk::Buffer& palettes) const {
+    command_buffer.set_dynamic_state(vuk::DynamicStateFlagBits::eViewport | vuk::DynamicStateFlagBits::eScissor)
+        .set_viewport(0, vuk::Rect2D::framebuffer())
+        .set_scissor(0, vuk::Rect2D::framebuffer())
+        .set_rasterization(vuk::PipelineRasterizationStateCreateInfo{})
+        .set_depth_stencil(vuk::PipelineDepthStencilStateCreateInfo{
+            .depthTestEnable = true,
+            .depthWriteEnable = true,
+            .depthCompareOp = vuk::CompareOp::eLessOrEqual
+        })
+        .broadcast_color_blend(vuk::BlendPreset::eOff);
+    // Commands of every entity are in one array, each entity draws its range
+    vuk::DrawIndexedIndirectCommand* commands = reinterpret_cast<vuk::DrawIndexedIndirectCommand*>(const_cast<VkDrawIndexedIndirectCommand*>(m_draw_commands_.data()));
+    for (const MeshDraw& draw : m_draws_) {
+        const GpuMesh& mesh = *draw.mesh;
+        const std::array<VkVertexInputAttributeDescription, MAX_VERTEX_ATTRIBUTES> descriptions = mesh.layout.get_attribute_descriptions();
+        std::array<vuk::VertexInputAttributeDescription, MAX_VERTEX_ATTRIBUTES> attributes{};
+        for (u32 i = 0; i < mesh.layout.get_attribute_count(); i++) {
+            attributes[i] = vuk::VertexInputAttributeDescription{descriptions[i].location, descriptions[i].binding, static_cast<vuk::Format>(descriptions[i].format),
+                descriptions[i].offset};
+        }
+        const bool is_skinned = draw.palette_offset != ~0u;
+        command_buffer.bind_graphics_pipeline(is_skinned ? "skinned" : mesh.layout == FULL_VERTEX_LAYOUT ? "cube" : "mesh")
+            .bind_vertex_buffer(0, *mesh.vertices, std::span{attributes.data(), mesh.layout.get_attribute_count()}, mesh.layout.get_stride())
+            .bind_index_buffer(*mesh.indices, static_cast<vuk::IndexType>(mesh.index_type));
+        const MeshUniforms uniforms{draw.model, camera.get_view(), camera.get_projection(), draw.normal};
+        if (is_skinned) {
+            *command_buffer.map_scratch_buffer<SkinnedMeshUniforms>(0, 0) = SkinnedMeshUniforms{uniforms, mesh.dequantization, draw.palette_offset};
+            command_buffer.bind_buffer(0, 1, palettes);
+        } else {
+            *command_buffer.map_scratch_buffer<MeshUniforms>(0, 0) = uniforms;
+        }
+        command_buffer.draw_indexed_indirect(std::span{commands + draw.first_command, draw.command_count});
+    }
+}
+
+void Renderer::upload_texture(const TextureUpload& upload) {
+    const TextureMip& top = upload.mips[upload.level];
+    const u32 level_count = static_cast<u32>(upload.mips.size()) - upload.level;
+    vuk::ImageCreateInfo create_info;
+    create_info.format = static_cast<vuk::Format>(get_vk_format(upload.header->format, (upload.header->flags & TEXTURE_FLAG_SRGB) != 0));
+    create_info.extent = vuk::Extent3D{top.width, top.height, 1};
+    create_info.samples = vuk::Samples::e1;
+    create_info.initialLayout = vuk::ImageLayout::eUndefined;
+    create_info.tiling = vuk::ImageTiling::eOptimal;
+    // Transfer source so shrink_texture can copy the coarser levels out
+    create_info.usage = vuk::ImageUsageFlagBits::eTransferSrc | vuk::ImageUsageFlagBits::eTransferDst | vuk::ImageUsageFlagBits::eSampled;
+    create_info.mipLevels = level_count;
+    create_info.arrayLayers = 1;
+    vuk::Texture texture = context->allocate_texture(*superframe_allocator, create_info);
+
+    vuk::Compiler compiler;
+    for (u32 level = 0; level < level_count; level++) {
+        const TextureMip& mip = upload.mips[upload.level + level];
+        vuk::ImageAttachment attachment = vuk::ImageAttachment::from_texture(texture);
+        attachment.extent = vuk::Dimension3D::absolute(mip.width, mip.height, 1);
+        attachment.base_level = level;
+        attachment.level_count = 1;
+        auto level_upload = vuk::host_data_to_image(*superframe_allocator, vuk::DomainFlagBits::eTransferOnGraphics, attachment,
+            upload.level_data(upload.level + level).data());
+        vuk::transition(std::move(level_upload), vuk::eFragmentSampled).wait(*superframe_allocator, compiler);
+    }
+    GpuTexture& gpu_texture = textures[upload.path];
+    gpu_texture.texture = std::move(texture);
+    gpu_texture.base_level = upload.level;
+}
+
+void Renderer::shrink_texture(const std::string& path, u32 level) {
+    const auto it = textures.find(path);
+    if (it == textures.end() || level <= it->second.base_level || level - it->second.base_level >= it->second.texture.level_count) {
+        return;
+    }
+    GpuTexture& gpu_texture = it->second;
+    const vuk::Texture& source = gpu_texture.texture;
+    const u32 dropped_levels = level - gpu_texture.base_level;
+    vuk::ImageCreateInfo create_info;
+    create_info.format = source.format;
+    create_info.extent = vuk::Extent3D{std::max(source.extent.width >> dropped_levels, 1u), std::max(source.extent.height >> dropped_levels, 1u), 1};
+    create_info.samples = vuk::Samples::e1;
+    create_info.initialLayout = vuk::ImageLayout::eUndefined;
+    create_info.tiling = vuk::ImageTiling::eOptimal;
+    create_info.usage = vuk::ImageUsageFlagBits::eTransferSrc | vuk::ImageUsageFlagBits::eTransferDst | vuk::ImageUsageFlagBits::eSampled;
+    create_info.mipLevels = source.level_count - dropped_levels;
+    create_info.arrayLayers = 1;
+    vuk::Texture texture = context->allocate_texture(*superframe_allocator, create_info);
+
+    vuk::Compiler compiler;
+    const vuk::Name source_name = "Resident Level";
+    const vuk::Name destination_name = "Shrunk Level";
+    for (u32 destination_level = 0; destination_level < create_info.mipLevels; destination_level++) {
+        const u32 width = std::max(create_info.extent.width >> destination_level, 1u);
+        const u32 height = std::max(create_info.extent.height >> destination_level, 1u);
+        vuk::ImageAttachment source_attachment = vuk::ImageAttachment::from_texture(source);
+        source_attachment.extent = vuk::Dimension3D::absolute(width, height, 1);
+        source_attachment.base_level = destination_level + dropped_levels;
+        source_attachment.level_count = 1;
+        vuk::ImageAttachment destination_attachment = vuk::ImageAttachment::from_texture(texture);
+        destination_attachment.extent = vuk::Dimension3D::absolute(width, height, 1);
+        destination_attachment.base_level = destination_level;
+        destination_attachment.level_count = 1;
+
+        vuk::ImageCopy copy;
+        copy.srcSubresource.aspectMask = vuk::format_to_aspect(source.format);
+        copy.srcSubresource.mipLevel = source_attachment.base_level;
+        copy.srcSubresource.baseArrayLayer = 0;
+        copy.srcSubresource.layerCount = 1;
+        copy.dstSubresource = copy.srcSubresource;
+        copy.dstSubresource.mipLevel = destination_level;
+        copy.imageExtent = vuk::Extent3D{width, height, 1};
+        std::shared_ptr<vuk::RenderGraph> render_graph = std::make_shared<vuk::RenderGraph>("Shrink Texture");
+        render_graph->add_pass({
+            .name = "Copy Level",
+            .execute_on = vuk::DomainFlagBits::eTransferOnGraphics,
+            .resources = {
+                vuk::Resource{source_name, vuk::Resource::Type::eImage, vuk::eTransferRead},
+                vuk::Resource{destination_name, vuk::Resource::Type::eImage, vuk::eTransferWrite}
+            },
+            .execute = [source_name, destination_name, copy](vuk::CommandBuffer& command_buffer) {
+                command_buffer.copy_image(source_name, destination_name, copy);
+            }
+        });
+        // Uploads leave every level sampled
+        render_graph->attach_image(source_name, source_attachment, vuk::eFragmentSampled);
+        render_graph->attach_image(destination_name, destination_attachment, vuk::eNone);
+        vuk::transition(vuk::Future{render_graph, destination_name.append("+")}, vuk::eFragmentSampled).wait(*superframe_allocator, compiler);
+    }
+    // The old image goes back through the superframe allocator like a replaced upload
+    gpu_texture.texture = std::move(texture);
+    gpu_texture.base_level = level;
 }
 
 void Renderer::render() {
@@ -131,20 +464,64 @@ void Renderer::render() {
         }
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
+        m_world_.progress();
+        const Camera* world_camera = m_world_.get<Camera>();
+        const Camera camera = world_camera ? *world_camera : Camera{};
+        // Uploads queued until now are drawn from this frame, which waits for
+        // their copies on the GPU instead of the CPU waiting for them
+        std::vector<PendingMeshUpload> mesh_uploads = std::move(m_pending_mesh_uploads_);
+        m_pending_mesh_uploads_.clear();
+        for (PendingMeshUpload& upload : mesh_uploads) {
+            GpuMesh& mesh = meshes[upload.name];
+            mesh = std::move(upload.mesh);
+            mesh_ids[get_asset_id(upload.name)] = &mesh;
+        }
+        const SkinningPalettes* skinning_palettes = m_world_.get<SkinningPalettes>();
+        const std::span<const JointMatrix> palettes = skinning_palettes ? skinning_palettes->matrices : std::span<const JointMatrix>{};
+        collect_mesh_draws(camera, static_cast<f32>(swap_chain->extent.height), static_cast<u32>(palettes.size()));
         
         auto& frame_resource = superframe_resource->get_next_frame();
         context->next_frame();
 
         vuk::Allocator frame_allocator{frame_resource};
+        // Every palette of the frame in one buffer, skinned draws index it
+        // with their palette_offset. Freed with the frame.
+        vuk::Unique<vuk::Buffer> palette_buffer;
+        if (!palettes.empty()) {
+            palette_buffer = *vuk::allocate_buffer(frame_allocator, vuk::BufferCreateInfo{vuk::MemoryUsage::eCPUtoGPU, palettes.size_bytes(), alignof(JointMatrix)});
+            std::memcpy(palette_buffer->mapped_ptr, palettes.data(), palettes.size_bytes());
+        }
         std::shared_ptr<vuk::RenderGraph> render_graph = std::make_shared<vuk::RenderGraph>("Main Render Graph");
         vuk::Name attachment_name = "Gameplay";
+        vuk::Name drawn_name = "Gameplay+";
         render_graph->attach_swapchain("_swp", swap_chain);
         render_graph->clear_image("_swp", attachment_name, vuk::ClearColor{0.0f, 0.0f, 0.8f, 1.0f});
+        render_graph->attach_and_clear_image("Depth", vuk::ImageAttachment{.format = vuk::Format::eD32Sfloat, .sample_count = vuk::Samples::e1},
+            vuk::ClearDepthStencil{1.0f, 0});
+        std::vector<vuk::Resource> mesh_resources{
+            vuk::Resource{attachment_name, vuk::Resource::Type::eImage, vuk::eColorRW, drawn_name},
+            vuk::Resource{"Depth", vuk::Resource::Type::eImage, vuk::eDepthStencilRW}
+        };
+        for (u32 i = 0; i < mesh_uploads.size(); i++) {
+            const vuk::Name vertices_name = vuk::Name{"Uploaded Vertices "}.append(std::to_string(i));
+            const vuk::Name indices_name = vuk::Name{"Uploaded Indices "}.append(std::to_string(i));
+            render_graph->attach_in(vertices_name, std::move(mesh_uploads[i].vertex_upload));
+            render_graph->attach_in(indices_name, std::move(mesh_uploads[i].index_upload));
+            mesh_resources.push_back(vuk::Resource{vertices_name, vuk::Resource::Type::eBuffer, vuk::eAttributeRead});
+            mesh_resources.push_back(vuk::Resource{indices_name, vuk::Resource::Type::eBuffer, vuk::eIndexRead});
+        }
+        render_graph->add_pass({
+            .name = "Meshes",
+            .resources = std::move(mesh_resources),
+            .execute = [this, camera, skinning_buffer = palette_buffer ? *palette_buffer : vuk::Buffer{}](vuk::CommandBuffer& command_buffer) {
+                draw_meshes(command_buffer, camera, skinning_buffer);
+            }
+        });
 
         ImGui::ShowDemoWindow();
         
         ImGui::Render();
-        auto fut = util::ImGui_ImplVuk_Render(frame_allocator, vuk::Future{render_graph, attachment_name}, imgui_data, ImGui::GetDrawData(), sampled_images);
+        auto fut = util::ImGui_ImplVuk_Render(frame_allocator, vuk::Future{render_graph, drawn_name}, imgui_data, ImGui::GetDrawData(), sampled_images);
         std::shared_ptr present_rg{std::make_shared<vuk::RenderGraph>("Presenter")};
         present_rg->attach_in("_src", fut);
         present_rg->release_for_present("_src");
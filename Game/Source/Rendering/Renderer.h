@@ -1,14 +1,23 @@
-﻿#pragma once
+#pragma once
 
 #include <utils.hpp>
 #include <vuk/Context.hpp>
+#include <vuk/Future.hpp>
 #include <vuk/resources/DeviceFrameResource.hpp>
 #include <vuk/SampledImage.hpp>
 
 #include "../../Vendor/vk-bootstrap/VkBootstrap.h"
+#include "Components/Components.h"
 #include "Containers/ObjectHolder.h"
+#include "FileIO/PackFile.h"
+#include "Models/MeshFile.h"
+#include "Models/Vertex.h"
+#include "Models/VertexLayout.h"
+#include "Rendering/Camera.h"
+#include "Textures/TextureStreamer.h"
 #include "Window.h"
 #include "flecs.h"
+#include "robin_hood.h"
 
 namespace engine {
 
@@ -25,8 +34,70 @@ struct RenderHandles {
     
 };
 
+struct GpuMesh {
+    vuk::Unique<vuk::Buffer> vertices;
+    vuk::Unique<vuk::Buffer> indices;
+    u32 index_count = 0;
+    // Index ranges of every level, LOD 0 first
+    std::vector<MeshLod> lods;
+    // Drawn with their offset as base vertex, one indirect draw each
+    std::vector<Submesh> submeshes;
+    // Levels of every submesh, submesh major, empty when there is no chain
+    std::vector<MeshLod> submesh_lods;
+    // Culled on the CPU, visible ones are drawn as ranges of LOD 0
+    std::vector<Meshlet> meshlets;
+    VertexLayout layout = FULL_VERTEX_LAYOUT;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+    // Premultiplied into the model matrix of quantized meshes
+    glm::mat4 dequantization{1.0f};
+    BoundingVolume bounds{};
+};
+
+// One culled entity, drawn with one indirect draw over its commands
+struct MeshDraw {
+    const GpuMesh* mesh;
+    // Without the dequantization for skinned draws, which skin in object space
+    glm::mat4 model;
+    glm::mat4 normal;
+    u32 first_command;
+    u32 command_count;
+    // First joint of the entity's palette, ~0u draws the mesh unskinned
+    u32 palette_offset;
+};
+
+// Mesh whose buffer copies were recorded but not submitted yet
+struct PendingMeshUpload {
+    std::string name;
+    GpuMesh mesh;
+    vuk::Future vertex_upload;
+    vuk::Future index_upload;
+};
+
+struct GpuTexture {
+    vuk::Texture texture;
+    // Level of the texture file the image's level 0 holds
+    u32 base_level = 0;
+};
+
 class Renderer {
     flecs::world& m_world_;
+    // Shaders are read from it first when one is mounted
+    const io::PackFile* m_pack_;
+    flecs::query<const components::Transform3D, const components::MeshRef, const components::Bounds, const components::Animator*> m_mesh_query_;
+    // Rebuilt every frame, the visible entities and their draws
+    std::vector<MeshDraw> m_draws_;
+    std::vector<VkDrawIndexedIndirectCommand> m_draw_commands_;
+    std::vector<u32> m_visible_;
+    // Drawn from the next frame on, whose graph waits for their copies
+    std::vector<PendingMeshUpload> m_pending_mesh_uploads_;
+
+    // Starts the copies of a mesh's packed buffers without waiting for them
+    void queue_mesh_upload(const std::string& name, GpuMesh mesh, std::span<const byte> vertices, std::span<const byte> indices);
+    // Culls every mesh entity, picks its LOD and writes its draws. Skinned
+    // meshes are only drawn skinned when palette_count covers their palette.
+    void collect_mesh_draws(const Camera& camera, f32 viewport_height, u32 palette_count);
+    // palettes is bound for the skinned draws, it holds this frame's SkinningPalettes
+    void draw_meshes(vuk::CommandBuffer& command_buffer, const Camera& camera, const vuk::Buffer& palettes) const;
 public:
     Window window;
     VulkanHandles handle_struct;
@@ -40,13 +111,47 @@ public:
     plf::colony<vuk::SampledImage> sampled_images;
     vuk::SingleSwapchainRenderBundle bundle;
     vuk::Unique<vuk::Buffer> cube_vertices, cube_indices;
+    robin_hood::unordered_node_map<std::string, GpuMesh> meshes;
+    // The same meshes by the asset id of their name, which MeshRef holds
+    robin_hood::unordered_flat_map<AssetId, GpuMesh*> mesh_ids;
+    // Streamed textures by file path, at whatever levels are resident
+    robin_hood::unordered_node_map<std::string, GpuTexture> textures;
+    // SPIR-V by file path and the files every named pipeline is built from,
+    // kept so a single changed shader can rebuild the pipelines using it
+    robin_hood::unordered_node_map<std::string, std::vector<u32>> shader_binaries;
+    robin_hood::unordered_node_map<std::string, std::vector<std::string>> pipeline_shaders;
     
+    // Layout meshes uploaded from plain vertices are packed to
+    VertexLayout mesh_layout = COMPACT_VERTEX_LAYOUT;
+    // Largest on-screen error in pixels the LOD picked for a mesh may have
+    f32 max_lod_pixel_error = 1.0f;
     bool is_suspended = false;
 
-    Renderer(flecs::world& world);
-    ~Renderer() = default;
+    explicit Renderer(flecs::world& world, const io::PackFile* pack = nullptr);
+    ~Renderer();
 
     void render();
+
+    void create_pipeline(const char* name, std::span<const char* const> spirv_paths);
+    // Replaces the SPIR-V of one file and rebuilds every pipeline using it,
+    // returns how many were rebuilt
+    u32 reload_shader(const std::string& spirv_path, std::vector<u32> spirv);
+    // Creates or replaces a mesh built at runtime, packed to mesh_layout.
+    // Nothing waits for the upload, the mesh is drawn from the next frame
+    // and a replaced one keeps drawing until then. Replaced buffers are
+    // released through the superframe allocator, so frames still in flight
+    // keep drawing the old one.
+    void upload_mesh(const std::string& name, std::span<const Vertex> vertices, std::span<const u32> indices, std::span<const Submesh> submeshes);
+    // Uploads the packed sections of a cooked mesh without repacking them,
+    // how the asset cache and hot reload upload models
+    void upload_mesh(const std::string& name, const MeshFile& mesh_file);
+    void remove_mesh(const std::string& name);
+    // Replaces a texture's image with one holding exactly the streamed levels,
+    // the old image is released through the superframe allocator like meshes
+    void upload_texture(const TextureUpload& upload);
+    // Replaces a texture's image with one holding only the levels from level
+    // on, copied from the current image on the GPU instead of read again
+    void shrink_texture(const std::string& path, u32 level);
 };
 
 }
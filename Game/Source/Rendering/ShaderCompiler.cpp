@@ -0,0 +1,91 @@
+﻿#include "ShaderCompiler.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <shaderc/shaderc.hpp>
+
+namespace engine {
+
+static std::string_view get_extension(std::string_view path) {
+    const size_t dot = path.find_last_of('.');
+    return dot == std::string_view::npos ? std::string_view{} : path.substr(dot + 1);
+}
+
+// Shader kind from the glslc style extension, infer_from_source for anything else
+static shaderc_shader_kind get_shader_kind(std::string_view extension) {
+    if (extension == "vert") {
+        return shaderc_vertex_shader;
+    }
+    if (extension == "frag") {
+        return shaderc_fragment_shader;
+    }
+    if (extension == "comp") {
+        return shaderc_compute_shader;
+    }
+    if (extension == "geom") {
+        return shaderc_geometry_shader;
+    }
+    return shaderc_glsl_infer_from_source;
+}
+
+// Reads included files from disk and remembers their paths
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+    // shaderc keeps pointers into the result until it is released
+    struct Include {
+        shaderc_include_result result;
+        std::string path;
+        std::string contents;
+    };
+
+    std::vector<std::string>* m_includes_;
+public:
+    explicit ShaderIncluder(std::vector<std::string>* includes) : m_includes_(includes) {}
+
+    shaderc_include_result* GetInclude(const char* requested_source, shaderc_include_type type, const char* requesting_source, size_t) override {
+        auto* include = new Include{};
+        std::filesystem::path path{requested_source};
+        if (type == shaderc_include_type_relative) {
+            path = std::filesystem::path{requesting_source}.parent_path() / path;
+        }
+        include->path = path.lexically_normal().generic_string();
+        std::ifstream file{include->path, std::ios::binary};
+        if (file.is_open()) {
+            include->contents.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+            if (m_includes_) {
+                m_includes_->push_back(include->path);
+            }
+        } else {
+            // An empty name tells shaderc the include failed, the contents hold the message
+            include->contents = "Cannot open " + include->path;
+            include->path.clear();
+        }
+        include->result = shaderc_include_result{include->path.data(), include->path.size(), include->contents.data(), include->contents.size(), include};
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* result) override {
+        delete static_cast<Include*>(result->user_data);
+    }
+};
+
+bool is_shader_source(std::string_view path) {
+    return get_shader_kind(get_extension(path)) != shaderc_glsl_infer_from_source;
+}
+
+bool compile_shader(const std::string& path, std::string_view source, std::vector<u32>& spirv, std::vector<std::string>* includes) {
+    shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+    options.SetIncluder(std::make_unique<ShaderIncluder>(includes));
+    const shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source.data(), source.size(), get_shader_kind(get_extension(path)),
+        path.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        ENGINE_LOG_ERROR("Failed to compile {}:\n{}", path, result.GetErrorMessage())
+        return false;
+    }
+    spirv.assign(result.cbegin(), result.cend());
+    return true;
+}
+
+}
@@ -0,0 +1,19 @@
+﻿#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+
+namespace engine {
+
+// Whether the glslc style extension (.vert, .frag, .comp, .geom) names a shader source
+bool is_shader_source(std::string_view path);
+
+// Compiles GLSL to SPIR-V for Vulkan 1.3, the stage comes from the extension.
+// #include "file" resolves relative to the including file, and when includes
+// is given every file pulled in is appended to it. Errors are logged.
+bool compile_shader(const std::string& path, std::string_view source, std::vector<u32>& spirv, std::vector<std::string>* includes = nullptr);
+
+}
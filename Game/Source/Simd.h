@@ -0,0 +1,7 @@
+﻿#pragma once
+
+// SSE is baseline on x64, MSVC does not define __SSE__ there
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define ENGINE_HAS_SSE
+#endif
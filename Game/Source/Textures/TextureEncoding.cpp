@@ -0,0 +1,293 @@
+﻿#include "TextureEncoding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Threading/ThreadPool.h"
+
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+
+static constexpr u32 BC7_MODE_6 = 1 << 6;
+static constexpr u32 BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+// Rounds of index selection and least squares endpoint refit
+static constexpr u32 BC7_REFINE_ITERATIONS = 2;
+
+namespace {
+
+// 7 bit endpoint channels and the shared lowest bit of each endpoint
+struct Bc7Endpoints {
+    u32 values[2][4];
+    u32 pbits[2];
+
+    u32 get_channel(u32 endpoint, u32 channel) const {
+        return values[endpoint][channel] << 1 | pbits[endpoint];
+    }
+};
+
+// Fills a 128 bit block from the lowest bit up
+struct BlockWriter {
+    byte* block;
+    u32 position = 0;
+
+    void write(u32 value, u32 bits) {
+        for (u32 i = 0; i < bits; i++, position++) {
+            block[position >> 3] |= static_cast<byte>(((value >> i) & 1) << (position & 7));
+        }
+    }
+};
+
+}
+
+// Quantizes to 7 bits per channel with whichever shared bit lands closer
+static void quantize_endpoint(const f32* color, u32* values, u32& pbit) {
+    f32 best_error = INFINITY;
+    for (u32 candidate = 0; candidate < 2; candidate++) {
+        u32 quantized[4];
+        f32 error = 0.0f;
+        for (u32 channel = 0; channel < 4; channel++) {
+            const f32 value = std::round((color[channel] - static_cast<f32>(candidate)) * 0.5f);
+            quantized[channel] = static_cast<u32>(std::clamp(value, 0.0f, 127.0f));
+            const f32 difference = static_cast<f32>(quantized[channel] << 1 | candidate) - color[channel];
+            error += difference * difference;
+        }
+        if (error < best_error) {
+            best_error = error;
+            pbit = candidate;
+            std::memcpy(values, quantized, sizeof(quantized));
+        }
+    }
+}
+
+// Picks the closest of the 16 interpolated colors for every texel, returns the squared error
+static f32 select_indices(const f32 (&texels)[16][4], const Bc7Endpoints& endpoints, u32 (&indices)[16]) {
+    f32 palette[16][4];
+    for (u32 weight = 0; weight < 16; weight++) {
+        for (u32 channel = 0; channel < 4; channel++) {
+            const u32 interpolated = ((64 - BC7_WEIGHTS[weight]) * endpoints.get_channel(0, channel) + BC7_WEIGHTS[weight] * endpoints.get_channel(1, channel)
+                + 32) >> 6;
+            palette[weight][channel] = static_cast<f32>(interpolated);
+        }
+    }
+    f32 total_error = 0.0f;
+    for (u32 texel = 0; texel < 16; texel++) {
+        f32 best_error = INFINITY;
+        for (u32 weight = 0; weight < 16; weight++) {
+            f32 error = 0.0f;
+            for (u32 channel = 0; channel < 4; channel++) {
+                const f32 difference = palette[weight][channel] - texels[texel][channel];
+                error += difference * difference;
+            }
+            if (error < best_error) {
+                best_error = error;
+                indices[texel] = weight;
+            }
+        }
+        total_error += best_error;
+    }
+    return total_error;
+}
+
+void encode_bc7_block(const u8* pixels, byte* block) {
+    f32 texels[16][4];
+    f32 mean[4]{};
+    for (u32 texel = 0; texel < 16; texel++) {
+        for (u32 channel = 0; channel < 4; channel++) {
+            texels[texel][channel] = pixels[texel * 4 + channel];
+            mean[channel] += texels[texel][channel] / 16.0f;
+        }
+    }
+
+    // Principal axis of the texels by power iteration on their covariance
+    f32 covariance[4][4]{};
+    for (u32 texel = 0; texel < 16; texel++) {
+        for (u32 row = 0; row < 4; row++) {
+            for (u32 column = 0; column < 4; column++) {
+                covariance[row][column] += (texels[texel][row] - mean[row]) * (texels[texel][column] - mean[column]);
+            }
+        }
+    }
+    // Seeded with the covariance column of the widest channel. A fixed seed
+    // collapses when it is orthogonal to the axis, e.g. for a red to green
+    // gradient, whose channels move in opposite directions.
+    u32 widest_channel = 0;
+    for (u32 channel = 1; channel < 4; channel++) {
+        if (covariance[channel][channel] > covariance[widest_channel][widest_channel]) {
+            widest_channel = channel;
+        }
+    }
+    f32 axis[4];
+    for (u32 channel = 0; channel < 4; channel++) {
+        axis[channel] = covariance[channel][widest_channel];
+    }
+    for (u32 iteration = 0; iteration < 8; iteration++) {
+        f32 next[4]{};
+        f32 length = 0.0f;
+        for (u32 row = 0; row < 4; row++) {
+            for (u32 column = 0; column < 4; column++) {
+                next[row] += covariance[row][column] * axis[column];
+            }
+            length = std::max(length, std::abs(next[row]));
+        }
+        if (length == 0.0f) {
+            break;
+        }
+        for (u32 channel = 0; channel < 4; channel++) {
+            axis[channel] = next[channel] / length;
+        }
+    }
+    f32 axis_length = 0.0f;
+    for (f32 component : axis) {
+        axis_length += component * component;
+    }
+    if (axis_length == 0.0f) {
+        // Fall back to the diagonal of the texels' bounding box
+        for (u32 channel = 0; channel < 4; channel++) {
+            f32 low = 255.0f;
+            f32 high = 0.0f;
+            for (u32 texel = 0; texel < 16; texel++) {
+                low = std::min(low, texels[texel][channel]);
+                high = std::max(high, texels[texel][channel]);
+            }
+            axis[channel] = high - low;
+            axis_length += axis[channel] * axis[channel];
+        }
+    }
+    f32 min_projection = 0.0f;
+    f32 max_projection = 0.0f;
+    if (axis_length > 0.0f) {
+        for (u32 texel = 0; texel < 16; texel++) {
+            f32 projection = 0.0f;
+            for (u32 channel = 0; channel < 4; channel++) {
+                projection += (texels[texel][channel] - mean[channel]) * axis[channel];
+            }
+            projection /= axis_length;
+            min_projection = std::min(min_projection, projection);
+            max_projection = std::max(max_projection, projection);
+        }
+    }
+    f32 colors[2][4];
+    for (u32 channel = 0; channel < 4; channel++) {
+        colors[0][channel] = std::clamp(mean[channel] + axis[channel] * min_projection, 0.0f, 255.0f);
+        colors[1][channel] = std::clamp(mean[channel] + axis[channel] * max_projection, 0.0f, 255.0f);
+    }
+
+    // Alternate index selection and a least squares refit of the endpoints
+    // to those indices, keeping the best round
+    Bc7Endpoints best_endpoints{};
+    u32 best_indices[16]{};
+    f32 best_error = INFINITY;
+    for (u32 iteration = 0; iteration <= BC7_REFINE_ITERATIONS; iteration++) {
+        Bc7Endpoints endpoints{};
+        quantize_endpoint(colors[0], endpoints.values[0], endpoints.pbits[0]);
+        quantize_endpoint(colors[1], endpoints.values[1], endpoints.pbits[1]);
+        u32 indices[16];
+        const f32 error = select_indices(texels, endpoints, indices);
+        if (error < best_error) {
+            best_error = error;
+            best_endpoints = endpoints;
+            std::memcpy(best_indices, indices, sizeof(indices));
+        }
+        if (error == 0.0f || iteration == BC7_REFINE_ITERATIONS) {
+            break;
+        }
+        f32 aa = 0.0f;
+        f32 ab = 0.0f;
+        f32 bb = 0.0f;
+        f32 ax[4]{};
+        f32 bx[4]{};
+        for (u32 texel = 0; texel < 16; texel++) {
+            const f32 weight = static_cast<f32>(BC7_WEIGHTS[indices[texel]]) / 64.0f;
+            aa += (1.0f - weight) * (1.0f - weight);
+            ab += (1.0f - weight) * weight;
+            bb += weight * weight;
+            for (u32 channel = 0; channel < 4; channel++) {
+                ax[channel] += (1.0f - weight) * texels[texel][channel];
+                bx[channel] += weight * texels[texel][channel];
+            }
+        }
+        const f32 determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) {
+            break;
+        }
+        for (u32 channel = 0; channel < 4; channel++) {
+            colors[0][channel] = std::clamp((ax[channel] * bb - bx[channel] * ab) / determinant, 0.0f, 255.0f);
+            colors[1][channel] = std::clamp((bx[channel] * aa - ax[channel] * ab) / determinant, 0.0f, 255.0f);
+        }
+    }
+
+    // The top bit of the first index is implied zero, flipping the endpoints
+    // and weights keeps the colors when it is set
+    if (best_indices[0] >= 8) {
+        std::swap(best_endpoints.values[0], best_endpoints.values[1]);
+        std::swap(best_endpoints.pbits[0], best_endpoints.pbits[1]);
+        for (u32& index : best_indices) {
+            index = 15 - index;
+        }
+    }
+
+    std::memset(block, 0, 16);
+    BlockWriter writer{block};
+    writer.write(BC7_MODE_6, 7);
+    for (u32 channel = 0; channel < 4; channel++) {
+        writer.write(best_endpoints.values[0][channel], 7);
+        writer.write(best_endpoints.values[1][channel], 7);
+    }
+    writer.write(best_endpoints.pbits[0], 1);
+    writer.write(best_endpoints.pbits[1], 1);
+    writer.write(best_indices[0], 3);
+    for (u32 texel = 1; texel < 16; texel++) {
+        writer.write(best_indices[texel], 4);
+    }
+}
+
+std::vector<byte> encode_texture(std::span<const u8> pixels, u32 width, u32 height, TextureFormat format, engine::ThreadPool* thread_pool) {
+    if (format == TextureFormat::RGBA8) {
+        return std::vector<byte>{pixels.begin(), pixels.end()};
+    }
+    const u32 blocks_x = (width + 3) / 4;
+    const u32 blocks_y = (height + 3) / 4;
+    const u32 block_size = get_texture_block_size(format);
+    std::vector<byte> encoded(static_cast<size_t>(blocks_x) * blocks_y * block_size);
+    const auto encode_rows = [&](size_t begin, size_t end) {
+        u8 texels[16 * 4];
+        u8 channels[16 * 2];
+        for (size_t block_y = begin; block_y < end; block_y++) {
+            for (u32 block_x = 0; block_x < blocks_x; block_x++) {
+                for (u32 texel = 0; texel < 16; texel++) {
+                    const u32 x = std::min(block_x * 4 + texel % 4, width - 1);
+                    const u32 y = std::min(static_cast<u32>(block_y) * 4 + texel / 4, height - 1);
+                    std::memcpy(&texels[texel * 4], &pixels[(static_cast<size_t>(y) * width + x) * 4], 4);
+                }
+                byte* block = &encoded[(block_y * blocks_x + block_x) * block_size];
+                switch (format) {
+                case TextureFormat::BC1:
+                    stb_compress_dxt_block(block, texels, 0, STB_DXT_HIGHQUAL);
+                    break;
+                case TextureFormat::BC3:
+                    stb_compress_dxt_block(block, texels, 1, STB_DXT_HIGHQUAL);
+                    break;
+                case TextureFormat::BC5:
+                    for (u32 texel = 0; texel < 16; texel++) {
+                        channels[texel * 2] = texels[texel * 4];
+                        channels[texel * 2 + 1] = texels[texel * 4 + 1];
+                    }
+                    stb_compress_bc5_block(block, channels);
+                    break;
+                case TextureFormat::BC7:
+                    encode_bc7_block(texels, block);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    };
+    if (thread_pool) {
+        thread_pool->parallel_for(blocks_y, 1, encode_rows);
+    } else {
+        encode_rows(0, blocks_y);
+    }
+    return encoded;
+}
@@ -0,0 +1,19 @@
+﻿#pragma once
+
+#include <span>
+#include <vector>
+
+#include "common.h"
+#include "TextureFile.h"
+
+namespace engine {
+class ThreadPool;
+}
+
+// Encodes an RGBA8 image into format. Blocks over the right and bottom edge
+// repeat the last column and row. Rows of blocks encode in parallel on the pool.
+std::vector<byte> encode_texture(std::span<const u8> pixels, u32 width, u32 height, TextureFormat format, engine::ThreadPool* thread_pool);
+
+// BC7 mode 6, one RGBA endpoint pair with 16 weights between them. pixels
+// holds the 16 RGBA texels of the block in row order.
+void encode_bc7_block(const u8* pixels, byte* block);
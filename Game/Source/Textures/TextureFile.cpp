@@ -0,0 +1,130 @@
+﻿#include "TextureFile.h"
+
+#include <fstream>
+
+u32 get_texture_block_dimension(TextureFormat format) {
+    return format == TextureFormat::RGBA8 ? 1 : 4;
+}
+
+u32 get_texture_block_size(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::BC1:
+        return 8;
+    case TextureFormat::BC3:
+    case TextureFormat::BC5:
+    case TextureFormat::BC7:
+        return 16;
+    case TextureFormat::RGBA8:
+    default:
+        return 4;
+    }
+}
+
+u64 get_texture_mip_size(TextureFormat format, u32 width, u32 height) {
+    const u32 dimension = get_texture_block_dimension(format);
+    const u64 blocks_x = (width + dimension - 1) / dimension;
+    const u64 blocks_y = (height + dimension - 1) / dimension;
+    return blocks_x * blocks_y * get_texture_block_size(format);
+}
+
+VkFormat get_vk_format(TextureFormat format, bool srgb) {
+    switch (format) {
+    case TextureFormat::BC1:
+        return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case TextureFormat::BC3:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case TextureFormat::BC5:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case TextureFormat::BC7:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    case TextureFormat::RGBA8:
+    default:
+        return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+TextureFile::TextureFile() : m_header_(nullptr), m_mips_(nullptr) {
+
+}
+
+TextureFile::TextureFile(const char* path) : TextureFile() {
+    open(path);
+}
+
+bool TextureFile::open(const char* path) {
+    m_header_ = nullptr;
+    m_mips_ = nullptr;
+    m_mapping_ = io::MappedFile{path, io::MapHint::SEQUENTIAL};
+    if (m_mapping_.size() < sizeof(TextureFileHeader)) {
+        return false;
+    }
+    const TextureFileHeader* header = reinterpret_cast<const TextureFileHeader*>(m_mapping_.data());
+    if (header->magic != TEXTURE_FILE_MAGIC || header->version != TEXTURE_FILE_VERSION) {
+        return false;
+    }
+    const u64 table_end = sizeof(TextureFileHeader) + static_cast<u64>(header->mip_count) * sizeof(TextureMip);
+    if (table_end > m_mapping_.size()) {
+        ENGINE_LOG_ERROR("Texture file {} is truncated", path)
+        return false;
+    }
+    const TextureMip* mips = reinterpret_cast<const TextureMip*>(m_mapping_.data() + sizeof(TextureFileHeader));
+    for (u32 i = 0; i < header->mip_count; i++) {
+        if (mips[i].offset + mips[i].size > m_mapping_.size()) {
+            ENGINE_LOG_ERROR("Texture file {} is truncated", path)
+            return false;
+        }
+    }
+    m_header_ = header;
+    m_mips_ = mips;
+    return true;
+}
+
+bool TextureFile::is_valid() const {
+    return m_header_ != nullptr;
+}
+
+const TextureFileHeader& TextureFile::header() const {
+    return *m_header_;
+}
+
+std::span<const TextureMip> TextureFile::mips() const {
+    if (m_header_ == nullptr) {
+        return {};
+    }
+    return std::span<const TextureMip>{m_mips_, m_header_->mip_count};
+}
+
+std::span<const byte> TextureFile::mip_data(u32 level) const {
+    if (m_header_ == nullptr || level >= m_header_->mip_count) {
+        return {};
+    }
+    return std::span<const byte>{m_mapping_.data() + m_mips_[level].offset, m_mips_[level].size};
+}
+
+bool write_texture_file(const char* path, TextureFileHeader header, std::span<const EncodedMip> mips) {
+    const auto align_up = [](u64 value) {
+        return (value + TEXTURE_MIP_ALIGNMENT - 1) & ~static_cast<u64>(TEXTURE_MIP_ALIGNMENT - 1);
+    };
+    header.mip_count = static_cast<u32>(mips.size());
+    std::vector<TextureMip> table(mips.size());
+    u64 offset = align_up(sizeof(TextureFileHeader) + table.size() * sizeof(TextureMip));
+    for (size_t i = mips.size(); i-- > 0;) {
+        table[i] = TextureMip{mips[i].width, mips[i].height, offset, mips[i].data.size()};
+        offset = align_up(offset + mips[i].data.size());
+    }
+
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        ENGINE_LOG_ERROR("Failed to create texture file {}", path)
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(TextureMip)));
+    for (size_t i = mips.size(); i-- > 0;) {
+        static constexpr char zeros[TEXTURE_MIP_ALIGNMENT]{};
+        const u64 padding = table[i].offset - static_cast<u64>(file.tellp());
+        file.write(zeros, static_cast<std::streamsize>(padding));
+        file.write(reinterpret_cast<const char*>(mips[i].data.data()), static_cast<std::streamsize>(mips[i].data.size()));
+    }
+    return file.good();
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <span>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "common.h"
+#include "FileIO/FileIO.h"
+
+static constexpr u32 TEXTURE_FILE_MAGIC = 0x58544753; // "SGTX"
+static constexpr u32 TEXTURE_FILE_VERSION = 1;
+// Bumped whenever the texture cooker changes its output
+static constexpr u32 TEXTURE_COOKER_VERSION = 1;
+static constexpr u32 TEXTURE_MIP_ALIGNMENT = 64;
+
+enum class TextureFormat : u32 {
+    RGBA8,
+    // RGB, 8 bytes per 4x4 block
+    BC1,
+    // RGBA with interpolated alpha, 16 bytes per block
+    BC3,
+    // Two channels, used for the XY of normal maps, 16 bytes per block
+    BC5,
+    // RGBA at higher quality than BC1 and BC3, 16 bytes per block
+    BC7
+};
+
+enum TextureFlags : u32 {
+    // Color channels are sRGB encoded and sampled through an _SRGB format
+    TEXTURE_FLAG_SRGB = 1 << 0,
+    // Tangent space XY, Z is rebuilt in the shader
+    TEXTURE_FLAG_NORMAL_MAP = 1 << 1,
+    TEXTURE_FLAG_HAS_ALPHA = 1 << 2
+};
+
+struct TextureFileHeader {
+    u32 magic;
+    u32 version;
+    // Source contents and import settings the texture was cooked from
+    u64 source_key;
+    u32 cooker_version;
+    TextureFormat format;
+    u32 width;
+    u32 height;
+    u32 mip_count;
+    u32 flags;
+    u32 reserved[2];
+};
+
+// Mip table entry, level 0 is the full size. The data of the smallest level
+// comes first in the file so every level below a size is one contiguous read.
+struct TextureMip {
+    u32 width;
+    u32 height;
+    u64 offset;
+    u64 size;
+};
+
+// A level as the encoder produced it, before it has an offset in a file
+struct EncodedMip {
+    u32 width;
+    u32 height;
+    std::vector<byte> data;
+};
+
+static_assert(sizeof(TextureFileHeader) == 48 && sizeof(TextureMip) == 24, "Texture file structures are written to disk as is");
+
+// 4 for block compressed formats, 1 otherwise
+u32 get_texture_block_dimension(TextureFormat format);
+// Bytes per block, or per pixel for RGBA8
+u32 get_texture_block_size(TextureFormat format);
+u64 get_texture_mip_size(TextureFormat format, u32 width, u32 height);
+VkFormat get_vk_format(TextureFormat format, bool srgb);
+
+// Cooked texture mapped straight from disk, mips are views into the mapping
+// ready for a buffer to image copy
+class TextureFile {
+    io::MappedFile m_mapping_;
+    const TextureFileHeader* m_header_;
+    const TextureMip* m_mips_;
+public:
+    TextureFile();
+    explicit TextureFile(const char* path);
+    TextureFile(const TextureFile&) = delete;
+    TextureFile& operator=(const TextureFile&) = delete;
+    TextureFile(TextureFile&&) noexcept = default;
+    TextureFile& operator=(TextureFile&&) noexcept = default;
+    ~TextureFile() = default;
+
+    bool open(const char* path);
+    [[nodiscard]] bool is_valid() const;
+    const TextureFileHeader& header() const;
+    std::span<const TextureMip> mips() const;
+    std::span<const byte> mip_data(u32 level) const;
+};
+
+// Writes the header, the mip table and the levels, mips[0] is level 0.
+// header.mip_count is filled in.
+bool write_texture_file(const char* path, TextureFileHeader header, std::span<const EncodedMip> mips);
@@ -0,0 +1,235 @@
+﻿#include "TextureProcessing.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <string>
+
+#include "TextureEncoding.h"
+#include "FileIO/FileIO.h"
+#include "Hashing/Hash.h"
+#include "Logging/Logger.h"
+#include "Threading/ThreadPool.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_STDIO
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_TGA
+#define STBI_ONLY_BMP
+#include "stb_image.h"
+
+#include "Simd.h"
+
+// Linear values are quantized to this many steps before the sRGB lookup
+static constexpr u32 SRGB_ENCODE_TABLE_SIZE = 4096;
+
+static const std::array<f32, 256>& get_srgb_decode_table() {
+    static const std::array<f32, 256> table = [] {
+        std::array<f32, 256> values{};
+        for (u32 i = 0; i < 256; i++) {
+            const f32 value = static_cast<f32>(i) / 255.0f;
+            values[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table;
+}
+
+static const std::array<u8, SRGB_ENCODE_TABLE_SIZE>& get_srgb_encode_table() {
+    static const std::array<u8, SRGB_ENCODE_TABLE_SIZE> table = [] {
+        std::array<u8, SRGB_ENCODE_TABLE_SIZE> values{};
+        for (u32 i = 0; i < SRGB_ENCODE_TABLE_SIZE; i++) {
+            const f32 value = static_cast<f32>(i) / static_cast<f32>(SRGB_ENCODE_TABLE_SIZE - 1);
+            const f32 encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            values[i] = static_cast<u8>(std::lround(std::clamp(encoded, 0.0f, 1.0f) * 255.0f));
+        }
+        return values;
+    }();
+    return table;
+}
+
+static bool is_normal_map_path(std::string_view source_path) {
+    const size_t extension = source_path.rfind('.');
+    const std::string_view stem = source_path.substr(0, extension);
+    return stem.ends_with("_n") || stem.ends_with("_normal") || stem.ends_with("_nrm");
+}
+
+// Runs rows through fn on the pool when there is one
+template<typename Fn>
+static void for_each_row(engine::ThreadPool* thread_pool, u32 rows, Fn&& fn) {
+    if (thread_pool) {
+        thread_pool->parallel_for(rows, 16, fn);
+    } else {
+        fn(0, rows);
+    }
+}
+
+// 2x2 box filter of one level into the next, for target rows [row_begin, row_end)
+static void downsample_rows(const f32* source, u32 width, u32 height, f32* target, u32 target_width, size_t row_begin, size_t row_end) {
+#ifdef ENGINE_HAS_SSE
+    const __m128 quarter = _mm_set1_ps(0.25f);
+#endif
+    for (size_t y = row_begin; y < row_end; y++) {
+        const size_t y0 = std::min<size_t>(y * 2, height - 1);
+        const size_t y1 = std::min<size_t>(y * 2 + 1, height - 1);
+        const f32* row0 = source + y0 * width * 4;
+        const f32* row1 = source + y1 * width * 4;
+        f32* output = target + y * target_width * 4;
+        for (u32 x = 0; x < target_width; x++) {
+            const u32 x0 = std::min(x * 2, width - 1) * 4;
+            const u32 x1 = std::min(x * 2 + 1, width - 1) * 4;
+#ifdef ENGINE_HAS_SSE
+            const __m128 top = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+            const __m128 bottom = _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1));
+            _mm_storeu_ps(output + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+#else
+            for (u32 channel = 0; channel < 4; channel++) {
+                output[x * 4 + channel] = (row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel]) * 0.25f;
+            }
+#endif
+        }
+    }
+}
+
+// Rescales the XYZ a normal map stores as 0..1 back to unit length
+static void renormalize_rows(f32* texels, u32 width, size_t row_begin, size_t row_end) {
+    for (size_t i = row_begin * width; i < row_end * width; i++) {
+        f32* texel = texels + i * 4;
+        const f32 x = texel[0] * 2.0f - 1.0f;
+        const f32 y = texel[1] * 2.0f - 1.0f;
+        const f32 z = texel[2] * 2.0f - 1.0f;
+        const f32 length = std::sqrt(x * x + y * y + z * z);
+        if (length > 0.0f) {
+            texel[0] = x / length * 0.5f + 0.5f;
+            texel[1] = y / length * 0.5f + 0.5f;
+            texel[2] = z / length * 0.5f + 0.5f;
+        }
+    }
+}
+
+static void quantize_rows(const f32* texels, u32 width, bool srgb, u8* pixels, size_t row_begin, size_t row_end) {
+    const std::array<u8, SRGB_ENCODE_TABLE_SIZE>& encode_table = get_srgb_encode_table();
+    for (size_t i = row_begin * width * 4; i < row_end * width * 4; i++) {
+        const f32 value = std::clamp(texels[i], 0.0f, 1.0f);
+        if (srgb && i % 4 != 3) {
+            pixels[i] = encode_table[static_cast<size_t>(value * static_cast<f32>(SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)];
+        } else {
+            pixels[i] = static_cast<u8>(value * 255.0f + 0.5f);
+        }
+    }
+}
+
+bool load_image(std::span<const byte> contents, TextureImage& image) {
+    i32 width = 0;
+    i32 height = 0;
+    i32 channels = 0;
+    stbi_uc* pixels = stbi_load_from_memory(contents.data(), static_cast<i32>(contents.size()), &width, &height, &channels, 4);
+    if (pixels == nullptr) {
+        return false;
+    }
+    image.width = static_cast<u32>(width);
+    image.height = static_cast<u32>(height);
+    image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+TextureImportSettings get_texture_import_settings(std::string_view source_path, const TextureImage& image, bool fast_encoding) {
+    TextureImportSettings settings{};
+    settings.normal_map = is_normal_map_path(source_path);
+    settings.srgb = !settings.normal_map;
+    for (size_t i = 3; i < image.pixels.size() && !settings.normal_map; i += 4) {
+        if (image.pixels[i] != 255) {
+            settings.has_alpha = true;
+            break;
+        }
+    }
+    if (settings.normal_map) {
+        settings.format = TextureFormat::BC5;
+    } else if (!fast_encoding) {
+        settings.format = TextureFormat::BC7;
+    } else {
+        settings.format = settings.has_alpha ? TextureFormat::BC3 : TextureFormat::BC1;
+    }
+    return settings;
+}
+
+std::vector<TextureImage> generate_mips(TextureImage image, const TextureImportSettings& settings, engine::ThreadPool* thread_pool) {
+    const u32 level_count = std::bit_width(std::max(image.width, image.height));
+    std::vector<TextureImage> levels;
+    levels.reserve(level_count);
+
+    // Filtering happens on linear floats, each level is built from the
+    // unquantized one above it
+    u32 width = image.width;
+    u32 height = image.height;
+    std::vector<f32> texels(static_cast<size_t>(width) * height * 4);
+    const std::array<f32, 256>& decode_table = get_srgb_decode_table();
+    for_each_row(thread_pool, height, [&](size_t begin, size_t end) {
+        for (size_t i = begin * width * 4; i < end * width * 4; i++) {
+            texels[i] = settings.srgb && i % 4 != 3 ? decode_table[image.pixels[i]] : static_cast<f32>(image.pixels[i]) / 255.0f;
+        }
+    });
+    levels.push_back(std::move(image));
+
+    std::vector<f32> next_texels;
+    while (levels.size() < level_count) {
+        const u32 next_width = std::max(width / 2, 1u);
+        const u32 next_height = std::max(height / 2, 1u);
+        next_texels.resize(static_cast<size_t>(next_width) * next_height * 4);
+        TextureImage& level = levels.emplace_back();
+        level.width = next_width;
+        level.height = next_height;
+        level.pixels.resize(next_texels.size());
+        for_each_row(thread_pool, next_height, [&](size_t begin, size_t end) {
+            downsample_rows(texels.data(), width, height, next_texels.data(), next_width, begin, end);
+            if (settings.normal_map) {
+                renormalize_rows(next_texels.data(), next_width, begin, end);
+            }
+            quantize_rows(next_texels.data(), next_width, settings.srgb, level.pixels.data(), begin, end);
+        });
+        texels.swap(next_texels);
+        width = next_width;
+        height = next_height;
+    }
+    return levels;
+}
+
+bool cook_texture(const char* source_path, const char* output_path, bool fast_encoding, engine::ThreadPool* thread_pool) {
+    const io::MappedFile source{source_path, io::MapHint::SEQUENTIAL};
+    TextureImage image;
+    if (!source.is_valid() || !load_image(std::span<const byte>{source.data(), source.size()}, image)) {
+        // stb leaves no reason when the file could not even be mapped, and fmt
+        // throws on a null string
+        const char* reason = source.is_valid() ? stbi_failure_reason() : "cannot open file";
+        ENGINE_LOG_ERROR("Failed to decode texture {}: {}", source_path, reason ? reason : "unknown")
+        return false;
+    }
+    const TextureImportSettings settings = get_texture_import_settings(source_path, image, fast_encoding);
+    const u32 width = image.width;
+    const u32 height = image.height;
+    const std::vector<TextureImage> levels = generate_mips(std::move(image), settings, thread_pool);
+
+    std::vector<EncodedMip> mips(levels.size());
+    u64 encoded_size = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        mips[i] = EncodedMip{levels[i].width, levels[i].height, encode_texture(levels[i].pixels, levels[i].width, levels[i].height, settings.format,
+            thread_pool)};
+        encoded_size += mips[i].data.size();
+    }
+
+    TextureFileHeader header{};
+    header.magic = TEXTURE_FILE_MAGIC;
+    header.version = TEXTURE_FILE_VERSION;
+    header.source_key = engine::hash::combine(engine::hash::xxh64(source.data(), source.size()), fast_encoding);
+    header.cooker_version = TEXTURE_COOKER_VERSION;
+    header.format = settings.format;
+    header.width = width;
+    header.height = height;
+    header.flags = (settings.srgb ? static_cast<u32>(TEXTURE_FLAG_SRGB) : 0u) | (settings.normal_map ? static_cast<u32>(TEXTURE_FLAG_NORMAL_MAP) : 0u)
+        | (settings.has_alpha ? static_cast<u32>(TEXTURE_FLAG_HAS_ALPHA) : 0u);
+    ENGINE_LOG_INFO("Cooked {}x{} texture {} with {} mips, {} KB", width, height, source_path, mips.size(), encoded_size / 1024)
+    return write_texture_file(output_path, header, mips);
+}
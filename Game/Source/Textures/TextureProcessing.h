@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+#include "TextureFile.h"
+
+namespace engine {
+class ThreadPool;
+}
+
+// Decoded RGBA8 pixels, rows top to bottom
+struct TextureImage {
+    u32 width = 0;
+    u32 height = 0;
+    std::vector<u8> pixels;
+};
+
+struct TextureImportSettings {
+    TextureFormat format;
+    // Color data, mips are filtered in linear space and the GPU decodes on sampling
+    bool srgb;
+    // Renormalized after every downsample, only X and Y survive encoding
+    bool normal_map;
+    bool has_alpha;
+};
+
+bool load_image(std::span<const byte> contents, TextureImage& image);
+// *_n, *_normal and *_nrm names are linear BC5 normal maps, everything else is
+// sRGB color. Color is BC7, or with fast encoding BC1 when opaque and BC3 otherwise.
+TextureImportSettings get_texture_import_settings(std::string_view source_path, const TextureImage& image, bool fast_encoding);
+// The full chain down to 1x1, levels[0] is the image itself. Every level is a
+// 2x2 box filter of the one above in linear space, odd edges repeat the last texel.
+std::vector<TextureImage> generate_mips(TextureImage image, const TextureImportSettings& settings, engine::ThreadPool* thread_pool);
+
+// Decodes the source, builds and encodes every level and writes a texture file
+bool cook_texture(const char* source_path, const char* output_path, bool fast_encoding, engine::ThreadPool* thread_pool);
@@ -0,0 +1,345 @@
+﻿#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+#include "Components/Components.h"
+#include "Logging/Logger.h"
+#include "Rendering/Camera.h"
+
+u32 compute_required_mip(u32 width, u32 height, u32 mip_count, f32 projected_size) {
+    const f32 size = static_cast<f32>(std::max(width, height));
+    if (mip_count == 0 || !(projected_size < size)) {
+        return 0;
+    }
+    // Rounded down, a level too sharp beats a blurry one
+    const f32 level = std::floor(std::log2(size / std::max(projected_size, 1.0f)));
+    return std::min(static_cast<u32>(level), mip_count - 1);
+}
+
+TextureStreamer::TextureStreamer(flecs::world& world, io::AsyncIOService& io_service, UploadCallback upload, ShrinkCallback shrink, u64 budget,
+    const io::PackFile* pack)
+    : m_io_service_(io_service), m_pack_(pack), m_upload_(std::move(upload)), m_shrink_(std::move(shrink)), m_budget_(budget), m_committed_bytes_(0), m_frame_(0), m_reads_in_flight_(0),
+      m_viewport_height_(800.0f), m_camera_position_(0.0f), m_pixels_per_unit_(0.0f) {
+    // Systems of a phase run in declaration order, requests land between the
+    // view and the update of the same frame
+    m_register_system_ = world.system<const components::TextureSource>("Register Entity Textures")
+        .kind(flecs::PreStore)
+        .without<components::TextureRef>()
+        .each([this](flecs::entity entity, const components::TextureSource& source) {
+            // A texture that fails to register is not retried, the invalid
+            // handle is ignored by the requests
+            entity.set(components::TextureRef{register_texture(source.path), source.uv_repeat});
+        });
+    m_view_system_ = world.system("Texture Streaming View")
+        .kind(flecs::PreStore)
+        .run([this](flecs::iter& iter) {
+            const Camera* camera = iter.world().get<Camera>();
+            m_pixels_per_unit_ = 0.0f;
+            if (camera != nullptr) {
+                m_camera_position_ = glm::vec3{glm::inverse(camera->get_view())[3]};
+                m_pixels_per_unit_ = m_viewport_height_ * 0.5f * std::abs(camera->get_projection()[1][1]);
+            }
+        });
+    m_request_system_ = world.system<const components::Transform3D, const components::Bounds, const components::TextureRef>("Request Texture Mips")
+        .kind(flecs::PreStore)
+        .each([this](const components::Transform3D& transform, const components::Bounds& bounds, const components::TextureRef& texture_ref) {
+            if (m_pixels_per_unit_ == 0.0f || texture_ref.texture >= m_textures_.size()) {
+                return;
+            }
+            // Distance to the nearest point of the bounding sphere, so the
+            // texture is at full size once the camera is inside it
+            const glm::vec4 sphere = bounds.world_sphere(transform);
+            const f32 distance = std::max(glm::distance(glm::vec3{sphere}, m_camera_position_) - sphere.w, 1e-3f);
+            const f32 projected_size = 2.0f * sphere.w * m_pixels_per_unit_ / (distance * texture_ref.uv_repeat);
+            const TextureFileHeader& header = m_textures_[texture_ref.texture].header;
+            request(texture_ref.texture, compute_required_mip(header.width, header.height, header.mip_count, projected_size), projected_size);
+        });
+    m_update_system_ = world.system("Stream Textures")
+        .kind(flecs::PreStore)
+        .run([this](flecs::iter&) {
+            update();
+        });
+}
+
+TextureStreamer::~TextureStreamer() {
+    m_register_system_.destruct();
+    m_view_system_.destruct();
+    m_request_system_.destruct();
+    m_update_system_.destruct();
+    for (StreamedTexture& texture : m_textures_) {
+        if (texture.read) {
+            m_io_service_.wait(texture.read);
+        }
+    }
+}
+
+u64 TextureStreamer::get_range_size(const StreamedTexture& texture, u32 level) {
+    if (level >= texture.mips.size()) {
+        return 0;
+    }
+    return texture.mips[level].offset + texture.mips[level].size - texture.mips.back().offset;
+}
+
+TextureHandle TextureStreamer::register_texture(const std::string& path) {
+    if (const auto it = m_handles_.find(path); it != m_handles_.end()) {
+        return it->second;
+    }
+    StreamedTexture& texture = m_textures_.emplace_back();
+    texture.path = path;
+    texture.read_path = path;
+    texture.base_offset = 0;
+    const io::PackEntry* entry = m_pack_ ? m_pack_->find(path) : nullptr;
+    if (entry != nullptr) {
+        // Levels are read as ranges of the entry, which only works in place
+        if (entry->compression != io::PackCompression::NONE) {
+            ENGINE_LOG_ERROR("Texture {} is compressed in {}, textures have to be packed uncompressed", path, m_pack_->get_path())
+            m_textures_.pop_back();
+            return INVALID_TEXTURE;
+        }
+        texture.read_path = m_pack_->get_path();
+        texture.base_offset = entry->offset;
+    }
+    u64 bytes_read = 0;
+    const i32 error = io::read_file_range(texture.read_path.c_str(), texture.base_offset, sizeof(TextureFileHeader), &texture.header, bytes_read);
+    const TextureFileHeader& header = texture.header;
+    if (error != 0 || bytes_read != sizeof(TextureFileHeader) || header.magic != TEXTURE_FILE_MAGIC || header.version != TEXTURE_FILE_VERSION
+        || header.mip_count == 0) {
+        ENGINE_LOG_ERROR("Failed to register texture {}", path)
+        m_textures_.pop_back();
+        return INVALID_TEXTURE;
+    }
+    texture.mips.resize(header.mip_count);
+    const u64 table_size = header.mip_count * sizeof(TextureMip);
+    if (io::read_file_range(texture.read_path.c_str(), texture.base_offset + sizeof(TextureFileHeader), table_size, texture.mips.data(), bytes_read) != 0
+        || bytes_read != table_size) {
+        ENGINE_LOG_ERROR("Texture file {} is truncated", path)
+        m_textures_.pop_back();
+        return INVALID_TEXTURE;
+    }
+    texture.tail_level = header.mip_count - 1;
+    while (texture.tail_level > 0 && std::max(texture.mips[texture.tail_level - 1].width, texture.mips[texture.tail_level - 1].height)
+        <= TEXTURE_RESIDENT_TAIL_SIZE) {
+        texture.tail_level--;
+    }
+    texture.resident_level = header.mip_count;
+    texture.target_level = header.mip_count;
+    texture.requested_level = header.mip_count;
+    texture.wanted_level = texture.tail_level;
+
+    // The tail is read by the next update like every other level, so a burst
+    // of registrations stays within the reads in flight
+    const TextureHandle handle = static_cast<TextureHandle>(m_textures_.size() - 1);
+    m_handles_.emplace(path, handle);
+    return handle;
+}
+
+void TextureStreamer::request(TextureHandle texture, u32 level, f32 priority) {
+    if (texture >= m_textures_.size()) {
+        return;
+    }
+    StreamedTexture& streamed = m_textures_[texture];
+    streamed.requested_level = std::min(streamed.requested_level, level);
+    streamed.priority += priority;
+}
+
+void TextureStreamer::update() {
+    m_frame_++;
+    m_candidates_.clear();
+    for (TextureHandle handle = 0; handle < m_textures_.size(); handle++) {
+        StreamedTexture& texture = m_textures_[handle];
+        const bool is_used = texture.requested_level < texture.mips.size();
+        if (is_used) {
+            texture.last_used_frame = m_frame_;
+        }
+        texture.wanted_level = std::min(texture.requested_level, texture.tail_level);
+        texture.last_priority = texture.priority;
+        texture.requested_level = static_cast<u32>(texture.mips.size());
+        if (!texture.failed && !texture.read && texture.wanted_level < texture.target_level) {
+            // A texture without its tail has nothing to draw with and goes
+            // first, then bigger on screen and further from what it needs
+            if (texture.target_level == texture.mips.size()) {
+                texture.priority = std::numeric_limits<f32>::max();
+            } else {
+                texture.priority *= static_cast<f32>(texture.target_level - texture.wanted_level);
+            }
+            m_candidates_.push_back(handle);
+        } else {
+            texture.priority = 0.0f;
+        }
+    }
+    // A lowered budget is met before anything new comes in
+    if (m_committed_bytes_ > m_budget_) {
+        const u64 excess = m_committed_bytes_ - m_budget_;
+        const u64 freed = evict(excess, INVALID_TEXTURE);
+        if (freed < excess) {
+            coarsen(excess - freed);
+        }
+    }
+    std::sort(m_candidates_.begin(), m_candidates_.end(), [this](TextureHandle a, TextureHandle b) {
+        return m_textures_[a].priority > m_textures_[b].priority;
+    });
+
+    for (const TextureHandle handle : m_candidates_) {
+        StreamedTexture& texture = m_textures_[handle];
+        texture.priority = 0.0f;
+        if (m_reads_in_flight_ >= MAX_TEXTURE_READS_IN_FLIGHT) {
+            continue;
+        }
+        const u64 current_size = get_range_size(texture, texture.target_level);
+        const u64 wanted_size = get_range_size(texture, texture.wanted_level);
+        if (m_committed_bytes_ + wanted_size - current_size > m_budget_) {
+            evict(m_committed_bytes_ + wanted_size - current_size - m_budget_, handle);
+        }
+        // Settle for the finest level that fits when eviction fell short. The
+        // tail is loaded even when it goes over the budget.
+        const u32 coarsest_level = texture.target_level == texture.mips.size() ? texture.tail_level : texture.target_level;
+        u32 level = texture.wanted_level;
+        while (level < coarsest_level && m_committed_bytes_ + get_range_size(texture, level) - current_size > m_budget_) {
+            level++;
+        }
+        if (level < texture.target_level) {
+            stream(handle, level);
+        }
+    }
+}
+
+u64 TextureStreamer::evict(u64 bytes, TextureHandle keep) {
+    m_victims_.clear();
+    for (TextureHandle handle = 0; handle < m_textures_.size(); handle++) {
+        const StreamedTexture& texture = m_textures_[handle];
+        if (handle != keep && !texture.read && texture.target_level < texture.wanted_level) {
+            m_victims_.push_back(handle);
+        }
+    }
+    std::sort(m_victims_.begin(), m_victims_.end(), [this](TextureHandle a, TextureHandle b) {
+        return m_textures_[a].last_used_frame < m_textures_[b].last_used_frame;
+    });
+    u64 freed = 0;
+    for (const TextureHandle handle : m_victims_) {
+        if (freed >= bytes) {
+            break;
+        }
+        StreamedTexture& texture = m_textures_[handle];
+        freed += get_range_size(texture, texture.target_level) - get_range_size(texture, texture.wanted_level);
+        shrink(handle, texture.wanted_level);
+    }
+    return freed;
+}
+
+void TextureStreamer::coarsen(u64 bytes) {
+    m_victims_.clear();
+    for (TextureHandle handle = 0; handle < m_textures_.size(); handle++) {
+        const StreamedTexture& texture = m_textures_[handle];
+        if (!texture.read && texture.target_level < texture.tail_level) {
+            m_victims_.push_back(handle);
+        }
+    }
+    std::sort(m_victims_.begin(), m_victims_.end(), [this](TextureHandle a, TextureHandle b) {
+        return m_textures_[a].last_priority < m_textures_[b].last_priority;
+    });
+    // Always the cheapest level to drop, taking a big texture down a level
+    // frees three times a smaller one's and the extra room is read back in
+    m_victim_levels_.clear();
+    for (const TextureHandle handle : m_victims_) {
+        m_victim_levels_.push_back(m_textures_[handle].target_level);
+    }
+    u64 freed = 0;
+    while (freed < bytes) {
+        size_t cheapest = m_victims_.size();
+        u64 cheapest_size = 0;
+        for (size_t i = 0; i < m_victims_.size(); i++) {
+            const StreamedTexture& texture = m_textures_[m_victims_[i]];
+            const u32 level = m_victim_levels_[i];
+            if (level >= texture.tail_level) {
+                continue;
+            }
+            const u64 size = get_range_size(texture, level) - get_range_size(texture, level + 1);
+            if (cheapest == m_victims_.size() || size < cheapest_size) {
+                cheapest = i;
+                cheapest_size = size;
+            }
+        }
+        if (cheapest == m_victims_.size()) {
+            break;
+        }
+        m_victim_levels_[cheapest]++;
+        freed += cheapest_size;
+    }
+    // The last drop can cover earlier ones, those are given back starting
+    // with the most important texture
+    for (size_t i = m_victims_.size(); i-- > 0;) {
+        const StreamedTexture& texture = m_textures_[m_victims_[i]];
+        u32& level = m_victim_levels_[i];
+        while (level > texture.target_level && freed - (get_range_size(texture, level - 1) - get_range_size(texture, level)) >= bytes) {
+            freed -= get_range_size(texture, level - 1) - get_range_size(texture, level);
+            level--;
+        }
+    }
+    for (size_t i = 0; i < m_victims_.size(); i++) {
+        if (m_victim_levels_[i] != m_textures_[m_victims_[i]].target_level) {
+            shrink(m_victims_[i], m_victim_levels_[i]);
+        }
+    }
+}
+
+void TextureStreamer::stream(TextureHandle handle, u32 level) {
+    StreamedTexture& texture = m_textures_[handle];
+    // Counted at the new size right away, so reads in flight are within the budget
+    m_committed_bytes_ = m_committed_bytes_ - get_range_size(texture, texture.target_level) + get_range_size(texture, level);
+    texture.target_level = level;
+    texture.staging.resize(get_range_size(texture, level));
+    const io::ReadRequest request{texture.read_path.c_str(), texture.base_offset + texture.mips.back().offset, texture.staging.size(), texture.staging.data()};
+    m_reads_in_flight_++;
+    texture.read = m_io_service_.submit(std::span{&request, 1}, [this, handle](const io::ReadBatch& batch) {
+        complete(handle, batch);
+    });
+}
+
+void TextureStreamer::shrink(TextureHandle handle, u32 level) {
+    StreamedTexture& texture = m_textures_[handle];
+    // Victims have no read in flight, so what they target is what is resident
+    m_committed_bytes_ = m_committed_bytes_ - get_range_size(texture, texture.resident_level) + get_range_size(texture, level);
+    texture.resident_level = level;
+    texture.target_level = level;
+    m_shrink_(handle, texture.path.c_str(), level);
+}
+
+void TextureStreamer::complete(TextureHandle handle, const io::ReadBatch& batch) {
+    StreamedTexture& texture = m_textures_[handle];
+    m_reads_in_flight_--;
+    texture.read.reset();
+    if (batch.succeeded() && batch.results()[0].bytes_read == texture.staging.size()) {
+        texture.resident_level = texture.target_level;
+        m_upload_(TextureUpload{handle, texture.path.c_str(), &texture.header, texture.resident_level, texture.mips, texture.staging});
+    } else {
+        // A file that fails once is left at what it has rather than retried every frame
+        ENGINE_LOG_ERROR("Failed to stream level {} of {}", texture.target_level, texture.path)
+        m_committed_bytes_ = m_committed_bytes_ - get_range_size(texture, texture.target_level) + get_range_size(texture, texture.resident_level);
+        texture.target_level = texture.resident_level;
+        texture.failed = true;
+    }
+    std::vector<byte>{}.swap(texture.staging);
+}
+
+void TextureStreamer::set_budget(u64 bytes) {
+    m_budget_ = bytes;
+}
+
+void TextureStreamer::set_viewport_height(f32 height) {
+    m_viewport_height_ = height;
+}
+
+u32 TextureStreamer::get_resident_level(TextureHandle texture) const {
+    return m_textures_[texture].resident_level;
+}
+
+u64 TextureStreamer::get_committed_bytes() const {
+    return m_committed_bytes_;
+}
+
+u64 TextureStreamer::get_budget() const {
+    return m_budget_;
+}
@@ -0,0 +1,145 @@
+﻿#pragma once
+
+#include <deque>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "flecs.h"
+#include "FileIO/AsyncIO.h"
+#include "FileIO/PackFile.h"
+#include "robin_hood.h"
+#include "TextureFile.h"
+
+using TextureHandle = u32;
+static constexpr TextureHandle INVALID_TEXTURE = ~0u;
+// Levels this size and smaller load on registration and are never evicted
+static constexpr u32 TEXTURE_RESIDENT_TAIL_SIZE = 64;
+static constexpr u64 DEFAULT_TEXTURE_BUDGET = 256ull << 20;
+// Further reads wait for a later frame, in priority order
+static constexpr u32 MAX_TEXTURE_READS_IN_FLIGHT = 8;
+
+// Levels [level, mip_count) of a texture, read from the file as one range
+struct TextureUpload {
+    TextureHandle texture;
+    const char* path;
+    const TextureFileHeader* header;
+    // Finest level in data, every coarser one down to 1x1 follows
+    u32 level;
+    std::span<const TextureMip> mips;
+    std::span<const byte> data;
+
+    [[nodiscard]] std::span<const byte> level_data(u32 mip_level) const {
+        return data.subspan(mips[mip_level].offset - mips.back().offset, mips[mip_level].size);
+    }
+};
+
+// Finest level worth loading for a texture that spans projected_size pixels
+// on screen, one texel per pixel
+u32 compute_required_mip(u32 width, u32 height, u32 mip_count, f32 projected_size);
+
+// Keeps the small tail of every registered texture resident and streams finer
+// levels in as they become visible. Entities with a TextureRef request a level
+// from their on-screen size every frame, the most important misses are read
+// asynchronously within a byte budget, and the least recently used textures
+// drop back down to what is still needed when the budget runs out. Finished
+// reads go to the upload callback from the IO poll at the start of a frame.
+// Dropping levels reads nothing, the shrink callback keeps the coarser levels
+// already uploaded.
+class TextureStreamer {
+public:
+    using UploadCallback = std::function<void(const TextureUpload&)>;
+    // Levels finer than level are no longer needed, [level, mip_count) stay
+    using ShrinkCallback = std::function<void(TextureHandle texture, const char* path, u32 level)>;
+private:
+    struct StreamedTexture {
+        std::string path;
+        // The pack holding the texture or path itself, with where the texture
+        // file starts in it
+        std::string read_path;
+        u64 base_offset;
+        TextureFileHeader header;
+        std::vector<TextureMip> mips;
+        // Finest level of the tail
+        u32 tail_level;
+        // Finest level uploaded, mip_count until the tail arrives
+        u32 resident_level;
+        // Differs from resident_level while a read is in flight
+        u32 target_level;
+        // Finest level requested this frame, mip_count when nothing asked
+        u32 requested_level;
+        // What the last update decided to keep, the tail when unused
+        u32 wanted_level;
+        f32 priority;
+        // Priority requested in the last update, orders coarsening
+        f32 last_priority;
+        u64 last_used_frame;
+        bool failed;
+        std::vector<byte> staging;
+        io::ReadBatchHandle read;
+    };
+
+    io::AsyncIOService& m_io_service_;
+    const io::PackFile* m_pack_;
+    UploadCallback m_upload_;
+    ShrinkCallback m_shrink_;
+    // Deque so paths and buffers of reads in flight stay put as textures are added
+    std::deque<StreamedTexture> m_textures_;
+    // Registered textures by path, entities sharing a file share its levels
+    robin_hood::unordered_node_map<std::string, TextureHandle> m_handles_;
+    u64 m_budget_;
+    // Bytes of every texture at its target level
+    u64 m_committed_bytes_;
+    u64 m_frame_;
+    u32 m_reads_in_flight_;
+    f32 m_viewport_height_;
+    glm::vec3 m_camera_position_;
+    // Projected size of one unit at distance 1, 0 without a camera
+    f32 m_pixels_per_unit_;
+    std::vector<TextureHandle> m_candidates_;
+    std::vector<TextureHandle> m_victims_;
+    std::vector<u32> m_victim_levels_;
+    flecs::system m_register_system_;
+    flecs::system m_view_system_;
+    flecs::system m_request_system_;
+    flecs::system m_update_system_;
+
+    static u64 get_range_size(const StreamedTexture& texture, u32 level);
+    void stream(TextureHandle handle, u32 level);
+    // Drops the resident levels finer than level, right away and without a read
+    void shrink(TextureHandle handle, u32 level);
+    void complete(TextureHandle handle, const io::ReadBatch& batch);
+    // Drops the least recently used textures down to their wanted level until
+    // bytes are freed or nothing is left to drop, returns the bytes freed
+    u64 evict(u64 bytes, TextureHandle keep);
+    // Last resort when what is visible alone is over the budget, drops the
+    // textures requested with the lowest priority towards their tail
+    void coarsen(u64 bytes);
+public:
+    // Textures are read from pack first when one is given, in place, so they
+    // have to be packed uncompressed
+    TextureStreamer(flecs::world& world, io::AsyncIOService& io_service, UploadCallback upload, ShrinkCallback shrink,
+        u64 budget = DEFAULT_TEXTURE_BUDGET, const io::PackFile* pack = nullptr);
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+    TextureStreamer(TextureStreamer&&) = delete;
+    TextureStreamer& operator=(TextureStreamer&&) = delete;
+    ~TextureStreamer();
+
+    // Reads the header and queues the tail for the next update, INVALID_TEXTURE
+    // when the file is missing or not a texture. A path registers once.
+    TextureHandle register_texture(const std::string& path);
+    // The finest level requested in a frame wins, priorities add up
+    void request(TextureHandle texture, u32 level, f32 priority);
+    // Issues reads for the most important missing levels, once per frame after the requests
+    void update();
+
+    void set_budget(u64 bytes);
+    void set_viewport_height(f32 height);
+    [[nodiscard]] u32 get_resident_level(TextureHandle texture) const;
+    [[nodiscard]] u64 get_committed_bytes() const;
+    [[nodiscard]] u64 get_budget() const;
+};
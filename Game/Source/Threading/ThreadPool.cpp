@@ -0,0 +1,105 @@
+﻿#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace engine {
+
+ThreadPool::ThreadPool(u32 thread_count) : m_running_(true) {
+    if (thread_count == 0) {
+        thread_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    m_workers_.reserve(thread_count);
+    for (u32 i = 0; i < thread_count; i++) {
+        m_workers_.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    m_running_.store(false, std::memory_order_release);
+    // Wake every worker with an empty job so it can observe the flag
+    for (size_t i = 0; i < m_workers_.size(); i++) {
+        m_jobs_.enqueue(QueuedJob{});
+    }
+    for (std::thread& worker : m_workers_) {
+        worker.join();
+    }
+    // Workers may exit on their token before reaching later jobs, finish them
+    // here so no counter is left waiting forever
+    QueuedJob queued_job;
+    while (m_jobs_.try_dequeue(queued_job) || m_background_jobs_.try_dequeue(queued_job)) {
+        run_job(queued_job);
+    }
+}
+
+void ThreadPool::run_job(QueuedJob& queued_job) {
+    if (queued_job.job) {
+        queued_job.job();
+    }
+    if (queued_job.counter && queued_job.counter->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Taking the lock orders this against a waiter between its check and
+        // its sleep, so the wake up cannot be lost
+        { std::lock_guard lock{m_wait_mutex_}; }
+        m_wait_condition_.notify_all();
+    }
+}
+
+void ThreadPool::worker_loop() {
+    QueuedJob queued_job;
+    while (true) {
+        if (!m_jobs_.try_dequeue(queued_job) && !m_background_jobs_.try_dequeue(queued_job)) {
+            m_jobs_.wait_dequeue(queued_job);
+        }
+        if (!queued_job.job && !m_running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        run_job(queued_job);
+    }
+}
+
+void ThreadPool::submit(Job job, JobCounter* counter) {
+    if (counter) {
+        counter->remaining.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_jobs_.enqueue(QueuedJob{std::move(job), counter});
+}
+
+void ThreadPool::submit_background(Job job, JobCounter* counter) {
+    if (counter) {
+        counter->remaining.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_background_jobs_.enqueue(QueuedJob{std::move(job), counter});
+    // An empty job wakes a sleeping worker, which then finds the background one
+    m_jobs_.enqueue(QueuedJob{});
+}
+
+void ThreadPool::wait(JobCounter& counter) {
+    QueuedJob queued_job;
+    u32 held_tokens = 0;
+    while (counter.remaining.load(std::memory_order_acquire) > 0) {
+        if (m_jobs_.try_dequeue(queued_job)) {
+            if (queued_job.job) {
+                run_job(queued_job);
+            } else {
+                // Wake token meant for a worker, handed back before sleeping
+                held_tokens++;
+            }
+            continue;
+        }
+        for (; held_tokens > 0; held_tokens--) {
+            m_jobs_.enqueue(QueuedJob{});
+        }
+        std::unique_lock lock{m_wait_mutex_};
+        m_wait_condition_.wait(lock, [&counter] {
+            return counter.remaining.load(std::memory_order_acquire) == 0;
+        });
+    }
+    for (; held_tokens > 0; held_tokens--) {
+        m_jobs_.enqueue(QueuedJob{});
+    }
+}
+
+u32 ThreadPool::get_thread_count() const {
+    return static_cast<u32>(m_workers_.size());
+}
+
+}
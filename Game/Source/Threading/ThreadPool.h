@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "blockingconcurrentqueue.h"
+#include "common.h"
+
+namespace engine {
+
+// Counts outstanding jobs so a caller can wait for a group of them
+struct JobCounter {
+    std::atomic<u32> remaining{0};
+};
+
+// Fixed set of worker threads pulling jobs from a lock-free queue. Threads
+// waiting on a JobCounter help by running queued jobs, so jobs may submit and
+// wait on more jobs without deadlocking the pool.
+class ThreadPool {
+public:
+    using Job = std::function<void()>;
+private:
+    struct QueuedJob {
+        Job job;
+        JobCounter* counter;
+    };
+
+    moodycamel::BlockingConcurrentQueue<QueuedJob> m_jobs_;
+    // Only taken by workers that found no regular job
+    moodycamel::ConcurrentQueue<QueuedJob> m_background_jobs_;
+    std::vector<std::thread> m_workers_;
+    std::atomic<bool> m_running_;
+    // wait() sleeps on this once there is nothing left to help with, it is
+    // signalled whenever a counter reaches zero
+    std::mutex m_wait_mutex_;
+    std::condition_variable m_wait_condition_;
+
+    void worker_loop();
+    void run_job(QueuedJob& queued_job);
+public:
+    // thread_count 0 leaves one hardware thread for the main thread
+    explicit ThreadPool(u32 thread_count = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+    ~ThreadPool();
+
+    void submit(Job job, JobCounter* counter = nullptr);
+    // Runs once the regular queue is empty. wait() does not pick these up,
+    // so a caller waiting on short jobs never gets stuck in a long one; a
+    // counter held by background jobs only drops as workers free up. Jobs
+    // still queued at destruction run on the destroying thread.
+    void submit_background(Job job, JobCounter* counter = nullptr);
+    // Runs queued jobs on the calling thread until the counter reaches zero,
+    // then sleeps until the jobs still running elsewhere finish
+    void wait(JobCounter& counter);
+
+    // Splits [0, count) into ranges of at most grain_size and calls
+    // fn(begin, end) for each in parallel. Blocks until all ranges are done.
+    template <typename Fn>
+    void parallel_for(size_t count, size_t grain_size, Fn&& fn);
+
+    [[nodiscard]] u32 get_thread_count() const;
+};
+
+template <typename Fn>
+void ThreadPool::parallel_for(size_t count, size_t grain_size, Fn&& fn) {
+    if (count == 0) {
+        return;
+    }
+    grain_size = grain_size == 0 ? 1 : grain_size;
+    if (count <= grain_size || m_workers_.empty()) {
+        fn(size_t{0}, count);
+        return;
+    }
+    JobCounter counter;
+    // The calling thread takes the first range itself
+    for (size_t begin = grain_size; begin < count; begin += grain_size) {
+        const size_t end = std::min(begin + grain_size, count);
+        submit([&fn, begin, end] {
+            fn(begin, end);
+        }, &counter);
+    }
+    fn(size_t{0}, grain_size);
+    wait(counter);
+}
+
+}
@@ -0,0 +1,91 @@
+project "AssetCooker"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   targetdir "Binaries/%{cfg.buildcfg}"
+   staticruntime "off"
+
+   local gameDir = "../../Game"
+
+   files { "Source/**.h", "Source/**.cpp",
+    gameDir .. "/Source/common.h",
+    gameDir .. "/Source/Components/**.h",
+    gameDir .. "/Source/Compression/**.h", gameDir .. "/Source/Compression/**.cpp",
+    gameDir .. "/Source/Containers/**.h",
+    gameDir .. "/Source/FileIO/**.h", gameDir .. "/Source/FileIO/**.cpp",
+    gameDir .. "/Source/Hashing/**.h", gameDir .. "/Source/Hashing/**.cpp",
+    gameDir .. "/Source/Logging/**.h", gameDir .. "/Source/Logging/**.cpp",
+    gameDir .. "/Source/Memory/**.h", gameDir .. "/Source/Memory/**.cpp",
+    gameDir .. "/Source/Models/**.h", gameDir .. "/Source/Models/**.cpp",
+    gameDir .. "/Source/Rendering/ShaderCompiler.h", gameDir .. "/Source/Rendering/ShaderCompiler.cpp",
+    gameDir .. "/Source/Textures/TextureFile.h", gameDir .. "/Source/Textures/TextureFile.cpp",
+    gameDir .. "/Source/Textures/TextureEncoding.h", gameDir .. "/Source/Textures/TextureEncoding.cpp",
+    gameDir .. "/Source/Textures/TextureProcessing.h", gameDir .. "/Source/Textures/TextureProcessing.cpp",
+    gameDir .. "/Source/Threading/**.h", gameDir .. "/Source/Threading/**.cpp",
+
+    gameDir .. "/Vendor/fmt/src/**.cc",
+    gameDir .. "/Vendor/spdlog/src/**.cpp" }
+
+   -- The doctest cases only build into the game
+   removefiles { gameDir .. "/Source/**Tests.cpp" }
+
+   defines
+   {
+       -- Keeps load_model importing sources in the Dist configuration
+       "ASSET_COOKER",
+       "GLM_FORCE_RADIANS",
+       "GLM_FORCE_DEPTH_ZERO_TO_ONE",
+       "SPDLOG_COMPILED_LIB",
+       "NOMINMAX",
+       "VC_EXTRALEAN",
+       "WIN32_LEAN_AND_MEAN",
+       "_CRT_SECURE_NO_WARNINGS",
+   }
+
+   local vulkanSDKPath = os.getenv("VULKAN_SDK")
+
+   includedirs
+   {
+      gameDir .. "/Source",
+      vulkanSDKPath .. "/Include",
+      gameDir .. "/Vendor/assimp/include",
+      gameDir .. "/Vendor/concurrentqueue/",
+      gameDir .. "/Vendor/fmt/include",
+      gameDir .. "/Vendor/glm",
+      gameDir .. "/Vendor/robin-hood-hashing",
+      gameDir .. "/Vendor/spdlog/include",
+      gameDir .. "/Vendor/stb",
+   }
+
+   links
+   {
+      vulkanSDKPath .. "/Lib/shaderc_shared.lib",
+      "assimp"
+   }
+
+   targetdir ("../../Binaries/" .. outputdir .. "/%{prj.name}")
+   objdir ("../../Binaries/Intermediates/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+       systemversion "latest"
+       defines { "WINDOWS" }
+
+   filter "toolset:msc*"
+       buildoptions { "/utf-8", "/FS" }
+
+   filter "configurations:Debug"
+       defines { "DEBUG" }
+       runtime "Debug"
+       symbols "On"
+
+   filter "configurations:Release"
+       defines { "RELEASE", "NDEBUG" }
+       runtime "Release"
+       optimize "On"
+       symbols "On"
+
+   filter "configurations:Dist"
+       defines { "DIST", "NDEBUG" }
+       runtime "Release"
+       optimize "On"
+       symbols "Off"
@@ -0,0 +1,151 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "CookManifest.h"
+#include "Cookers.h"
+#include "FileIO/AssetIndex.h"
+#include "FileIO/FileIO.h"
+#include "Hashing/Hash.h"
+#include "Memory/Arena.h"
+#include "Threading/ThreadPool.h"
+
+struct CookJob {
+    const Cooker* cooker;
+    // Relative to the root, the key of its manifest record
+    std::string source;
+    std::string source_path;
+    std::string output_path;
+    u64 key;
+    bool succeeded;
+    std::vector<std::string> dependencies;
+};
+
+static u64 hash_contents(const std::string& path) {
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        return 0;
+    }
+    const io::MappedFile file{path.c_str(), io::MapHint::SEQUENTIAL};
+    return engine::hash::xxh64(file.data(), file.size());
+}
+
+// Indexed files reuse the hash the index cached, 0 for missing files
+static u64 hash_file(const io::AssetIndex& index, const std::string& path) {
+    const std::optional<io::AssetEntry> entry = index.find(path);
+    return entry ? entry->content_hash : hash_contents(path);
+}
+
+static bool is_up_to_date(const io::AssetIndex& index, const std::string& root, const CookManifest& manifest, const CookJob& job) {
+    const CookRecord* record = manifest.find(job.source);
+    if (!record || record->key != job.key || record->output_hash == 0 || hash_file(index, job.output_path) != record->output_hash) {
+        return false;
+    }
+    return std::ranges::all_of(record->dependencies, [&](const CookDependency& dependency) {
+        return hash_file(index, root + '/' + dependency.path) == dependency.content_hash;
+    });
+}
+
+// Usage: AssetCooker <root> <content directory>... [--import-flags <flags>] [--fast-textures] [--force]
+// Cooks every source under the content directories into the runtime format
+// next to it, models to .mesh, shaders to .spv and images to .tex, so shipped
+// builds never import at startup. Sources whose inputs did not change since the
+// last run are skipped, tracked in <root>/cook_manifest.bin. --fast-textures
+// trades BC7 for BC1 and BC3 while iterating, --force cooks everything.
+int main(int argc, char** argv) {
+    engine::Logger::Init();
+    if (argc < 3) {
+        APP_LOG_ERROR("Usage: AssetCooker <root> <content directory>... [--import-flags <flags>] [--fast-textures] [--force]")
+        return 1;
+    }
+    std::string root = argv[1];
+    while (root.size() > 1 && (root.back() == '/' || root.back() == '\\')) {
+        root.pop_back();
+    }
+
+    CookSettings settings{};
+    bool force = false;
+    std::vector<const char*> content_directories;
+    for (int i = 2; i < argc; i++) {
+        if (std::strcmp(argv[i], "--import-flags") == 0 && i + 1 < argc) {
+            settings.model_import_flags = static_cast<u32>(std::strtoul(argv[++i], nullptr, 0));
+        } else if (std::strcmp(argv[i], "--fast-textures") == 0) {
+            settings.fast_texture_encoding = true;
+        } else if (std::strcmp(argv[i], "--force") == 0) {
+            force = true;
+        } else {
+            content_directories.push_back(argv[i]);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    engine::ThreadPool thread_pool;
+    settings.thread_pool = &thread_pool;
+    // Holds the entries and path table of the content index, grows with it
+    Arena index_arena;
+    io::AssetIndex index{&index_arena, root.c_str()};
+    const std::string index_cache_path = root + "/cooker_index.cache";
+    index.build(thread_pool, index_cache_path.c_str(), content_directories);
+    const std::string manifest_path = root + "/cook_manifest.bin";
+    CookManifest manifest;
+    manifest.load(manifest_path.c_str());
+
+    std::vector<CookJob> jobs;
+    robin_hood::unordered_flat_set<std::string> sources;
+    for (const io::AssetEntry& entry : index.entries()) {
+        const std::string_view relative_path = index.get_relative_path(entry);
+        const Cooker* cooker = find_cooker(relative_path);
+        if (!cooker) {
+            continue;
+        }
+        sources.emplace(relative_path);
+        CookJob job{cooker, std::string{relative_path}, root + '/' + std::string{relative_path}, {}, 0, false, {}};
+        job.output_path = cooker->get_output_path(job.source_path);
+        const u64 settings_key = cooker->get_settings_key ? cooker->get_settings_key(settings) : 0;
+        job.key = engine::hash::combine(engine::hash::combine(cooker->version, settings_key), entry.content_hash);
+        if (force || !is_up_to_date(index, root, manifest, job)) {
+            jobs.push_back(std::move(job));
+        }
+    }
+
+    // One job per source, the model importer spreads each model over the pool
+    // as well so a single large model still uses every core
+    thread_pool.parallel_for(jobs.size(), 1, [&jobs, &settings](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            CookJob& job = jobs[i];
+            job.succeeded = job.cooker->cook(settings, job.source_path, job.output_path, job.dependencies);
+        }
+    });
+
+    u32 failed = 0;
+    for (CookJob& job : jobs) {
+        if (!job.succeeded) {
+            // Without a record the source is cooked again on the next run
+            APP_LOG_ERROR("Failed to cook {} with the {} cooker", job.source, job.cooker->name)
+            failed++;
+            continue;
+        }
+        CookRecord record{job.source, job.key, hash_contents(job.output_path), {}};
+        std::ranges::sort(job.dependencies);
+        const auto duplicates = std::ranges::unique(job.dependencies);
+        job.dependencies.erase(duplicates.begin(), duplicates.end());
+        for (const std::string& dependency : job.dependencies) {
+            std::error_code error;
+            const std::string relative_path = std::filesystem::relative(dependency, root, error).generic_string();
+            record.dependencies.push_back(CookDependency{relative_path, hash_contents(dependency)});
+        }
+        manifest.set(std::move(record));
+    }
+    manifest.retain(sources);
+    manifest.save(manifest_path.c_str());
+
+    const auto elapsed = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start);
+    APP_LOG_INFO("Cooked {} of {} assets in {:.1f}ms on {} threads, {} failed", jobs.size() - failed, sources.size(), elapsed.count(),
+        thread_pool.get_thread_count() + 1, failed)
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+﻿#include "CookManifest.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "FileIO/FileIO.h"
+
+static constexpr u32 COOK_MANIFEST_MAGIC = 0x4D434753; // "SGCM"
+static constexpr u32 COOK_MANIFEST_VERSION = 1;
+
+struct CookManifestHeader {
+    u32 magic;
+    u32 version;
+    u32 record_count;
+    u32 reserved;
+};
+
+// Bounds checked reads over the mapped manifest
+struct ManifestReader {
+    const byte* current;
+    const byte* end;
+    bool failed = false;
+
+    template <typename T>
+    T read() {
+        T value{};
+        if (static_cast<size_t>(end - current) < sizeof(T)) {
+            failed = true;
+            return value;
+        }
+        std::memcpy(&value, current, sizeof(T));
+        current += sizeof(T);
+        return value;
+    }
+
+    std::string read_string() {
+        const u32 length = read<u32>();
+        if (failed || static_cast<size_t>(end - current) < length) {
+            failed = true;
+            return {};
+        }
+        std::string value{reinterpret_cast<const char*>(current), length};
+        current += length;
+        return value;
+    }
+};
+
+template <typename T>
+static void write_value(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void write_string(std::ofstream& file, std::string_view value) {
+    write_value(file, static_cast<u32>(value.size()));
+    file.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+void CookManifest::load(const char* path) {
+    m_records_.clear();
+    if (!std::filesystem::exists(path)) {
+        return;
+    }
+    const io::MappedFile file{path, io::MapHint::SEQUENTIAL};
+    ManifestReader reader{file.data(), file.data() + file.size()};
+    const CookManifestHeader header = reader.read<CookManifestHeader>();
+    if (reader.failed || header.magic != COOK_MANIFEST_MAGIC || header.version != COOK_MANIFEST_VERSION) {
+        APP_LOG_WARN("Ignoring stale or corrupt cook manifest {}", path)
+        return;
+    }
+    m_records_.reserve(header.record_count);
+    for (u32 i = 0; i < header.record_count && !reader.failed; i++) {
+        CookRecord record;
+        record.source = reader.read_string();
+        record.key = reader.read<u64>();
+        record.output_hash = reader.read<u64>();
+        const u32 dependency_count = reader.read<u32>();
+        for (u32 j = 0; j < dependency_count && !reader.failed; j++) {
+            CookDependency dependency;
+            dependency.path = reader.read_string();
+            dependency.content_hash = reader.read<u64>();
+            record.dependencies.push_back(std::move(dependency));
+        }
+        if (!reader.failed) {
+            m_records_[record.source] = std::move(record);
+        }
+    }
+    if (reader.failed) {
+        APP_LOG_WARN("Ignoring stale or corrupt cook manifest {}", path)
+        m_records_.clear();
+    }
+}
+
+bool CookManifest::save(const char* path) const {
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        APP_LOG_ERROR("Failed to write cook manifest {}", path)
+        return false;
+    }
+    write_value(file, CookManifestHeader{COOK_MANIFEST_MAGIC, COOK_MANIFEST_VERSION, static_cast<u32>(m_records_.size()), 0});
+    for (const auto& [source, record] : m_records_) {
+        write_string(file, record.source);
+        write_value(file, record.key);
+        write_value(file, record.output_hash);
+        write_value(file, static_cast<u32>(record.dependencies.size()));
+        for (const CookDependency& dependency : record.dependencies) {
+            write_string(file, dependency.path);
+            write_value(file, dependency.content_hash);
+        }
+    }
+    return file.good();
+}
+
+const CookRecord* CookManifest::find(std::string_view source) const {
+    const auto it = m_records_.find(std::string{source});
+    return it == m_records_.end() ? nullptr : &it->second;
+}
+
+void CookManifest::set(CookRecord record) {
+    std::string source = record.source;
+    m_records_[std::move(source)] = std::move(record);
+}
+
+void CookManifest::retain(const robin_hood::unordered_flat_set<std::string>& sources) {
+    for (auto it = m_records_.begin(); it != m_records_.end();) {
+        if (sources.contains(it->first)) {
+            ++it;
+        } else {
+            it = m_records_.erase(it);
+        }
+    }
+}
+
+size_t CookManifest::size() const {
+    return m_records_.size();
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+#include "robin_hood.h"
+
+// A file an output was built from besides its source, e.g. a shader include
+struct CookDependency {
+    std::string path;
+    u64 content_hash;
+};
+
+struct CookRecord {
+    // Relative to the content root
+    std::string source;
+    // Cooker version, cook settings and the content hash of the source
+    u64 key;
+    u64 output_hash;
+    std::vector<CookDependency> dependencies;
+};
+
+// What every output was last cooked from, persisted between runs so a source
+// is only cooked again when it, one of its dependencies, the cooker or the
+// settings changed, or when its output went missing or was modified.
+class CookManifest {
+    robin_hood::unordered_node_map<std::string, CookRecord> m_records_;
+public:
+    // A missing, stale or corrupt manifest loads empty, which cooks everything
+    void load(const char* path);
+    bool save(const char* path) const;
+
+    const CookRecord* find(std::string_view source) const;
+    void set(CookRecord record);
+    // Drops the records of sources that no longer exist
+    void retain(const robin_hood::unordered_flat_set<std::string>& sources);
+    size_t size() const;
+};
@@ -0,0 +1,90 @@
+﻿#include "Cookers.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "Models/MeshFile.h"
+#include "Models/Vertex.h"
+#include "Rendering/ShaderCompiler.h"
+#include "Textures/TextureProcessing.h"
+
+static constexpr u32 SHADER_COOKER_VERSION = 1;
+
+// <base>.obj, .gltf and the other model sources cook to <base>.mesh, which
+// load_model maps without importing
+static std::string get_mesh_path(std::string_view source_path) {
+    return std::string{source_path.substr(0, source_path.rfind('.'))} + ".mesh";
+}
+
+static u64 get_model_settings_key(const CookSettings& settings) {
+    return settings.model_import_flags;
+}
+
+static bool cook_model(const CookSettings& settings, const std::string& source_path, const std::string& output_path, std::vector<std::string>& dependencies) {
+    // load_model keeps a cooked mesh whose source key still matches, so a
+    // modified or truncated output has to go first
+    std::error_code error;
+    std::filesystem::remove(output_path, error);
+    Arena arena{MODEL_IMPORT_ARENA_SIZE};
+    VertexIndexInfo model{arena};
+    const std::string base_path = source_path.substr(0, source_path.rfind('.'));
+    const bool loaded = model.load_model(arena, arena_string{base_path.data(), base_path.size(), STLArenaAllocator<char>{&arena}},
+        settings.model_import_flags, nullptr, settings.thread_pool);
+    // The external buffers and images of a .gltf, so editing one re-cooks it
+    dependencies = get_model_dependencies(source_path);
+    return loaded && std::filesystem::exists(output_path) && MeshFile{output_path.c_str()}.is_valid();
+}
+
+// Shaders cook to <source>.spv next to the source, like the hot reloader writes them
+static std::string get_spirv_path(std::string_view source_path) {
+    return std::string{source_path} + ".spv";
+}
+
+static bool cook_shader(const CookSettings&, const std::string& source_path, const std::string& output_path, std::vector<std::string>& dependencies) {
+    std::ifstream file{source_path, std::ios::binary};
+    const std::string contents{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    std::vector<u32> spirv;
+    if (!file.is_open() || !engine::compile_shader(source_path, contents, spirv, &dependencies)) {
+        return false;
+    }
+    std::ofstream output{output_path, std::ios::binary | std::ios::trunc};
+    output.write(reinterpret_cast<const char*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(u32)));
+    return output.good();
+}
+
+static bool is_texture_source(std::string_view source_path) {
+    return source_path.ends_with(".png") || source_path.ends_with(".jpg") || source_path.ends_with(".jpeg") || source_path.ends_with(".tga")
+        || source_path.ends_with(".bmp");
+}
+
+// <base>.png cooks to <base>.tex with every mip block compressed
+static std::string get_texture_path(std::string_view source_path) {
+    return std::string{source_path.substr(0, source_path.rfind('.'))} + ".tex";
+}
+
+static u64 get_texture_settings_key(const CookSettings& settings) {
+    return settings.fast_texture_encoding;
+}
+
+static bool cook_texture_source(const CookSettings& settings, const std::string& source_path, const std::string& output_path, std::vector<std::string>&) {
+    return cook_texture(source_path.c_str(), output_path.c_str(), settings.fast_texture_encoding, settings.thread_pool);
+}
+
+static constexpr Cooker COOKERS[] = {
+    {"mesh", MODEL_IMPORTER_VERSION, is_model_source, get_mesh_path, get_model_settings_key, cook_model},
+    {"shader", SHADER_COOKER_VERSION, engine::is_shader_source, get_spirv_path, nullptr, cook_shader},
+    {"texture", TEXTURE_COOKER_VERSION, is_texture_source, get_texture_path, get_texture_settings_key, cook_texture_source},
+};
+
+std::span<const Cooker> get_cookers() {
+    return COOKERS;
+}
+
+const Cooker* find_cooker(std::string_view source_path) {
+    for (const Cooker& cooker : COOKERS) {
+        if (cooker.accepts(source_path)) {
+            return &cooker;
+        }
+    }
+    return nullptr;
+}
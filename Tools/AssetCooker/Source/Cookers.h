@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+
+namespace engine {
+class ThreadPool;
+}
+
+struct CookSettings {
+    // Must match the flags the game loads models with, they are part of the cooked mesh's source key
+    u32 model_import_flags;
+    // BC1 and BC3 instead of BC7 for color textures, much faster to encode
+    bool fast_texture_encoding;
+    engine::ThreadPool* thread_pool;
+};
+
+// Turns one kind of source file into the format the game loads at runtime
+struct Cooker {
+    const char* name;
+    // Bump whenever the output changes for the same input, it re-cooks everything the cooker made
+    u32 version;
+    bool (*accepts)(std::string_view source_path);
+    std::string (*get_output_path)(std::string_view source_path);
+    // Hash of the settings the output depends on, 0 when there are none
+    u64 (*get_settings_key)(const CookSettings& settings);
+    // Writes the output, dependencies receives every other file it was built from
+    bool (*cook)(const CookSettings& settings, const std::string& source_path, const std::string& output_path, std::vector<std::string>& dependencies);
+};
+
+std::span<const Cooker> get_cookers();
+// The cooker for a source, nullptr for files that are not cooked
+const Cooker* find_cooker(std::string_view source_path);
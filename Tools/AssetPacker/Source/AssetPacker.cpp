@@ -0,0 +1,56 @@
+﻿#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+#include "common.h"
+#include "FileIO/PackFile.h"
+#include "Threading/ThreadPool.h"
+
+// Usage: AssetPacker <output.pak> <root> <content directory>... [--align <bytes>] [--no-compress]
+// Entries are named by their path relative to root, e.g. Models/cube.obj.
+// Meshes, shaders and other wholly read entries are stored as block streams
+// that decompress on every core, --no-compress stores everything as is.
+int main(int argc, char** argv) {
+    engine::Logger::Init();
+    if (argc < 4) {
+        APP_LOG_ERROR("Usage: AssetPacker <output.pak> <root> <content directory>... [--align <bytes>] [--no-compress]")
+        return 1;
+    }
+    const char* output_path = argv[1];
+    const char* root = argv[2];
+
+    u32 alignment = 64;
+    io::PackCompression (*choose_compression)(std::string_view) = io::get_default_pack_compression;
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--align") == 0) {
+            // Entries are placed with a mask, so anything but a power of two
+            // would misplace them
+            char* end = nullptr;
+            const unsigned long value = i + 1 < argc ? std::strtoul(argv[i + 1], &end, 10) : 0;
+            if (end == nullptr || *end != '\0' || value == 0 || value > (1ul << 30) || !std::has_single_bit(value)) {
+                APP_LOG_ERROR("--align needs a power of two number of bytes up to 1 GiB, got {}", i + 1 < argc ? argv[i + 1] : "nothing")
+                return 1;
+            }
+            alignment = static_cast<u32>(value);
+        } else if (std::strcmp(argv[i], "--no-compress") == 0) {
+            choose_compression = [](std::string_view) {
+                return io::PackCompression::NONE;
+            };
+        }
+    }
+
+    engine::ThreadPool thread_pool;
+    io::PackBuilder builder{alignment, &thread_pool};
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--align") == 0) {
+            i++;
+            continue;
+        }
+        if (std::strcmp(argv[i], "--no-compress") == 0) {
+            continue;
+        }
+        const u32 added = builder.add_directory(root, argv[i], choose_compression);
+        APP_LOG_INFO("Packing {} files from {}", added, argv[i])
+    }
+    return builder.write(output_path) ? 0 : 1;
+}
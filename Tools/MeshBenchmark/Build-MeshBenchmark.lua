@@ -0,0 +1,85 @@
+project "MeshBenchmark"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   targetdir "Binaries/%{cfg.buildcfg}"
+   staticruntime "off"
+   -- Default models are relative to the game directory
+   debugdir "../../Game"
+
+   local gameDir = "../../Game"
+
+   files { "Source/**.h", "Source/**.cpp",
+    gameDir .. "/Source/common.h",
+    gameDir .. "/Source/Compression/**.h", gameDir .. "/Source/Compression/**.cpp",
+    gameDir .. "/Source/Containers/**.h",
+    -- Only what importing needs, the inotify file watcher stays out
+    gameDir .. "/Source/FileIO/AssetIndex.h", gameDir .. "/Source/FileIO/AssetIndex.cpp",
+    gameDir .. "/Source/FileIO/AsyncIO.h", gameDir .. "/Source/FileIO/AsyncIO.cpp",
+    gameDir .. "/Source/FileIO/FileIO.h", gameDir .. "/Source/FileIO/FileIO.cpp",
+    gameDir .. "/Source/FileIO/PackFile.h", gameDir .. "/Source/FileIO/PackFile.cpp",
+    gameDir .. "/Source/Hashing/**.h", gameDir .. "/Source/Hashing/**.cpp",
+    gameDir .. "/Source/Logging/**.h", gameDir .. "/Source/Logging/**.cpp",
+    gameDir .. "/Source/Memory/**.h", gameDir .. "/Source/Memory/**.cpp",
+    gameDir .. "/Source/Models/**.h", gameDir .. "/Source/Models/**.cpp",
+    gameDir .. "/Source/Threading/**.h", gameDir .. "/Source/Threading/**.cpp",
+
+    gameDir .. "/Vendor/fmt/src/**.cc",
+    gameDir .. "/Vendor/spdlog/src/**.cpp" }
+
+   -- The doctest cases only build into the game
+   removefiles { gameDir .. "/Source/**Tests.cpp" }
+
+   defines
+   {
+       "GLM_FORCE_RADIANS",
+       "GLM_FORCE_DEPTH_ZERO_TO_ONE",
+       "SPDLOG_COMPILED_LIB",
+       "NOMINMAX",
+       "VC_EXTRALEAN",
+       "WIN32_LEAN_AND_MEAN",
+       "_CRT_SECURE_NO_WARNINGS",
+   }
+
+   includedirs
+   {
+      gameDir .. "/Source",
+      gameDir .. "/Vendor/assimp/include",
+      gameDir .. "/Vendor/concurrentqueue/",
+      gameDir .. "/Vendor/fmt/include",
+      gameDir .. "/Vendor/glm",
+      gameDir .. "/Vendor/robin-hood-hashing",
+      gameDir .. "/Vendor/spdlog/include",
+   }
+
+   links
+   {
+      "assimp"
+   }
+
+   targetdir ("../../Binaries/" .. outputdir .. "/%{prj.name}")
+   objdir ("../../Binaries/Intermediates/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+       systemversion "latest"
+       defines { "WINDOWS" }
+
+   filter "toolset:msc*"
+       buildoptions { "/utf-8", "/FS" }
+
+   filter "configurations:Debug"
+       defines { "DEBUG" }
+       runtime "Debug"
+       symbols "On"
+
+   filter "configurations:Release"
+       defines { "RELEASE", "NDEBUG" }
+       runtime "Release"
+       optimize "On"
+       symbols "On"
+
+   filter "configurations:Dist"
+       defines { "DIST", "NDEBUG" }
+       runtime "Release"
+       optimize "On"
+       symbols "Off"
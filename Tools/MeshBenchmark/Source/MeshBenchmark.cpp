@@ -0,0 +1,196 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "assimp/Importer.hpp"
+#include "assimp/postprocess.h"
+#include "assimp/scene.h"
+#include "common.h"
+#include "FileIO/FileIO.h"
+#include "Memory/Arena.h"
+#include "Models/MeshProcessing.h"
+#include "Models/ObjParser.h"
+#include "Models/Vertex.h"
+#include "Threading/ThreadPool.h"
+
+// Usage: MeshBenchmark [model.obj]... [--runs <count>]
+// Times the OBJ import and every stage of the mesh processing pipeline and
+// prints the vertex cache statistics before and after. Without models it
+// runs on the two the parser was tuned on, so run it from the Game directory.
+// Results go to stdout, outside Debug the loggers only print errors.
+static constexpr const char* DEFAULT_MODELS[] = {"Models/AK-47.obj", "Models/flat_vase.obj"};
+
+using Clock = std::chrono::steady_clock;
+
+static f64 get_milliseconds(Clock::time_point start) {
+    return std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+}
+
+// Pipeline stages in the order load_model runs them, summed over submeshes
+enum Stage : u32 {
+    WELD,
+    VERTEX_CACHE,
+    OVERDRAW,
+    MESHLETS,
+    VERTEX_FETCH,
+    LODS,
+    STAGE_COUNT
+};
+
+static constexpr const char* STAGE_NAMES[STAGE_COUNT] = {"weld", "vertex cache", "overdraw", "meshlets", "vertex fetch", "lods"};
+
+struct PipelineResult {
+    f64 stage_milliseconds[STAGE_COUNT];
+    u32 triangles;
+    u32 welded_vertices;
+    u32 fetched_vertices;
+    u32 shaded_before;
+    u32 shaded_after;
+    u32 meshlets;
+};
+
+// One pass over every submesh, the same steps cook_submesh takes
+static PipelineResult run_pipeline(std::span<const Vertex> vertices, std::span<const u32> indices, std::span<const Submesh> submeshes) {
+    PipelineResult result{};
+    for (const Submesh& submesh : submeshes) {
+        Arena arena{(submesh.vertex_count * sizeof(Vertex) + submesh.index_count * sizeof(u32) * 3) * 2 + 1024};
+        arena_vector<Vertex> submesh_vertices = MAKE_ARENA_VECTOR(&arena, Vertex);
+        arena_vector<u32> submesh_indices = MAKE_ARENA_VECTOR(&arena, u32);
+        submesh_vertices.assign(vertices.begin() + submesh.vertex_offset, vertices.begin() + submesh.vertex_offset + submesh.vertex_count);
+        submesh_indices.assign(indices.begin() + submesh.index_offset, indices.begin() + submesh.index_offset + submesh.index_count);
+
+        Clock::time_point start = Clock::now();
+        const WeldStats weld_stats = weld_vertices(submesh_vertices, submesh_indices);
+        result.stage_milliseconds[WELD] += get_milliseconds(start);
+        const u32 vertex_count = static_cast<u32>(submesh_vertices.size());
+        result.shaded_before += analyze_vertex_cache(submesh_indices, vertex_count).shaded_vertices;
+
+        start = Clock::now();
+        const std::vector<u32> clusters = optimize_vertex_cache(submesh_indices, vertex_count);
+        result.stage_milliseconds[VERTEX_CACHE] += get_milliseconds(start);
+
+        start = Clock::now();
+        optimize_overdraw(submesh_indices, submesh_vertices, clusters);
+        result.stage_milliseconds[OVERDRAW] += get_milliseconds(start);
+
+        start = Clock::now();
+        const std::vector<Meshlet> meshlets = build_meshlets(submesh_indices, submesh_vertices);
+        result.stage_milliseconds[MESHLETS] += get_milliseconds(start);
+
+        start = Clock::now();
+        optimize_vertex_fetch(submesh_vertices, submesh_indices);
+        result.stage_milliseconds[VERTEX_FETCH] += get_milliseconds(start);
+        result.shaded_after += analyze_vertex_cache(submesh_indices, static_cast<u32>(submesh_vertices.size())).shaded_vertices;
+        result.fetched_vertices += static_cast<u32>(submesh_vertices.size());
+
+        start = Clock::now();
+        std::vector<MeshLod> lods;
+        generate_lods(submesh_vertices, submesh_indices, lods);
+        result.stage_milliseconds[LODS] += get_milliseconds(start);
+
+        result.triangles += submesh.index_count / 3;
+        result.welded_vertices += weld_stats.vertices_after;
+        result.meshlets += static_cast<u32>(meshlets.size());
+    }
+    return result;
+}
+
+static bool benchmark_model(const char* path, u32 runs, engine::ThreadPool& thread_pool) {
+    if (!std::filesystem::exists(path)) {
+        APP_LOG_ERROR("{} does not exist", path)
+        return false;
+    }
+    const io::MappedFile source{path, io::MapHint::SEQUENTIAL};
+
+    // ReadFile alone, the copy into engine vertices comes on top of it
+    f64 assimp_best = 0.0;
+    for (u32 run = 0; run < runs; run++) {
+        const Clock::time_point start = Clock::now();
+        Assimp::Importer importer;
+        if (importer.ReadFile(path, aiProcess_Triangulate) == nullptr) {
+            APP_LOG_ERROR("Assimp failed to import {}: {}", path, importer.GetErrorString())
+            return false;
+        }
+        const f64 elapsed = get_milliseconds(start);
+        assimp_best = run == 0 ? elapsed : std::min(assimp_best, elapsed);
+    }
+
+    Arena arena{MODEL_IMPORT_ARENA_SIZE};
+    arena_vector<Vertex> vertices = MAKE_ARENA_VECTOR(&arena, Vertex);
+    arena_vector<u32> indices = MAKE_ARENA_VECTOR(&arena, u32);
+    arena_vector<Submesh> submeshes = MAKE_ARENA_VECTOR(&arena, Submesh);
+    f64 native_best = 0.0;
+    for (u32 run = 0; run < runs; run++) {
+        vertices.clear();
+        indices.clear();
+        submeshes.clear();
+        const Clock::time_point start = Clock::now();
+        if (!parse_obj(std::span<const byte>{source.data(), source.size()}, 0, &thread_pool, vertices, indices, submeshes)) {
+            APP_LOG_ERROR("{} has no faces", path)
+            return false;
+        }
+        const f64 elapsed = get_milliseconds(start);
+        native_best = run == 0 ? elapsed : std::min(native_best, elapsed);
+    }
+    std::printf("%s: %zu vertices, %zu triangles in %zu submeshes\n", path, vertices.size(), indices.size() / 3, submeshes.size());
+    std::printf("  parse        assimp %8.2fms  native %8.2fms\n", assimp_best, native_best);
+
+    PipelineResult best{};
+    for (u32 run = 0; run < runs; run++) {
+        const PipelineResult result = run_pipeline(vertices, indices, submeshes);
+        if (run == 0) {
+            best = result;
+            continue;
+        }
+        for (u32 stage = 0; stage < STAGE_COUNT; stage++) {
+            best.stage_milliseconds[stage] = std::min(best.stage_milliseconds[stage], result.stage_milliseconds[stage]);
+        }
+    }
+    f64 total = 0.0;
+    for (u32 stage = 0; stage < STAGE_COUNT; stage++) {
+        std::printf("  %-12s %8.2fms\n", STAGE_NAMES[stage], best.stage_milliseconds[stage]);
+        total += best.stage_milliseconds[stage];
+    }
+    std::printf("  %-12s %8.2fms\n", "pipeline", total);
+    const f32 triangles = static_cast<f32>(best.triangles);
+    std::printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %u meshlets\n", best.shaded_before / triangles, best.shaded_after / triangles,
+        best.shaded_before / static_cast<f32>(best.welded_vertices), best.shaded_after / static_cast<f32>(best.fetched_vertices), best.meshlets);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    engine::Logger::Init();
+    // Best of runs, the first one also pays for the page cache
+    u32 runs = 5;
+    std::vector<const char*> models;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--runs") == 0) {
+            char* end = nullptr;
+            const unsigned long value = i + 1 < argc ? std::strtoul(argv[i + 1], &end, 10) : 0;
+            if (end == nullptr || *end != '\0' || value == 0) {
+                APP_LOG_ERROR("--runs needs a positive count, got {}", i + 1 < argc ? argv[i + 1] : "nothing")
+                return 1;
+            }
+            runs = static_cast<u32>(value);
+            i++;
+        } else {
+            models.push_back(argv[i]);
+        }
+    }
+    if (models.empty()) {
+        models.assign(std::begin(DEFAULT_MODELS), std::end(DEFAULT_MODELS));
+    }
+
+    engine::ThreadPool thread_pool;
+    std::printf("Best of %u runs on %u threads\n", runs, thread_pool.get_thread_count());
+    bool succeeded = true;
+    for (const char* model : models) {
+        succeeded &= benchmark_model(model, runs, thread_pool);
+    }
+    return succeeded ? 0 : 1;
+}